@@ -293,6 +293,23 @@ fm::vector::ptr compute_pagerank(FG_graph::ptr fg, int num_iters,
 fm::vector::ptr compute_pagerank2(FG_graph::ptr, int num_iters,
 		float damping_factor);
 
+/**
+  * \brief Compute the PageRank of a graph with the push method in
+  *       the asynchronous mode of the graph engine. A vertex pushes
+  *       the change of its PageRank as soon as it receives updates,
+  *       and the vertices with larger changes run first. It runs until
+  *       no vertex has a noticeable change.
+  *
+  * \param fg The FlashGraph graph object for which you want to compute.
+  * \param damping_factor The damping factor. Originally .85.
+  *
+  * \return A vector with an entry for each vertex in the graph's
+  *         PageRank value.
+  *
+*/
+fm::vector::ptr compute_async_pagerank(FG_graph::ptr fg,
+		float damping_factor);
+
 fm::vector::ptr compute_sstsg(FG_graph::ptr fg, time_t start_time,
 		time_t interval, int num_intervals);
 
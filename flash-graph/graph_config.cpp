@@ -47,6 +47,8 @@ void graph_config::print_help()
 	printf("\tmin_vpart_degree: the min degree of a vertex to perform vertical partitioning\n");
 	printf("\tserial_run: run the user code on a vertex in serial\n");
 	printf("\tvertex_merge_gap: the gap size allowed when merging two vertex requests\n");
+	printf("\tpull_alpha: an iteration runs in the pull mode when the edges of active vertices exceed the edges of pull candidates divided by it (0 disables the pull mode)\n");
+	printf("\tpull_beta: an iteration after a pull iteration runs in the push mode when the active vertices are fewer than all vertices divided by it\n");
 }
 
 void graph_config::print()
@@ -65,6 +67,8 @@ void graph_config::print()
 	BOOST_LOG_TRIVIAL(info) << "\tmin_vpart_degree: " << min_vpart_degree;
 	BOOST_LOG_TRIVIAL(info) << "\tserial_run: " << serial_run;
 	BOOST_LOG_TRIVIAL(info) << "\tvertex_merge_gap: " << vertex_merge_gap;
+	BOOST_LOG_TRIVIAL(info) << "\tpull_alpha: " << pull_alpha;
+	BOOST_LOG_TRIVIAL(info) << "\tpull_beta: " << pull_beta;
 }
 
 void graph_config::init(config_map::ptr map)
@@ -94,6 +98,8 @@ void graph_config::init(config_map::ptr map)
 	map->read_option_int("min_vpart_degree", min_vpart_degree);
 	map->read_option_bool("serial_run", serial_run);
 	map->read_option_int("vertex_merge_gap", vertex_merge_gap);
+	map->read_option_int("pull_alpha", pull_alpha);
+	map->read_option_int("pull_beta", pull_beta);
 }
 
 }
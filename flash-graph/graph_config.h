@@ -48,6 +48,9 @@ class graph_config
 	bool serial_run;
 	// in pages.
 	int vertex_merge_gap;
+	// The parameters of switching between the push and pull modes.
+	int pull_alpha;
+	int pull_beta;
 public:
 	/**
 	 * \brief The default constructor that set all configurations to
@@ -67,6 +70,9 @@ public:
 		// When the gap is 0, it means two vertices either in the same page
 		// or two adjacent pages.
 		vertex_merge_gap = 0;
+		// The values used by direction-optimizing BFS.
+		pull_alpha = 14;
+		pull_beta = 24;
 	}
 
 	/**
@@ -196,6 +202,28 @@ public:
 	int get_vertex_merge_gap() const {
 		return vertex_merge_gap;
 	}
+
+	/**
+	 * \brief Get the parameter of switching an iteration to the pull mode.
+	 * If a graph algorithm supports the pull mode, an iteration runs in
+	 * the pull mode when the edges of the active vertices exceed
+	 * the edges of the pull candidates divided by the parameter.
+	 * \return the parameter. 0 disables the pull mode.
+	 */
+	int get_pull_alpha() const {
+		return pull_alpha;
+	}
+
+	/**
+	 * \brief Get the parameter of switching an iteration back to
+	 * the push mode. An iteration after a pull iteration runs in
+	 * the push mode when the active vertices are fewer than the vertices
+	 * in the graph divided by the parameter.
+	 * \return the parameter.
+	 */
+	int get_pull_beta() const {
+		return pull_beta;
+	}
 };
 
 extern graph_config graph_conf;
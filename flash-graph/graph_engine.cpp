@@ -31,6 +31,7 @@
 #include "vertex_compute.h"
 #include "vertex_request.h"
 #include "vertex_index_reader.h"
+#include "message_processor.h"
 #include "in_mem_storage.h"
 #include "FGlib.h"
 #include "sparse_matrix.h"
@@ -551,6 +552,12 @@ void graph_engine::init(graph_index::ptr index)
 
 	max_processing_vertices = graph_conf.get_max_processing_vertices();
 	is_complete = false;
+	pull_enabled = false;
+	push_edge = edge_type::OUT_EDGE;
+	num_frontier_vertices = 0;
+	pull_level = false;
+	async_enabled = false;
+	quiescent = false;
 	this->vertices = index;
 
 	pthread_mutex_init(&lock, NULL);
@@ -741,6 +748,7 @@ bool graph_engine::progress_first_level()
 				tot_num_activates.get());
 		// If there aren't more activated vertices.
 		is_complete = tot_num_activates.get() == 0;
+		num_frontier_vertices = tot_num_activates.get();
 		tot_num_activates = 0;
 		num_threads = 0;
 	}
@@ -757,6 +765,8 @@ bool graph_engine::progress_first_level()
 bool graph_engine::progress_next_level()
 {
 	static atomic_number<long> tot_num_activates;
+	static atomic_number<size_t> tot_frontier_edges;
+	static atomic_number<size_t> tot_candidate_edges;
 	static atomic_integer num_threads;
 	// We have to make sure all threads have reach here, so we can switch
 	// queues to progress to the next level.
@@ -768,6 +778,10 @@ bool graph_engine::progress_next_level()
 	worker_thread *curr = (worker_thread *) thread::get_curr_thread();
 	int num_activates = curr->enter_next_level();
 	tot_num_activates.inc(num_activates);
+	if (can_pull()) {
+		tot_frontier_edges.inc(curr->get_num_frontier_edges());
+		tot_candidate_edges.inc(curr->get_num_candidate_edges());
+	}
 	// If all threads have reached here.
 	if (num_threads.inc(1) == get_num_threads()) {
 		level.inc(1);
@@ -783,7 +797,21 @@ bool graph_engine::progress_next_level()
 				tot_num_activates.get());
 		// If there aren't more activated vertices.
 		is_complete = tot_num_activates.get() == 0;
+		pull_level = use_pull(tot_num_activates.get(),
+				tot_frontier_edges.get(), tot_candidate_edges.get());
+		num_frontier_vertices = tot_num_activates.get();
+		if (pull_level) {
+			BOOST_LOG_TRIVIAL(info)
+				<< boost::format("Iter %1% runs in the pull mode") % level.get();
+			// The candidates of the pull mode are counted below.
+			num_remaining_vertices_in_level = atomic_number<size_t>(0);
+		}
+		// No threads are running vertices now.
+		num_idle_threads = atomic_integer(0);
+		quiescent = false;
 		tot_num_activates = 0;
+		tot_frontier_edges = atomic_number<size_t>(0);
+		tot_candidate_edges = atomic_number<size_t>(0);
 		num_threads = 0;
 	}
 
@@ -793,9 +821,96 @@ bool graph_engine::progress_next_level()
 	if(rc != 0 && rc != PTHREAD_BARRIER_SERIAL_THREAD)
 		throw std::system_error(std::make_error_code((std::errc) rc),
 				"Could not wait on barrier");
+	if (pull_level && !is_complete) {
+		num_remaining_vertices_in_level.inc(curr->enter_pull_level());
+		// All frontiers have to be ready before any thread starts to run
+		// the vertices.
+		rc = pthread_barrier_wait(&barrier1);
+		if(rc != 0 && rc != PTHREAD_BARRIER_SERIAL_THREAD)
+			throw std::system_error(std::make_error_code((std::errc) rc),
+					"Could not wait on barrier");
+	}
 	return is_complete;
 }
 
+bool graph_engine::can_pull() const
+{
+	if (!pull_enabled || graph_conf.get_pull_alpha() <= 0)
+		return false;
+	// The pull mode needs to replace all active vertices in the default
+	// vertex queues.
+	return !scheduler && !async_enabled && graph_conf.get_num_vparts() <= 1;
+}
+
+/*
+ * This follows direction-optimizing BFS. A pull iteration reads the edges
+ * of the candidates until they find a neighbor in the frontier, so it pays
+ * off when the frontier is growing and has many edges to push along
+ * compared with the edges of the candidates. Once in the pull mode,
+ * the graph engine scans all vertices for the candidates in every
+ * iteration, so it stays in the pull mode until the frontier becomes small.
+ */
+bool graph_engine::use_pull(size_t num_active, size_t num_frontier_edges,
+		size_t num_candidate_edges) const
+{
+	if (!can_pull())
+		return false;
+	if (pull_level)
+		return num_active * graph_conf.get_pull_beta() >= get_num_vertices();
+	return num_active > num_frontier_vertices
+		&& num_frontier_edges * graph_conf.get_pull_alpha()
+		> num_candidate_edges;
+}
+
+/*
+ * An idle thread doesn't run vertices or send messages until it's woken up
+ * by messages, so if all threads are idle and no messages are in their
+ * queues, no more work can be generated. A thread that leaves the idle
+ * state between the checks may have fetched the messages that we missed,
+ * so we have to check the wakeups again in the end.
+ */
+bool graph_engine::is_quiescent()
+{
+	if (quiescent)
+		return true;
+
+	long num_wakeups = num_idle_wakeups.get();
+	if (num_idle_threads.get() < get_num_threads())
+		return false;
+	for (size_t i = 0; i < worker_threads.size(); i++) {
+		if (!worker_threads[i]->get_msg_processor().get_msg_queue().is_empty())
+			return false;
+	}
+	if (num_idle_wakeups.get() != num_wakeups)
+		return false;
+	quiescent = true;
+	// The other threads are blocked until they're woken up.
+	for (size_t i = 0; i < worker_threads.size(); i++)
+		worker_threads[i]->get_msg_processor().get_msg_queue().wakeup();
+	return true;
+}
+
+/*
+ * Every thread checks the quiescence before it blocks, so the last thread
+ * that becomes idle detects the end of the level and wakes up the others.
+ * If the check fails, a thread is either running or about to be woken up
+ * by messages, and it will check again when it becomes idle.
+ */
+bool graph_engine::wait4msgs(msg_queue &q)
+{
+	if (q.is_empty() && !is_quiescent())
+		q.wait4msgs(&quiescent);
+	return !q.is_empty();
+}
+
+bool graph_engine::is_in_frontier(vertex_id_t id) const
+{
+	int part_id;
+	off_t off;
+	get_partitioner()->map2loc(id, part_id, off);
+	return worker_threads[part_id]->is_in_frontier(local_vid_t(off));
+}
+
 void graph_engine::wait4complete()
 {
 	for (unsigned i = 0; i < worker_threads.size(); i++) {
@@ -812,9 +927,24 @@ void graph_engine::wait4complete()
 
 void graph_engine::set_vertex_scheduler(vertex_scheduler::ptr scheduler)
 {
+	// The asynchronous mode orders vertices by their priorities.
+	if (async_enabled)
+		throw unsupported_exception(
+				"a vertex scheduler in the asynchronous mode");
 	this->scheduler = scheduler;
 }
 
+void graph_engine::enable_async()
+{
+	if (scheduler)
+		throw unsupported_exception(
+				"a vertex scheduler in the asynchronous mode");
+	if (graph_conf.get_num_vparts() > 1)
+		throw unsupported_exception(
+				"vertical partitioning in the asynchronous mode");
+	async_enabled = true;
+}
+
 #if 0
 void graph_engine::preload_graph()
 {
@@ -86,6 +86,28 @@ public:
 	void notify_iteration_end(vertex_program & prog) {
 	}
 
+	/**
+	 * \brief In an iteration in the pull mode, the graph engine runs
+	 *        the vertices that return true here instead of the active
+	 *        vertices. See `graph_engine::enable_pull`. A vertex is
+	 *        expected to stop being a candidate once it runs as
+	 *        an active vertex, e.g., after BFS visits it.
+	 * \param prog The vertex program associated with running the graph algorithm.
+	 */
+	bool is_pull_candidate(vertex_program &prog) const {
+		return false;
+	}
+
+	/**
+	 * \brief The priority of the vertex when it's activated in the
+	 *        asynchronous mode. See `graph_engine::enable_async`.
+	 * \param prog The vertex program associated with running the graph algorithm.
+	 * \return The priority of the vertex.
+	 */
+	int get_priority(vertex_program &prog) const {
+		return 0;
+	}
+
 	/**
 	  * \brief This method is invoked by calling the `request_vertex_headers`
 	  *		method and is where one would access the vertex in/out edges.
@@ -347,6 +369,28 @@ class graph_engine
 	atomic_number<size_t> num_remaining_vertices_in_level;
 	atomic_integer level;
 	volatile bool is_complete;
+	// Whether the graph algorithm supports the pull mode.
+	bool pull_enabled;
+	// The edges that active vertices push updates along.
+	edge_type push_edge;
+	// The number of vertices activated for the current iteration.
+	size_t num_frontier_vertices;
+	// Whether the current iteration runs in the pull mode.
+	volatile bool pull_level;
+	// Whether the graph algorithm runs asynchronously.
+	bool async_enabled;
+
+	/*
+	 * These are used to detect the end of a level in the asynchronous mode.
+	 * A thread becomes idle when it has no work left and has sent all of
+	 * its messages, and it's woken up only by the messages from other
+	 * threads. The level ends when all threads are idle and there are no
+	 * messages in their queues.
+	 */
+	atomic_integer num_idle_threads;
+	// The number of times that idle threads are woken up.
+	atomic_number<long> num_idle_wakeups;
+	volatile bool quiescent;
 
 	// These are used for switching queues.
 	pthread_mutex_t lock;
@@ -365,6 +409,9 @@ class graph_engine
 	struct timeval start_time, iter_start;
 
 	void init_threads(vertex_program_creater::ptr creater);
+	// Determine whether the next iteration runs in the pull mode.
+	bool use_pull(size_t num_active, size_t num_frontier_edges,
+			size_t num_candidate_edges) const;
 protected:
 	graph_engine(FG_graph &graph, graph_index::ptr index);
 	void init(graph_index::ptr index);
@@ -468,6 +515,7 @@ public:
     /**
      * \brief Set the graph computation to use a custom vertex scheduler.
      * \param scheduler The user-defined vertex scheduler.
+     *        It can't be used in the asynchronous mode.
      */
 	void set_vertex_scheduler(vertex_scheduler::ptr scheduler);
     
@@ -550,6 +598,116 @@ public:
 		programs = vprograms;
 	}
 
+	/**
+	 * \brief Allow iterations to run in the pull mode.
+	 *
+	 * By default, the graph engine runs the active vertices in an iteration
+	 * and they push updates to their neighbors by activating them or
+	 * sending them messages. When the active vertices have many edges,
+	 * it's usually cheaper to have the vertices that still need updates
+	 * pull them from their neighbors. In such an iteration, the active
+	 * vertices form the frontier, and the graph engine runs the vertices
+	 * whose `is_pull_candidate` returns true instead. A vertex can test if
+	 * its neighbors are in the frontier with `is_in_frontier`.
+	 *
+	 * The graph engine decides the mode of each iteration automatically
+	 * in the same way as direction-optimizing BFS. It switches to the pull
+	 * mode when the frontier grows and its edges in the push direction
+	 * exceed the edges of the candidates in the pull direction divided by
+	 * `graph_config::get_pull_alpha`, and it switches back when
+	 * the frontier has fewer vertices than the graph divided by
+	 * `graph_config::get_pull_beta`.
+	 *
+	 * The pull mode doesn't work with a customized vertex scheduler,
+	 * the asynchronous mode or vertical partitioning.
+	 *
+	 * \param push_edge The edges that active vertices push updates along.
+	 *        The candidates pull updates along the edges in the opposite
+	 *        direction.
+	 */
+	void enable_pull(edge_type push_edge = edge_type::OUT_EDGE) {
+		pull_enabled = true;
+		this->push_edge = push_edge;
+	}
+
+	/**
+	 * \internal
+	 * \brief Determine whether iterations may run in the pull mode.
+	 */
+	bool can_pull() const;
+
+	/**
+	 * \brief Get the edges that active vertices push updates along.
+	 */
+	edge_type get_push_edge() const {
+		return push_edge;
+	}
+
+	/**
+	 * \brief Get the edges that the candidates of the pull mode pull
+	 *        updates along.
+	 */
+	edge_type get_pull_edge() const {
+		switch (push_edge) {
+			case edge_type::OUT_EDGE:
+				return edge_type::IN_EDGE;
+			case edge_type::IN_EDGE:
+				return edge_type::OUT_EDGE;
+			default:
+				return push_edge;
+		}
+	}
+
+	/**
+	 * \brief Determine whether the current iteration runs in the pull mode.
+	 * \return true if the current iteration runs in the pull mode.
+	 */
+	bool is_pull_level() const {
+		return pull_level;
+	}
+
+	/**
+	 * \brief Run the graph algorithm asynchronously.
+	 *
+	 * In the asynchronous mode, a vertex activated in an iteration runs
+	 * in the same iteration instead of the next one, so an iteration
+	 * doesn't end until no vertices are activated and no messages are
+	 * in flight in the graph engine. Each worker thread keeps its activated
+	 * vertices in buckets keyed by `compute_vertex::get_priority`, which is
+	 * evaluated when a vertex is activated, and runs the vertices in
+	 * the bucket of the highest priority first. A vertex should map its
+	 * pending update to a small range of priorities, e.g., the exponent
+	 * of the update in delta-based PageRank.
+	 *
+	 * The callbacks of vertices are invoked as in the synchronous mode,
+	 * but a vertex can't rely on the iteration number to decide what to
+	 * do, and `notify_iteration_end` and `run_on_iteration_end` are
+	 * invoked only when no more work is left. The asynchronous mode
+	 * doesn't work with a customized vertex scheduler, the pull mode,
+	 * vertical partitioning or load balancing. It throws
+	 * `unsupported_exception` if a vertex scheduler has been set or
+	 * vertical partitioning is enabled.
+	 * It has to be enabled before the graph engine starts.
+	 */
+	void enable_async();
+
+	/**
+	 * \brief Determine whether the graph algorithm runs asynchronously.
+	 * \return true if the graph algorithm runs asynchronously.
+	 */
+	bool is_async() const {
+		return async_enabled;
+	}
+
+	/**
+	 * \brief Determine whether a vertex is in the frontier of the current
+	 *        iteration in the pull mode, i.e., the vertex is activated for
+	 *        the current iteration.
+	 * \param id The vertex ID.
+	 * \return true if the vertex is in the frontier.
+	 */
+	bool is_in_frontier(vertex_id_t id) const;
+
 	/**
 	 * \brief This returns the current iteration number in the graph engine.
      * \return The current iteration number.
@@ -615,6 +773,14 @@ public:
 		num_remaining_vertices_in_level.dec(num);
 	}
 
+	/**
+	 * \internal
+	 * Vertices are activated in the current level in the asynchronous mode.
+	 */
+	void add_remaining_vertices(size_t num) {
+		num_remaining_vertices_in_level.inc(num);
+	}
+
 	/**
      * \internal Get the number of activated vertices that still haven't been
      * processed in the current level.
@@ -623,6 +789,44 @@ public:
 		return num_remaining_vertices_in_level.get();
 	}
 
+	/*
+	 * The following three methods detect the end of a level in
+	 * the asynchronous mode.
+	 */
+
+	/**
+	 * \internal
+	 * A worker thread has no work left and has flushed all of its messages.
+	 */
+	void enter_idle() {
+		num_idle_threads.inc(1);
+	}
+
+	/**
+	 * \internal
+	 * An idle worker thread has received messages. It has to be invoked
+	 * before the thread fetches the messages.
+	 */
+	void leave_idle() {
+		num_idle_threads.dec(1);
+		num_idle_wakeups.inc(1);
+	}
+
+	/**
+	 * \internal
+	 * Determine whether all worker threads are idle and no messages are
+	 * in flight. It's invoked by idle threads.
+	 */
+	bool is_quiescent();
+
+	/**
+	 * \internal
+	 * Block an idle worker thread until it receives messages or all
+	 * threads become quiescent. It returns true if the thread has
+	 * received messages.
+	 */
+	bool wait4msgs(msg_queue &q);
+
 	const in_mem_query_vertex_index::ptr get_in_mem_index() const {
 		return vindex;
 	}
@@ -0,0 +1,279 @@
+/*
+ * Copyright 2014 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of FlashGraph.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include <errno.h>
+
+#include <algorithm>
+
+#include "graph_reorder.h"
+#include "in_mem_storage.h"
+#include "fg_utils.h"
+
+namespace fg
+{
+
+void adj_lists::load(FILE *f, off_t off, size_t size,
+		vertex_index::ptr vindex, bool in_edges)
+{
+	data.resize(size);
+	if (fseek(f, off, SEEK_SET) != 0
+			|| fread(data.data(), size, 1, f) != 1) {
+		fprintf(stderr, "can't read the graph image: %s\n", strerror(errno));
+		exit(1);
+	}
+	offs.resize(vindex->get_num_vertices() + 1);
+	if (in_edges)
+		init_in_offs(vindex, offs);
+	else
+		init_out_offs(vindex, offs);
+	for (size_t i = 0; i < offs.size(); i++)
+		offs[i] -= off;
+}
+
+void graph_image::get_neighbors(vertex_id_t id,
+		std::vector<vertex_id_t> &neighs) const
+{
+	neighs.clear();
+	const ext_mem_undirected_vertex &v = out_lists.get_vertex(id);
+	for (size_t i = 0; i < v.get_num_edges(); i++)
+		neighs.push_back(v.get_neighbor(i));
+	if (directed) {
+		const ext_mem_undirected_vertex &in_v = in_lists.get_vertex(id);
+		for (size_t i = 0; i < in_v.get_num_edges(); i++)
+			neighs.push_back(in_v.get_neighbor(i));
+	}
+}
+
+graph_image::graph_image(const std::string &graph_file,
+		vertex_index::ptr vindex)
+{
+	num_vertices = vindex->get_num_vertices();
+	directed = vindex->get_graph_header().is_directed_graph();
+	FILE *f = fopen(graph_file.c_str(), "r");
+	if (f == NULL) {
+		fprintf(stderr, "can't open %s: %s\n", graph_file.c_str(),
+				strerror(errno));
+		exit(1);
+	}
+	out_lists.load(f, get_out_off(vindex), get_out_size(vindex), vindex,
+			false);
+	if (directed)
+		in_lists.load(f, get_in_off(vindex), get_in_size(vindex), vindex,
+				true);
+	fclose(f);
+
+	degrees.resize(num_vertices);
+	for (size_t i = 0; i < num_vertices; i++) {
+		degrees[i] = out_lists.get_vertex(i).get_num_edges();
+		if (directed)
+			degrees[i] += in_lists.get_vertex(i).get_num_edges();
+	}
+}
+
+/*
+ * The vertices with more edges are accessed more frequently, so we put them
+ * together.
+ */
+std::vector<vertex_id_t> degree_order(const graph_image &g)
+{
+	std::vector<vertex_id_t> order(g.get_num_vertices());
+	for (size_t i = 0; i < order.size(); i++)
+		order[i] = i;
+	std::stable_sort(order.begin(), order.end(),
+			[&g](vertex_id_t v1, vertex_id_t v2) {
+				return g.get_degree(v1) > g.get_degree(v2);
+			});
+	return order;
+}
+
+/*
+ * Reverse Cuthill-McKee. It traverses the graph in BFS order, starts from
+ * a vertex with the min degree in each connected component and visits
+ * the neighbors of a vertex in the ascending order of their degree.
+ * It keeps the neighbors of a vertex in a narrow range of vertex IDs.
+ */
+std::vector<vertex_id_t> rcm_order(const graph_image &g)
+{
+	size_t num_vertices = g.get_num_vertices();
+	std::vector<vertex_id_t> starts(num_vertices);
+	for (size_t i = 0; i < num_vertices; i++)
+		starts[i] = i;
+	std::stable_sort(starts.begin(), starts.end(),
+			[&g](vertex_id_t v1, vertex_id_t v2) {
+				return g.get_degree(v1) < g.get_degree(v2);
+			});
+
+	std::vector<bool> visited(num_vertices);
+	std::vector<vertex_id_t> order;
+	order.reserve(num_vertices);
+	std::vector<vertex_id_t> neighs;
+	for (size_t i = 0; i < num_vertices; i++) {
+		if (visited[starts[i]])
+			continue;
+		size_t head = order.size();
+		order.push_back(starts[i]);
+		visited[starts[i]] = true;
+		// The vertices in `order' after `head' are the BFS queue.
+		for (; head < order.size(); head++) {
+			g.get_neighbors(order[head], neighs);
+			size_t num_new = order.size();
+			for (size_t j = 0; j < neighs.size(); j++) {
+				if (!visited[neighs[j]]) {
+					visited[neighs[j]] = true;
+					order.push_back(neighs[j]);
+				}
+			}
+			std::stable_sort(order.begin() + num_new, order.end(),
+					[&g](vertex_id_t v1, vertex_id_t v2) {
+						return g.get_degree(v1) < g.get_degree(v2);
+					});
+		}
+	}
+	std::reverse(order.begin(), order.end());
+	return order;
+}
+
+/*
+ * This detects communities with label propagation and stores the vertices
+ * of a community together. The communities are placed in the RCM order,
+ * so the communities connected to each other are also close. Inside
+ * a community, the vertices are in the RCM order as well.
+ */
+std::vector<vertex_id_t> community_order(const graph_image &g, int num_iters)
+{
+	size_t num_vertices = g.get_num_vertices();
+	std::vector<vertex_id_t> labels(num_vertices);
+	for (size_t i = 0; i < num_vertices; i++)
+		labels[i] = i;
+
+	std::vector<vertex_id_t> neighs;
+	for (int iter = 0; iter < num_iters; iter++) {
+		size_t num_changes = 0;
+		for (size_t i = 0; i < num_vertices; i++) {
+			g.get_neighbors(i, neighs);
+			if (neighs.empty())
+				continue;
+			for (size_t j = 0; j < neighs.size(); j++)
+				neighs[j] = labels[neighs[j]];
+			std::sort(neighs.begin(), neighs.end());
+			// Take the most frequent label of the neighbors. The smallest
+			// label wins a tie, so the result is deterministic.
+			vertex_id_t best = labels[i];
+			size_t best_count = 0;
+			for (size_t j = 0; j < neighs.size();) {
+				size_t k = j;
+				while (k < neighs.size() && neighs[k] == neighs[j])
+					k++;
+				if (k - j > best_count) {
+					best_count = k - j;
+					best = neighs[j];
+				}
+				j = k;
+			}
+			if (best != labels[i]) {
+				labels[i] = best;
+				num_changes++;
+			}
+		}
+		printf("label propagation iter %d: %ld vertices change labels\n",
+				iter, num_changes);
+		if (num_changes == 0)
+			break;
+	}
+
+	std::vector<vertex_id_t> order = rcm_order(g);
+	// A community is placed where its first vertex is in the RCM order.
+	std::vector<vertex_id_t> comm_locs(num_vertices, INVALID_VERTEX_ID);
+	for (size_t i = 0; i < order.size(); i++) {
+		vertex_id_t label = labels[order[i]];
+		if (comm_locs[label] == INVALID_VERTEX_ID)
+			comm_locs[label] = i;
+	}
+	std::stable_sort(order.begin(), order.end(),
+			[&labels, &comm_locs](vertex_id_t v1, vertex_id_t v2) {
+				return comm_locs[labels[v1]] < comm_locs[labels[v2]];
+			});
+	return order;
+}
+
+/*
+ * The average distance between the IDs of two adjacent vertices.
+ * The smaller the distance is, the more likely the adjacency lists of
+ * the neighbors of a vertex are in the same pages.
+ */
+double get_avg_edge_span(const graph_image &g,
+		const std::vector<vertex_id_t> &old2new)
+{
+	double tot_span = 0;
+	size_t num_edges = 0;
+	for (size_t i = 0; i < g.get_num_vertices(); i++) {
+		const ext_mem_undirected_vertex &v = g.get_out_vertex(i);
+		for (size_t j = 0; j < v.get_num_edges(); j++) {
+			vertex_id_t id1 = old2new[i];
+			vertex_id_t id2 = old2new[v.get_neighbor(j)];
+			tot_span += id1 > id2 ? id1 - id2 : id2 - id1;
+		}
+		num_edges += v.get_num_edges();
+	}
+	return num_edges == 0 ? 0 : tot_span / num_edges;
+}
+
+static void get_new_edges(const ext_mem_undirected_vertex &v,
+		const std::vector<vertex_id_t> &old2new,
+		std::vector<vertex_id_t> &edges)
+{
+	edges.resize(v.get_num_edges());
+	for (size_t i = 0; i < edges.size(); i++)
+		edges[i] = old2new[v.get_neighbor(i)];
+	// The edges of a vertex are sorted in the graph image.
+	std::sort(edges.begin(), edges.end());
+}
+
+utils::mem_serial_graph::ptr relabel(const graph_image &g,
+		const std::vector<vertex_id_t> &new2old,
+		const std::vector<vertex_id_t> &old2new)
+{
+	utils::mem_serial_graph::ptr new_g = utils::mem_serial_graph::create(
+			g.is_directed(), 0);
+	std::vector<vertex_id_t> edges;
+	for (size_t new_id = 0; new_id < new2old.size(); new_id++) {
+		vertex_id_t old_id = new2old[new_id];
+		if (g.is_directed()) {
+			in_mem_directed_vertex<> v(new_id, false);
+			get_new_edges(g.get_in_vertex(old_id), old2new, edges);
+			for (size_t i = 0; i < edges.size(); i++)
+				v.add_in_edge(edge<>(edges[i], new_id));
+			get_new_edges(g.get_out_vertex(old_id), old2new, edges);
+			for (size_t i = 0; i < edges.size(); i++)
+				v.add_out_edge(edge<>(new_id, edges[i]));
+			new_g->add_vertex(v);
+		}
+		else {
+			in_mem_undirected_vertex<> v(new_id, false);
+			get_new_edges(g.get_out_vertex(old_id), old2new, edges);
+			for (size_t i = 0; i < edges.size(); i++)
+				v.add_edge(edge<>(new_id, edges[i]));
+			new_g->add_vertex(v);
+		}
+	}
+	return new_g;
+}
+
+}
@@ -0,0 +1,133 @@
+#ifndef __GRAPH_REORDER_H__
+#define __GRAPH_REORDER_H__
+
+/*
+ * Copyright 2014 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of FlashGraph.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+
+#include <vector>
+#include <string>
+
+#include "vertex.h"
+#include "vertex_index.h"
+#include "utils.h"
+
+/*
+ * The vertex orderings that relabel the vertices of a graph, so that
+ * the vertices accessed together are stored close to each other in
+ * the graph image. An ordering returns the original vertex IDs in
+ * the new order, i.e., the i-th entry is the vertex that gets the new ID i.
+ */
+
+namespace fg
+{
+
+/*
+ * The adjacency lists of a graph in memory. A directed graph has both
+ * in-edge and out-edge lists.
+ */
+class adj_lists
+{
+	std::vector<char> data;
+	std::vector<off_t> offs;
+public:
+	void load(FILE *f, off_t off, size_t size, vertex_index::ptr vindex,
+			bool in_edges);
+
+	const ext_mem_undirected_vertex &get_vertex(vertex_id_t id) const {
+		return *(const ext_mem_undirected_vertex *) (data.data() + offs[id]);
+	}
+
+	bool is_empty() const {
+		return data.empty();
+	}
+};
+
+class graph_image
+{
+	adj_lists out_lists;
+	adj_lists in_lists;
+	size_t num_vertices;
+	bool directed;
+	std::vector<vsize_t> degrees;
+public:
+	graph_image(const std::string &graph_file, vertex_index::ptr vindex);
+
+	size_t get_num_vertices() const {
+		return num_vertices;
+	}
+
+	bool is_directed() const {
+		return directed;
+	}
+
+	const ext_mem_undirected_vertex &get_out_vertex(vertex_id_t id) const {
+		return out_lists.get_vertex(id);
+	}
+
+	const ext_mem_undirected_vertex &get_in_vertex(vertex_id_t id) const {
+		return in_lists.get_vertex(id);
+	}
+
+	/*
+	 * The number of neighbors regardless of the edge direction.
+	 */
+	vsize_t get_degree(vertex_id_t id) const {
+		return degrees[id];
+	}
+
+	/*
+	 * Get the neighbors of a vertex regardless of the edge direction.
+	 */
+	void get_neighbors(vertex_id_t id, std::vector<vertex_id_t> &neighs) const;
+};
+
+/*
+ * The vertices with more edges come first.
+ */
+std::vector<vertex_id_t> degree_order(const graph_image &g);
+/*
+ * Reverse Cuthill-McKee.
+ */
+std::vector<vertex_id_t> rcm_order(const graph_image &g);
+/*
+ * The vertices of a community detected by label propagation are stored
+ * together. It runs label propagation for at most `num_iters' iterations.
+ */
+std::vector<vertex_id_t> community_order(const graph_image &g, int num_iters);
+
+/*
+ * The average distance between the IDs of two adjacent vertices after
+ * the vertices get the new IDs in `old2new'.
+ */
+double get_avg_edge_span(const graph_image &g,
+		const std::vector<vertex_id_t> &old2new);
+
+/*
+ * Build the graph with the new vertex IDs. `new2old' is the order returned
+ * by an ordering and `old2new' is its inverse.
+ */
+utils::mem_serial_graph::ptr relabel(const graph_image &g,
+		const std::vector<vertex_id_t> &new2old,
+		const std::vector<vertex_id_t> &old2new);
+
+}
+
+#endif
@@ -36,15 +36,35 @@ namespace
 
 edge_type traverse_edge = edge_type::OUT_EDGE;
 
+/*
+ * In an iteration in the pull mode, a vertex that hasn't been visited checks
+ * the edges in the opposite direction. It stops at the first neighbor in
+ * the frontier, which means it's reached by BFS, and activates itself for
+ * the next iteration. A vertex in the frontier that hasn't been visited is
+ * visited in the pull iteration without reading its edges, because its
+ * neighbors pull from it.
+ */
+bool in_frontier(vertex_program &prog, edge_seq_iterator &it)
+{
+	while (it.has_next()) {
+		if (prog.get_graph().is_in_frontier(it.next()))
+			return true;
+	}
+	return false;
+}
+
 /*
  * Vertex program for BFS on a directed graph.
  */
 class bfs_dvertex: public compute_directed_vertex
 {
 	bool visited;
+	// Whether the vertex reads its out-edges in a pull iteration.
+	bool pull_out;
 public:
 	bfs_dvertex(vertex_id_t id): compute_directed_vertex(id) {
 		visited = false;
+		pull_out = false;
 	}
 
 	bool has_visited() const {
@@ -55,22 +75,67 @@ public:
 		this->visited = visited;
 	}
 
+	bool is_pull_candidate(vertex_program &prog) const {
+		return !has_visited();
+	}
+
 	void run(vertex_program &prog) {
-		if (!has_visited()) {
-			directed_vertex_request req(prog.get_vertex_id(*this),
-					traverse_edge);
+		if (has_visited())
+			return;
+		vertex_id_t id = prog.get_vertex_id(*this);
+		graph_engine &graph = prog.get_graph();
+		if (!graph.is_pull_level()) {
+			directed_vertex_request req(id, traverse_edge);
+			request_partial_vertices(&req, 1);
+		}
+		else if (graph.is_in_frontier(id))
+			set_visited(true);
+		// When the vertex pulls from both directions, we read its in-edges
+		// first and read its out-edges only if none of its in-neighbors is
+		// in the frontier.
+		else
+			request_pull_edges(prog, graph.get_pull_edge() == BOTH_EDGES
+					? IN_EDGE : graph.get_pull_edge());
+	}
+
+	void request_pull_edges(vertex_program &prog, edge_type type) {
+		pull_out = type == OUT_EDGE;
+		vertex_id_t id = prog.get_vertex_id(*this);
+		graph_engine &graph = prog.get_graph();
+		// We don't need to read edges in a direction without edges.
+		if (graph.get_num_edges(id, type) > 0) {
+			directed_vertex_request req(id, type);
 			request_partial_vertices(&req, 1);
 		}
+		else if (type == IN_EDGE && graph.get_pull_edge() == BOTH_EDGES)
+			request_pull_edges(prog, OUT_EDGE);
 	}
 
 	void run(vertex_program &prog, const page_vertex &vertex);
+	void run_pull(vertex_program &prog, const page_vertex &vertex);
 
 	void run_on_message(vertex_program &prog, const vertex_message &msg) {
 	}
 };
 
+void bfs_dvertex::run_pull(vertex_program &prog, const page_vertex &vertex)
+{
+	edge_type type = pull_out ? OUT_EDGE : IN_EDGE;
+	edge_seq_iterator it = vertex.get_neigh_seq_it(type, 0,
+			vertex.get_num_edges(type));
+	if (in_frontier(prog, it))
+		prog.activate_vertex(vertex.get_id());
+	else if (type == IN_EDGE
+			&& prog.get_graph().get_pull_edge() == BOTH_EDGES)
+		request_pull_edges(prog, OUT_EDGE);
+}
+
 void bfs_dvertex::run(vertex_program &prog, const page_vertex &vertex)
 {
+	if (prog.get_graph().is_pull_level()) {
+		run_pull(prog, vertex);
+		return;
+	}
 	assert(!has_visited());
 	set_visited(true);
 
@@ -109,11 +174,22 @@ public:
 		return visited;
 	}
 
+	bool is_pull_candidate(vertex_program &prog) const {
+		return !has_visited();
+	}
+
 	void run(vertex_program &prog) {
-		if (!has_visited()) {
-			vertex_id_t id = prog.get_vertex_id(*this);
+		if (has_visited())
+			return;
+		vertex_id_t id = prog.get_vertex_id(*this);
+		graph_engine &graph = prog.get_graph();
+		if (!graph.is_pull_level())
+			request_vertices(&id, 1);
+		else if (graph.is_in_frontier(id))
+			visited = true;
+		// A vertex without edges can't be reached.
+		else if (graph.get_num_edges(id) > 0)
 			request_vertices(&id, 1);
-		}
 	}
 
 	void run(vertex_program &prog, const page_vertex &vertex);
@@ -124,6 +200,13 @@ public:
 
 void bfs_uvertex::run(vertex_program &prog, const page_vertex &vertex)
 {
+	if (prog.get_graph().is_pull_level()) {
+		edge_seq_iterator it = vertex.get_neigh_seq_it(edge_type::BOTH_EDGES,
+				0, vertex.get_num_edges(edge_type::BOTH_EDGES));
+		if (in_frontier(prog, it))
+			prog.activate_vertex(vertex.get_id());
+		return;
+	}
 	assert(!has_visited());
 	visited = true;
 
@@ -183,6 +266,7 @@ size_t bfs(FG_graph::ptr fg, vertex_id_t start_vertex, edge_type traverse_e)
 	else
 		index = NUMA_graph_index<bfs_uvertex>::create(fg->get_graph_header());
 	graph_engine::ptr graph = fg->create_engine(index);
+	graph->enable_pull(traverse_e);
 
 	traverse_edge = traverse_e;
 	printf("BFS starts\n");
@@ -140,26 +140,63 @@ public:
 	float get_delta() const {
 		return delta;
 	}
+
+	float get_value() const {
+		return delta;
+	}
+
+	void set_value(float delta) {
+		this->delta = delta;
+	}
 };
 
+/*
+ * A vertex pushes the change of its PageRank to its out-neighbors.
+ * It can run either synchronously or asynchronously because it only
+ * depends on the change that it hasn't pushed.
+ */
 class pgrank_vertex2: public compute_directed_vertex
 {
 	float new_pr;
-	float curr_itr_pr; // Current iteration's page rank
+	// The PageRank that has been pushed to the out-neighbors.
+	// It starts with 0 so that the vertex pushes its initial PageRank
+	// the first time it runs.
+	float curr_itr_pr;
+
+	float get_delta() const {
+		return new_pr - curr_itr_pr;
+	}
 public:
 	pgrank_vertex2(vertex_id_t id): compute_directed_vertex(id) {
-		this->curr_itr_pr = 1 - DAMPING_FACTOR; // Must be this
-		this->new_pr = curr_itr_pr;
+		this->curr_itr_pr = 0;
+		this->new_pr = 1 - DAMPING_FACTOR; // Must be this
 	}
 
 	float get_result() const{
 		return new_pr;
 	}
 
+	/*
+	 * In the asynchronous mode, the vertices with larger changes run first.
+	 * We use the exponent of the change to keep the number of priorities
+	 * small.
+	 */
+	int get_priority(vertex_program &prog) const {
+		float delta = std::fabs(get_delta());
+		if (delta <= TOLERANCE)
+			return std::numeric_limits<int>::min();
+		int exp;
+		std::frexp(delta, &exp);
+		return exp;
+	}
+
 	void run(vertex_program &prog) { 
 		// We perform pagerank for at most `max_num_iters' iterations.
 		if (prog.get_graph().get_curr_level() >= max_num_iters)
 			return;
+		// We don't need to read the edges if we don't push the change.
+		if (std::fabs(get_delta()) <= TOLERANCE)
+			return;
 		directed_vertex_request req(prog.get_vertex_id(*this),
 				edge_type::OUT_EDGE);
 		request_partial_vertices(&req, 1);
@@ -173,18 +210,32 @@ public:
 	}
 };
 
+class pgrank2_vertex_program: public vertex_program_impl<pgrank_vertex2>
+{
+public:
+	pgrank2_vertex_program() {
+		// A vertex only needs the sum of the deltas sent to it.
+		set_msg_combiner(msg_combiner::ptr(new sum_msg_combiner<pr_message>()));
+	}
+};
+
+class pgrank2_vertex_program_creater: public vertex_program_creater
+{
+public:
+	vertex_program::ptr create() const {
+		return vertex_program::ptr(new pgrank2_vertex_program());
+	}
+};
+
 void pgrank_vertex2::run(vertex_program &prog, const page_vertex &vertex)
 {
 	int num_dests = vertex.get_num_edges(OUT_EDGE);
 	edge_seq_iterator it = vertex.get_neigh_seq_it(OUT_EDGE, 0, num_dests);
 
-	// If this is the first iteration.
-	if (prog.get_graph().get_curr_level() == 0) {
-		pr_message msg(curr_itr_pr / num_dests * DAMPING_FACTOR);
-		prog.multicast_msg(it, msg);
-	}
-	else if (std::fabs(new_pr - curr_itr_pr) > TOLERANCE) {
-		pr_message msg((new_pr - curr_itr_pr) / num_dests * DAMPING_FACTOR);
+	// The vertex may have received more messages since it requested
+	// its edges, so we push all of the change it has now.
+	if (std::fabs(get_delta()) > TOLERANCE) {
+		pr_message msg(get_delta() / num_dests * DAMPING_FACTOR);
 		prog.multicast_msg(it, msg);
 		curr_itr_pr = new_pr;
 	}
@@ -254,8 +305,8 @@ fm::vector::ptr compute_pagerank(FG_graph::ptr fg, int num_iters,
 	return fm::vector::create(res_store);
 }
 
-fm::vector::ptr compute_pagerank2(FG_graph::ptr fg, int num_iters,
-		float damping_factor)
+static fm::vector::ptr run_pagerank2(FG_graph::ptr fg, int num_iters,
+		float damping_factor, bool async)
 {
 	bool directed = fg->get_graph_header().is_directed_graph();
 	if (!directed) {
@@ -275,9 +326,14 @@ fm::vector::ptr compute_pagerank2(FG_graph::ptr fg, int num_iters,
 			fg->get_graph_header());
 	graph_engine::ptr graph = fg->create_engine(index);
 	max_num_iters = num_iters;
-	BOOST_LOG_TRIVIAL(info)
-		<< boost::format("Pagerank (at maximal %1% iterations) starting")
-		% max_num_iters;
+	if (async) {
+		graph->enable_async();
+		BOOST_LOG_TRIVIAL(info) << "Asynchronous Pagerank starting";
+	}
+	else
+		BOOST_LOG_TRIVIAL(info)
+			<< boost::format("Pagerank (at maximal %1% iterations) starting")
+			% max_num_iters;
 	BOOST_LOG_TRIVIAL(info) << "prof_file: " << graph_conf.get_prof_file();
 #ifdef PROFILER
 	if (!graph_conf.get_prof_file().empty())
@@ -286,7 +342,8 @@ fm::vector::ptr compute_pagerank2(FG_graph::ptr fg, int num_iters,
 
 	struct timeval start, end;
 	gettimeofday(&start, NULL);
-	graph->start_all(); 
+	graph->start_all(vertex_initializer::ptr(),
+			vertex_program_creater::ptr(new pgrank2_vertex_program_creater()));
 	graph->wait4complete();
 	gettimeofday(&end, NULL);
 
@@ -307,4 +364,16 @@ fm::vector::ptr compute_pagerank2(FG_graph::ptr fg, int num_iters,
 	return fm::vector::create(res_store);
 }
 
+fm::vector::ptr compute_pagerank2(FG_graph::ptr fg, int num_iters,
+		float damping_factor)
+{
+	return run_pagerank2(fg, num_iters, damping_factor, false);
+}
+
+fm::vector::ptr compute_async_pagerank(FG_graph::ptr fg,
+		float damping_factor)
+{
+	return run_pagerank2(fg, INT_MAX, damping_factor, true);
+}
+
 }
@@ -44,6 +44,14 @@ public:
 	vertex_id_t get_id() const {
 		return id;
 	}
+
+	vertex_id_t get_value() const {
+		return id;
+	}
+
+	void set_value(vertex_id_t id) {
+		this->id = id;
+	}
 };
 
 class wcc_vertex: public compute_directed_vertex
@@ -101,6 +109,12 @@ class wcc_vertex_program: public vertex_program_impl<vertex_type>
 public:
 	typedef std::shared_ptr<wcc_vertex_program<vertex_type> > ptr;
 
+	wcc_vertex_program() {
+		// A vertex only needs the minimal component ID sent to it.
+		this->set_msg_combiner(msg_combiner::ptr(
+					new min_msg_combiner<component_message>()));
+	}
+
 	static ptr cast2(vertex_program::ptr prog) {
 		return std::static_pointer_cast<wcc_vertex_program<vertex_type>,
 			   vertex_program>(prog);
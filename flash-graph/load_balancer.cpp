@@ -27,7 +27,8 @@ namespace fg
 load_balancer::load_balancer(graph_engine &_graph,
 		worker_thread &_owner): owner(_owner), graph(_graph)
 {
-	steal_thread_id = (owner.get_worker_id() + 1) % graph.get_num_threads();
+	local_steal_idx = 0;
+	remote_steal_idx = 0;
 	// TODO can I have a better way to do it?
 	completed_stolen_vertices = (fifo_queue<vertex_id_t> *) malloc(
 			graph.get_num_threads() * sizeof(fifo_queue<vertex_id_t>));
@@ -45,36 +46,49 @@ load_balancer::~load_balancer()
 	free(completed_stolen_vertices);
 }
 
-/**
- * This steals vertices from other threads. It tries to steal more vertices
- * than it can process, and the remaining vertices will be placed in its
- * own activated vertex queue.
+/*
+ * The threads aren't all created when the load balancer is constructed,
+ * so we initialize the victims before the first steal.
  */
-int load_balancer::steal_activated_vertices(compute_vertex_pointer vertex_buf[],
-		int buf_size)
+void load_balancer::init_victims()
 {
-	if (steal_thread_id == owner.get_worker_id())
-		steal_thread_id = (steal_thread_id + 1) % graph.get_num_threads();
-	int num_tries = 0;
-	int num;
-	do {
-		worker_thread *t = graph.get_thread(steal_thread_id);
-		num_tries++;
+	int num_threads = graph.get_num_threads();
+	// Each thread starts from the thread next to it, so the threads don't
+	// steal from the same victim at the same time.
+	for (int i = 1; i < num_threads; i++) {
+		int id = (owner.get_worker_id() + i) % num_threads;
+		if (graph.get_thread(id)->get_node_id() == owner.get_node_id())
+			local_victims.push_back(id);
+		else
+			remote_victims.push_back(id);
+	}
+}
 
-		num = t->steal_activated_vertices(vertex_buf, buf_size);
+bool load_balancer::steal_from(const std::vector<int> &victims,
+		size_t &steal_idx, vertex_batch &batch)
+{
+	for (size_t i = 0; i < victims.size(); i++) {
+		worker_thread *t = graph.get_thread(victims[steal_idx]);
+		if (t->steal_activated_vertices(batch)) {
+			assert(batch.part_id >= 0);
+			return true;
+		}
 		// If we can't steal vertices from the thread, we should move
 		// to the next thread.
-		if (num == 0)
-			steal_thread_id = (steal_thread_id + 1) % graph.get_num_threads();
-		// If we have tried to steal vertices from all threads.
-	} while (num == 0 && num_tries < graph.get_num_threads());
-
-	// Record the owner thread of the stolen vertices.
-	for (int i = 0; i < num; i++)
-		stolen_vertex_map.insert(vertex_map_t::value_type(
-					vertex_buf[i].get(), steal_thread_id));
+		steal_idx = (steal_idx + 1) % victims.size();
+	}
+	return false;
+}
 
-	return num;
+/**
+ * This steals a batch of vertices from other threads.
+ */
+bool load_balancer::steal_activated_vertices(vertex_batch &batch)
+{
+	if (local_victims.empty() && remote_victims.empty())
+		init_victims();
+	return steal_from(local_victims, local_steal_idx, batch)
+		|| steal_from(remote_victims, remote_steal_idx, batch);
 }
 
 void load_balancer::process_completed_stolen_vertices()
@@ -99,29 +113,27 @@ void load_balancer::process_completed_stolen_vertices()
 	num_completed_stolen_vertices = 0;
 }
 
-void load_balancer::return_vertices(const compute_vertex_pointer vs[], int num)
+void load_balancer::return_vertices(const compute_vertex_pointer vs[], int num,
+		int part_id)
 {
 	for (int i = 0; i < num; i++) {
 		compute_vertex_pointer v = vs[i];
-		vertex_map_t::iterator it = stolen_vertex_map.find(v.get());
-		assert(it != stolen_vertex_map.end());
-		int part_id = it->second;
 		// We don't need to return verticalled partitioned vertices to their
 		// owner because messages are processed in the main vertices and the
 		// main vertices cannot be stolen by other threads.
 		if (!v.is_part()) {
-			if (completed_stolen_vertices[part_id].is_full()) {
-				completed_stolen_vertices[part_id].expand_queue(
-						completed_stolen_vertices[part_id].get_size() * 2);
-			}
 			// TODO we can return compute_vertex_pointer and so we don't
 			// map it back to local_vid_t.
 			vertex_id_t id = graph.get_graph_index().get_vertex_id(part_id,
 					*v.get());
+			assert(id != INVALID_VERTEX_ID);
+			if (completed_stolen_vertices[part_id].is_full()) {
+				completed_stolen_vertices[part_id].expand_queue(
+						completed_stolen_vertices[part_id].get_size() * 2);
+			}
 			completed_stolen_vertices[part_id].push_back(id);
 			num_completed_stolen_vertices++;
 		}
-		stolen_vertex_map.erase(it);
 	}
 }
 
@@ -132,13 +144,4 @@ void load_balancer::reset()
 	assert(num_completed_stolen_vertices == 0);
 }
 
-int load_balancer::get_stolen_vertex_part(const compute_vertex &v) const
-{
-	vertex_map_t::const_iterator it = stolen_vertex_map.find(&v);
-	if (it != stolen_vertex_map.end())
-		return it->second;
-	else
-		return -1;
-}
-
 }
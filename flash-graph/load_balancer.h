@@ -20,7 +20,7 @@
  * limitations under the License.
  */
 
-#include <unordered_map>
+#include <vector>
 
 #include "container.h"
 #include "vertex.h"
@@ -32,6 +32,7 @@ class worker_thread;
 class graph_engine;
 class compute_vertex;
 class compute_vertex_pointer;
+struct vertex_batch;
 
 /*
  * This class is to help balance the load.
@@ -40,34 +41,39 @@ class compute_vertex_pointer;
  */
 class load_balancer
 {
-	typedef std::unordered_map<const compute_vertex *, int> vertex_map_t;
-
 	worker_thread &owner;
 	graph_engine &graph;
 
-	// This map records the owner threads of vertices stolen from another
-	// partition.
-	vertex_map_t stolen_vertex_map;
-
 	// This is a local buffer that contains the completed stolen vertices.
 	// All vertices here need to be returned to their owner threads.
 	fifo_queue<vertex_id_t> *completed_stolen_vertices;
 	int num_completed_stolen_vertices;
-	// The thread where we should steal activated vertices from.
-	int steal_thread_id;
+
+	// The threads where we steal activated vertices from. We always try
+	// the threads on the same NUMA node first, so most stolen vertices
+	// are in the local memory.
+	std::vector<int> local_victims;
+	std::vector<int> remote_victims;
+	// The victims where we should start stealing next time.
+	size_t local_steal_idx;
+	size_t remote_steal_idx;
+
+	void init_victims();
+	bool steal_from(const std::vector<int> &victims, size_t &steal_idx,
+			vertex_batch &batch);
 public:
 	load_balancer(graph_engine &_graph, worker_thread &_owner);
 
 	~load_balancer();
 
-	int get_stolen_vertex_part(const compute_vertex &v) const;
-
-	int steal_activated_vertices(compute_vertex_pointer vertices[], int num);
+	bool steal_activated_vertices(vertex_batch &batch);
 	/**
 	 * After the thread finishes processing the stolen vertices, it needs to
-	 * return all the vertices to their owner threads.
+	 * return all the vertices to their owner threads. All vertices belong
+	 * to partition `part_id'.
 	 */
-	void return_vertices(const compute_vertex_pointer vs[], int num);
+	void return_vertices(const compute_vertex_pointer vs[], int num,
+			int part_id);
 
 	// This method is to return all completed stolen vertices to their owner
 	// threads.
@@ -28,7 +28,8 @@ namespace fg
 
 message_processor::message_processor(graph_engine &_graph,
 		worker_thread &_owner, std::shared_ptr<slab_allocator> msg_alloc): graph(_graph),
-	owner(_owner), msg_q(_owner.get_node_id(), "graph_msg_queue", 16, INT_MAX),
+	owner(_owner), msg_q(_owner.get_node_id(), "graph_msg_queue", 16, INT_MAX,
+			safs::params.get_msg_queue_ring_size()),
 	stolenv_msgs(_owner.get_node_id(), 4096, true)
 {
 	if (graph_conf.use_serial_run())
@@ -22,6 +22,73 @@
 namespace fg
 {
 
+void msg_queue::wait4msgs(volatile bool *stop)
+{
+	pthread_mutex_lock(&wait_mutex);
+	waiting = true;
+	// The waiting flag has to be visible before we check the queue,
+	// so a sender either sees the flag or we see its messages.
+	__sync_synchronize();
+	while (is_empty() && !*stop)
+		pthread_cond_wait(&wait_cond, &wait_mutex);
+	waiting = false;
+	pthread_mutex_unlock(&wait_mutex);
+}
+
+void msg_queue::wakeup()
+{
+	// The messages or the stop flag have to be visible before we check
+	// the waiting flag.
+	__sync_synchronize();
+	if (waiting) {
+		pthread_mutex_lock(&wait_mutex);
+		pthread_cond_signal(&wait_cond);
+		pthread_mutex_unlock(&wait_mutex);
+	}
+}
+
+void combined_msg_sender::send(const vertex_message &msg)
+{
+	if (msg_size == 0) {
+		msg_size = msg.get_serialized_size();
+		buf.resize(NUM_SLOTS * msg_size);
+	}
+	assert(msg.get_serialized_size() == msg_size);
+
+	vertex_id_t dest = msg.get_dest().id;
+	int slot = dest % NUM_SLOTS;
+	if (slot_dests[slot] == dest) {
+		vertex_message &combined = get_msg(slot);
+		combiner->combine(combined, msg);
+		// The vertex is activated if any of the messages activates it.
+		if (msg.is_activate())
+			combined.set_activate(true);
+		return;
+	}
+
+	if (slot_dests[slot] != INVALID_VERTEX_ID)
+		sender.send_cached(get_msg(slot));
+	else
+		num_used++;
+	msg.serialize((char *) &get_msg(slot), msg_size);
+	slot_dests[slot] = dest;
+}
+
+int combined_msg_sender::flush()
+{
+	if (num_used == 0)
+		return 0;
+
+	for (int i = 0; i < NUM_SLOTS; i++) {
+		if (slot_dests[i] != INVALID_VERTEX_ID) {
+			sender.send_cached(get_msg(i));
+			slot_dests[i] = INVALID_VERTEX_ID;
+		}
+	}
+	num_used = 0;
+	return 1;
+}
+
 int multicast_msg_sender::flush()
 {
 	if (buf.is_empty()) {
@@ -20,6 +20,8 @@
  * limitations under the License.
  */
 
+#include <vector>
+
 #include "slab_allocator.h"
 
 #include "vertex.h"
@@ -180,17 +182,57 @@ public:
 	}
 };
 
-class msg_queue: public thread_safe_FIFO_queue<message>
+class msg_queue: public MPSC_FIFO_queue<message>
 {
+	// These are used to block the owner thread until messages arrive.
+	pthread_mutex_t wait_mutex;
+	pthread_cond_t wait_cond;
+	volatile bool waiting;
 public:
+	/**
+	 * If `ring_size' is larger than 0, senders add messages to
+	 * a lock-free ring and only one thread can fetch messages.
+	 */
 	msg_queue(int node_id, const std::string _name, int init_size,
-			int max_size): thread_safe_FIFO_queue<message>(_name,
-				node_id, init_size, max_size) {
+			int max_size, int ring_size = 0): MPSC_FIFO_queue<message>(_name,
+				node_id, init_size, max_size, ring_size) {
+		pthread_mutex_init(&wait_mutex, NULL);
+		pthread_cond_init(&wait_cond, NULL);
+		waiting = false;
 	}
 
+	~msg_queue() {
+		pthread_mutex_destroy(&wait_mutex);
+		pthread_cond_destroy(&wait_cond);
+	}
+
+	virtual int add(message *msgs, int num) {
+		int ret = MPSC_FIFO_queue<message>::add(msgs, num);
+		wakeup();
+		return ret;
+	}
+
+	virtual int add(fifo_queue<message> *queue) {
+		int ret = MPSC_FIFO_queue<message>::add(queue);
+		wakeup();
+		return ret;
+	}
+
+	/**
+	 * Wait until the queue has messages or `stop' is set.
+	 * Only the thread that fetches messages from the queue can invoke it.
+	 */
+	void wait4msgs(volatile bool *stop);
+
+	/**
+	 * Wake up the thread waiting for messages. A thread that sets
+	 * the stop flag of the waiting thread has to invoke it.
+	 */
+	void wakeup();
+
 	static msg_queue *create(int node_id, const std::string name,
-			int init_size, int max_size) {
-		return new msg_queue(node_id, name, init_size, max_size);
+			int init_size, int max_size, int ring_size = 0) {
+		return new msg_queue(node_id, name, init_size, max_size, ring_size);
 	}
 
 	static void destroy(msg_queue *q) {
@@ -205,14 +247,14 @@ public:
 	 * It is also a heavy operation.
 	 */
 	int get_num_objs() {
-		int num = thread_safe_FIFO_queue<message>::get_num_entries();
+		int num = MPSC_FIFO_queue<message>::get_num_entries();
 		stack_array<message> msgs(num);
-		int ret = thread_safe_FIFO_queue<message>::fetch(msgs.data(), num);
+		int ret = MPSC_FIFO_queue<message>::fetch(msgs.data(), num);
 		int num_objs = 0;
 		for (int i = 0; i < ret; i++) {
 			num_objs += msgs[i].get_num_objs();
 		}
-		BOOST_VERIFY(ret == thread_safe_FIFO_queue<message>::add(
+		BOOST_VERIFY(ret == MPSC_FIFO_queue<message>::add(
 					msgs.data(), ret));
 		return num_objs;
 	}
@@ -333,6 +375,10 @@ public:
 		return activate;
 	}
 
+	void set_activate(bool activate) {
+		this->activate = activate;
+	}
+
 	bool is_multicast() const {
 		return multicast;
 	}
@@ -494,6 +540,152 @@ inline local_vid_t multicast_dest_list::get_dest(int idx) const
 	return local_vid_t(dest_list[idx]);
 }
 
+/**
+ * \brief A message combiner merges the messages sent to the same vertex
+ *        in a sender thread, so the destination vertex receives fewer
+ *        messages. A user can only use a combiner if the result of
+ *        processing the combined message is the same as processing
+ *        the original messages, e.g., the messages are summed up or only
+ *        the minimal one matters.
+ */
+class msg_combiner
+{
+public:
+	typedef std::shared_ptr<msg_combiner> ptr;
+
+	virtual ~msg_combiner() {
+	}
+
+	/**
+	 * \brief Merge a message into the combined message. Both messages are
+	 *        sent to the same vertex and have the same size.
+	 * \param combined The combined message.
+	 * \param msg The new message.
+	 */
+	virtual void combine(vertex_message &combined,
+			const vertex_message &msg) const = 0;
+};
+
+/**
+ * \brief Combine messages with a user-defined reduce function.
+ *        `ReduceOp' is invoked as `op(combined, msg)' on messages
+ *        of `MsgType' and stores the result in `combined'.
+ */
+template<class MsgType, class ReduceOp>
+class reduce_msg_combiner: public msg_combiner
+{
+	ReduceOp op;
+public:
+	virtual void combine(vertex_message &combined,
+			const vertex_message &msg) const {
+		op((MsgType &) combined, (const MsgType &) msg);
+	}
+};
+
+/*
+ * The reduce functions of the common combiners. They require `MsgType'
+ * to have get_value() and set_value().
+ */
+template<class MsgType>
+struct sum_msg_op
+{
+	void operator()(MsgType &combined, const MsgType &msg) const {
+		combined.set_value(combined.get_value() + msg.get_value());
+	}
+};
+
+template<class MsgType>
+struct min_msg_op
+{
+	void operator()(MsgType &combined, const MsgType &msg) const {
+		if (msg.get_value() < combined.get_value())
+			combined.set_value(msg.get_value());
+	}
+};
+
+template<class MsgType>
+struct max_msg_op
+{
+	void operator()(MsgType &combined, const MsgType &msg) const {
+		if (msg.get_value() > combined.get_value())
+			combined.set_value(msg.get_value());
+	}
+};
+
+/**
+ * \brief Sum the values of the messages sent to the same vertex.
+ */
+template<class MsgType>
+class sum_msg_combiner: public reduce_msg_combiner<MsgType, sum_msg_op<MsgType> >
+{
+};
+
+/**
+ * \brief Keep the minimal value of the messages sent to the same vertex.
+ */
+template<class MsgType>
+class min_msg_combiner: public reduce_msg_combiner<MsgType, min_msg_op<MsgType> >
+{
+};
+
+/**
+ * \brief Keep the maximal value of the messages sent to the same vertex.
+ */
+template<class MsgType>
+class max_msg_combiner: public reduce_msg_combiner<MsgType, max_msg_op<MsgType> >
+{
+};
+
+/*
+ * This sender keeps combined messages for the destination vertices in
+ * a thread in a direct-mapped table and merges the new messages to
+ * a vertex into its combined message. If a message is sent to another
+ * vertex mapped to the same slot, the combined message in the slot is
+ * sent with a simple_msg_sender first. Vertices that receive many
+ * messages, such as hubs in a power-law graph, usually stay in the table.
+ */
+class combined_msg_sender
+{
+	const static int NUM_SLOTS = 4096;
+
+	msg_combiner::ptr combiner;
+	simple_msg_sender &sender;
+	// All combined messages have the same size.
+	int msg_size;
+	std::vector<char> buf;
+	// The destination of the combined message in each slot.
+	std::vector<vertex_id_t> slot_dests;
+	int num_used;
+
+	combined_msg_sender(msg_combiner::ptr combiner,
+			simple_msg_sender &_sender): sender(_sender) {
+		this->combiner = combiner;
+		this->msg_size = 0;
+		this->num_used = 0;
+		slot_dests.resize(NUM_SLOTS, INVALID_VERTEX_ID);
+	}
+
+	vertex_message &get_msg(int slot) {
+		return *(vertex_message *) &buf[slot * msg_size];
+	}
+public:
+	static combined_msg_sender *create(msg_combiner::ptr combiner,
+			simple_msg_sender &sender) {
+		return new combined_msg_sender(combiner, sender);
+	}
+
+	static void destroy(combined_msg_sender *s) {
+		delete s;
+	}
+
+	/*
+	 * The destination of the message has to be set.
+	 */
+	void send(const vertex_message &msg);
+
+	int flush();
+};
+
 class multicast_msg_sender
 {
 	const static int MMSG_BUF_SIZE = 4096;
@@ -549,6 +741,10 @@ public:
 
 	bool add_dest(local_vid_t id);
 
+	int get_num_dests() const {
+		return num_dests;
+	}
+
 	void end_multicast() {
 		if (num_dests == 0) {
 			multicast_message *mmsg_template
@@ -311,6 +311,9 @@ void run_pagerank(FG_graph::ptr graph, int argc, char *argv[], int version)
 		case 2:
 			pr = compute_pagerank2(graph, num_iters, damping_factor);
 			break;
+		case 3:
+			pr = compute_async_pagerank(graph, damping_factor);
+			break;
 		default:
 			abort();
 	}
@@ -828,6 +831,7 @@ std::string supported_algs[] = {
 	"diameter",
 	"pagerank",
 	"pagerank2",
+	"async_pagerank",
 	"sstsg",
 	"ts_wcc",
 	"kcore",
@@ -855,7 +859,7 @@ void print_usage()
 	fprintf(stderr, "-s num: the number of sweeps performed in diameter estimation\n");
 	fprintf(stderr, "\n");
 	fprintf(stderr, "pagerank\n");
-	fprintf(stderr, "-i num: the maximum number of iterations\n");
+	fprintf(stderr, "-i num: the maximum number of iterations (ignored by async_pagerank)\n");
 	fprintf(stderr, "-D v: damping factor\n");
 	fprintf(stderr, "\n");
 	fprintf(stderr, "sstsg\n");
@@ -963,6 +967,9 @@ int main(int argc, char *argv[])
 	else if (alg == "pagerank2") {
 		run_pagerank(graph, argc, argv, 2);
 	}
+	else if (alg == "async_pagerank") {
+		run_pagerank(graph, argc, argv, 3);
+	}
 	else if (alg == "wcc") {
 		run_wcc(graph, argc, argv);
 	}
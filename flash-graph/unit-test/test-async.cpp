@@ -0,0 +1,239 @@
+#include <limits>
+#include <deque>
+#include <algorithm>
+
+#define BOOST_TEST_MODULE async
+#include <boost/test/included/unit_test.hpp>
+
+#include "graph_engine.h"
+#include "graph_config.h"
+#include "FGlib.h"
+#include "utils.h"
+#include "in_mem_storage.h"
+
+using namespace fg;
+
+const vertex_id_t MAX_DIST = std::numeric_limits<vertex_id_t>::max();
+vertex_id_t source;
+
+class dist_message: public vertex_message
+{
+	vertex_id_t dist;
+public:
+	dist_message(vertex_id_t dist): vertex_message(sizeof(dist_message),
+			true) {
+		this->dist = dist;
+	}
+
+	vertex_id_t get_dist() const {
+		return dist;
+	}
+};
+
+/*
+ * Compute the number of hops from the source vertex. A vertex pushes its
+ * distance to its out-neighbors whenever its distance becomes shorter.
+ */
+class dist_vertex: public compute_directed_vertex
+{
+	vertex_id_t dist;
+	bool updated;
+public:
+	dist_vertex(vertex_id_t id): compute_directed_vertex(id) {
+		dist = id == source ? 0 : MAX_DIST;
+		updated = id == source;
+	}
+
+	vertex_id_t get_dist() const {
+		return dist;
+	}
+
+	// The vertices closer to the source run first.
+	int get_priority(vertex_program &prog) const {
+		return dist == MAX_DIST ? std::numeric_limits<int>::min() : -(int) dist;
+	}
+
+	void run(vertex_program &prog) {
+		if (!updated)
+			return;
+		updated = false;
+		directed_vertex_request req(prog.get_vertex_id(*this), OUT_EDGE);
+		request_partial_vertices(&req, 1);
+	}
+
+	void run(vertex_program &prog, const page_vertex &vertex) {
+		edge_seq_iterator it = vertex.get_neigh_seq_it(OUT_EDGE, 0,
+				vertex.get_num_edges(OUT_EDGE));
+		dist_message msg(dist + 1);
+		prog.multicast_msg(it, msg);
+	}
+
+	void run_on_message(vertex_program &, const vertex_message &msg1) {
+		const dist_message &msg = (const dist_message &) msg1;
+		if (msg.get_dist() < dist) {
+			dist = msg.get_dist();
+			updated = true;
+		}
+	}
+};
+
+class dummy_scheduler: public vertex_scheduler
+{
+public:
+	void schedule(vertex_program &prog,
+			std::vector<compute_vertex_pointer> &vertices) {
+	}
+};
+
+config_map::ptr configs;
+
+void init_configs()
+{
+	if (configs)
+		return;
+	configs = config_map::create();
+	configs->add_options("threads=4");
+	try {
+		safs::init_io_system(configs, false);
+	} catch (safs::init_error &e) {
+	}
+	graph_conf.init(configs);
+}
+
+FG_graph::ptr create_graph(const std::vector<std::vector<vertex_id_t> > &out)
+{
+	size_t num_vertices = out.size();
+	std::vector<std::vector<vertex_id_t> > in(num_vertices);
+	for (size_t i = 0; i < num_vertices; i++) {
+		for (size_t j = 0; j < out[i].size(); j++)
+			in[out[i][j]].push_back(i);
+	}
+
+	utils::mem_serial_graph::ptr g = utils::mem_serial_graph::create(true, 0);
+	for (size_t i = 0; i < num_vertices; i++) {
+		std::vector<vertex_id_t> out_neighs = out[i];
+		std::sort(out_neighs.begin(), out_neighs.end());
+		out_neighs.erase(std::unique(out_neighs.begin(), out_neighs.end()),
+				out_neighs.end());
+		std::vector<vertex_id_t> in_neighs = in[i];
+		std::sort(in_neighs.begin(), in_neighs.end());
+		in_neighs.erase(std::unique(in_neighs.begin(), in_neighs.end()),
+				in_neighs.end());
+
+		in_mem_directed_vertex<> v(i, false);
+		for (size_t j = 0; j < out_neighs.size(); j++)
+			v.add_out_edge(edge<>(i, out_neighs[j]));
+		for (size_t j = 0; j < in_neighs.size(); j++)
+			v.add_in_edge(edge<>(in_neighs[j], i));
+		g->add_vertex(v);
+	}
+	vertex_index::ptr index = g->dump_index(false);
+	in_mem_graph::ptr data = g->dump_graph("test");
+	return FG_graph::create(data, index, "test", configs);
+}
+
+std::vector<vertex_id_t> bfs(const std::vector<std::vector<vertex_id_t> > &out)
+{
+	std::vector<vertex_id_t> dists(out.size(), MAX_DIST);
+	std::deque<vertex_id_t> queue;
+	dists[source] = 0;
+	queue.push_back(source);
+	while (!queue.empty()) {
+		vertex_id_t id = queue.front();
+		queue.pop_front();
+		for (size_t i = 0; i < out[id].size(); i++) {
+			vertex_id_t neigh = out[id][i];
+			if (dists[neigh] == MAX_DIST) {
+				dists[neigh] = dists[id] + 1;
+				queue.push_back(neigh);
+			}
+		}
+	}
+	return dists;
+}
+
+/*
+ * Run the graph algorithm asynchronously and check the distance of every
+ * vertex. All vertices should run in the first level, so the graph engine
+ * should stop right after it.
+ */
+void test_dists(const std::vector<std::vector<vertex_id_t> > &out)
+{
+	FG_graph::ptr fg = create_graph(out);
+	graph_index::ptr index = NUMA_graph_index<dist_vertex>::create(
+			fg->get_graph_header());
+	graph_engine::ptr graph = fg->create_engine(index);
+	graph->enable_async();
+	graph->start(&source, 1);
+	graph->wait4complete();
+	BOOST_CHECK_EQUAL(graph->get_curr_level(), 1);
+
+	std::vector<vertex_id_t> expected = bfs(out);
+	size_t num_wrong = 0;
+	for (size_t i = 0; i < out.size(); i++) {
+		dist_vertex &v = (dist_vertex &) graph->get_vertex(i);
+		if (v.get_dist() != expected[i])
+			num_wrong++;
+	}
+	BOOST_CHECK_EQUAL(num_wrong, 0U);
+}
+
+BOOST_AUTO_TEST_SUITE (async_test)
+
+/*
+ * The vertices on a chain are activated one at a time and consecutive
+ * vertices usually belong to different threads, so threads become idle
+ * and are woken up many times before the level ends.
+ */
+BOOST_AUTO_TEST_CASE (test_chain)
+{
+	init_configs();
+	const size_t num_vertices = 10000;
+	std::vector<vertex_id_t> chain(num_vertices);
+	for (size_t i = 0; i < num_vertices; i++)
+		chain[i] = i;
+	std::random_shuffle(chain.begin(), chain.end());
+	std::vector<std::vector<vertex_id_t> > out(num_vertices);
+	for (size_t i = 0; i + 1 < num_vertices; i++)
+		out[chain[i]].push_back(chain[i + 1]);
+	source = chain[0];
+	test_dists(out);
+}
+
+/*
+ * Vertices in a random graph are activated many times, often while they
+ * are still waiting for their edges.
+ */
+BOOST_AUTO_TEST_CASE (test_random)
+{
+	init_configs();
+	const size_t num_vertices = 100000;
+	std::vector<std::vector<vertex_id_t> > out(num_vertices);
+	for (size_t i = 0; i < num_vertices; i++) {
+		for (int j = 0; j < 4; j++)
+			out[i].push_back(random() % num_vertices);
+	}
+	source = 1;
+	test_dists(out);
+}
+
+BOOST_AUTO_TEST_CASE (test_unsupported)
+{
+	init_configs();
+	std::vector<std::vector<vertex_id_t> > out(100);
+	FG_graph::ptr fg = create_graph(out);
+	graph_index::ptr index = NUMA_graph_index<dist_vertex>::create(
+			fg->get_graph_header());
+	graph_engine::ptr graph = fg->create_engine(index);
+	graph->set_vertex_scheduler(vertex_scheduler::ptr(new dummy_scheduler()));
+	BOOST_CHECK_THROW(graph->enable_async(), unsupported_exception);
+
+	index = NUMA_graph_index<dist_vertex>::create(fg->get_graph_header());
+	graph = fg->create_engine(index);
+	graph->enable_async();
+	BOOST_CHECK_THROW(graph->set_vertex_scheduler(
+				vertex_scheduler::ptr(new dummy_scheduler())),
+			unsupported_exception);
+}
+
+BOOST_AUTO_TEST_SUITE_END( )
@@ -0,0 +1,256 @@
+#include <limits>
+#include <deque>
+#include <algorithm>
+
+#define BOOST_TEST_MODULE bfs_pull
+#include <boost/test/included/unit_test.hpp>
+
+#include "graph_engine.h"
+#include "graph_config.h"
+#include "FGlib.h"
+#include "utils.h"
+#include "in_mem_storage.h"
+
+using namespace fg;
+
+const int MAX_LEVEL = std::numeric_limits<int>::max();
+vertex_id_t source;
+// The number of vertices that run in the pull mode.
+atomic_number<size_t> num_pull_runs;
+
+/*
+ * BFS that records the level where a vertex is visited. In a push
+ * iteration, a visited vertex activates its out-neighbors. In a pull
+ * iteration, an unvisited vertex activates itself if one of its
+ * in-neighbors is in the frontier.
+ */
+class level_vertex: public compute_directed_vertex
+{
+	int level;
+public:
+	level_vertex(vertex_id_t id): compute_directed_vertex(id) {
+		level = MAX_LEVEL;
+	}
+
+	int get_level() const {
+		return level;
+	}
+
+	bool is_pull_candidate(vertex_program &prog) const {
+		return level == MAX_LEVEL;
+	}
+
+	void run(vertex_program &prog) {
+		if (level != MAX_LEVEL)
+			return;
+		graph_engine &graph = prog.get_graph();
+		vertex_id_t id = prog.get_vertex_id(*this);
+		if (!graph.is_pull_level()) {
+			level = graph.get_curr_level();
+			directed_vertex_request req(id, OUT_EDGE);
+			request_partial_vertices(&req, 1);
+		}
+		else if (graph.is_in_frontier(id))
+			level = graph.get_curr_level();
+		else {
+			num_pull_runs.inc(1);
+			directed_vertex_request req(id, IN_EDGE);
+			request_partial_vertices(&req, 1);
+		}
+	}
+
+	void run(vertex_program &prog, const page_vertex &vertex) {
+		if (prog.get_graph().is_pull_level()) {
+			edge_seq_iterator it = vertex.get_neigh_seq_it(IN_EDGE, 0,
+					vertex.get_num_edges(IN_EDGE));
+			while (it.has_next()) {
+				if (prog.get_graph().is_in_frontier(it.next())) {
+					prog.activate_vertex(vertex.get_id());
+					break;
+				}
+			}
+		}
+		else {
+			edge_seq_iterator it = vertex.get_neigh_seq_it(OUT_EDGE, 0,
+					vertex.get_num_edges(OUT_EDGE));
+			prog.activate_vertices(it);
+		}
+	}
+
+	void run_on_message(vertex_program &, const vertex_message &msg) {
+	}
+};
+
+config_map::ptr configs;
+
+void init_configs()
+{
+	if (configs)
+		return;
+	configs = config_map::create();
+	configs->add_options("threads=4");
+	try {
+		safs::init_io_system(configs, false);
+	} catch (safs::init_error &e) {
+	}
+	graph_conf.init(configs);
+}
+
+FG_graph::ptr create_graph(const std::vector<std::vector<vertex_id_t> > &out)
+{
+	size_t num_vertices = out.size();
+	std::vector<std::vector<vertex_id_t> > in(num_vertices);
+	for (size_t i = 0; i < num_vertices; i++) {
+		for (size_t j = 0; j < out[i].size(); j++)
+			in[out[i][j]].push_back(i);
+	}
+
+	utils::mem_serial_graph::ptr g = utils::mem_serial_graph::create(true, 0);
+	for (size_t i = 0; i < num_vertices; i++) {
+		std::vector<vertex_id_t> out_neighs = out[i];
+		std::sort(out_neighs.begin(), out_neighs.end());
+		out_neighs.erase(std::unique(out_neighs.begin(), out_neighs.end()),
+				out_neighs.end());
+		std::vector<vertex_id_t> in_neighs = in[i];
+		std::sort(in_neighs.begin(), in_neighs.end());
+		in_neighs.erase(std::unique(in_neighs.begin(), in_neighs.end()),
+				in_neighs.end());
+
+		in_mem_directed_vertex<> v(i, false);
+		for (size_t j = 0; j < out_neighs.size(); j++)
+			v.add_out_edge(edge<>(i, out_neighs[j]));
+		for (size_t j = 0; j < in_neighs.size(); j++)
+			v.add_in_edge(edge<>(in_neighs[j], i));
+		g->add_vertex(v);
+	}
+	vertex_index::ptr index = g->dump_index(false);
+	in_mem_graph::ptr data = g->dump_graph("test");
+	return FG_graph::create(data, index, "test", configs);
+}
+
+std::vector<int> bfs(const std::vector<std::vector<vertex_id_t> > &out)
+{
+	std::vector<int> levels(out.size(), MAX_LEVEL);
+	std::deque<vertex_id_t> queue;
+	levels[source] = 0;
+	queue.push_back(source);
+	while (!queue.empty()) {
+		vertex_id_t id = queue.front();
+		queue.pop_front();
+		for (size_t i = 0; i < out[id].size(); i++) {
+			vertex_id_t neigh = out[id][i];
+			if (levels[neigh] == MAX_LEVEL) {
+				levels[neigh] = levels[id] + 1;
+				queue.push_back(neigh);
+			}
+		}
+	}
+	return levels;
+}
+
+/*
+ * Run BFS in the graph engine and get the level of every vertex.
+ */
+std::vector<int> run_bfs(FG_graph::ptr fg, bool pull)
+{
+	graph_index::ptr index = NUMA_graph_index<level_vertex>::create(
+			fg->get_graph_header());
+	graph_engine::ptr graph = fg->create_engine(index);
+	if (pull)
+		graph->enable_pull(OUT_EDGE);
+	graph->start(&source, 1);
+	graph->wait4complete();
+
+	std::vector<int> levels(fg->get_graph_header().get_num_vertices());
+	for (size_t i = 0; i < levels.size(); i++)
+		levels[i] = ((level_vertex &) graph->get_vertex(i)).get_level();
+	return levels;
+}
+
+/*
+ * The levels in the pull mode should be the same as the ones in the push
+ * mode, and both should match the BFS computed here.
+ */
+void test_levels(const std::vector<std::vector<vertex_id_t> > &out,
+		bool expect_pull)
+{
+	FG_graph::ptr fg = create_graph(out);
+	std::vector<int> expected = bfs(out);
+
+	num_pull_runs = atomic_number<size_t>(0);
+	std::vector<int> push_levels = run_bfs(fg, false);
+	BOOST_CHECK_EQUAL(num_pull_runs.get(), 0U);
+
+	std::vector<int> pull_levels = run_bfs(fg, true);
+	if (expect_pull)
+		BOOST_CHECK(num_pull_runs.get() > 0);
+	else
+		BOOST_CHECK_EQUAL(num_pull_runs.get(), 0U);
+
+	size_t num_wrong_push = 0;
+	size_t num_wrong_pull = 0;
+	for (size_t i = 0; i < out.size(); i++) {
+		if (push_levels[i] != expected[i])
+			num_wrong_push++;
+		if (pull_levels[i] != push_levels[i])
+			num_wrong_pull++;
+	}
+	BOOST_CHECK_EQUAL(num_wrong_push, 0U);
+	BOOST_CHECK_EQUAL(num_wrong_pull, 0U);
+}
+
+BOOST_AUTO_TEST_SUITE (bfs_pull_test)
+
+/*
+ * The frontier of a random graph grows quickly, so the middle levels run
+ * in the pull mode and the last levels run in the push mode again.
+ */
+BOOST_AUTO_TEST_CASE (test_random)
+{
+	init_configs();
+	const size_t num_vertices = 100000;
+	std::vector<std::vector<vertex_id_t> > out(num_vertices);
+	for (size_t i = 0; i < num_vertices; i++) {
+		for (int j = 0; j < 8; j++)
+			out[i].push_back(random() % num_vertices);
+	}
+	source = 1;
+	test_levels(out, true);
+}
+
+/*
+ * A few vertices with many edges make the frontier have more edges than
+ * the rest of the graph early on.
+ */
+BOOST_AUTO_TEST_CASE (test_hubs)
+{
+	init_configs();
+	const size_t num_vertices = 50000;
+	std::vector<std::vector<vertex_id_t> > out(num_vertices);
+	for (size_t i = 0; i < num_vertices; i++) {
+		out[i].push_back(random() % num_vertices);
+		if (i % 1000 == 0) {
+			for (int j = 0; j < 5000; j++)
+				out[i].push_back(random() % num_vertices);
+		}
+	}
+	source = 0;
+	test_levels(out, true);
+}
+
+/*
+ * The frontier of a chain only has one vertex, so BFS never runs in
+ * the pull mode.
+ */
+BOOST_AUTO_TEST_CASE (test_chain)
+{
+	init_configs();
+	const size_t num_vertices = 1000;
+	std::vector<std::vector<vertex_id_t> > out(num_vertices);
+	for (size_t i = 0; i + 1 < num_vertices; i++)
+		out[i].push_back(i + 1);
+	source = 0;
+	test_levels(out, false);
+}
+
+BOOST_AUTO_TEST_SUITE_END( )
@@ -0,0 +1,180 @@
+#include <map>
+
+#define BOOST_TEST_MODULE combined_msg_sender
+#include <boost/test/included/unit_test.hpp>
+
+#include "messaging.h"
+
+using namespace fg;
+
+// A small buffer so that messages span multiple buffers.
+const int MSG_BUF_SIZE = 4096;
+
+class count_message: public vertex_message
+{
+	long value;
+public:
+	count_message(long value, bool activate): vertex_message(
+			sizeof(count_message), activate) {
+		this->value = value;
+	}
+
+	long get_value() const {
+		return value;
+	}
+
+	void set_value(long value) {
+		this->value = value;
+	}
+};
+
+struct test_env
+{
+	std::shared_ptr<slab_allocator> alloc;
+	msg_queue *queue;
+	simple_msg_sender *sender;
+	combined_msg_sender *combined;
+
+	test_env(msg_combiner::ptr combiner) {
+		alloc = std::shared_ptr<slab_allocator>(new slab_allocator(
+					"test-msg-allocator", MSG_BUF_SIZE, 1024 * 1024,
+					INT_MAX, 0));
+		queue = msg_queue::create(0, "test-msg-queue", 16, INT_MAX);
+		sender = simple_msg_sender::create(0, alloc, queue);
+		combined = combined_msg_sender::create(combiner, *sender);
+	}
+
+	~test_env() {
+		combined_msg_sender::destroy(combined);
+		simple_msg_sender::destroy(sender);
+		msg_queue::destroy(queue);
+	}
+
+	void send(vertex_id_t dest, long value, bool activate = false) {
+		count_message msg(value, activate);
+		msg.set_dest(local_vid_t(dest));
+		combined->send(msg);
+	}
+
+	/*
+	 * Flush both senders and collect all messages delivered to the queue.
+	 */
+	void fetch(std::vector<count_message> &msgs) {
+		combined->flush();
+		sender->flush();
+		int num = queue->get_num_entries();
+		std::vector<message> bufs(num);
+		BOOST_REQUIRE_EQUAL(queue->fetch(bufs.data(), num), num);
+		for (int i = 0; i < num; i++) {
+			while (bufs[i].has_next()) {
+				vertex_message *v_msgs[16];
+				int num_msgs = bufs[i].get_next(v_msgs, 16);
+				for (int j = 0; j < num_msgs; j++)
+					msgs.push_back(*(count_message *) v_msgs[j]);
+			}
+		}
+	}
+};
+
+BOOST_AUTO_TEST_SUITE (combined_msg_sender_test)
+
+BOOST_AUTO_TEST_CASE (test_combine_same_dest)
+{
+	test_env env(msg_combiner::ptr(new sum_msg_combiner<count_message>()));
+	for (int i = 1; i <= 100; i++)
+		env.send(5, i);
+	env.send(7, 3);
+
+	std::vector<count_message> msgs;
+	env.fetch(msgs);
+	BOOST_REQUIRE_EQUAL(msgs.size(), 2U);
+	std::map<vertex_id_t, long> vals;
+	for (size_t i = 0; i < msgs.size(); i++)
+		vals[msgs[i].get_dest().id] = msgs[i].get_value();
+	BOOST_CHECK_EQUAL(vals[5], 5050);
+	BOOST_CHECK_EQUAL(vals[7], 3);
+
+	// Nothing is left after a flush.
+	msgs.clear();
+	env.fetch(msgs);
+	BOOST_CHECK(msgs.empty());
+}
+
+BOOST_AUTO_TEST_CASE (test_slot_conflict)
+{
+	test_env env(msg_combiner::ptr(new min_msg_combiner<count_message>()));
+	// Two vertices that are mapped to the same slot keep evicting each
+	// other, so none of their messages is lost.
+	const vertex_id_t v1 = 1;
+	const vertex_id_t v2 = 1 + 4096;
+	long expected[2] = {LONG_MAX, LONG_MAX};
+	int num_sent = 0;
+	for (int i = 0; i < 10; i++) {
+		vertex_id_t dest = i % 3 == 0 ? v1 : v2;
+		long val = 100 - i * 7 % 13;
+		env.send(dest, val);
+		num_sent++;
+		long &min = expected[dest == v1 ? 0 : 1];
+		min = std::min(min, val);
+	}
+
+	std::vector<count_message> msgs;
+	env.fetch(msgs);
+	BOOST_CHECK(msgs.size() > 2);
+	BOOST_CHECK((int) msgs.size() <= num_sent);
+	long mins[2] = {LONG_MAX, LONG_MAX};
+	for (size_t i = 0; i < msgs.size(); i++) {
+		vertex_id_t dest = msgs[i].get_dest().id;
+		BOOST_REQUIRE(dest == v1 || dest == v2);
+		long &min = mins[dest == v1 ? 0 : 1];
+		min = std::min(min, msgs[i].get_value());
+	}
+	BOOST_CHECK_EQUAL(mins[0], expected[0]);
+	BOOST_CHECK_EQUAL(mins[1], expected[1]);
+}
+
+BOOST_AUTO_TEST_CASE (test_many_dests)
+{
+	test_env env(msg_combiner::ptr(new sum_msg_combiner<count_message>()));
+	// Send more destinations than the table has slots so that messages
+	// are evicted to the simple sender.
+	const int num_dests = 20000;
+	std::map<vertex_id_t, long> expected;
+	for (int i = 0; i < 200000; i++) {
+		vertex_id_t dest = random() % num_dests;
+		long val = random() % 10;
+		env.send(dest, val);
+		expected[dest] += val;
+	}
+
+	std::vector<count_message> msgs;
+	env.fetch(msgs);
+	BOOST_CHECK(msgs.size() < 200000U);
+	std::map<vertex_id_t, long> sums;
+	for (size_t i = 0; i < msgs.size(); i++)
+		sums[msgs[i].get_dest().id] += msgs[i].get_value();
+	BOOST_CHECK(sums == expected);
+}
+
+BOOST_AUTO_TEST_CASE (test_activate)
+{
+	test_env env(msg_combiner::ptr(new sum_msg_combiner<count_message>()));
+	env.send(9, 1, false);
+	env.send(9, 1, true);
+	env.send(9, 1, false);
+	env.send(11, 1, false);
+
+	std::vector<count_message> msgs;
+	env.fetch(msgs);
+	BOOST_REQUIRE_EQUAL(msgs.size(), 2U);
+	for (size_t i = 0; i < msgs.size(); i++) {
+		if (msgs[i].get_dest().id == 9) {
+			BOOST_CHECK(msgs[i].is_activate());
+			BOOST_CHECK_EQUAL(msgs[i].get_value(), 3);
+		}
+		else
+			BOOST_CHECK(!msgs[i].is_activate());
+	}
+}
+
+BOOST_AUTO_TEST_SUITE_END( )
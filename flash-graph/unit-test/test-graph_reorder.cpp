@@ -0,0 +1,178 @@
+#include <unistd.h>
+
+#include <set>
+#include <algorithm>
+
+#define BOOST_TEST_MODULE graph_reorder
+#include <boost/test/included/unit_test.hpp>
+
+#include "graph_reorder.h"
+#include "in_mem_storage.h"
+#include "utils.h"
+
+using namespace fg;
+
+typedef std::vector<std::set<vertex_id_t> > adj_t;
+
+const std::string graph_file = "/tmp/test-graph_reorder.adj";
+const std::string index_file = "/tmp/test-graph_reorder.index";
+
+/*
+ * Write the graph to the files and load it back as a graph image.
+ */
+std::shared_ptr<graph_image> dump_image(utils::mem_serial_graph::ptr g)
+{
+	g->dump_index(true)->dump(index_file);
+	g->dump_graph("test")->dump(graph_file);
+	std::shared_ptr<graph_image> image(new graph_image(graph_file,
+				vertex_index::load(index_file)));
+	unlink(graph_file.c_str());
+	unlink(index_file.c_str());
+	return image;
+}
+
+/*
+ * Create the graph image from the out-edges of the vertices. The out-edges
+ * of an undirected graph have to be symmetric.
+ */
+std::shared_ptr<graph_image> create_image(const adj_t &out, bool directed)
+{
+	size_t num_vertices = out.size();
+	adj_t in(num_vertices);
+	for (size_t i = 0; i < num_vertices; i++)
+		for (auto it = out[i].begin(); it != out[i].end(); it++)
+			in[*it].insert(i);
+
+	utils::mem_serial_graph::ptr g = utils::mem_serial_graph::create(
+			directed, 0);
+	for (size_t i = 0; i < num_vertices; i++) {
+		if (directed) {
+			in_mem_directed_vertex<> v(i, false);
+			for (auto it = in[i].begin(); it != in[i].end(); it++)
+				v.add_in_edge(edge<>(*it, i));
+			for (auto it = out[i].begin(); it != out[i].end(); it++)
+				v.add_out_edge(edge<>(i, *it));
+			g->add_vertex(v);
+		}
+		else {
+			in_mem_undirected_vertex<> v(i, false);
+			for (auto it = out[i].begin(); it != out[i].end(); it++)
+				v.add_edge(edge<>(i, *it));
+			g->add_vertex(v);
+		}
+	}
+	return dump_image(g);
+}
+
+std::set<vertex_id_t> get_edges(const ext_mem_undirected_vertex &v)
+{
+	std::set<vertex_id_t> edges;
+	for (size_t i = 0; i < v.get_num_edges(); i++)
+		edges.insert(v.get_neighbor(i));
+	BOOST_CHECK_EQUAL(edges.size(), v.get_num_edges());
+	return edges;
+}
+
+std::set<vertex_id_t> map_edges(const std::set<vertex_id_t> &edges,
+		const std::vector<vertex_id_t> &old2new)
+{
+	std::set<vertex_id_t> new_edges;
+	for (auto it = edges.begin(); it != edges.end(); it++)
+		new_edges.insert(old2new[*it]);
+	return new_edges;
+}
+
+/*
+ * The order has to be a permutation of the vertices, and the relabelled
+ * graph has to have edge (old2new[u], old2new[v]) for each edge (u, v)
+ * in the original graph and nothing else.
+ */
+void check_order(const graph_image &g, const std::vector<vertex_id_t> &new2old)
+{
+	size_t num_vertices = g.get_num_vertices();
+	BOOST_REQUIRE_EQUAL(new2old.size(), num_vertices);
+	std::vector<vertex_id_t> old2new(num_vertices, INVALID_VERTEX_ID);
+	for (size_t i = 0; i < num_vertices; i++) {
+		BOOST_REQUIRE(new2old[i] < num_vertices);
+		BOOST_REQUIRE_EQUAL(old2new[new2old[i]], INVALID_VERTEX_ID);
+		old2new[new2old[i]] = i;
+	}
+
+	std::shared_ptr<graph_image> new_g = dump_image(
+			relabel(g, new2old, old2new));
+	BOOST_REQUIRE_EQUAL(new_g->get_num_vertices(), num_vertices);
+	BOOST_REQUIRE_EQUAL(new_g->is_directed(), g.is_directed());
+	size_t num_wrong = 0;
+	for (size_t i = 0; i < num_vertices; i++) {
+		vertex_id_t new_id = old2new[i];
+		if (get_edges(new_g->get_out_vertex(new_id))
+				!= map_edges(get_edges(g.get_out_vertex(i)), old2new))
+			num_wrong++;
+		if (g.is_directed() && get_edges(new_g->get_in_vertex(new_id))
+				!= map_edges(get_edges(g.get_in_vertex(i)), old2new))
+			num_wrong++;
+	}
+	BOOST_CHECK_EQUAL(num_wrong, 0U);
+}
+
+void check_orders(const adj_t &out, bool directed)
+{
+	std::shared_ptr<graph_image> g = create_image(out, directed);
+	check_order(*g, degree_order(*g));
+	check_order(*g, rcm_order(*g));
+	check_order(*g, community_order(*g, 10));
+	// The communities aren't stable yet after a single iteration.
+	check_order(*g, community_order(*g, 1));
+}
+
+/*
+ * A few random components of different sizes and some isolated vertices.
+ */
+adj_t create_random(size_t num_vertices, bool directed)
+{
+	adj_t out(num_vertices);
+	size_t comp_start = 0;
+	while (comp_start < num_vertices) {
+		size_t comp_size = std::min<size_t>(random() % 200 + 1,
+				num_vertices - comp_start);
+		for (size_t i = 0; i < comp_size * 3; i++) {
+			vertex_id_t from = comp_start + random() % comp_size;
+			vertex_id_t to = comp_start + random() % comp_size;
+			if (from == to)
+				continue;
+			out[from].insert(to);
+			if (!directed)
+				out[to].insert(from);
+		}
+		// Skip a vertex so that it's isolated.
+		comp_start += comp_size + 1;
+	}
+	return out;
+}
+
+BOOST_AUTO_TEST_SUITE (graph_reorder_test)
+
+BOOST_AUTO_TEST_CASE (test_directed)
+{
+	check_orders(create_random(1000, true), true);
+}
+
+BOOST_AUTO_TEST_CASE (test_undirected)
+{
+	check_orders(create_random(1000, false), false);
+}
+
+/*
+ * A directed chain: each vertex has one in-edge and one out-edge, so
+ * the in-edges and out-edges of a vertex must not be swapped by relabelling.
+ */
+BOOST_AUTO_TEST_CASE (test_chain)
+{
+	const size_t num_vertices = 100;
+	adj_t out(num_vertices);
+	for (size_t i = 0; i + 1 < num_vertices; i++)
+		out[(i * 37) % num_vertices].insert(((i + 1) * 37) % num_vertices);
+	check_orders(out, true);
+}
+
+BOOST_AUTO_TEST_SUITE_END( )
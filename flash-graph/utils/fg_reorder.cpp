@@ -0,0 +1,131 @@
+/*
+ * Copyright 2014 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of FlashGraph.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * This relabels the vertices of a graph in FlashGraph format, so that
+ * the vertices accessed together are stored close to each other in
+ * the graph image. It writes a new graph image, its index and the map
+ * from the original vertex IDs to the new ones.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include <vector>
+#include <string>
+
+#include "vertex_index.h"
+#include "in_mem_storage.h"
+#include "graph_reorder.h"
+
+using namespace fg;
+
+void print_usage()
+{
+	fprintf(stderr, "relabel vertices to improve the locality of a graph\n");
+	fprintf(stderr, "fg_reorder [options] graph_file index_file new_graph_name\n");
+	fprintf(stderr, "-o order: degree, rcm (default) or community\n");
+	fprintf(stderr, "-i num: the max number of label propagation iterations in community order\n");
+	fprintf(stderr, "The new graph is stored in new_graph_name.adj and new_graph_name.index.\n");
+	fprintf(stderr, "new_graph_name.map stores the new ID of each vertex as an array of vertex_id_t.\n");
+}
+
+int main(int argc, char *argv[])
+{
+	std::string order_name = "rcm";
+	int num_iters = 10;
+	int opt;
+	while ((opt = getopt(argc, argv, "o:i:")) != -1) {
+		switch (opt) {
+			case 'o':
+				order_name = optarg;
+				break;
+			case 'i':
+				num_iters = atoi(optarg);
+				break;
+			default:
+				print_usage();
+				exit(1);
+		}
+	}
+	if (argc - optind < 3) {
+		print_usage();
+		exit(1);
+	}
+
+	std::string graph_file = argv[optind];
+	std::string index_file = argv[optind + 1];
+	std::string graph_name = argv[optind + 2];
+	std::string adj_file = graph_name + ".adj";
+	std::string new_index_file = graph_name + ".index";
+	std::string map_file = graph_name + ".map";
+
+	vertex_index::ptr vindex = vertex_index::load(index_file);
+	if (vindex->get_graph_header().has_edge_data()) {
+		fprintf(stderr, "fg_reorder doesn't support graphs with edge data\n");
+		return -1;
+	}
+	graph_image g(graph_file, vindex);
+	vindex = NULL;
+
+	std::vector<vertex_id_t> new2old;
+	if (order_name == "degree")
+		new2old = degree_order(g);
+	else if (order_name == "rcm")
+		new2old = rcm_order(g);
+	else if (order_name == "community")
+		new2old = community_order(g, num_iters);
+	else {
+		fprintf(stderr, "unknown order: %s\n", order_name.c_str());
+		print_usage();
+		return -1;
+	}
+	assert(new2old.size() == g.get_num_vertices());
+
+	std::vector<vertex_id_t> old2new(new2old.size());
+	std::vector<vertex_id_t> identity(new2old.size());
+	for (size_t i = 0; i < new2old.size(); i++) {
+		old2new[new2old[i]] = i;
+		identity[i] = i;
+	}
+	printf("avg edge span: %.1f before reordering, %.1f after reordering\n",
+			get_avg_edge_span(g, identity), get_avg_edge_span(g, old2new));
+
+	utils::mem_serial_graph::ptr new_g = relabel(g, new2old, old2new);
+	new_g->dump_index(true)->dump(new_index_file);
+	new_g->dump_graph(graph_name)->dump(adj_file);
+
+	FILE *f = fopen(map_file.c_str(), "w");
+	if (f == NULL) {
+		fprintf(stderr, "can't open %s: %s\n", map_file.c_str(),
+				strerror(errno));
+		return -1;
+	}
+	if (fwrite(old2new.data(), sizeof(old2new[0]), old2new.size(), f)
+			!= old2new.size()) {
+		fprintf(stderr, "can't write %s: %s\n", map_file.c_str(),
+				strerror(errno));
+		fclose(f);
+		return -1;
+	}
+	fclose(f);
+	return 0;
+}
@@ -33,12 +33,14 @@ request_range vertex_compute::get_next_request()
 	requested_vertices.pop();
 	data_loc_t loc(graph->get_file_id(), info.get_off());
 	num_issued++;
-	return request_range(loc, info.get_size(), READ, this);
+	// A vertex requests other vertices one by one and waits for them,
+	// so these are latency-sensitive point lookups.
+	return request_range(loc, info.get_size(), READ, this, IO_PRIO_LATENCY);
 }
 
 void vertex_compute::start_run()
 {
-	issue_thread->start_run_vertex(v);
+	issue_thread->start_run_vertex(v, part_id);
 }
 
 void vertex_compute::finish_run()
@@ -52,7 +54,7 @@ void vertex_compute::finish_run()
 		// this is to double check. If there are pending requests,
 		// the vertex shouldn't have issued requests in this run.
 		BOOST_VERIFY(!issued_reqs);
-		issue_thread->complete_vertex(v);
+		issue_thread->complete_vertex(v, part_id);
 	}
 }
 
@@ -90,6 +92,7 @@ void vertex_compute::issue_io_request(const ext_mem_vertex_info &info)
 		// Otherwise, we need to issue the I/O request to SAFS explicitly.
 		data_loc_t loc(graph->get_file_id(), info.get_off());
 		io_request req(this, loc, info.get_size(), READ);
+		req.set_prio_class(IO_PRIO_LATENCY);
 		num_issued++;
 		issue_thread->issue_io_request(req);
 	}
@@ -202,10 +205,12 @@ void directed_vertex_compute::issue_io_request(const ext_mem_vertex_info &in_inf
 		// Otherwise, we need to issue the I/O request to SAFS explicitly.
 		data_loc_t loc1(graph->get_file_id(), in_info.get_off());
 		io_request req1(this, loc1, in_info.get_size(), READ);
+		req1.set_prio_class(IO_PRIO_LATENCY);
 		issue_thread->issue_io_request(req1);
 
 		data_loc_t loc2(graph->get_file_id(), out_info.get_off());
 		io_request req2(this, loc2, out_info.get_size(), READ);
+		req2.set_prio_class(IO_PRIO_LATENCY);
 		issue_thread->issue_io_request(req2);
 		num_issued += 2;
 	}
@@ -220,13 +225,15 @@ void directed_vertex_compute::request_num_edges(vertex_id_t ids[], size_t num)
 			num, *this);
 }
 
-void merged_vertex_compute::start_run(compute_vertex_pointer v)
+void merged_vertex_compute::start_run(compute_vertex_pointer v, vertex_id_t id)
 {
-	issue_thread->start_run_vertex(v);
+	// The vertex may have been stolen from another thread.
+	issue_thread->start_run_vertex(v, get_graph().get_partitioner()->map(id));
 }
 
 void merged_vertex_compute::finish_run(compute_vertex_pointer v)
 {
+	int part_id = issue_thread->get_curr_part_id();
 	bool issued_reqs = issue_thread->finish_run_vertex(v);
 	// TODO we have to make sure that this vertex didn't issue another vertex
 	// request.
@@ -236,7 +243,7 @@ void merged_vertex_compute::finish_run(compute_vertex_pointer v)
 	// We need to notify the thread that initiate processing the vertex
 	// of the completion of the vertex.
 	if (!issued_reqs)
-		issue_thread->complete_vertex(v);
+		issue_thread->complete_vertex(v, part_id);
 }
 
 void merged_undirected_vertex_compute::run(page_byte_array &array)
@@ -251,7 +258,7 @@ void merged_undirected_vertex_compute::run(page_byte_array &array)
 		page_undirected_vertex pg_v(sub_arr);
 		assert(pg_v.get_id() == id);
 		compute_vertex_pointer v(&get_graph().get_vertex(pg_v.get_id()));
-		start_run(v);
+		start_run(v, pg_v.get_id());
 		curr_vprog.run(*v, pg_v);
 		finish_run(v);
 		off += pg_v.get_size();
@@ -273,7 +280,7 @@ void merged_directed_vertex_compute::run_on_array(page_byte_array &array)
 		page_directed_vertex pg_v(sub_arr, in_part);
 		assert(pg_v.get_id() == id);
 		compute_vertex_pointer v(&get_graph().get_vertex(pg_v.get_id()));
-		start_run(v);
+		start_run(v, pg_v.get_id());
 		curr_vprog.run(*v, pg_v);
 		finish_run(v);
 		if (in_part)
@@ -298,7 +305,7 @@ void merged_directed_vertex_compute::run_on_arrays(page_byte_array &in_arr,
 		page_directed_vertex pg_v(sub_in_arr, sub_out_arr);
 		assert(pg_v.get_id() == id);
 		compute_vertex_pointer v(&get_graph().get_vertex(pg_v.get_id()));
-		start_run(v);
+		start_run(v, pg_v.get_id());
 		curr_vprog.run(*v, pg_v);
 		finish_run(v);
 		in_off += pg_v.get_in_size();
@@ -343,13 +350,15 @@ void merged_directed_vertex_compute::run(page_byte_array &arr)
 		throw std::invalid_argument("wrong edge type");
 }
 
-void sparse_vertex_compute::start_run(compute_vertex_pointer v)
+void sparse_vertex_compute::start_run(compute_vertex_pointer v, vertex_id_t id)
 {
-	issue_thread->start_run_vertex(v);
+	// The vertex may have been stolen from another thread.
+	issue_thread->start_run_vertex(v, get_graph().get_partitioner()->map(id));
 }
 
 void sparse_vertex_compute::finish_run(compute_vertex_pointer v)
 {
+	int part_id = issue_thread->get_curr_part_id();
 	bool issued_reqs = issue_thread->finish_run_vertex(v);
 	// TODO we have to make sure that this vertex didn't issue another vertex
 	// request.
@@ -359,7 +368,7 @@ void sparse_vertex_compute::finish_run(compute_vertex_pointer v)
 	// We need to notify the thread that initiate processing the vertex
 	// of the completion of the vertex.
 	if (!issued_reqs)
-		issue_thread->complete_vertex(v);
+		issue_thread->complete_vertex(v, part_id);
 }
 
 void sparse_undirected_vertex_compute::run(page_byte_array &arr)
@@ -376,7 +385,7 @@ void sparse_undirected_vertex_compute::run(page_byte_array &arr)
 			page_undirected_vertex pg_v(sub_arr);
 			assert(pg_v.get_id() == id);
 			compute_vertex_pointer v(&get_graph().get_vertex(pg_v.get_id()));
-			start_run(v);
+			start_run(v, pg_v.get_id());
 			curr_vprog.run(*v, pg_v);
 			finish_run(v);
 			off += pg_v.get_size();
@@ -401,7 +410,7 @@ void sparse_directed_vertex_compute::run_on_array(page_byte_array &arr)
 			page_directed_vertex pg_v(sub_arr, in_part);
 			assert(pg_v.get_id() == id);
 			compute_vertex_pointer v(&get_graph().get_vertex(pg_v.get_id()));
-			start_run(v);
+			start_run(v, pg_v.get_id());
 			curr_vprog.run(*v, pg_v);
 			finish_run(v);
 			if (in_part)
@@ -436,7 +445,7 @@ void sparse_directed_vertex_compute::run_on_arrays(page_byte_array &in_arr,
 			page_directed_vertex pg_v(sub_in_arr, sub_out_arr);
 			assert(pg_v.get_id() == id);
 			compute_vertex_pointer v(&get_graph().get_vertex(pg_v.get_id()));
-			start_run(v);
+			start_run(v, pg_v.get_id());
 			curr_vprog.run(*v, pg_v);
 			finish_run(v);
 			in_off += pg_v.get_in_size();
@@ -70,6 +70,9 @@ protected:
 	// The thread that creates the vertex compute.
 	worker_thread *issue_thread;
 	compute_vertex_pointer v;
+	// The partition where the vertex belongs to. It's different from
+	// the issue thread if the vertex is stolen from another thread.
+	int part_id;
 
 	/*
 	 * These two variables keep track of the number of completed requests
@@ -117,8 +120,13 @@ public:
 		num_edge_completed = 0;
 	}
 
-	void init(compute_vertex_pointer v) {
+	void init(compute_vertex_pointer v, int part_id) {
 		this->v = v;
+		this->part_id = part_id;
+	}
+
+	int get_part_id() const {
+		return part_id;
 	}
 
 	/*
@@ -265,7 +273,7 @@ class merged_vertex_compute: public safs::user_compute
 protected:
 	worker_thread *issue_thread;
 
-	void start_run(compute_vertex_pointer v);
+	void start_run(compute_vertex_pointer v, vertex_id_t id);
 	void finish_run(compute_vertex_pointer v);
 public:
 	merged_vertex_compute(graph_engine *graph,
@@ -396,7 +404,7 @@ protected:
 	graph_engine *graph;
 	worker_thread *issue_thread;
 
-	void start_run(compute_vertex_pointer v);
+	void start_run(compute_vertex_pointer v, vertex_id_t id);
 	void finish_run(compute_vertex_pointer v);
 public:
 	sparse_vertex_compute(graph_engine *graph,
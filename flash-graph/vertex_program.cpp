@@ -39,6 +39,8 @@ vertex_program::~vertex_program()
 		multicast_msg_sender::destroy(multicast_senders[i]);
 	for (unsigned i = 0; i < activate_senders.size(); i++)
 		multicast_msg_sender::destroy(activate_senders[i]);
+	for (unsigned i = 0; i < combined_senders.size(); i++)
+		combined_msg_sender::destroy(combined_senders[i]);
 }
 
 void vertex_program::init(graph_engine *graph, worker_thread *t)
@@ -71,6 +73,9 @@ void vertex_program::init_messaging(const std::vector<worker_thread *> &threads,
 		activation_message msg;
 		activate_sender->init(msg);
 		activate_senders.push_back(activate_sender);
+		if (combiner)
+			combined_senders.push_back(combined_msg_sender::create(combiner,
+						*msg_senders.back()));
 	}
 }
 
@@ -83,6 +88,10 @@ void vertex_program::multicast_msg(vertex_id_t ids[], int num,
 	if (num == 0)
 		return;
 
+	// When there are very few destinations, this way is cheaper.
+	// The messages sent to each destination individually go through
+	// the combiner if there is one. A multicast message is shared by all
+	// of its destinations, so it's never combined.
 	if (num < graph->get_num_threads() * 2) {
 		for (int i = 0; i < num; i++)
 			this->send_msg(ids[i], msg);
@@ -150,12 +159,16 @@ void vertex_program::send_msg(vertex_id_t dest, vertex_message &msg)
 		// the flush message.
 		get_activate_sender(part_id).flush();
 		get_multicast_sender(part_id).flush();
+		if (combiner)
+			combined_senders[part_id]->flush();
 		get_msg_sender(part_id).flush();
 
 		simple_msg_sender &sender = get_flush_msg_sender(part_id);
 		sender.send_cached(msg);
 		sender.flush();
 	}
+	else if (combiner)
+		combined_senders[part_id]->send(msg);
 	else {
 		simple_msg_sender &sender = get_msg_sender(part_id);
 		sender.send_cached(msg);
@@ -245,11 +258,18 @@ void vertex_program::activate_vertices(edge_seq_iterator &it)
 
 void vertex_program::flush_msgs()
 {
+	// The combined messages are sent with the message senders.
+	for (size_t i = 0; i < combined_senders.size(); i++)
+		combined_senders[i]->flush();
 	for (size_t i = 0; i < msg_senders.size(); i++)
 		msg_senders[i]->flush();
 	for (size_t i = 0; i < multicast_senders.size(); i++)
 		multicast_senders[i]->flush();
 	for (size_t i = 0; i < activate_senders.size(); i++) {
+		// The activation message stays in the buffer. We don't need to
+		// send it if it doesn't activate any vertices.
+		if (activate_senders[i]->get_num_dests() == 0)
+			continue;
 		activate_senders[i]->flush();
 		activation_message msg;
 		activate_senders[i]->init(msg);
@@ -274,9 +294,7 @@ vertex_id_t vertex_program::get_vertex_id(const compute_vertex &v) const
 	// thread due to load balancing.
 	vertex_id_t id = graph->get_graph_index().get_vertex_id(t->get_worker_id(), v);
 	if (id == INVALID_VERTEX_ID) {
-		int part_id = t->get_stolen_vertex_part(v);
-		assert(part_id >= 0);
-		id = graph->get_graph_index().get_vertex_id(part_id, v);
+		id = graph->get_graph_index().get_vertex_id(t->get_curr_part_id(), v);
 		assert(id != INVALID_VERTEX_ID);
 	}
 	return id;
@@ -290,9 +308,7 @@ vertex_id_t vertex_program::get_vertex_id(compute_vertex_pointer v) const
 	// thread due to load balancing.
 	vertex_id_t id = graph->get_graph_index().get_vertex_id(t->get_worker_id(), v);
 	if (id == INVALID_VERTEX_ID) {
-		int part_id = t->get_stolen_vertex_part(*v);
-		assert(part_id >= 0);
-		id = graph->get_graph_index().get_vertex_id(part_id, v);
+		id = graph->get_graph_index().get_vertex_id(t->get_curr_part_id(), v);
 		assert(id != INVALID_VERTEX_ID);
 	}
 	return id;
@@ -59,6 +59,10 @@ class vertex_program
 	std::vector<simple_msg_sender *> flush_msg_senders;
 	std::vector<multicast_msg_sender *> multicast_senders;
 	std::vector<multicast_msg_sender *> activate_senders;
+	// The senders that combine messages before sending them. They exist
+	// only if the vertex program has a message combiner.
+	msg_combiner::ptr combiner;
+	std::vector<combined_msg_sender *> combined_senders;
     
 	multicast_msg_sender &get_activate_sender(int thread_id) const {
 		return *activate_senders[thread_id];
@@ -154,7 +158,40 @@ public:
      * \param cv A `compute_vertex` that is executed in the method.
      */
 	virtual void notify_iteration_end(compute_vertex &cv) = 0;
+
+	/**
+	 * \brief Determine whether a vertex runs in an iteration in the pull mode.
+	 * \param cv A `compute_vertex`.
+	 * \return true if the vertex runs in the iteration.
+	 */
+	virtual bool is_pull_candidate(compute_vertex &cv) {
+		return false;
+	}
+
+	/**
+	 * \brief Get the priority of an activated vertex in the asynchronous mode.
+	 * \param cv A `compute_vertex`.
+	 * \return The priority of the vertex.
+	 */
+	virtual int get_priority(compute_vertex &cv) {
+		return 0;
+	}
     
+	/**
+	 * \brief Set a combiner to merge the messages sent to the same vertex
+	 *        before they are sent to other threads. All messages sent by
+	 *        the vertex program have to be combinable by the combiner.
+	 *        It has to be set before the graph engine starts, e.g.,
+	 *        in the constructor of a vertex program. Only the messages
+	 *        sent to individual vertices are combined; a message
+	 *        multicast to many vertices is delivered as it is.
+	 * \param combiner The message combiner.
+	 */
+	void set_msg_combiner(msg_combiner::ptr combiner) {
+		assert(combined_senders.empty());
+		this->combiner = combiner;
+	}
+
     /* Internal */
 	const worker_thread &get_thread() const {
 		return *t;
@@ -355,6 +392,14 @@ public:
 	virtual void notify_iteration_end(compute_vertex &comp_v) {
 		((vertex_type &) comp_v).notify_iteration_end(*this);
 	}
+
+	virtual bool is_pull_candidate(compute_vertex &comp_v) {
+		return ((vertex_type &) comp_v).is_pull_candidate(*this);
+	}
+
+	virtual int get_priority(compute_vertex &comp_v) {
+		return ((vertex_type &) comp_v).get_priority(*this);
+	}
 };
 
 }
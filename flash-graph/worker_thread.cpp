@@ -17,6 +17,8 @@
  * limitations under the License.
  */
 
+#include <unistd.h>
+
 #include <atomic>
 
 #include "io_interface.h"
@@ -62,7 +64,10 @@ void active_vertex_set::fetch_reset_active_vertices(size_t max_num,
 		while (ids.size() < max_num
 				&& bitmap_fetch_idx.get_num_remaining() > 0) {
 			size_t curr_loc = bitmap_fetch_idx.get_curr_loc();
-			size_t new_loc = bitmap_fetch_idx.move(max_num / NUM_BITS_LONG);
+			// We have to move forward by at least a long. Otherwise,
+			// we never finish if there are few active vertices.
+			size_t new_loc = bitmap_fetch_idx.move(
+					std::max(max_num / NUM_BITS_LONG, (size_t) 1));
 			// bitmap_fetch_idx points to the locations of longs.
 			active_map.get_reset_set_bits(min(curr_loc, new_loc) * NUM_BITS_LONG,
 					max(curr_loc, new_loc) * NUM_BITS_LONG, ids);
@@ -73,11 +78,45 @@ void active_vertex_set::fetch_reset_active_vertices(size_t max_num,
 	}
 }
 
+/*
+ * Fetch all active vertices. It scans the entire bitmap regardless of
+ * the scan pointer if the active vertices are kept in the bitmap.
+ */
 void active_vertex_set::fetch_reset_active_vertices(
 		std::vector<local_vid_t> &local_ids)
 {
-	active_vertex_set::fetch_reset_active_vertices(get_num_active_vertices(),
-			local_ids);
+	if (!active_v.empty()) {
+		local_ids.insert(local_ids.end(), active_v.begin(), active_v.end());
+		active_v.clear();
+	}
+	else if (active_map.get_num_set_bits() > 0) {
+		std::vector<vertex_id_t> ids;
+		active_map.get_reset_set_bits(ids);
+		local_ids.resize(ids.size());
+		for (size_t i = 0; i < ids.size(); i++)
+			local_ids[i] = local_vid_t(ids[i]);
+	}
+}
+
+/*
+ * Get the active vertices in a range of local vertices without resetting
+ * them. The range has to start at the beginning of a long in the bitmap.
+ */
+void active_vertex_set::get_active_vertices(size_t begin, size_t end,
+		std::vector<local_vid_t> &local_ids) const
+{
+	if (!active_v.empty()) {
+		BOOST_FOREACH(local_vid_t id, active_v) {
+			if (id.id >= begin && id.id < end)
+				local_ids.push_back(id);
+		}
+	}
+	else if (active_map.get_num_set_bits() > 0) {
+		std::vector<vertex_id_t> ids;
+		active_map.get_set_bits(begin, end, ids);
+		for (size_t i = 0; i < ids.size(); i++)
+			local_ids.push_back(local_vid_t(ids[i]));
+	}
 }
 
 /*
@@ -188,6 +227,46 @@ void default_vertex_queue::init(worker_thread &t)
 	curr_vpart = 0;
 }
 
+size_t default_vertex_queue::init_pull(worker_thread &t)
+{
+	lock.lock();
+	assert(buf_fetch_idx.get_num_remaining() == 0);
+	assert(vpart_ps.empty());
+	// Other threads look up the frontier in the bitmap.
+	active_vertices->force_bitmap();
+	active_vertices.swap(t.frontier);
+	active_vertices->clear();
+
+	// We also count the edges of the candidates exactly here. The ones
+	// in the frontier have been counted with the frontier.
+	t.num_candidate_edges = 0;
+	edge_type pull_edge = graph.get_pull_edge();
+	size_t num_local_vertices = t.get_num_local_vertices();
+	for (size_t i = 0; i < num_local_vertices; i++) {
+		local_vid_t id(i);
+		compute_vertex &v = graph.get_vertex(part_id, id);
+		if (t.vprogram->is_pull_candidate(v)) {
+			active_vertices->activate_vertex(id);
+			if (!t.frontier->is_active(id)) {
+				vertex_id_t global_id;
+				graph.get_partitioner()->loc2map(part_id, i, global_id);
+				t.num_candidate_edges += graph.get_num_edges(global_id,
+						pull_edge);
+			}
+		}
+	}
+	active_vertices->finalize();
+	this->num_active = active_vertices->get_num_active_vertices();
+
+	bool forward = true;
+	if (graph_conf.get_elevator_enabled())
+		forward = graph.get_curr_level() % 2;
+	active_vertices->set_dir(forward);
+	buf_fetch_idx = scan_pointer(0, true);
+	lock.unlock();
+	return num_active;
+}
+
 void default_vertex_queue::fetch_from_map()
 {
 	assert(buf_fetch_idx.get_num_remaining() == 0);
@@ -337,6 +416,118 @@ void customized_vertex_queue::init(worker_thread &t)
 	lock.unlock();
 }
 
+priority_vertex_queue::priority_vertex_queue(vertex_program::ptr vprog,
+		int part_id, int node_id): queued(vprog->get_graph().get_partitioner(
+				)->get_part_size(part_id, vprog->get_graph().get_num_vertices()),
+			node_id), busy(queued.get_num_bits(), node_id),
+		reactivated(queued.get_num_bits(), node_id),
+		graph(vprog->get_graph()), index(graph.get_graph_index())
+{
+	this->num_queued = 0;
+	this->vprog = vprog;
+	this->part_id = part_id;
+	priorities.resize(queued.get_num_bits());
+}
+
+void priority_vertex_queue::add_vertex(local_vid_t id)
+{
+	// The vertex will be added to the queue when it completes, so it'll
+	// run with its latest state anyway.
+	if (busy.get(id.id)) {
+		reactivated.set(id.id);
+		return;
+	}
+
+	// The vertex state may have changed since it was queued, so we always
+	// compute its priority again.
+	int priority = vprog->get_priority(graph.get_vertex(part_id, id));
+	if (queued.get(id.id)) {
+		// The old entry of the vertex becomes stale.
+		if (priorities[id.id] != priority) {
+			priorities[id.id] = priority;
+			buckets[priority].push_back(id);
+		}
+		return;
+	}
+	queued.set(id.id);
+	priorities[id.id] = priority;
+	buckets[priority].push_back(id);
+	num_queued++;
+}
+
+void priority_vertex_queue::add_vertices(const std::vector<local_vid_t> &ids)
+{
+	for (size_t i = 0; i < ids.size(); i++)
+		add_vertex(ids[i]);
+}
+
+void priority_vertex_queue::init(const vertex_id_t buf[], size_t size,
+		bool sorted)
+{
+	std::vector<local_vid_t> local_ids(size);
+	for (size_t i = 0; i < size; i++) {
+		int part_id;
+		off_t off;
+		graph.get_partitioner()->map2loc(buf[i], part_id, off);
+		assert(part_id == this->part_id);
+		local_ids[i] = local_vid_t(off);
+	}
+	add_vertices(local_ids);
+}
+
+size_t priority_vertex_queue::add_activated(worker_thread &t)
+{
+	if (t.next_activated_vertices->get_num_active_vertices() == 0)
+		return 0;
+
+	size_t orig_num_queued = num_queued;
+	std::vector<local_vid_t> local_ids;
+	t.next_activated_vertices->fetch_reset_active_vertices(local_ids);
+	assert(t.next_activated_vertices->get_num_active_vertices() == 0);
+	add_vertices(local_ids);
+	return num_queued - orig_num_queued;
+}
+
+size_t priority_vertex_queue::complete(local_vid_t id)
+{
+	assert(busy.get(id.id));
+	busy.reset(id.id);
+	if (!reactivated.get(id.id))
+		return 0;
+
+	reactivated.reset(id.id);
+	add_vertex(id);
+	return 1;
+}
+
+int priority_vertex_queue::fetch(compute_vertex_pointer vertices[], int num)
+{
+	fetch_buf.clear();
+	while (fetch_buf.size() < (size_t) num && !buckets.empty()) {
+		int priority = buckets.begin()->first;
+		std::vector<local_vid_t> &bucket = buckets.begin()->second;
+		while (fetch_buf.size() < (size_t) num && !bucket.empty()) {
+			local_vid_t id = bucket.back();
+			bucket.pop_back();
+			// Skip the stale entries.
+			if (!queued.get(id.id) || priorities[id.id] != priority)
+				continue;
+			queued.reset(id.id);
+			busy.set(id.id);
+			fetch_buf.push_back(id);
+		}
+		if (bucket.empty())
+			buckets.erase(buckets.begin());
+	}
+	num_queued -= fetch_buf.size();
+	// Only stale entries are left.
+	if (num_queued == 0)
+		buckets.clear();
+	index.get_vertices(part_id, fetch_buf.data(), fetch_buf.size(),
+			compute_vertex_pointer::conv(vertices));
+	return fetch_buf.size();
+}
+
 worker_thread::worker_thread(graph_engine *graph,
 		file_io_factory::shared_ptr graph_factory,
 		file_io_factory::shared_ptr index_factory,
@@ -348,6 +539,9 @@ worker_thread::worker_thread(graph_engine *graph,
 {
 	this->scheduler = scheduler;
 	req_on_vertex = false;
+	curr_part_id = worker_id;
+	num_frontier_edges = 0;
+	num_candidate_edges = 0;
 	this->vprogram = prog;
 	this->vpart_vprogram = vpart_prog;
 	start_all = false;
@@ -359,6 +553,11 @@ worker_thread::worker_thread(graph_engine *graph,
 	vprogram->init(graph, this);
 	vpart_vprogram->init(graph, this);
 	balancer = std::unique_ptr<load_balancer>(new load_balancer(*graph, *this));
+	// Other threads may steal from the deque before this thread is
+	// initialized, so it has to be created here.
+	ready_batches = std::unique_ptr<work_stealing_deque<vertex_batch> >(
+			new work_stealing_deque<vertex_batch>(NUM_READY_BATCHES));
+	curr_batch_idx = 0;
 	msg_processor = std::unique_ptr<message_processor>(new message_processor(
 				*graph, *this, msg_alloc));
 	switch(graph->get_graph_header().get_graph_type()) {
@@ -413,7 +612,12 @@ void worker_thread::init()
 			new active_vertex_set(num_local_vertices, get_node_id()));
 	notify_vertices = std::unique_ptr<bitmap>(new bitmap(num_local_vertices,
 				get_node_id()));
-	if (scheduler)
+	frontier = std::unique_ptr<active_vertex_set>(
+			new active_vertex_set(num_local_vertices, get_node_id()));
+	if (graph->is_async())
+		curr_activated_vertices = std::unique_ptr<active_vertex_queue>(
+				new priority_vertex_queue(vprogram, worker_id, get_node_id()));
+	else if (scheduler)
 		curr_activated_vertices = std::unique_ptr<active_vertex_queue>(
 				// TODO can we only use the default vertex program?
 				// what about the vertex program for vertex partitions.
@@ -437,14 +641,16 @@ void worker_thread::init()
 	}
 
 	if (!started_vertices.empty()) {
-		assert(curr_activated_vertices->is_empty());
-		curr_activated_vertices->init(started_vertices, false);
+		// The vertex queue may need the state of the vertices, so we have to
+		// initialize them first.
 		if (vinitializer) {
 			BOOST_FOREACH(vertex_id_t id, started_vertices) {
 				compute_vertex &v = graph->get_vertex(id);
 				vinitializer->init(v);
 			}
 		}
+		assert(curr_activated_vertices->is_empty());
+		curr_activated_vertices->init(started_vertices, false);
 		// Free the space used by the vector.
 		started_vertices = std::vector<vertex_id_t>();
 	}
@@ -467,10 +673,6 @@ void worker_thread::init()
 	}
 	// If a user wants to start all vertices.
 	else if (start_all) {
-		next_activated_vertices->activate_all();
-		assert(curr_activated_vertices->is_empty());
-		curr_activated_vertices->init(*this);
-		assert(next_activated_vertices->get_num_active_vertices() == 0);
 		if (vinitializer) {
 			std::vector<vertex_id_t> local_ids;
 			graph->get_partitioner()->get_all_vertices_in_part(worker_id,
@@ -480,8 +682,14 @@ void worker_thread::init()
 				vinitializer->init(v);
 			}
 		}
+		next_activated_vertices->activate_all();
+		assert(curr_activated_vertices->is_empty());
+		curr_activated_vertices->init(*this);
+		assert(next_activated_vertices->get_num_active_vertices() == 0);
 	}
 
+	if (graph->can_pull())
+		count_candidate_edges();
 	bool ret = graph->progress_first_level();
 	if (ret)
 		BOOST_LOG_TRIVIAL(warning)
@@ -497,6 +705,73 @@ void worker_thread::init_messaging(const std::vector<worker_thread *> &threads,
 	vpart_vprogram->init_messaging(threads, msg_alloc, flush_msg_alloc);
 }
 
+/*
+ * This moves activated vertices from the vertex queue to the deque.
+ * The batches are pushed in the reverse order, so this thread still
+ * processes vertices in the order of the queue while other threads
+ * steal the vertices at the end.
+ */
+int worker_thread::fill_ready_batches()
+{
+	assert(ready_batches->is_empty());
+	// In the asynchronous mode, vertices activated later may have higher
+	// priorities, and no threads steal vertices, so we only fetch a batch.
+	if (graph->is_async())
+		fill_buf.resize(vertex_batch::MAX_SIZE);
+	else
+		fill_buf.resize(NUM_READY_BATCHES * vertex_batch::MAX_SIZE);
+	size_t num_fetched = 0;
+	while (num_fetched < fill_buf.size()) {
+		int num = curr_activated_vertices->fetch(fill_buf.data() + num_fetched,
+				fill_buf.size() - num_fetched);
+		if (num == 0)
+			break;
+		num_fetched += num;
+	}
+	int num_batches = ceil(((double) num_fetched) / vertex_batch::MAX_SIZE);
+	for (int i = num_batches - 1; i >= 0; i--) {
+		vertex_batch batch;
+		size_t start = i * vertex_batch::MAX_SIZE;
+		batch.num = min(num_fetched - start, (size_t) vertex_batch::MAX_SIZE);
+		batch.part_id = worker_id;
+		memcpy(batch.vertices, fill_buf.data() + start,
+				batch.num * sizeof(batch.vertices[0]));
+		BOOST_VERIFY(ready_batches->push(batch));
+	}
+	return num_batches;
+}
+
+/*
+ * Fetch the activated vertices that belong to this thread. It takes
+ * vertices from the current batch first and then from the deque.
+ * The vertices of a stolen batch aren't fetched together with other
+ * vertices, so the current batch tells where the vertices being run
+ * belong to.
+ */
+int worker_thread::fetch_activated_vertices(compute_vertex_pointer vertices[],
+		int num)
+{
+	int num_fetched = 0;
+	while (num_fetched < num) {
+		if (curr_batch_idx == curr_batch.num) {
+			if (num_fetched > 0 && curr_batch.part_id != worker_id)
+				break;
+			curr_batch.num = 0;
+			curr_batch_idx = 0;
+			if (!ready_batches->pop(curr_batch)
+					&& (fill_ready_batches() == 0
+						|| !ready_batches->pop(curr_batch)))
+				break;
+		}
+		int num_copy = min(num - num_fetched, curr_batch.num - curr_batch_idx);
+		memcpy(vertices + num_fetched, curr_batch.vertices + curr_batch_idx,
+				num_copy * sizeof(vertices[0]));
+		curr_batch_idx += num_copy;
+		num_fetched += num_copy;
+	}
+	return num_fetched;
+}
+
 /**
  * This is to process the activated vertices in the current iteration.
  */
@@ -506,29 +781,33 @@ int worker_thread::process_activated_vertices(int max)
 		return 0;
 
 	process_vertex_buf.resize(max);
-	int num = curr_activated_vertices->fetch(process_vertex_buf.data(), max);
-	if (num == 0) {
+	int num = fetch_activated_vertices(process_vertex_buf.data(), max);
+	if (num == 0 && !graph->is_async()) {
 		assert(curr_activated_vertices->is_empty());
-		num = balancer->steal_activated_vertices(process_vertex_buf.data(),
-				max);
+		if (balancer->steal_activated_vertices(curr_batch)) {
+			curr_batch_idx = 0;
+			num = fetch_activated_vertices(process_vertex_buf.data(), max);
+		}
 	}
 	if (num > 0) {
 		num_activated_vertices_in_level.inc(num);
 		graph->process_vertices(num);
 	}
 
+	// The fetched vertices all belong to the partition of the current batch.
+	int part_id = curr_batch.part_id;
 	for (int i = 0; i < num; i++) {
 		compute_vertex_pointer info = process_vertex_buf[i];
 		// We execute the pre-run to determine if the vertex has completed
 		// in the current iteration.
 		vertex_program &curr_vprog = get_vertex_program(info.is_part());
-		start_run_vertex(info);
+		start_run_vertex(info, part_id);
 		curr_vprog.run(*info);
 		bool issued_reqs = finish_run_vertex(info);
 		// If this run doesn't issue any requests, we can be sure that
 		// the vertex has completed in this iteration.
 		if (!issued_reqs)
-			complete_vertex(info);
+			complete_vertex(info, part_id);
 	}
 	return num;
 }
@@ -555,6 +834,12 @@ size_t worker_thread::enter_next_level()
 		}
 	}
 
+	// The graph engine chooses the mode of the next level with the edges
+	// of the vertices activated for it.
+	if (graph->can_pull()) {
+		next_activated_vertices->finalize();
+		count_frontier_edges();
+	}
 	curr_activated_vertices->init(*this);
 	assert(next_activated_vertices->get_num_active_vertices() == 0);
 	balancer->reset();
@@ -562,40 +847,174 @@ size_t worker_thread::enter_next_level()
 	return curr_activated_vertices->get_num_vertices();
 }
 
+/*
+ * Count the edges of all local pull candidates in the pull direction.
+ * The vertices that start in the first level are counted as well.
+ */
+void worker_thread::count_candidate_edges()
+{
+	num_candidate_edges = 0;
+	edge_type pull_edge = graph->get_pull_edge();
+	size_t num_local_vertices = get_num_local_vertices();
+	for (size_t i = 0; i < num_local_vertices; i++) {
+		compute_vertex &v = graph->get_vertex(worker_id, local_vid_t(i));
+		if (vprogram->is_pull_candidate(v)) {
+			vertex_id_t id;
+			graph->get_partitioner()->loc2map(worker_id, i, id);
+			num_candidate_edges += graph->get_num_edges(id, pull_edge);
+		}
+	}
+}
+
+/*
+ * Count the edges of the vertices activated for the next level.
+ * The candidates among them stop being candidates after they run,
+ * so we don't count their edges in the pull direction any more.
+ */
+void worker_thread::count_frontier_edges()
+{
+	num_frontier_edges = 0;
+	size_t num_reached_edges = 0;
+	edge_type push_edge = graph->get_push_edge();
+	edge_type pull_edge = graph->get_pull_edge();
+	size_t num_local_vertices = get_num_local_vertices();
+	const size_t stride = 1024 * 64;
+	std::vector<local_vid_t> local_ids;
+	for (size_t i = 0; i < num_local_vertices; i += stride) {
+		local_ids.clear();
+		next_activated_vertices->get_active_vertices(i,
+				min(i + stride, num_local_vertices), local_ids);
+		BOOST_FOREACH(local_vid_t local_id, local_ids) {
+			vertex_id_t id;
+			graph->get_partitioner()->loc2map(worker_id, local_id.id, id);
+			num_frontier_edges += graph->get_num_edges(id, push_edge);
+			compute_vertex &v = graph->get_vertex(worker_id, local_id);
+			if (vprogram->is_pull_candidate(v))
+				num_reached_edges += graph->get_num_edges(id, pull_edge);
+		}
+	}
+	num_candidate_edges -= min(num_reached_edges, num_candidate_edges);
+}
+
+size_t worker_thread::enter_pull_level()
+{
+	// The graph engine only runs in the pull mode with the default
+	// vertex queue.
+	default_vertex_queue *q
+		= (default_vertex_queue *) curr_activated_vertices.get();
+	return q->init_pull(*this);
+}
+
+/*
+ * Process the messages from other threads and issue and complete
+ * the requests of the vertices being processed.
+ */
+void worker_thread::process_ios()
+{
+	msg_processor->process_msgs();
+	index_reader->wait4complete(0);
+	io->access(adj_reqs.data(), adj_reqs.size());
+	adj_reqs.clear();
+	if (io->num_pending_ios() == 0 && index_reader->get_num_pending_tasks() > 0)
+		index_reader->wait4complete(1);
+	io->wait4complete(min(io->num_pending_ios() / 10, 2));
+}
+
+/*
+ * Run the vertices activated in the current level.
+ * It returns the number of vertices it runs.
+ */
+int worker_thread::run_level()
+{
+	int num_visited = 0;
+	do {
+		balancer->process_completed_stolen_vertices();
+		num_visited += process_activated_vertices(
+				graph->get_max_processing_vertices()
+				- get_num_vertices_processing());
+		process_ios();
+		// If there are vertices being processed, we need to call
+		// wait4complete to complete processing them.
+	} while (get_num_vertices_processing() > 0
+			// We still have vertices remaining for processing
+			|| !curr_activated_vertices->is_empty()
+			|| !ready_batches->is_empty()
+			|| curr_batch_idx < curr_batch.num
+			// Even if we have processed all activated vertices belonging
+			// to this thread, we still need to process vertices from
+			// other threads in order to balance the load.
+			|| graph->get_num_remaining_vertices() > 0);
+	return num_visited;
+}
+
+/*
+ * Run the current level in the asynchronous mode. The vertices activated
+ * in this thread or by messages are added to the priority queue and run
+ * in the same level, so the level doesn't end until all threads are
+ * quiescent. It returns the number of vertices it runs.
+ */
+int worker_thread::run_async_level()
+{
+	priority_vertex_queue *q
+		= (priority_vertex_queue *) curr_activated_vertices.get();
+	int num_visited = 0;
+	bool idle = false;
+	while (true) {
+		if (idle) {
+			// Only messages from other threads can give an idle thread
+			// more work.
+			if (!graph->wait4msgs(msg_processor->get_msg_queue()))
+				break;
+			graph->leave_idle();
+			idle = false;
+		}
+
+		graph->add_remaining_vertices(q->add_activated(*this));
+		int num = process_activated_vertices(
+				graph->get_max_processing_vertices()
+				- get_num_vertices_processing());
+		num_visited += num;
+		// Other threads may be waiting for the messages from this thread,
+		// so we send them out whenever we can't run more vertices.
+		if (num == 0) {
+			vprogram->flush_msgs();
+			vpart_vprogram->flush_msgs();
+		}
+		process_ios();
+
+		if (get_num_vertices_processing() == 0 && q->is_empty()
+				&& ready_batches->is_empty()
+				&& curr_batch_idx == curr_batch.num
+				&& next_activated_vertices->get_num_active_vertices() == 0
+				&& io->num_pending_ios() == 0
+				&& index_reader->get_num_pending_tasks() == 0
+				&& msg_processor->get_msg_queue().is_empty()) {
+			vprogram->flush_msgs();
+			vpart_vprogram->flush_msgs();
+			graph->enter_idle();
+			idle = true;
+		}
+	}
+	return num_visited;
+}
+
 /**
  * This method is the main function of the graph engine.
  */
 void worker_thread::run()
 {
 	while (true) {
-		int num_visited = 0;
-		int num;
-		do {
-			balancer->process_completed_stolen_vertices();
-			num = process_activated_vertices(
-					graph->get_max_processing_vertices()
-					- get_num_vertices_processing());
-			num_visited += num;
-			msg_processor->process_msgs();
-			index_reader->wait4complete(0);
-			io->access(adj_reqs.data(), adj_reqs.size());
-			adj_reqs.clear();
-			if (io->num_pending_ios() == 0 && index_reader->get_num_pending_tasks() > 0)
-				index_reader->wait4complete(1);
-			io->wait4complete(min(io->num_pending_ios() / 10, 2));
-			// If there are vertices being processed, we need to call
-			// wait4complete to complete processing them.
-		} while (get_num_vertices_processing() > 0
-				// We still have vertices remaining for processing
-				|| !curr_activated_vertices->is_empty()
-				// Even if we have processed all activated vertices belonging
-				// to this thread, we still need to process vertices from
-				// other threads in order to balance the load.
-				|| graph->get_num_remaining_vertices() > 0);
+		int num_visited;
+		if (graph->is_async())
+			num_visited = run_async_level();
+		else
+			num_visited = run_level();
 		assert(index_reader->get_num_pending_tasks() == 0);
 		assert(io->num_pending_ios() == 0);
 		assert(active_computes.size() == 0);
 		assert(curr_activated_vertices->is_empty());
+		assert(ready_batches->is_empty());
+		assert(curr_batch_idx == curr_batch.num);
 		assert(num_visited == num_activated_vertices_in_level.get());
 		if (num_visited != num_completed_vertices_in_level.get()) {
 			BOOST_LOG_TRIVIAL(error)
@@ -626,24 +1045,14 @@ void worker_thread::run()
 	stop();
 }
 
-int worker_thread::steal_activated_vertices(compute_vertex_pointer vertices[], int num)
+bool worker_thread::steal_activated_vertices(vertex_batch &batch)
 {
-	// This method is called in the context of other worker threads,
-	// curr_activated_vertices may not have been initialized. If so,
-	// skip it.
-	if (curr_activated_vertices == NULL)
-		return 0;
-	// We want to steal as much as possible, but we don't want
-	// to overloaded by the stolen vertices.
-	size_t num_steal = std::max(1UL,
-			curr_activated_vertices->get_num_vertices() / graph->get_num_threads());
-	num = curr_activated_vertices->fetch(vertices,
-			std::min((size_t) num, num_steal));
-	if (num > 0)
-		// If the thread steals vertices from another thread successfully,
-		// it needs to notify the thread of the stolen vertices.
-		msg_processor->steal_vertices(vertices, num);
-	return num;
+	if (!ready_batches->steal(batch))
+		return false;
+	// If the thread steals vertices from another thread successfully,
+	// it needs to notify the thread of the stolen vertices.
+	msg_processor->steal_vertices(batch.vertices, batch.num);
+	return true;
 }
 
 void worker_thread::return_vertices(vertex_id_t ids[], int num)
@@ -651,7 +1060,8 @@ void worker_thread::return_vertices(vertex_id_t ids[], int num)
 	msg_processor->return_vertices(ids, num);
 }
 
-void worker_thread::complete_vertex(const compute_vertex_pointer v)
+void worker_thread::complete_vertex(const compute_vertex_pointer v,
+		int part_id)
 {
 	std::unordered_map<compute_vertex *, vertex_compute *>::iterator it
 		= active_computes.find(v.get());
@@ -673,10 +1083,17 @@ void worker_thread::complete_vertex(const compute_vertex_pointer v)
 	}
 
 	num_completed_vertices_in_level.inc(1);
-	// The vertex might be stolen from another thread. Now we have
-	// finished processing it, we should return it to its owner thread.
-	if (!index.belong2part(*v.get(), worker_id))
-		balancer->return_vertices(&v, 1);
+	// A vertex activated while it was running can run again now.
+	if (graph->is_async()) {
+		priority_vertex_queue *q
+			= (priority_vertex_queue *) curr_activated_vertices.get();
+		graph->add_remaining_vertices(q->complete(index.get_local_id(
+						worker_id, *v)));
+	}
+	// Now we have finished processing a stolen vertex, we should return
+	// it to its owner thread.
+	if (part_id != worker_id)
+		balancer->return_vertices(&v, 1, part_id);
 }
 
 vertex_compute *worker_thread::get_vertex_compute(compute_vertex_pointer v)
@@ -685,7 +1102,9 @@ vertex_compute *worker_thread::get_vertex_compute(compute_vertex_pointer v)
 		= active_computes.find(v.get());
 	if (it == active_computes.end()) {
 		vertex_compute *compute = (vertex_compute *) alloc->alloc();
-		compute->init(v);
+		// A vertex_compute is only created for the running vertex.
+		assert(curr_vertex.get() == v.get());
+		compute->init(v, curr_part_id);
 		active_computes.insert(std::pair<compute_vertex *, vertex_compute *>(
 					v.get(), compute));
 		compute->inc_ref();
@@ -695,9 +1114,4 @@ vertex_compute *worker_thread::get_vertex_compute(compute_vertex_pointer v)
 		return it->second;
 }
 
-int worker_thread::get_stolen_vertex_part(const compute_vertex &v) const
-{
-	return balancer->get_stolen_vertex_part(v);
-}
-
 }
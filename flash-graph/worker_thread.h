@@ -23,8 +23,11 @@
 #include <pthread.h>
 
 #include <vector>
+#include <map>
 #include <unordered_map>
 
+#include "container.h"
+
 #include "graph_engine.h"
 #include "bitmap.h"
 #include "scan_pointer.h"
@@ -152,6 +155,8 @@ public:
 	void fetch_reset_active_vertices(size_t max_num,
 			std::vector<local_vid_t> &local_ids);
 	void fetch_reset_active_vertices(std::vector<local_vid_t> &local_ids);
+	void get_active_vertices(size_t begin, size_t end,
+			std::vector<local_vid_t> &local_ids) const;
 };
 
 /*
@@ -215,6 +220,12 @@ public:
 	virtual void init(const vertex_id_t buf[], size_t size, bool sorted);
 	virtual void init(worker_thread &);
 	virtual int fetch(compute_vertex_pointer vertices[], int num);
+	/*
+	 * The active vertices in the queue become the frontier of an iteration
+	 * in the pull mode, and the queue has the candidates of the pull mode
+	 * instead. It returns the number of the candidates.
+	 */
+	size_t init_pull(worker_thread &);
 
 	virtual bool is_empty() {
 		return num_active == 0;
@@ -279,6 +290,91 @@ public:
 	}
 };
 
+/*
+ * This vertex queue is used in the asynchronous mode. Activated vertices
+ * are kept in buckets keyed by their priorities, and the vertices in
+ * the bucket of the highest priority are fetched first. A vertex is kept
+ * in the queue at most once, and it isn't added to the queue again until
+ * it completes after it's fetched. If it's activated in the meantime, it's
+ * added back to the queue when it completes.
+ * Only the owner thread accesses the queue.
+ */
+class priority_vertex_queue: public active_vertex_queue
+{
+	typedef std::map<int, std::vector<local_vid_t>, std::greater<int> > bucket_map;
+	/*
+	 * A vertex whose priority changes while it's in the queue is added to
+	 * the bucket of its new priority, so the buckets may contain stale
+	 * entries. An entry is valid only if the vertex is still queued and
+	 * the bucket matches the latest priority of the vertex.
+	 */
+	bucket_map buckets;
+	// The latest priority of the queued vertices.
+	std::vector<int> priorities;
+	// Indicate the vertices in the queue.
+	bitmap queued;
+	// Indicate the vertices that have been fetched but haven't completed.
+	bitmap busy;
+	// Indicate the busy vertices that have been activated again.
+	bitmap reactivated;
+	size_t num_queued;
+	std::vector<local_vid_t> fetch_buf;
+	vertex_program::ptr vprog;
+	graph_engine &graph;
+	const graph_index &index;
+	int part_id;
+
+	void add_vertex(local_vid_t id);
+	void add_vertices(const std::vector<local_vid_t> &ids);
+public:
+	priority_vertex_queue(vertex_program::ptr vprog, int part_id, int node_id);
+
+	void init(const vertex_id_t buf[], size_t size, bool sorted);
+	void init(worker_thread &t) {
+		assert(busy.get_num_set_bits() == 0);
+		add_activated(t);
+	}
+	int fetch(compute_vertex_pointer vertices[], int num);
+	/*
+	 * Add the vertices activated in the worker thread since the last time.
+	 * It returns the number of vertices added to the queue.
+	 */
+	size_t add_activated(worker_thread &t);
+	/*
+	 * A vertex fetched from the queue has completed. It returns
+	 * the number of vertices added to the queue.
+	 */
+	size_t complete(local_vid_t id);
+
+	bool is_empty() {
+		return num_queued == 0;
+	}
+
+	size_t get_num_vertices() {
+		return num_queued;
+	}
+};
+
+/*
+ * A batch of activated vertices. It's the unit that other threads steal
+ * from a worker thread.
+ */
+struct vertex_batch
+{
+	static const int MAX_SIZE = 64;
+
+	int num;
+	// The partition where the vertices belong to, so a thread that steals
+	// the batch knows where to return the vertices.
+	int part_id;
+	compute_vertex_pointer vertices[MAX_SIZE];
+
+	vertex_batch() {
+		num = 0;
+		part_id = -1;
+	}
+};
+
 class vertex_compute;
 class steal_state_t;
 class message_processor;
@@ -313,6 +409,9 @@ class worker_thread: public thread
 	bool req_on_vertex;
 	// This points to the vertex that is currently being processed.
 	compute_vertex_pointer curr_vertex;
+	// The partition of the vertex that is currently being processed.
+	// It isn't this thread's partition if the vertex is stolen.
+	int curr_part_id;
 
 	/*
 	 * A vertex is allowed to send messages to other vertices.
@@ -336,6 +435,17 @@ class worker_thread: public thread
 	std::unique_ptr<active_vertex_set> next_activated_vertices;
 	// This contains the vertices activated in the current level.
 	std::unique_ptr<active_vertex_queue> curr_activated_vertices;
+	// This contains the vertices activated in the current level if
+	// the level runs in the pull mode.
+	std::unique_ptr<active_vertex_set> frontier;
+	/*
+	 * The graph engine chooses between the push and pull modes with these.
+	 * They are the edges of the vertices activated for the next level
+	 * in the push direction and the edges of the local pull candidates
+	 * that aren't in the frontier in the pull direction.
+	 */
+	size_t num_frontier_edges;
+	size_t num_candidate_edges;
 	vertex_scheduler::ptr scheduler;
 
 	// Indicate that we need to start all vertices.
@@ -347,6 +457,19 @@ class worker_thread: public thread
 	// The buffer for processing activated vertex.
 	embedded_array<compute_vertex_pointer> process_vertex_buf;
 
+	/*
+	 * The thread fetches activated vertices from curr_activated_vertices
+	 * in batches and keeps them in the deque, so other threads can steal
+	 * batches without locking the vertex queue or interrupting this thread.
+	 */
+	static const int NUM_READY_BATCHES = 32;
+	std::unique_ptr<work_stealing_deque<vertex_batch> > ready_batches;
+	// The batch being processed. It's popped from the deque or stolen
+	// from another thread.
+	vertex_batch curr_batch;
+	int curr_batch_idx;
+	std::vector<compute_vertex_pointer> fill_buf;
+
 	// The number of activated vertices processed in the current level.
 	atomic_number<long> num_activated_vertices_in_level;
 	// The number of vertices completed in the current level.
@@ -359,7 +482,12 @@ class worker_thread: public thread
 		return num_activated_vertices_in_level.get()
 			- num_completed_vertices_in_level.get();
 	}
+	int fill_ready_batches();
+	int fetch_activated_vertices(compute_vertex_pointer vertices[], int num);
 	int process_activated_vertices(int max);
+	void process_ios();
+	int run_level();
+	int run_async_level();
 public:
 	worker_thread(graph_engine *graph, std::shared_ptr<safs::file_io_factory> graph_factory,
 			std::shared_ptr<safs::file_io_factory> index_factory, vertex_program::ptr prog,
@@ -381,9 +509,24 @@ public:
 	 * method is invoked to notify the worker thread, so that the worker
 	 * thread can update its statistics on the number of completed vertices.
 	 */
-	void complete_vertex(const compute_vertex_pointer v);
+	void complete_vertex(const compute_vertex_pointer v, int part_id);
 
 	size_t enter_next_level();
+	size_t enter_pull_level();
+	void count_candidate_edges();
+	void count_frontier_edges();
+
+	size_t get_num_frontier_edges() const {
+		return num_frontier_edges;
+	}
+
+	size_t get_num_candidate_edges() const {
+		return num_candidate_edges;
+	}
+
+	bool is_in_frontier(local_vid_t id) const {
+		return frontier->is_active(id);
+	}
 
 	void start_vertices(const std::vector<vertex_id_t> &vertices,
 			vertex_initializer::ptr initializer) {
@@ -403,9 +546,13 @@ public:
 	compute_vertex_pointer get_curr_vertex() const {
 		return curr_vertex;
 	}
-	void start_run_vertex(compute_vertex_pointer v) {
+	int get_curr_part_id() const {
+		return curr_part_id;
+	}
+	void start_run_vertex(compute_vertex_pointer v, int part_id) {
 		assert(!curr_vertex.is_valid());
 		curr_vertex = v;
+		curr_part_id = part_id;
 		req_on_vertex = false;
 	}
 	bool finish_run_vertex(compute_vertex_pointer v) {
@@ -435,7 +582,10 @@ public:
 		notify_vertices->set(id.id);
 	}
 
-	int steal_activated_vertices(compute_vertex_pointer vertices[], int num);
+	/*
+	 * Other threads steal a batch of activated vertices from this thread.
+	 */
+	bool steal_activated_vertices(vertex_batch &batch);
 	void return_vertices(vertex_id_t ids[], int num);
 
 	size_t get_num_local_vertices() const {
@@ -479,11 +629,10 @@ public:
 		return *sparse_alloc;
 	}
 
-	int get_stolen_vertex_part(const compute_vertex &v) const;
-
 	friend class load_balancer;
 	friend class default_vertex_queue;
 	friend class customized_vertex_queue;
+	friend class priority_vertex_queue;
 };
 
 }
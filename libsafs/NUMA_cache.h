@@ -111,6 +111,25 @@ public:
 		return tot;
 	}
 
+	virtual void get_resident_pages(std::vector<page_id_t> &pages) const {
+		for (size_t i = 0; i < caches.size(); i++)
+			caches[i]->get_resident_pages(pages);
+	}
+
+	virtual void get_access_stat(long &num_accesses, long &num_misses,
+			long &num_ghost_hits) const {
+		num_accesses = 0;
+		num_misses = 0;
+		num_ghost_hits = 0;
+		for (size_t i = 0; i < caches.size(); i++) {
+			long accesses, misses, ghost_hits;
+			caches[i]->get_access_stat(accesses, misses, ghost_hits);
+			num_accesses += accesses;
+			num_misses += misses;
+			num_ghost_hits += ghost_hits;
+		}
+	}
+
 	virtual void sanity_check() const {
 		for (size_t i = 0; i < caches.size(); i++) {
 			caches[i]->sanity_check();
@@ -70,7 +70,8 @@ file_mapper::ptr RAID_config::create_file_mapper(const std::string &file_name) c
 		}
 		int part_id = atoi(part_ids[0].c_str());
 		part_file_info info(dir_name + std::string("/") + part_ids[0],
-				root_paths[i].get_disk_id(), root_paths[i].get_node_id());
+				root_paths[i].get_disk_id(), root_paths[i].get_node_id(),
+				root_paths[i].get_weight(), root_paths[i].is_fast());
 		file_map.insert(std::pair<int, part_file_info>(part_id, info));
 	}
 	if (file_map.size() < root_paths.size()) {
@@ -86,27 +87,10 @@ file_mapper::ptr RAID_config::create_file_mapper(const std::string &file_name) c
 	}
 
 	safs_header header = get_safs_header(*this, file_name);
-	int block_size = RAID_block_size;
-	int mapping_option = RAID_mapping_option;
 	// The per-file config can overwrite the default config.
-	if (header.is_valid()) {
-		block_size = header.get_block_size();
-		mapping_option = header.get_mapping_option();
-	}
-	switch (mapping_option) {
-		case RAID0:
-			return file_mapper::ptr(new RAID0_mapper(file_name, files,
-						block_size));
-		case RAID5:
-			return file_mapper::ptr(new RAID5_mapper(file_name, files,
-						block_size));
-		case HASH:
-			return file_mapper::ptr(new hash_mapper(file_name, files,
-						block_size));
-		default:
-			fprintf(stderr, "wrong RAID mapping option\n");
-			return file_mapper::ptr();
-	}
+	if (!header.is_valid())
+		header = safs_header(RAID_block_size, RAID_mapping_option, false, 0);
+	return file_mapper::create(header, files, file_name);
 }
 
 file_mapper::ptr RAID_config::create_file_mapper() const
@@ -121,12 +105,28 @@ file_mapper::ptr RAID_config::create_file_mapper() const
 		case HASH:
 			return file_mapper::ptr(new hash_mapper("root", root_paths,
 						RAID_block_size));
+		case WEIGHTED:
+			return file_mapper::ptr(new weighted_mapper("root", root_paths,
+						RAID_block_size));
+		case TIERED:
+			// The root mapper only locates the disks, so the tiers
+			// don't matter.
+			return file_mapper::ptr(new RAID0_mapper("root", root_paths,
+						RAID_block_size));
 		default:
 			fprintf(stderr, "wrong RAID mapping option\n");
 			return file_mapper::ptr();
 	}
 }
 
+bool RAID_config::has_fast_disks() const
+{
+	for (size_t i = 0; i < root_paths.size(); i++)
+		if (root_paths[i].is_fast())
+			return true;
+	return false;
+}
+
 std::set<int> RAID_config::get_node_ids() const
 {
 	std::set<int> node_ids;
@@ -160,6 +160,9 @@ static int retrieve_data_files(std::string file_file,
 		char *colon = strstr(line, ":");
 		char *name = line;
 		int node_id = 0;
+		int weight = 1;
+		bool fast = false;
+		bool valid = true;
 		if (colon) {
 			*colon = 0;
 			std::string node_id_str = line;
@@ -168,6 +171,33 @@ static int retrieve_data_files(std::string file_file,
 			node_id = atoi(node_id_str.c_str());
 			colon++;
 			name = colon;
+			// The weight of the disk and the tier are optional.
+			colon = strstr(name, ":");
+			if (colon)
+				*colon = 0;
+			while (colon) {
+				char *field = colon + 1;
+				colon = strstr(field, ":");
+				if (colon)
+					*colon = 0;
+				std::string field_str = field;
+				field_str.erase(std::remove_if(field_str.begin(),
+							field_str.end(), isspace), field_str.end());
+				if (field_str == "fast")
+					fast = true;
+				else if (!field_str.empty()) {
+					weight = atoi(field_str.c_str());
+					if (weight <= 0) {
+						BOOST_LOG_TRIVIAL(error) << boost::format(
+								"The weight of `%1%' must be positive") % name;
+						valid = false;
+					}
+				}
+			}
+		}
+		if (!valid) {
+			data_files.clear();
+			break;
 		}
 		std::string path_name = name;
 		path_name.erase(std::remove_if(path_name.begin(), path_name.end(),
@@ -193,7 +223,7 @@ static int retrieve_data_files(std::string file_file,
 			break;
 		}
 
-		data_files.emplace_back(path_name, disk_id, node_id);
+		data_files.emplace_back(path_name, disk_id, node_id, weight, fast);
 		free(line);
 		line = NULL;
 		size = 0;
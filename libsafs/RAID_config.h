@@ -35,6 +35,8 @@ enum {
 	RAID0,
 	RAID5,
 	HASH,
+	WEIGHTED,
+	TIERED,
 };
 
 class RAID_config
@@ -68,6 +70,11 @@ public:
 	 */
 	std::set<int> get_node_ids() const;
 
+	/**
+	 * Whether some of the disks are in the fast tier.
+	 */
+	bool has_fast_disks() const;
+
 	const part_file_info &get_disk(int idx) const {
 		return root_paths[idx];
 	}
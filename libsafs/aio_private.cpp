@@ -26,6 +26,7 @@
 #include "read_private.h"
 #include "file_partition.h"
 #include "slab_allocator.h"
+#include "io_stats.h"
 
 template class blocking_FIFO_queue<safs::thread_callback_s *>;
 
@@ -51,6 +52,10 @@ struct thread_callback_s
 	callback_allocator *cb_allocator;
 	io_request req;
 	embedded_array<struct iovec, MAX_EMBED_BUFS> vec;
+	// The disk where the request is sent to and the time when the request
+	// is submitted. They are only used for collecting I/O statistics.
+	int disk_id;
+	long submit_time;
 };
 
 /**
@@ -109,22 +114,25 @@ void async_io::io_ref::dec_ref()
 async_io::async_io(const logical_file_partition &partition,
 		int aio_depth_per_file, thread *t, const safs_header &header,
 		int flags): io_interface(t, header), AIO_DEPTH(
-			aio_depth_per_file * partition.get_num_files())
+			aio_depth_per_file * partition.get_num_files()),
+	poller(params.get_max_spin_time() * 1000L)
 {
 	int node_id = t->get_node_id();
 	cb_allocator = new callback_allocator(node_id,
 			AIO_DEPTH * sizeof(thread_callback_s));;
 	buf_idx = 0;
-	ctx = new aio_ctx_impl(node_id, AIO_DEPTH);
+	ctx = create_aio_ctx(node_id, AIO_DEPTH);
 
 	num_iowait = 0;
 	num_completed_reqs = 0;
+	stats = NULL;
 	open_flags = flags;
 	if (partition.is_active()) {
 		int file_id = partition.get_file_id();
 		io_ref io(new buffered_io(partition, t, header, O_DIRECT | flags));
 		default_io = io;
 		open_files.insert(std::pair<int, io_ref>(file_id, io));
+		ctx->register_files(default_io.get_io().get_fds());
 	}
 }
 
@@ -181,12 +189,23 @@ struct iocb *async_io::construct_req(io_request &io_req, callback_t cb_func)
 	assert(it != open_files.end());
 	assert(it->second.is_valid());
 	buffered_io &io = it->second.get_io();
+	// The reads that don't come from remote_io are counted here. A merged
+	// request doesn't need to be counted because the requests merged in it
+	// are counted.
+	if (io_type == A_READ && !tcb->req.is_tier_tracked()
+			&& tcb->req.get_merged_reqs() == NULL)
+		tcb->req.set_tier_epoch(io.get_partition().get_mapper()->begin_read());
 	io.get_partition().map(tcb->req.get_offset() / PAGE_SIZE, bid);
 	// Here we translate the global request offset to the offset in the local
 	// disk.
 	off_t local_off = bid.off * PAGE_SIZE + (tcb->req.get_offset() % PAGE_SIZE);
+	if (stats) {
+		tcb->disk_id = io.get_partition().get_disk_id(bid.idx);
+		tcb->submit_time = get_curr_ns();
+		stats->submit(tcb->disk_id, tcb->submit_time);
+	}
 	if (tcb->req.get_num_bufs() == 1)
-		return ctx->make_io_request(io.get_fd(tcb->req.get_offset()),
+		return ctx->make_io_request(io.get_fd_by_idx(bid.idx),
 				tcb->req.get_size(), local_off, tcb->req.get_buf(), io_type, cb);
 	else {
 		int num_bufs = tcb->req.get_num_bufs();
@@ -196,20 +215,48 @@ struct iocb *async_io::construct_req(io_request &io_req, callback_t cb_func)
 		}
 		tcb->vec.resize(num_bufs);
 		BOOST_VERIFY(tcb->req.get_vec(tcb->vec.data(), num_bufs) == num_bufs);
-		struct iocb *req = ctx->make_iovec_request(io.get_fd(tcb->req.get_offset()),
-				/* 
-				 * iocb only contains a pointer to the io vector.
-				 * the space for the IO vector is stored
-				 * in the callback structure.
-				 */
+		/* 
+		 * iocb only contains a pointer to the io vector.
+		 * the space for the IO vector is stored in the callback structure,
+		 * so the request can be submitted with other requests in a batch.
+		 */
+		return ctx->make_iovec_request(io.get_fd_by_idx(bid.idx),
 				tcb->vec.data(), num_bufs, local_off, io_type, cb);
-		// I need to submit the request immediately. The iovec array is
-		// allocated in the stack.
-		ctx->submit_io_request(&req, 1);
-		return NULL;
 	}
 }
 
+/*
+ * Wait for at least `num' requests to complete. If completions usually
+ * arrive soon, we poll the completion queue for a while before we block
+ * in the kernel.
+ */
+int async_io::wait4complete(int num)
+{
+	long spin_ns = poller.get_spin_ns();
+	if (spin_ns == 0) {
+		long start = get_curr_ns();
+		int ret = ctx->io_wait(NULL, num);
+		poller.add_wait(get_curr_ns() - start, 0, false);
+		return ret;
+	}
+
+	struct timespec no_wait = {0, 0};
+	int num_completed = 0;
+	long start = get_curr_ns();
+	long now = start;
+	while (num_completed < num && now - start < spin_ns) {
+		num_completed += ctx->io_wait(&no_wait, 0);
+		now = get_curr_ns();
+	}
+	if (num_completed >= num) {
+		poller.add_wait(now - start, now - start, true);
+		return num_completed;
+	}
+	num_completed += ctx->io_wait(NULL, num - num_completed);
+	poller.add_wait(get_curr_ns() - start, now - start, false);
+	return num_completed;
+}
+
 void async_io::access(io_request *requests, int num, io_status *status)
 {
 	ASSERT_EQ(get_thread(), thread::get_curr_thread());
@@ -221,7 +268,7 @@ void async_io::access(io_request *requests, int num, io_status *status)
 			 * as long as there is a slot available.
 			 */
 			num_iowait++;
-			ctx->io_wait(NULL, 1);
+			wait4complete(1);
 			slot = ctx->max_io_slot();
 		}
 		struct iocb *reqs[slot];
@@ -331,14 +378,69 @@ void aio_complete_thread::process_completed_reqs(thread_callback_s *tcbs[],
 	}
 }
 
+/*
+ * An I/O thread may merge requests from different threads into one request.
+ * Here we replace a merged request with the original requests, so they
+ * complete in the same way as the requests that aren't merged.
+ */
+void async_io::split_merged_reqs(thread_callback_s *tcbs[], int num,
+		std::vector<thread_callback_s *> &split)
+{
+	for (int i = 0; i < num; i++) {
+		std::vector<io_request> *origs = tcbs[i]->req.get_merged_reqs();
+		if (origs == NULL) {
+			split.push_back(tcbs[i]);
+			continue;
+		}
+		for (size_t j = 0; j < origs->size(); j++) {
+			thread_callback_s *tcb = cb_allocator->alloc_obj();
+			tcb->req = origs->at(j);
+			tcb->aio = this;
+			tcb->cb_allocator = cb_allocator;
+			split.push_back(tcb);
+		}
+		delete origs;
+		delete tcbs[i]->req.get_extension();
+		tcbs[i]->cb_allocator->free(tcbs[i]);
+	}
+}
+
 void async_io::return_cb(thread_callback_s *tcbs[], int num)
 {
+	num_completed_reqs += num;
+	if (stats) {
+		long now = get_curr_ns();
+		for (int i = 0; i < num; i++)
+			stats->complete(tcbs[i]->disk_id, tcbs[i]->req.get_file_id(),
+					tcbs[i]->submit_time, now);
+	}
+
+	std::vector<thread_callback_s *> split;
+	for (int i = 0; i < num; i++) {
+		if (tcbs[i]->req.get_merged_reqs()) {
+			split_merged_reqs(tcbs, num, split);
+			tcbs = split.data();
+			num = split.size();
+			break;
+		}
+	}
+
+	// The reads no longer access the locations they are mapped to.
+	for (int i = 0; i < num; i++) {
+		io_request &req = tcbs[i]->req;
+		if (req.is_tier_tracked()) {
+			auto it = open_files.find(req.get_file_id());
+			assert(it != open_files.end());
+			it->second.get_io().get_partition().get_mapper()->end_read(
+					req.get_tier_epoch());
+			req.set_tier_epoch(-1);
+		}
+	}
+
 	thread_callback_s *local_tcbs[num];
 	thread_callback_s *remote_tcbs[num];
 	int num_local = 0;
 	int num_remote = 0;
-
-	num_completed_reqs += num;
 	for (int i = 0; i < num; i++) {
 		thread_callback_s *tcb = tcbs[i];
 		if (tcb->req.get_io() == this)
@@ -382,6 +484,7 @@ int async_io::open_file(const logical_file_partition &partition)
 		buffered_io *io = new buffered_io(partition, get_thread(),
 				get_header(), O_DIRECT | open_flags);
 		open_files.insert(std::pair<int, io_ref>(file_id, io_ref(io)));
+		ctx->register_files(io->get_fds());
 #if 0
 		if (data)
 			data->add_new_file(io);
@@ -395,6 +498,7 @@ int async_io::open_file(const logical_file_partition &partition)
 	else {
 		it->second = io_ref(new buffered_io(partition, get_thread(),
 					get_header(), O_DIRECT | open_flags));
+		ctx->register_files(it->second.get_io().get_fds());
 	}
 	return 0;
 }
@@ -404,6 +508,9 @@ int async_io::close_file(int file_id)
 	auto it = open_files.find(file_id);
 	// Users shouldn't close a file that hasn't been opened before.
 	assert(it != open_files.end());
+	// The files are going to be closed.
+	if (it->second.get_count() == 1)
+		ctx->unregister_files(it->second.get_io().get_fds());
 	it->second.dec_ref();
 //	open_files.erase(it);
 	return 0;
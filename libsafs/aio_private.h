@@ -28,6 +28,7 @@
 #include "thread.h"
 #include "container.h"
 #include "io_request.h"
+#include "hybrid_poller.h"
 
 namespace safs
 {
@@ -37,6 +38,7 @@ struct thread_callback_s;
 class buffered_io;
 class logical_file_partition;
 class callback_allocator;
+class io_stat_collector;
 
 class async_io: public io_interface
 {
@@ -49,6 +51,10 @@ class async_io: public io_interface
 
 	int num_iowait;
 	int num_completed_reqs;
+	// It's NULL if we don't collect I/O statistics.
+	io_stat_collector *stats;
+	// It decides how long we spin for completions before blocking.
+	hybrid_poller poller;
 
 	class io_ref
 	{
@@ -88,6 +94,8 @@ class async_io: public io_interface
 	io_ref default_io;
 
 	struct iocb *construct_req(io_request &io_req, callback_t cb_func);
+	void split_merged_reqs(thread_callback_s *tcbs[], int num,
+			std::vector<thread_callback_s *> &split);
 public:
 	/**
 	 * @aio_depth_per_file
@@ -136,9 +144,7 @@ public:
 	}
 
 	virtual void notify_completion(io_request *reqs[], int num);
-	int wait4complete(int num) {
-		return ctx->io_wait(NULL, num);
-	}
+	int wait4complete(int num);
 	virtual int get_max_num_pending_ios() const {
 		return AIO_DEPTH;
 	}
@@ -153,6 +159,13 @@ public:
 		return num_completed_reqs;
 	}
 
+	/*
+	 * The I/O statistics of the requests are collected in `stats'.
+	 */
+	void set_stat_collector(io_stat_collector *stats) {
+		this->stats = stats;
+	}
+
 	virtual void flush_requests();
 
 	// These two interfaces allow users to open and close more files.
@@ -168,6 +181,8 @@ public:
 	virtual void print_state() {
 		printf("aio %d has %ld open files, %d pending reqs\n",
 				get_io_id(), open_files.size(), num_pending_ios());
+		ctx->print_stat();
+		poller.print_stat();
 	}
 };
 
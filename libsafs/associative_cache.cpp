@@ -21,12 +21,14 @@
 #include <limits.h>
 
 #include <algorithm>
+#include <unordered_map>
 
 #include "io_interface.h"
 #include "associative_cache.h"
 #include "dirty_page_flusher.h"
 #include "safs_exception.h"
 #include "memory_manager.h"
+#include "shared_cache.h"
 
 namespace safs
 {
@@ -155,33 +157,37 @@ void hash_cell::init(associative_cache *cache, long hash, bool get_pages) {
 
 void hash_cell::sanity_check()
 {
-	_lock.lock();
+	_lock.write_lock();
 	buf.sanity_check();
 	assert(!is_referenced());
-	_lock.unlock();
+	_lock.write_unlock();
 }
 
 void hash_cell::add_pages(char *pages[], int num)
 {
+	_lock.write_lock();
 	buf.add_pages(pages, num, table->get_node_id());
+	_lock.write_unlock();
 }
 
 int hash_cell::add_pages_to_min(char *pages[], int num)
 {
+	_lock.write_lock();
 	int num_required = CELL_MIN_NUM_PAGES - buf.get_num_pages();
 	if (num_required > 0) {
 		num_required = min(num_required, num);
 		buf.add_pages(pages, num_required, table->get_node_id());
-		return num_required;
 	}
 	else
-		return 0;
+		num_required = 0;
+	_lock.write_unlock();
+	return num_required;
 }
 
 void hash_cell::merge(hash_cell *cell)
 {
-	_lock.lock();
-	cell->_lock.lock();
+	_lock.write_lock();
+	cell->_lock.write_lock();
 
 	assert(cell->get_num_pages() + this->get_num_pages() <= CELL_SIZE);
 	thread_safe_page pages[CELL_SIZE];
@@ -190,8 +196,8 @@ void hash_cell::merge(hash_cell *cell)
 	cell->buf.steal_pages(pages, npages);
 	buf.inject_pages(pages, npages);
 
-	cell->_lock.unlock();
-	_lock.unlock();
+	cell->_lock.write_unlock();
+	_lock.write_unlock();
 }
 
 /**
@@ -199,8 +205,8 @@ void hash_cell::merge(hash_cell *cell)
  */
 void hash_cell::rehash(hash_cell *expanded)
 {
-	_lock.lock();
-	expanded->_lock.lock();
+	_lock.write_lock();
+	expanded->_lock.write_lock();
 	thread_safe_page *exchanged_pages_pointers[CELL_SIZE];
 	int num_exchanges = 0;
 	for (unsigned int i = 0; i < buf.get_num_pages(); i++) {
@@ -276,12 +282,13 @@ void hash_cell::rehash(hash_cell *expanded)
 		expanded->buf.inject_pages(empty_pages, num_empty);
 		delete [] empty_pages;
 	}
-	expanded->_lock.unlock();
-	_lock.unlock();
+	expanded->_lock.write_unlock();
+	_lock.write_unlock();
 }
 
 void hash_cell::steal_pages(char *pages[], int &npages)
 {
+	_lock.write_lock();
 	int num_stolen = 0;
 	while (num_stolen < npages) {
 		thread_safe_page *pg = get_empty_page();
@@ -294,6 +301,7 @@ void hash_cell::steal_pages(char *pages[], int &npages)
 	}
 	buf.rebuild_map();
 	npages = num_stolen;
+	_lock.write_unlock();
 }
 
 void hash_cell::rebalance(hash_cell *cell)
@@ -303,8 +311,11 @@ void hash_cell::rebalance(hash_cell *cell)
 
 page *hash_cell::search(const page_id_t &pg_id)
 {
-	_lock.lock();
-	page *ret = NULL;
+	page *ret = search_lockless(pg_id);
+	if (ret)
+		return ret;
+
+	_lock.write_lock();
 	for (unsigned int i = 0; i < buf.get_num_pages(); i++) {
 		if (buf.get_page(i)->get_offset() == pg_id.get_offset()
 				&& buf.get_page(i)->get_file_id() == pg_id.get_file_id()) {
@@ -314,19 +325,88 @@ page *hash_cell::search(const page_id_t &pg_id)
 	}
 	if (ret)
 		ret->inc_ref();
-	_lock.unlock();
+	_lock.write_unlock();
 	return ret;
 }
 
+/**
+ * Search for a page without holding the lock of the cell.
+ * We take a reference of the page first, so it can't be evicted or moved
+ * after we verify it's still the page we are looking for. If anyone has
+ * locked the cell in the meanwhile, we give up and let the invoker search
+ * the cell with the lock.
+ * It only works for cache hits. A miss has to evict a page, which always
+ * requires the lock.
+ */
+thread_safe_page *hash_cell::search_lockless(const page_id_t &pg_id)
+{
+#ifdef USE_LRU
+	// The LRU policy has to reorder pages when a page is accessed.
+	return NULL;
+#else
+	unsigned long count;
+	if (!_lock.try_read_lock(count))
+		return NULL;
+	thread_safe_page *ret = buf.find_page(pg_id);
+	if (ret == NULL)
+		return NULL;
+	// inc_ref is a full memory barrier, so the checks below see the latest
+	// state of the page and the cell.
+	ret->inc_ref();
+	if (ret->get_offset() != pg_id.get_offset()
+			|| ret->get_file_id() != pg_id.get_file_id()
+			|| !_lock.read_unlock(count) || table->is_expanding()) {
+		ret->dec_ref();
+		return NULL;
+	}
+	return ret;
+#endif
+}
+
 /**
  * search for a page with the offset.
  * If the page doesn't exist, return an empty page.
  */
 page *hash_cell::search(const page_id_t &pg_id, page_id_t &old_id)
 {
-	thread_safe_page *ret = NULL;
-	_lock.lock();
-	num_accesses++;
+	thread_safe_page *ret = search_lockless(pg_id);
+	if (ret) {
+		// We need the lock to scale down the hits of all pages.
+		if (ret->get_hits() < 0xff) {
+			if (table->is_use_arc())
+				arc_policy.access_page(ret, buf);
+			else
+				policy.access_page(ret, buf);
+			/*
+			 * We don't hold the lock here, so the counters are updated
+			 * atomically. The page may still be evicted, or its hits may
+			 * be scaled down by another thread in the meanwhile. The hit
+			 * is then counted for the new page or lost by the scaling,
+			 * which only affects the choice of the victim a little and
+			 * never the correctness of the cache.
+			 */
+			ret->hit();
+			num_accesses.inc(1);
+			return ret;
+		}
+		ret->dec_ref();
+		ret = NULL;
+	}
+
+	// The evicted page whose old data should be kept in the compressed
+	// tier, and the state of the cell when it was evicted.
+	bool compress_old = false;
+	page_id_t compress_id;
+	long evict_seq = 0;
+	// The new page should be filled from the compressed tier or
+	// the shared cache after we release the cell lock.
+	bool fill_new = false;
+	// We need the version of the new page in the shared cache before
+	// the page can be read from the disks.
+	bool get_shared_version = false;
+
+	_lock.write_lock();
+	num_accesses.inc(1);
 
 	for (unsigned int i = 0; i < buf.get_num_pages(); i++) {
 		if (buf.get_page(i)->get_offset() == pg_id.get_offset()
@@ -339,9 +419,19 @@ page *hash_cell::search(const page_id_t &pg_id, page_id_t &old_id)
 		num_evictions++;
 		ret = get_empty_page();
 		if (ret == NULL) {
-			_lock.unlock();
+			_lock.write_unlock();
 			return NULL;
 		}
+		compressed_page_cache *ccache = table->get_compressed_cache();
+		shared_page_cache *scache = shared_page_cache::get_global();
+		// We can keep the evicted page in the compressed tier only if it's
+		// clean. A dirty page has to be written back with its data.
+		if (ccache && ret->initialized() && ret->data_ready()
+				&& !ret->is_dirty() && !ret->is_old_dirty()) {
+			compress_old = true;
+			compress_id = page_id_t(ret->get_file_id(), ret->get_offset());
+			evict_seq = num_evictions;
+		}
 		// We need to clear flags here.
 		ret->set_data_ready(false);
 		assert(!ret->is_io_pending());
@@ -368,6 +458,30 @@ page *hash_cell::search(const page_id_t &pg_id, page_id_t &old_id)
 		 * it might not have data ready.
 		 */
 		ret->set_id(pg_id);
+		if (table->is_use_arc())
+			arc_policy.add_page(ret, pg_id, buf);
+		// The page still holds the old dirty data, so we can't
+		// decompress the new page to it. The page will be read from
+		// the disk and we have to drop the compressed copy because
+		// a page can't be in both tiers.
+		if (ret->is_old_dirty()) {
+			if (ccache)
+				ccache->invalidate(pg_id);
+		}
+		// Other processes may have read the page from the disks.
+		else if (ccache || scache)
+			fill_new = true;
+		get_shared_version = scache != NULL;
+		/*
+		 * Compression and decompression are too expensive to run with
+		 * the cell lock held. We lock the page instead, so it works as
+		 * a placeholder: other threads can find the page, but they lock
+		 * it before they check its data or issue I/O to it, so they wait
+		 * until we fill it. Nobody holds a page lock while locking
+		 * a cell, so we can't deadlock here.
+		 */
+		if (compress_old || fill_new || get_shared_version)
+			ret->lock();
 #ifdef USE_SHADOW_PAGE
 		shadow_page shadow_pg = shadow.search(off);
 		/*
@@ -378,6 +492,8 @@ page *hash_cell::search(const page_id_t &pg_id, page_id_t &old_id)
 			ret->set_hits(shadow_pg.get_hits());
 #endif
 	}
+	else if (table->is_use_arc())
+		arc_policy.access_page(ret, buf);
 	else
 		policy.access_page(ret, buf);
 	/* it's possible that the data in the page isn't ready */
@@ -389,7 +505,45 @@ page *hash_cell::search(const page_id_t &pg_id, page_id_t &old_id)
 #endif
 	}
 	ret->hit();
-	_lock.unlock();
+	_lock.write_unlock();
+
+	if (compress_old || fill_new || get_shared_version) {
+		compressed_page_cache *ccache = table->get_compressed_cache();
+		char *compressed = NULL;
+		uint32_t compressed_size = 0;
+		// The page still holds the data of the evicted page.
+		if (compress_old)
+			compressed = ccache->compress((char *) ret->get_data(),
+					compressed_size);
+		shared_page_cache *scache = shared_page_cache::get_global();
+		// If the page isn't in the shared cache, it will be read from
+		// the disks, and the version tells whether another process has
+		// written the page since.
+		if (get_shared_version)
+			ret->set_shared_version(scache->get_version(pg_id));
+		if (fill_new) {
+			if (ccache && ccache->fetch(pg_id, (char *) ret->get_data()))
+				ret->set_data_ready(true);
+			else if (scache && scache->fetch(pg_id, (char *) ret->get_data()))
+				ret->set_data_ready(true);
+		}
+		ret->unlock();
+
+		/*
+		 * The evicted page may have been loaded to the cell again and even
+		 * modified and written back while we compressed it. A miss in
+		 * the cell is the only way to load it, so we drop the compressed
+		 * copy if the cell has evicted any other page since.
+		 */
+		if (compressed) {
+			_lock.write_lock();
+			if (num_evictions == evict_seq)
+				ccache->insert(compress_id, compressed, compressed_size);
+			else
+				free(compressed);
+			_lock.write_unlock();
+		}
+	}
 #ifdef DEBUG
 	if (enable_debug && ret->is_old_dirty())
 		print_cell();
@@ -399,7 +553,7 @@ page *hash_cell::search(const page_id_t &pg_id, page_id_t &old_id)
 
 void hash_cell::print_cell()
 {
-	_lock.lock();
+	_lock.write_lock();
 	printf("cell %ld: in queue: %d\n", get_hash(), is_in_queue());
 	for (unsigned int i = 0; i < buf.get_num_pages(); i++) {
 		thread_safe_page *p = buf.get_page(i);
@@ -408,13 +562,21 @@ void hash_cell::print_cell()
 				p->get_ref(), p->data_ready(), p->is_io_pending(), p->is_dirty(),
 				p->is_old_dirty(), p->is_prepare_writeback());
 	}
-	_lock.unlock();
+	_lock.write_unlock();
 }
 
 /* this function has to be called with lock held */
+/*
+ * The eviction policies don't clear the flags of the evicted page, so
+ * the caller can still tell if the page holds valid data.
+ */
 thread_safe_page *hash_cell::get_empty_page()
 {
-	thread_safe_page *ret = policy.evict_page(buf);
+	thread_safe_page *ret;
+	if (table->is_use_arc())
+		ret = arc_policy.evict_page(buf);
+	else
+		ret = policy.evict_page(buf);
 	if (ret == NULL) {
 #ifdef DEBUG
 		printf("all pages in the cell were all referenced\n");
@@ -450,7 +612,6 @@ thread_safe_page *LRU_eviction_policy::evict_page(
 	thread_safe_page *ret = buf.get_page(pos);
 	while (ret->get_ref()) {}
 	pos_vec.push_back(pos);
-	ret->set_data_ready(false);
 	return ret;
 }
 
@@ -509,7 +670,6 @@ thread_safe_page *LFU_eviction_policy::evict_page(
 		}
 		/* it happens when all pages in the cell is used currently. */
 	} while (ret == NULL);
-	ret->set_data_ready(false);
 	ret->reset_hits();
 	return ret;
 }
@@ -526,7 +686,6 @@ thread_safe_page *FIFO_eviction_policy::evict_page(
 	while (ret->get_ref()) {
 		ret = buf.get_empty_page();
 	}
-	ret->set_data_ready(false);
 	return ret;
 }
 
@@ -599,8 +758,11 @@ thread_safe_page *gclock_eviction_policy::evict_page(
 			break;
 		}
 		pg->set_hits(pg->get_hits() - 1);
+		// The page can be evicted in a later round, so the pages we have
+		// skipped don't mean that all pages in the cell are in use.
+		num_dirty = 0;
+		num_referenced = 0;
 	} while (ret == NULL);
-	ret->set_data_ready(false);
 #if 0
 	assign_flush_scores(buf);
 #endif
@@ -692,11 +854,171 @@ thread_safe_page *clock_eviction_policy::evict_page(
 		pg->reset_hits();
 		clock_head++;
 	} while (ret == NULL);
-	ret->set_data_ready(false);
 	ret->reset_hits();
 	return ret;
 }
 
+void arc_eviction_policy::ghost_list::add(const page_id_t &pg_id,
+		int max_size)
+{
+	assert(max_size <= CELL_SIZE);
+	// Drop the oldest pages.
+	while (num >= max_size && num > 0) {
+		head = (head + 1) % CELL_SIZE;
+		num--;
+	}
+	if (max_size == 0)
+		return;
+	ghost_page &pg = pages[(head + num) % CELL_SIZE];
+	pg.file_id = pg_id.get_file_id();
+	pg.offset = pg_id.get_offset() >> LOG_PAGE_SIZE;
+	num++;
+}
+
+bool arc_eviction_policy::ghost_list::remove(const page_id_t &pg_id)
+{
+	int offset = pg_id.get_offset() >> LOG_PAGE_SIZE;
+	for (int i = 0; i < num; i++) {
+		int idx = (head + i) % CELL_SIZE;
+		if (pages[idx].offset == offset
+				&& pages[idx].file_id == pg_id.get_file_id()) {
+			// Fill the hole with the pages after it.
+			for (int j = i + 1; j < num; j++)
+				pages[(head + j - 1) % CELL_SIZE] = pages[(head + j) % CELL_SIZE];
+			num--;
+			return true;
+		}
+	}
+	return false;
+}
+
+thread_safe_page *arc_eviction_policy::evict_page(
+		page_cell<thread_safe_page> &buf)
+{
+	const int num_pages = buf.get_num_pages();
+	int num_t1 = 0;
+	for (int i = 0; i < num_pages; i++) {
+		thread_safe_page *pg = buf.get_page(i);
+		// Use the pages that have never been used first.
+		if (!pg->initialized() && pg->get_ref() == 0) {
+			pg->set_data_ready(false);
+			return pg;
+		}
+		if (!pg->active())
+			num_t1++;
+	}
+
+	/*
+	 * In the first two rounds, we only evict pages from the preferred list
+	 * and avoid dirty pages. A page visited in the first round may get
+	 * its reference bit cleared and is evicted in the second round.
+	 * In the next two rounds, we can evict any page.
+	 */
+	bool from_t1 = num_t1 > 0 && num_t1 >= std::max(1, target_t1);
+	thread_safe_page *ret = NULL;
+	for (int i = 0; i < num_pages * 4 && ret == NULL; i++) {
+		int round = i / num_pages;
+		if (i % num_pages == 0 && round >= 2) {
+			bool all_referenced = true;
+			for (int j = 0; j < num_pages; j++)
+				if (buf.get_page(j)->get_ref() == 0)
+					all_referenced = false;
+			// If all pages in the cell are referenced, we should
+			// return NULL to notify the invoker.
+			if (all_referenced)
+				return NULL;
+		}
+		thread_safe_page *pg = buf.get_page(clock_head % num_pages);
+		clock_head++;
+		if (pg->get_ref())
+			continue;
+		bool in_t1 = !pg->active();
+		if (round < 2 && (in_t1 != from_t1 || pg->is_dirty()))
+			continue;
+		if (pg->referenced()) {
+			pg->set_referenced(false);
+			// A page in T1 that is accessed again is moved to T2.
+			if (in_t1)
+				pg->set_active(true);
+			continue;
+		}
+		ret = pg;
+	}
+	if (ret == NULL)
+		return NULL;
+
+	page_id_t pg_id(ret->get_file_id(), ret->get_offset());
+	if (ret->active())
+		b2.add(pg_id, num_pages);
+	else
+		b1.add(pg_id, num_pages);
+	ret->set_active(false);
+	ret->set_referenced(false);
+	return ret;
+}
+
+void arc_eviction_policy::add_page(thread_safe_page *pg,
+		const page_id_t &pg_id, page_cell<thread_safe_page> &buf)
+{
+	const int num_pages = buf.get_num_pages();
+	int b1_size = b1.get_size();
+	int b2_size = b2.get_size();
+	pg->set_referenced(false);
+	// The page was evicted from T1 too early, T1 should be larger.
+	if (b1.remove(pg_id)) {
+		num_b1_hits++;
+		target_t1 = std::min(target_t1 + std::max(1, b2_size / b1_size),
+				num_pages);
+		pg->set_active(true);
+	}
+	// The page was evicted from T2 too early, T2 should be larger.
+	else if (b2.remove(pg_id)) {
+		num_b2_hits++;
+		target_t1 = std::max(target_t1 - std::max(1, b1_size / b2_size), 0);
+		pg->set_active(true);
+	}
+	else
+		pg->set_active(false);
+}
+
+/*
+ * The pages most likely to be evicted are the ones without the reference bit
+ * in the list that the policy evicts pages from.
+ */
+int arc_eviction_policy::predict_evicted_pages(
+		page_cell<thread_safe_page> &buf, int num_pages, int set_flags,
+		int clear_flags, std::map<off_t, thread_safe_page *> &pages)
+{
+	const int num_cell_pages = buf.get_num_pages();
+	int num_t1 = 0;
+	for (int i = 0; i < num_cell_pages; i++)
+		if (!buf.get_page(i)->active())
+			num_t1++;
+	bool from_t1 = num_t1 > 0 && num_t1 >= std::max(1, target_t1);
+
+	int num_most_likely = 0;
+	for (int pass = 0; pass < 2; pass++) {
+		bool in_t1 = pass == 0 ? from_t1 : !from_t1;
+		for (int i = 0; i < num_cell_pages; i++) {
+			thread_safe_page *p = buf.get_page((i + clock_head) % num_cell_pages);
+			if (!p->initialized() || p->referenced()
+					|| (!p->active()) != in_t1)
+				continue;
+			p->set_flush_score(num_most_likely);
+			if (p->test_flags(set_flags) && !p->test_flags(clear_flags)) {
+				pages.insert(std::pair<off_t, thread_safe_page *>(
+							p->get_offset(), p));
+				if ((int) pages.size() == num_pages)
+					return pages.size();
+			}
+			num_most_likely++;
+			if (num_most_likely >= MAX_NUM_WRITEBACK)
+				return pages.size();
+		}
+	}
+	return pages.size();
+}
+
 associative_cache::~associative_cache()
 {
 	for (unsigned int i = 0; i < cells_table.size(); i++)
@@ -945,6 +1267,38 @@ page *associative_cache::search(const page_id_t &pg_id)
 	} while (true);
 }
 
+void associative_cache::get_access_stat(long &num_accesses, long &num_misses,
+		long &num_ghost_hits) const
+{
+	unsigned long count;
+	do {
+		table_lock.read_lock(count);
+		num_accesses = 0;
+		num_misses = 0;
+		num_ghost_hits = 0;
+		int ncells = get_num_cells();
+		for (int i = 0; i < ncells; i++) {
+			hash_cell *cell = get_cell(i);
+			num_accesses += cell->get_num_accesses();
+			num_misses += cell->get_num_evictions();
+			num_ghost_hits += cell->get_num_ghost_hits();
+		}
+	} while (!table_lock.read_unlock(count));
+}
+
+void associative_cache::get_resident_pages(std::vector<page_id_t> &pages) const
+{
+	size_t orig_size = pages.size();
+	unsigned long count;
+	do {
+		pages.resize(orig_size);
+		table_lock.read_lock(count);
+		int ncells = get_num_cells();
+		for (int i = 0; i < ncells; i++)
+			get_cell(i)->get_resident_pages(pages);
+	} while (!table_lock.read_unlock(count));
+}
+
 int associative_cache::get_num_used_pages() const
 {
 	unsigned long count;
@@ -974,7 +1328,8 @@ void associative_cache::sanity_check() const
 
 associative_cache::associative_cache(long cache_size, long max_cache_size,
 		int node_id, int offset_factor, int _max_num_pending_flush,
-		bool expandable): max_num_pending_flush(_max_num_pending_flush)
+		bool expandable, bool use_arc): max_num_pending_flush(
+			_max_num_pending_flush)
 {
 	this->offset_factor = offset_factor;
 	pthread_mutex_init(&init_mutex, NULL);
@@ -988,6 +1343,7 @@ associative_cache::associative_cache(long cache_size, long max_cache_size,
 	height = params.get_SA_min_cell_size();
 	expand_cell_idx = 0;
 	this->expandable = expandable;
+	this->use_arc = use_arc;
 	this->manager = memory_manager::create(max_cache_size, node_id);
 	manager->register_cache(this);
 	long init_cache_size = default_init_cache_size;
@@ -1021,6 +1377,13 @@ associative_cache::associative_cache(long cache_size, long max_cache_size,
 
 	if (expandable && cache_size > init_cache_size)
 		expand((cache_size - init_cache_size) / PAGE_SIZE);
+
+	// The compressed tier is split among the caches on NUMA nodes
+	// in the same way as the page cache.
+	if (params.get_compressed_cache_size() > 0)
+		compressed_cache = compressed_page_cache::create(
+				params.get_compressed_cache_size() * (double) cache_size
+				/ max(params.get_cache_size(), cache_size));
 }
 
 /**
@@ -1076,41 +1439,95 @@ class associative_flusher;
 
 class flush_io: public io_interface
 {
-	io_interface::ptr underlying;
+	// The I/O instances for writing back the dirty pages of each file.
+	spin_lock lock;
+	std::unordered_map<int, io_interface::ptr> underlyings;
+	// Each thread writes back dirty pages with its own I/O instances,
+	// which are cloned from the ones above.
 	pthread_key_t underlying_key;
+	// The per-thread I/O instances of all threads, so we can free them.
+	std::vector<std::unordered_map<int, io_interface *> *> thread_ios;
 	associative_cache *cache;
 	associative_flusher *flusher;
 
-	io_interface *get_per_thread_io() {
-		io_interface *io = (io_interface *) pthread_getspecific(underlying_key);
-		if (io == NULL) {
-			thread *curr = thread::get_curr_thread();
-			assert(curr);
-			io = underlying->clone(curr);
-			pthread_setspecific(underlying_key, io);
+	io_interface *get_per_thread_io(int file_id) {
+		std::unordered_map<int, io_interface *> *ios
+			= (std::unordered_map<int, io_interface *> *) pthread_getspecific(
+					underlying_key);
+		if (ios == NULL) {
+			ios = new std::unordered_map<int, io_interface *>();
+			pthread_setspecific(underlying_key, ios);
+			lock.lock();
+			thread_ios.push_back(ios);
+			lock.unlock();
 		}
+		auto it = ios->find(file_id);
+		if (it != ios->end())
+			return it->second;
+
+		lock.lock();
+		auto underlying_it = underlyings.find(file_id);
+		assert(underlying_it != underlyings.end());
+		io_interface::ptr underlying = underlying_it->second;
+		lock.unlock();
+		thread *curr = thread::get_curr_thread();
+		assert(curr);
+		io_interface *io = underlying->clone(curr);
+		ios->insert(std::pair<int, io_interface *>(file_id, io));
 		return io;
 	}
 public:
 	flush_io(io_interface::ptr underlying, associative_cache *cache,
 			associative_flusher *flusher): io_interface(NULL,
 				underlying->get_header()) {
-		this->underlying = underlying;
+		add_underlying(underlying);
 		this->cache = cache;
 		this->flusher = flusher;
 		pthread_key_create(&underlying_key, NULL);
 	}
 
+	~flush_io() {
+		for (size_t i = 0; i < thread_ios.size(); i++) {
+			for (auto it = thread_ios[i]->begin(); it != thread_ios[i]->end();
+					it++)
+				delete it->second;
+			delete thread_ios[i];
+		}
+		pthread_key_delete(underlying_key);
+	}
+
+	void add_underlying(io_interface::ptr underlying) {
+		lock.lock();
+		underlyings.insert(std::pair<int, io_interface::ptr>(
+					underlying->get_file_id(), underlying));
+		lock.unlock();
+	}
+
 	virtual int get_file_id() const {
 		throw unsupported_exception("get_file_id");
 	}
 
 	virtual void notify_completion(io_request *reqs[], int num);
 	virtual void access(io_request *requests, int num, io_status *status = NULL) {
-		get_per_thread_io()->access(requests, num, status);
+		// The requests to the same file are usually next to each other.
+		for (int i = 0; i < num;) {
+			int file_id = requests[i].get_file_id();
+			int j = i + 1;
+			while (j < num && requests[j].get_file_id() == file_id)
+				j++;
+			get_per_thread_io(file_id)->access(requests + i, j - i,
+					status ? status + i : NULL);
+			i = j;
+		}
 	}
 	virtual void flush_requests() {
-		get_per_thread_io()->flush_requests();
+		std::unordered_map<int, io_interface *> *ios
+			= (std::unordered_map<int, io_interface *> *) pthread_getspecific(
+					underlying_key);
+		if (ios == NULL)
+			return;
+		for (auto it = ios->begin(); it != ios->end(); it++)
+			it->second->flush_requests();
 	}
 	virtual int wait4complete(int num) {
 		throw unsupported_exception("wait4complete");
@@ -1130,12 +1547,28 @@ class associative_flusher: public dirty_page_flusher
 
 	std::unique_ptr<flush_io> io;
 	std::unique_ptr<select_dirty_pages_policy> policy;
+
+	/*
+	 * The flusher throttles itself with the latency of the writes
+	 * on the disks.
+	 */
+	spin_lock throttle_lock;
+	// The moving average of the write latency in us.
+	double avg_write_latency;
+	// The max number of flushes in the I/O queues.
+	int max_num_pending;
+	// The number of flushes completed since we reduced the max number
+	// of pending flushes.
+	int num_completed;
+
+	thread_safe_page *prepare_writeback(const page_id_t &pg_id);
+	void merge_dirty_pages(io_request &req);
 public:
 	thread_safe_FIFO_queue<hash_cell *> dirty_cells;
 	associative_flusher(page_cache *cache, associative_cache *local_cache,
 			io_interface::ptr io, int node_id): dirty_cells(
-				std::string("dirty_cells-") + itoa(io->get_node_id()),
-				io->get_node_id(), local_cache->get_num_cells()) {
+				std::string("dirty_cells-") + itoa(node_id),
+				node_id, local_cache->get_num_cells()) {
 		this->node_id = node_id;
 		this->cache = cache;
 		this->local_cache = local_cache;
@@ -1144,12 +1577,24 @@ public:
 
 		this->io = std::unique_ptr<flush_io>(new flush_io(io, local_cache, this));
 		policy = std::unique_ptr<select_dirty_pages_policy>(new eviction_select_dirty_pages_policy());
+		avg_write_latency = 0;
+		max_num_pending = local_cache->max_num_pending_flush;
+		num_completed = 0;
 	}
 
 	int get_node_id() const {
 		return node_id;
 	}
 
+	int get_max_num_pending() const {
+		return max_num_pending;
+	}
+
+	void add_io(io_interface::ptr io) {
+		this->io->add_underlying(io);
+	}
+
+	void throttle(const long latencies[], int num);
 	void run();
 	void flush_dirty_pages(thread_safe_page *pages[], int num,
 			io_interface &io);
@@ -1157,12 +1602,35 @@ public:
 	int flush_cell(hash_cell *cell, io_request *req_array, int req_array_size);
 };
 
+/*
+ * The flushes are issued in the order of their locations, so the writes
+ * to a disk are sequential.
+ */
+struct flush_comparator
+{
+	bool operator()(const io_request &req1, const io_request &req2) const {
+		if (req1.get_file_id() != req2.get_file_id())
+			return req1.get_file_id() < req2.get_file_id();
+		return req1.get_offset() < req2.get_offset();
+	}
+};
+
 void flush_io::notify_completion(io_request *reqs[], int num)
 {
 	hash_cell *dirty_cells[num];
 	int num_dirty_cells = 0;
 	int num_flushes = 0;
+	long latencies[num];
+	int num_writes = 0;
+	struct timeval curr_time;
+	gettimeofday(&curr_time, NULL);
+	// An I/O thread may split a flush into multiple runs of contiguous
+	// pages. Only the first run keeps the private data of the flush,
+	// so the flush is counted once.
+	int num_orig_flushes = 0;
 	for (int i = 0; i < num; i++) {
+		if (reqs[i]->get_priv())
+			num_orig_flushes++;
 		// If the request is discarded by the I/O thread, we need to
 		// check the page set where it is located.
 		// If the page set isn't in the queue of dirty page sets,
@@ -1174,12 +1642,13 @@ void flush_io::notify_completion(io_request *reqs[], int num)
 #ifdef DEBUG
 			assert(cell->contain(reqs[i]->get_page(0))); 
 #endif
+			delete reqs[i]->get_extension();
 			if (cell->is_in_queue())
 				continue;
 
 			// Try to add more flushes only when there aren't many pending
 			// flush requests.
-			if (cache->num_pending_flush.get() < cache->max_num_pending_flush) {
+			if (cache->num_pending_flush.get() < flusher->get_max_num_pending()) {
 				io_request req_array[NUM_WRITEBACK_DIRTY_PAGES];
 				int ret = flusher->flush_cell(cell, req_array,
 						NUM_WRITEBACK_DIRTY_PAGES);
@@ -1200,11 +1669,18 @@ void flush_io::notify_completion(io_request *reqs[], int num)
 		}
 
 		assert(reqs[i]->get_num_bufs());
+		// The I/O thread sets the timestamp when it issues the write.
+		latencies[num_writes++] = time_diff_us(reqs[i]->get_timestamp(),
+				curr_time);
+		shared_page_cache *scache = shared_page_cache::get_global();
 		if (reqs[i]->get_num_bufs() == 1) {
 			thread_safe_page *p = (thread_safe_page *) reqs[i]->get_page(0);
 			p->lock();
 			assert(p->is_dirty());
 			p->set_dirty(false);
+			// The other processes have to read the new data from the disks.
+			if (scache)
+				scache->invalidate(page_id_t(p->get_file_id(), p->get_offset()));
 			p->set_io_pending(false);
 			BOOST_VERIFY(p->reset_reqs() == NULL);
 			p->unlock();
@@ -1218,6 +1694,9 @@ void flush_io::notify_completion(io_request *reqs[], int num)
 				p->lock();
 				assert(p->is_dirty());
 				p->set_dirty(false);
+				if (scache)
+					scache->invalidate(page_id_t(p->get_file_id(),
+								p->get_offset()));
 				p->set_io_pending(false);
 				BOOST_VERIFY(p->reset_reqs() == NULL);
 				p->unlock();
@@ -1233,13 +1712,14 @@ void flush_io::notify_completion(io_request *reqs[], int num)
 		flusher->dirty_cells.add(dirty_cells, num_dirty_cells);
 	if (num_flushes > 0)
 		cache->num_pending_flush.inc(num_flushes);
+	flusher->throttle(latencies, num_writes);
 
-	cache->num_pending_flush.dec(num);
+	cache->num_pending_flush.dec(num_orig_flushes);
 #ifdef DEBUG
 	cache->num_dirty_pages.dec(num);
 	int orig = cache->num_pending_flush.get();
 #endif
-	if (cache->num_pending_flush.get() < cache->max_num_pending_flush) {
+	if (cache->num_pending_flush.get() < flusher->get_max_num_pending()) {
 		flusher->run();
 	}
 #ifdef DEBUG
@@ -1251,7 +1731,65 @@ void flush_io::notify_completion(io_request *reqs[], int num)
 #endif
 }
 
-void merge_pages2req(io_request &req, page_cache *cache);
+/*
+ * Decide whether we can flush the page and mark it for writing back.
+ * The caller has to lock the page.
+ */
+static bool try_prepare_writeback(thread_safe_page *p)
+{
+	if (!p->is_io_pending() && !p->is_prepare_writeback()
+			// The page may have been cleaned.
+			&& p->is_dirty()) {
+		p->set_prepare_writeback(true);
+		return true;
+	}
+	else
+		return false;
+}
+
+thread_safe_page *associative_flusher::prepare_writeback(
+		const page_id_t &pg_id)
+{
+	thread_safe_page *p = (thread_safe_page *) cache->search(pg_id);
+	if (p == NULL)
+		return NULL;
+	p->lock();
+	bool ret = try_prepare_writeback(p);
+	p->unlock();
+	// The request for writing back the page doesn't own the page.
+	p->dec_ref();
+	return ret ? p : NULL;
+}
+
+/*
+ * Add the dirty pages adjacent to the ones in the request, so we write
+ * back the contiguous dirty pages in a RAID block with a single request.
+ * The adjacent pages are usually in other cells.
+ */
+void associative_flusher::merge_dirty_pages(io_request &req)
+{
+	const off_t block_size = params.get_RAID_block_size() * PAGE_SIZE;
+	off_t block_off = ROUND(req.get_offset(), block_size);
+	off_t block_end_off = block_off + block_size;
+	int file_id = req.get_file_id();
+	for (off_t off = req.get_offset() + PAGE_SIZE; off < block_end_off;
+			off += PAGE_SIZE) {
+		thread_safe_page *p = prepare_writeback(page_id_t(file_id, off));
+		if (p == NULL)
+			break;
+		req.add_page(p);
+	}
+	for (off_t off = req.get_offset() - PAGE_SIZE; off >= block_off;
+			off -= PAGE_SIZE) {
+		page_id_t pg_id(file_id, off);
+		thread_safe_page *p = prepare_writeback(pg_id);
+		if (p == NULL)
+			break;
+		req.add_page_front(p);
+		req.set_data_loc(pg_id);
+	}
+	assert(req.inside_RAID_block(params.get_RAID_block_size()));
+}
 
 int associative_flusher::flush_cell(hash_cell *cell,
 		io_request *req_array, int req_array_size)
@@ -1267,57 +1805,59 @@ int associative_flusher::flush_cell(hash_cell *cell,
 		assert(p->data_ready());
 
 		assert(num_init_reqs < req_array_size);
-		// Here we flush dirty pages with normal requests.
-#if 0
-		if (!p->is_io_pending() && !p->is_prepare_writeback()
-				// The page may have been cleaned.
-				&& p->is_dirty()) {
-			// TODO global_cached_io may delete the extension.
-			// I'll fix it later.
-			if (!req_array[num_init_reqs].is_extended_req()) {
-				io_request tmp(true);
-				req_array[num_init_reqs] = tmp;
-			}
-			req_array[num_init_reqs].init(p->get_offset(), WRITE, io,
-					get_node_id(), NULL, cache, NULL);
-			req_array[num_init_reqs].add_page(p);
-			req_array[num_init_reqs].set_high_prio(true);
-			p->set_io_pending(true);
-			p->unlock();
-			merge_pages2req(req_array[num_init_reqs], cache);
-			num_init_reqs++;
-		}
-		else {
-			p->unlock();
-			p->dec_ref();
-		}
-#endif
-
-		// The code blow flush dirty pages with low-priority requests.
-		if (!p->is_io_pending() && !p->is_prepare_writeback()
-				// The page may have been cleaned.
-				&& p->is_dirty()) {
+		// We flush dirty pages with low-priority requests.
+		// The page may have been merged in the previous request.
+		if (try_prepare_writeback(p)) {
 			data_loc_t loc(p->get_file_id(), p->get_offset());
 			new (req_array + num_init_reqs) io_request(
 					new io_req_extension(), loc, WRITE, io.get(), get_node_id());
 			req_array[num_init_reqs].set_priv(cache);
 			req_array[num_init_reqs].add_page(p);
 			req_array[num_init_reqs].set_high_prio(false);
-#ifdef STATISTICS
 			req_array[num_init_reqs].set_timestamp();
-#endif
+			p->unlock();
+			merge_dirty_pages(req_array[num_init_reqs]);
 			num_init_reqs++;
-			p->set_prepare_writeback(true);
 		}
+		else
+			p->unlock();
 		// When a page is put in the queue for writing back,
 		// the queue of the IO thread doesn't own the page, which
 		// means that the page can be evicted.
-		p->unlock();
 		p->dec_ref();
 	}
 	return num_init_reqs;
 }
 
+/*
+ * Adjust the max number of pending flushes with the latency of
+ * the completed writes. It's reduced by half at most once in a window
+ * of completed writes when the writes are slower than the target, and
+ * grows by one for every write faster than the target.
+ */
+void associative_flusher::throttle(const long latencies[], int num)
+{
+	int target = params.get_flush_latency_target();
+	if (target <= 0 || num == 0)
+		return;
+
+	throttle_lock.lock();
+	for (int i = 0; i < num; i++) {
+		avg_write_latency += (latencies[i] - avg_write_latency) / 8;
+		num_completed++;
+		if (avg_write_latency > target) {
+			if (num_completed >= max_num_pending) {
+				max_num_pending = max(max_num_pending / 2,
+						MIN_NUM_PENDING_FLUSHES);
+				num_completed = 0;
+			}
+		}
+		else if (max_num_pending < local_cache->max_num_pending_flush)
+			max_num_pending++;
+	}
+	throttle_lock.unlock();
+}
+
 /**
  * This will run until we get enough pending flushes.
  */
@@ -1325,7 +1865,7 @@ void associative_flusher::run()
 {
 	const int FETCH_BUF_SIZE = 32;
 	// We can't get more requests than the number of pages in a cell.
-	io_request req_array[NUM_WRITEBACK_DIRTY_PAGES];
+	io_request req_array[FETCH_BUF_SIZE * NUM_WRITEBACK_DIRTY_PAGES];
 	int tot_flushes = 0;
 	while (dirty_cells.get_num_entries() > 0) {
 		hash_cell *cells[FETCH_BUF_SIZE];
@@ -1334,12 +1874,9 @@ void associative_flusher::run()
 		int num_fetches = dirty_cells.fetch(cells, FETCH_BUF_SIZE);
 		int num_flushes = 0;
 		for (int i = 0; i < num_fetches; i++) {
-			int ret = flush_cell(cells[i], req_array,
+			int ret = flush_cell(cells[i], req_array + num_flushes,
 					NUM_WRITEBACK_DIRTY_PAGES);
-			if (ret > 0) {
-				io->access(req_array, ret);
-				num_flushes += ret;
-			}
+			num_flushes += ret;
 			// If we get what we ask for, maybe there are more dirty pages
 			// we can flush. Add the dirty cell back in the queue.
 			if (ret == NUM_WRITEBACK_DIRTY_PAGES)
@@ -1353,13 +1890,16 @@ void associative_flusher::run()
 				cells[i]->set_in_queue(false);
 			}
 		}
+		if (num_flushes > 0) {
+			std::sort(req_array, req_array + num_flushes, flush_comparator());
+			io->access(req_array, num_flushes);
+		}
 		dirty_cells.add(tmp, num_dirty_cells);
 		local_cache->num_pending_flush.inc(num_flushes);
 		tot_flushes += num_flushes;
 
 		// If we have flushed enough pages, we can stop now.
-		if (local_cache->num_pending_flush.get()
-				> local_cache->max_num_pending_flush) {
+		if (local_cache->num_pending_flush.get() > get_max_num_pending()) {
 			break;
 		}
 	}
@@ -1372,11 +1912,19 @@ void associative_cache::create_flusher(io_interface::ptr io,
 	pthread_mutex_lock(&init_mutex);
 	if (_flusher == NULL && io
 			// The IO instance should be on the same node or we don't know
-			// in which node the cache is.
-			&& (io->get_node_id() == node_id || node_id == -1)) {
+			// in which node the cache is. The flushes are issued with
+			// the I/O instances cloned in the threads that issue them,
+			// so the IO instance may also be used by a thread that isn't
+			// bound to any node.
+			&& (io->get_node_id() == node_id || node_id == -1
+				|| io->get_node_id() == -1)) {
 		_flusher = std::unique_ptr<dirty_page_flusher>(
 				new associative_flusher(global_cache, this, io, node_id));
 	}
+	// The flusher needs an I/O instance for each file to write back
+	// its dirty pages.
+	else if (_flusher && io)
+		static_cast<associative_flusher *>(_flusher.get())->add_io(io);
 	pthread_mutex_unlock(&init_mutex);
 }
 
@@ -1442,22 +1990,26 @@ hash_cell *associative_cache::get_next_cell(hash_cell *cell)
 int hash_cell::num_pages(char set_flags, char clear_flags)
 {
 	int num = 0;
-	_lock.lock();
+	_lock.write_lock();
 	for (unsigned int i = 0; i < buf.get_num_pages(); i++) {
 		thread_safe_page *p = buf.get_page(i);
 		if (p->test_flags(set_flags) && !p->test_flags(clear_flags))
 			num++;
 	}
-	_lock.unlock();
+	_lock.write_unlock();
 	return num;
 }
 
 void hash_cell::predict_evicted_pages(int num_pages, char set_flags,
 		char clear_flags, std::map<off_t, thread_safe_page *> &pages)
 {
-	_lock.lock();
-	policy.predict_evicted_pages(buf, num_pages, set_flags,
-			clear_flags, pages);
+	_lock.write_lock();
+	if (table->is_use_arc())
+		arc_policy.predict_evicted_pages(buf, num_pages, set_flags,
+				clear_flags, pages);
+	else
+		policy.predict_evicted_pages(buf, num_pages, set_flags,
+				clear_flags, pages);
 	bool print = false;
 	for (std::map<off_t, thread_safe_page *>::iterator it = pages.begin();
 			it != pages.end(); it++) {
@@ -1465,7 +2017,7 @@ void hash_cell::predict_evicted_pages(int num_pages, char set_flags,
 		if (it->second->get_flush_score() >= MAX_NUM_WRITEBACK)
 			print = true;
 	}
-	_lock.unlock();
+	_lock.write_unlock();
 
 	if (print) {
 		for (std::map<off_t, thread_safe_page *>::iterator it = pages.begin();
@@ -1479,7 +2031,7 @@ void hash_cell::predict_evicted_pages(int num_pages, char set_flags,
 void hash_cell::get_pages(int num_pages, char set_flags, char clear_flags,
 		std::map<off_t, thread_safe_page *> &pages)
 {
-	_lock.lock();
+	_lock.write_lock();
 	for (int i = 0; i < (int) buf.get_num_pages(); i++) {
 		thread_safe_page *p = buf.get_page(i);
 		if (p->test_flags(set_flags) && !p->test_flags(clear_flags)) {
@@ -1488,7 +2040,18 @@ void hash_cell::get_pages(int num_pages, char set_flags, char clear_flags,
 						p->get_offset(), p));
 		}
 	}
-	_lock.unlock();
+	_lock.write_unlock();
+}
+
+void hash_cell::get_resident_pages(std::vector<page_id_t> &pages)
+{
+	_lock.write_lock();
+	for (unsigned int i = 0; i < buf.get_num_pages(); i++) {
+		thread_safe_page *p = buf.get_page(i);
+		if (p->initialized() && p->data_ready())
+			pages.push_back(page_id_t(p->get_file_id(), p->get_offset()));
+	}
+	_lock.write_unlock();
 }
 
 void associative_flusher::flush_dirty_pages(thread_safe_page *pages[],
@@ -1517,8 +2080,7 @@ void associative_flusher::flush_dirty_pages(thread_safe_page *pages[],
 		 */
 		int n = cell->num_pages(dirty_flag, skip_flags);
 		if (n > DIRTY_PAGES_THRESHOLD) {
-			if (local_cache->num_pending_flush.get()
-					> local_cache->max_num_pending_flush) {
+			if (local_cache->num_pending_flush.get() > get_max_num_pending()) {
 				if (!cell->set_in_queue(true))
 					cells[num_queued_cells++] = cell;
 			}
@@ -1526,7 +2088,9 @@ void associative_flusher::flush_dirty_pages(thread_safe_page *pages[],
 				io_request req_array[NUM_WRITEBACK_DIRTY_PAGES];
 				int ret = flush_cell(cell, req_array,
 						NUM_WRITEBACK_DIRTY_PAGES);
-				io.access(req_array, ret);
+				// We don't issue the flushes with the I/O instance of
+				// the application, so the application doesn't wait for them.
+				this->io->access(req_array, ret);
 				num_flushes += ret;
 				// If it has the required number of dirty pages to flush,
 				// it may have more to be flushed.
@@ -1536,8 +2100,10 @@ void associative_flusher::flush_dirty_pages(thread_safe_page *pages[],
 			}
 		}
 	}
-	if (num_flushes > 0)
+	if (num_flushes > 0) {
 		local_cache->num_pending_flush.inc(num_flushes);
+		this->io->flush_requests();
+	}
 	if (num_queued_cells > 0) {
 		// TODO currently, there is only one flush thread. Adding dirty cells
 		// requires to grab a spin lock. It may not work well on a NUMA machine.
@@ -1571,16 +2137,22 @@ int associative_flusher::flush_dirty_pages(page_filter *filter, int max_num)
 		int num_fetched_cells = dirty_cells.fetch(cells, num_cells);
 		if (num_fetched_cells == 0)
 			return num_flushes;
-		io_request req_array[NUM_WRITEBACK_DIRTY_PAGES];
+		stack_array<io_request> req_array(
+				num_fetched_cells * NUM_WRITEBACK_DIRTY_PAGES);
+		int num_reqs = 0;
 		for (int i = 0; i < num_fetched_cells; i++) {
-			int ret = flush_cell(cells[i], req_array, NUM_WRITEBACK_DIRTY_PAGES);
-			io->access(req_array, ret);
-			num_flushes += ret;
+			int ret = flush_cell(cells[i], req_array.data() + num_reqs,
+					NUM_WRITEBACK_DIRTY_PAGES);
+			num_reqs += ret;
 			if (ret == NUM_WRITEBACK_DIRTY_PAGES)
 				queue_cells[num_queued_cells++] = cells[i];
 			else
 				cells[i]->set_in_queue(false);
 		}
+		std::sort(req_array.data(), req_array.data() + num_reqs,
+				flush_comparator());
+		io->access(req_array.data(), num_reqs);
+		num_flushes += num_reqs;
 		dirty_cells.add(queue_cells, num_queued_cells);
 	}
 	io->flush_requests();
@@ -37,6 +37,7 @@
 #include "safs_exception.h"
 #include "comm_exception.h"
 #include "compute_stat.h"
+#include "compressed_cache.h"
 
 namespace safs
 {
@@ -138,6 +139,20 @@ public:
 		return ret;
 	}
 
+	/**
+	 * Search for the page in the physical array.
+	 * It can be called without the lock of the hash cell, so the caller
+	 * has to verify the page it gets.
+	 */
+	T *find_page(const page_id_t &pg_id) {
+		for (int i = 0; i < CELL_SIZE; i++) {
+			if (buf[i].get_offset() == pg_id.get_offset()
+					&& buf[i].get_file_id() == pg_id.get_file_id())
+				return &buf[i];
+		}
+		return NULL;
+	}
+
 	int get_idx(T *page) const {
 		int idx = page - buf;
 		assert (idx >= 0 && idx < num_pages);
@@ -207,6 +222,79 @@ public:
 	void assign_flush_scores(page_cell<thread_safe_page> &buf);
 };
 
+/*
+ * An adaptive and scan-resistant eviction policy. It's CAR, the clock
+ * version of ARC, applied to the pages in a cell.
+ * A page in the cell is either in T1 (accessed once recently) or in T2
+ * (accessed at least twice). The active bit of a page indicates T2 and
+ * the referenced bit is the clock reference bit.
+ * The cell remembers the pages evicted from T1 and T2 in two ghost lists
+ * and adapts the target size of T1 when an evicted page is accessed again.
+ * A one-pass scan only goes through T1, so it can't flush the pages in T2.
+ */
+class arc_eviction_policy: public eviction_policy
+{
+	/*
+	 * A ghost list keeps the IDs of recently evicted pages in FIFO order.
+	 */
+	class ghost_list
+	{
+		struct ghost_page {
+			file_id_t file_id;
+			// in pages.
+			int offset;
+		};
+		ghost_page pages[CELL_SIZE];
+		unsigned char head;
+		unsigned char num;
+	public:
+		ghost_list() {
+			head = 0;
+			num = 0;
+		}
+
+		int get_size() const {
+			return num;
+		}
+
+		void add(const page_id_t &pg_id, int max_size);
+		bool remove(const page_id_t &pg_id);
+	};
+
+	ghost_list b1;
+	ghost_list b2;
+	unsigned int clock_head;
+	// The target number of pages in T1.
+	int target_t1;
+	long num_b1_hits;
+	long num_b2_hits;
+public:
+	arc_eviction_policy() {
+		clock_head = 0;
+		target_t1 = 0;
+		num_b1_hits = 0;
+		num_b2_hits = 0;
+	}
+
+	thread_safe_page *evict_page(page_cell<thread_safe_page> &buf);
+	void access_page(thread_safe_page *pg,
+			page_cell<thread_safe_page> &buf) {
+		pg->set_referenced(true);
+	}
+	/*
+	 * A page of `pg_id' is placed in the cell after a miss.
+	 */
+	void add_page(thread_safe_page *pg, const page_id_t &pg_id,
+			page_cell<thread_safe_page> &buf);
+	int predict_evicted_pages(page_cell<thread_safe_page> &buf,
+			int num_pages, int set_flags, int clear_flags,
+			std::map<off_t, thread_safe_page *> &pages);
+
+	long get_num_ghost_hits() const {
+		return num_b1_hits + num_b2_hits;
+	}
+};
+
 class LFU_eviction_policy: public eviction_policy
 {
 public:
@@ -231,7 +319,10 @@ class hash_cell
 	int hash;
 	atomic_flags<int> flags;
 
-	spin_lock _lock;
+	// Every time a thread acquires the lock, the sequence number is increased,
+	// so a thread can search the cell without the lock and verify the result
+	// with the sequence number afterwards.
+	seq_lock _lock;
 	page_cell<thread_safe_page> buf;
 	associative_cache *table;
 #ifdef USE_LRU
@@ -245,14 +336,18 @@ class hash_cell
 #elif defined USE_GCLOCK
 	gclock_eviction_policy policy;
 #endif
+	// The eviction policy that can be chosen at runtime.
+	arc_eviction_policy arc_policy;
 #ifdef USE_SHADOW_PAGE
 	clock_shadow_cell shadow;
 #endif
 
-	long num_accesses;
+	// It's updated by the cache hits without the cell lock.
+	atomic_number<long> num_accesses;
 	long num_evictions;
 
 	thread_safe_page *get_empty_page();
+	thread_safe_page *search_lockless(const page_id_t &pg_id);
 
 	void init() {
 		table = NULL;
@@ -329,6 +424,11 @@ public:
 	void get_pages(int num_pages, char set_flags, char clear_flags,
 			std::map<off_t, thread_safe_page *> &pages);
 
+	/**
+	 * Get the pages whose data is ready in the cell.
+	 */
+	void get_resident_pages(std::vector<page_id_t> &pages);
+
 	/**
 	 * Predict the pages that are about to be evicted by the eviction policy,
 	 * and return them to the invoker.
@@ -375,13 +475,17 @@ public:
 	}
 
 	long get_num_accesses() const {
-		return num_accesses;
+		return num_accesses.get();
 	}
 
 	long get_num_evictions() const {
 		return num_evictions;
 	}
 
+	long get_num_ghost_hits() const {
+		return arc_policy.get_num_ghost_hits();
+	}
+
 	void print_cell();
 };
 
@@ -416,6 +520,10 @@ class associative_cache: public page_cache
 	int node_id;
 
 	bool expandable;
+	// Use the ARC eviction policy instead of the default one.
+	bool use_arc;
+	// The compressed tier of the cache. It's NULL if it's disabled.
+	compressed_page_cache::ptr compressed_cache;
 	int height;
 	/* used for linear hashing */
 	int level;
@@ -426,7 +534,7 @@ class associative_cache: public page_cache
 
 	associative_cache(long cache_size, long max_cache_size, int node_id,
 			int offset_factor, int _max_num_pending_flush,
-			bool expandable = false);
+			bool expandable = false, bool use_arc = false);
 
 	void create_flusher(std::shared_ptr<io_interface> io, page_cache *global_cache);
 
@@ -446,10 +554,11 @@ public:
 
 	static page_cache::ptr create(long cache_size, long max_cache_size,
 			int node_id, int offset_factor, int _max_num_pending_flush,
-			bool expandable = false) {
+			bool expandable = false, bool use_arc = false) {
 		assert(node_id >= 0);
 		return page_cache::ptr(new associative_cache(cache_size, max_cache_size,
-				node_id, offset_factor, _max_num_pending_flush, expandable));
+				node_id, offset_factor, _max_num_pending_flush, expandable,
+				use_arc));
 	}
 
 	~associative_cache();
@@ -549,6 +658,32 @@ public:
 		return expandable;
 	}
 
+	/*
+	 * Pages may be moved between hash cells while the table is expanding
+	 * or shrinking.
+	 */
+	bool is_expanding() const {
+		return flags.test_flag(TABLE_EXPANDING);
+	}
+
+	bool is_use_arc() const {
+		return use_arc;
+	}
+
+	compressed_page_cache *get_compressed_cache() const {
+		return compressed_cache.get();
+	}
+
+	/*
+	 * Get the number of page lookups, misses and the misses on
+	 * the pages recently evicted in all cells. It's only an estimate
+	 * because the counters are read without locking cells.
+	 */
+	virtual void get_access_stat(long &num_accesses, long &num_misses,
+			long &num_ghost_hits) const;
+
+	virtual void get_resident_pages(std::vector<page_id_t> &pages) const;
+
 	/* Methods for flushing dirty pages. */
 
 	void mark_dirty_pages(thread_safe_page *pages[], int num, io_interface &);
@@ -577,6 +712,14 @@ public:
 		printf("\tmax pending flushes: %ld, avg: %ld, remaining pending: %d\n",
 				recorded_max_num_pending.get(), (long) avg_num_pending.get(),
 				num_pending_flush.get());
+		long num_accesses, num_misses, num_ghost_hits;
+		get_access_stat(num_accesses, num_misses, num_ghost_hits);
+		printf("\t%s: %ld accesses, %ld misses, hit rate: %.3f, %ld ghost hits\n",
+				use_arc ? "arc" : "default policy", num_accesses, num_misses,
+				num_accesses > 0 ? 1 - ((double) num_misses) / num_accesses : 0,
+				num_ghost_hits);
+		if (compressed_cache)
+			compressed_cache->print_stat();
 #ifdef DETAILED_STATISTICS
 		for (int i = 0; i < get_num_cells(); i++)
 			printf("cell %d: %ld accesses, %ld evictions\n", i,
@@ -62,7 +62,9 @@ void page_byte_array::memcpy(off_t rel_off, char buf[], size_t size) const
 
 void page::hit()
 {
-	hits++;
+	unsigned char old = hits;
+	while (old < 0xff && !__sync_bool_compare_and_swap(&hits, old, old + 1))
+		old = hits;
 }
 
 }
@@ -57,7 +57,7 @@ enum {
 
 	/* 
 	 * These bits don't need to be protected by the lock.
-	 * They are used by LRU2Q, so it can be deleted in the future.
+	 * They are used by LRU2Q and the ARC eviction policy.
 	 */
 	ACTIVE_BIT,
 	REFERENCED_BIT,
@@ -200,7 +200,11 @@ public:
 		assert (hits <= 0xff);
 		this->hits = hits;
 	}
-	/* the page is accessed */
+	/*
+	 * The page is accessed. A page can be hit by multiple threads at
+	 * the same time, so the counter is increased atomically and it stops
+	 * at 0xff.
+	 */
 	void hit();
 
 	virtual void inc_ref() {
@@ -239,6 +243,10 @@ class thread_safe_page: public page
 
 	original_io_request *reqs;
 	int node_id;
+	// The version of the page in the shared cache when the page was added
+	// to the page cache. The page read from the disks can be added to
+	// the shared cache only if the version hasn't changed since.
+	uint32_t shared_version;
 	spin_lock _lock;
 
 public:
@@ -250,6 +258,7 @@ public:
 #endif
 		reqs = NULL;
 		node_id = -1;
+		shared_version = 0;
 	}
 
 	thread_safe_page(const page_id_t &pg_id, char *data,
@@ -261,6 +270,7 @@ public:
 #endif
 		reqs = NULL;
 		this->node_id = node_id;
+		shared_version = 0;
 	}
 
 	~thread_safe_page() {
@@ -275,6 +285,14 @@ public:
 		return node_id;
 	}
 
+	uint32_t get_shared_version() const {
+		return shared_version;
+	}
+
+	void set_shared_version(uint32_t version) {
+		shared_version = version;
+	}
+
 	/* this is enough for x86 architecture */
 	bool data_ready() const { return get_flags_bit(DATA_READY_BIT); }
 	void wait_ready() {
@@ -351,6 +369,17 @@ public:
 		return set_flags_bit(PREPARE_WRITEBACK, writeback);
 	}
 
+	/*
+	 * Other threads may change the flags of the page without holding
+	 * the lock of the hash cell, so these have to be atomic.
+	 */
+	bool set_referenced(bool referenced) {
+		return set_flags_bit(REFERENCED_BIT, referenced);
+	}
+	bool set_active(bool active) {
+		return set_flags_bit(ACTIVE_BIT, active);
+	}
+
 	void lock() {
 		_lock.lock();
 //		int old;
@@ -438,6 +467,21 @@ public:
 	virtual int get_node_id() const {
 		return -1;
 	}
+	/**
+	 * Get the pages whose data is in the cache.
+	 */
+	virtual void get_resident_pages(std::vector<page_id_t> &pages) const {
+	}
+	/**
+	 * Get the number of page lookups, misses and the misses on the pages
+	 * recently evicted.
+	 */
+	virtual void get_access_stat(long &num_accesses, long &num_misses,
+			long &num_ghost_hits) const {
+		num_accesses = 0;
+		num_misses = 0;
+		num_ghost_hits = 0;
+	}
 
 	// For test
 	virtual void print_stat() const {
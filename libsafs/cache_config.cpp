@@ -60,6 +60,11 @@ page_cache::ptr cache_config::__create_cache_on_node(int node_id,
 			cache = associative_cache::create(get_part_size(node_id),
 					MAX_CACHE_SIZE, node_id, 1, max_num_pending_flush);
 			break;
+		case ARC_CACHE:
+			cache = associative_cache::create(get_part_size(node_id),
+					MAX_CACHE_SIZE, node_id, 1, max_num_pending_flush,
+					false, true);
+			break;
 		default:
 			fprintf(stderr, "wrong cache type\n");
 			return page_cache::ptr();
@@ -149,7 +154,9 @@ file_map_cache_config::file_map_cache_config(long size, int type,
 
 int file_map_cache_config::page2cache(const page_id_t &pg_id) const
 {
-	int idx = mapper->map2file(pg_id.get_offset() / PAGE_SIZE);
+	// The location of a page in the cache shouldn't change when the page
+	// moves among disks.
+	int idx = mapper->map2home(pg_id.get_offset() / PAGE_SIZE);
 	return mapper->get_file_node_id(idx) + shift;
 }
 
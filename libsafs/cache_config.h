@@ -39,6 +39,8 @@ enum {
 	CUCKOO_CACHE,
 	LRU2Q_CACHE,
 	GCLOCK_CACHE,
+	// The associative cache with the ARC eviction policy.
+	ARC_CACHE,
 };
 
 /**
@@ -0,0 +1,270 @@
+/*
+ * Copyright 2014 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of SAFSlib.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <boost/format.hpp>
+
+#include "log.h"
+#include "cache_snapshot.h"
+
+namespace safs
+{
+
+/*
+ * The layout of a manifest file:
+ *	magic, version, the number of files,
+ *	for each file: the length of the file name, the file name,
+ *	the number of runs, the runs.
+ */
+static const char SNAPSHOT_MAGIC[8] = {'S', 'A', 'F', 'S', 'S', 'N', 'A', 'P'};
+static const uint32_t SNAPSHOT_VERSION = 1;
+
+struct snapshot_run
+{
+	int64_t start;
+	uint64_t num_pages;
+};
+
+void cache_snapshot::add_pages(const std::string &file_name,
+		std::vector<off_t> &offs)
+{
+	if (offs.empty())
+		return;
+
+	std::vector<page_run> &runs = files[file_name];
+	for (size_t i = 0; i < offs.size(); i++)
+		offs[i] /= PAGE_SIZE;
+	for (size_t i = 0; i < runs.size(); i++)
+		for (size_t j = 0; j < runs[i].num_pages; j++)
+			offs.push_back(runs[i].start + j);
+	std::sort(offs.begin(), offs.end());
+	offs.erase(std::unique(offs.begin(), offs.end()), offs.end());
+
+	runs.clear();
+	runs.push_back(page_run(offs[0], 1));
+	for (size_t i = 1; i < offs.size(); i++) {
+		page_run &last = runs.back();
+		if (last.start + (off_t) last.num_pages == offs[i])
+			last.num_pages++;
+		else
+			runs.push_back(page_run(offs[i], 1));
+	}
+}
+
+void cache_snapshot::add_runs(const std::string &file_name,
+		const std::vector<page_run> &runs)
+{
+	std::vector<page_run> &file_runs = files[file_name];
+	if (file_runs.empty()) {
+		file_runs = runs;
+		return;
+	}
+	std::vector<off_t> offs;
+	for (size_t i = 0; i < runs.size(); i++)
+		for (size_t j = 0; j < runs[i].num_pages; j++)
+			offs.push_back((runs[i].start + j) * PAGE_SIZE);
+	add_pages(file_name, offs);
+}
+
+size_t cache_snapshot::get_num_pages() const
+{
+	size_t num_pages = 0;
+	for (auto it = files.begin(); it != files.end(); it++)
+		for (size_t i = 0; i < it->second.size(); i++)
+			num_pages += it->second[i].num_pages;
+	return num_pages;
+}
+
+bool cache_snapshot::save(const std::string &file) const
+{
+	// We write to a temporary file first, so we never leave a broken
+	// manifest if the process crashes.
+	std::string tmp_file = file + ".tmp";
+	FILE *f = fopen(tmp_file.c_str(), "w");
+	if (f == NULL) {
+		BOOST_LOG_TRIVIAL(error) << boost::format("can't open %1%: %2%")
+			% tmp_file % strerror(errno);
+		return false;
+	}
+
+	bool success = true;
+	uint32_t num_files = files.size();
+	success = fwrite(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC), 1, f) == 1
+		&& fwrite(&SNAPSHOT_VERSION, sizeof(SNAPSHOT_VERSION), 1, f) == 1
+		&& fwrite(&num_files, sizeof(num_files), 1, f) == 1;
+	for (auto it = files.begin(); success && it != files.end(); it++) {
+		uint32_t name_len = it->first.length();
+		uint64_t num_runs = it->second.size();
+		std::vector<snapshot_run> runs(num_runs);
+		for (size_t i = 0; i < num_runs; i++) {
+			runs[i].start = it->second[i].start;
+			runs[i].num_pages = it->second[i].num_pages;
+		}
+		success = fwrite(&name_len, sizeof(name_len), 1, f) == 1
+			&& fwrite(it->first.c_str(), name_len, 1, f) == 1
+			&& fwrite(&num_runs, sizeof(num_runs), 1, f) == 1
+			&& fwrite(runs.data(), sizeof(runs[0]), num_runs, f) == num_runs;
+	}
+	if (fclose(f) != 0)
+		success = false;
+	if (success && rename(tmp_file.c_str(), file.c_str()) < 0)
+		success = false;
+	if (!success) {
+		BOOST_LOG_TRIVIAL(error) << boost::format("can't write %1%: %2%")
+			% file % strerror(errno);
+		unlink(tmp_file.c_str());
+	}
+	return success;
+}
+
+cache_snapshot::ptr cache_snapshot::load(const std::string &file)
+{
+	FILE *f = fopen(file.c_str(), "r");
+	if (f == NULL) {
+		BOOST_LOG_TRIVIAL(error) << boost::format("can't open %1%: %2%")
+			% file % strerror(errno);
+		return ptr();
+	}
+
+	ptr snapshot = create();
+	char magic[sizeof(SNAPSHOT_MAGIC)];
+	uint32_t version = 0;
+	uint32_t num_files = 0;
+	bool success = fread(magic, sizeof(magic), 1, f) == 1
+		&& memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic)) == 0
+		&& fread(&version, sizeof(version), 1, f) == 1
+		&& version == SNAPSHOT_VERSION
+		&& fread(&num_files, sizeof(num_files), 1, f) == 1;
+	for (uint32_t i = 0; success && i < num_files; i++) {
+		uint32_t name_len = 0;
+		uint64_t num_runs = 0;
+		success = fread(&name_len, sizeof(name_len), 1, f) == 1
+			&& name_len > 0 && name_len <= PATH_MAX;
+		if (!success)
+			break;
+		std::vector<char> name(name_len);
+		success = fread(name.data(), name_len, 1, f) == 1
+			&& fread(&num_runs, sizeof(num_runs), 1, f) == 1;
+		if (!success)
+			break;
+		std::vector<page_run> &runs = snapshot->files[std::string(
+				name.data(), name_len)];
+		for (uint64_t j = 0; success && j < num_runs; j++) {
+			snapshot_run run;
+			success = fread(&run, sizeof(run), 1, f) == 1;
+			if (success)
+				runs.push_back(page_run(run.start, run.num_pages));
+		}
+	}
+	fclose(f);
+	if (!success) {
+		BOOST_LOG_TRIVIAL(error) << boost::format("%1% is a broken manifest")
+			% file;
+		return ptr();
+	}
+	return snapshot;
+}
+
+namespace
+{
+
+/*
+ * The max size of a request to warm up the page cache.
+ */
+const size_t WARMUP_REQ_SIZE = 1024 * 1024;
+/*
+ * The max number of pending requests to warm up the page cache.
+ * The requests are spread to all disks, so we read data in parallel.
+ */
+const int WARMUP_NUM_PENDING = 32;
+
+class warmup_callback: public callback
+{
+	std::vector<char *> &free_bufs;
+public:
+	warmup_callback(std::vector<char *> &bufs): free_bufs(bufs) {
+	}
+
+	virtual int invoke(io_request *reqs[], int num) {
+		for (int i = 0; i < num; i++)
+			free_bufs.push_back(reqs[i]->get_buf());
+		return 0;
+	}
+};
+
+}
+
+ssize_t warm_up_cache(file_io_factory::shared_ptr factory,
+		const std::vector<page_run> &runs, size_t max_num_pages)
+{
+	thread *curr = thread::get_curr_thread();
+	if (curr == NULL) {
+		BOOST_LOG_TRIVIAL(warning)
+			<< "can't warm up the page cache in a non-SAFS thread";
+		return -1;
+	}
+	io_interface::ptr io = create_io(factory, curr);
+
+	std::vector<char *> free_bufs;
+	std::vector<char *> all_bufs;
+	for (int i = 0; i < WARMUP_NUM_PENDING; i++) {
+		char *buf = (char *) valloc(WARMUP_REQ_SIZE);
+		free_bufs.push_back(buf);
+		all_bufs.push_back(buf);
+	}
+	io->set_callback(callback::ptr(new warmup_callback(free_bufs)));
+
+	size_t num_file_pages = factory->get_file_size() / PAGE_SIZE;
+	const size_t max_req_pages = WARMUP_REQ_SIZE / PAGE_SIZE;
+	size_t num_pages = 0;
+	for (size_t i = 0; i < runs.size() && num_pages < max_num_pages; i++) {
+		// The file may have been shrunk since the snapshot was taken.
+		if (runs[i].start >= (off_t) num_file_pages)
+			continue;
+		off_t end = std::min<off_t>(runs[i].start + runs[i].num_pages,
+				num_file_pages);
+		for (off_t start = runs[i].start; start < end
+				&& num_pages < max_num_pages; start += max_req_pages) {
+			size_t req_pages = std::min(std::min<size_t>(end - start,
+						max_req_pages), max_num_pages - num_pages);
+			while (free_bufs.empty())
+				io->wait4complete(1);
+			char *buf = free_bufs.back();
+			free_bufs.pop_back();
+			data_loc_t loc(io->get_file_id(), start * PAGE_SIZE);
+			io_request req(buf, loc, req_pages * PAGE_SIZE, READ);
+			io->access(&req, 1);
+			num_pages += req_pages;
+		}
+	}
+	io->wait4complete(io->num_pending_ios());
+	io->cleanup();
+	for (size_t i = 0; i < all_bufs.size(); i++)
+		free(all_bufs[i]);
+	return num_pages;
+}
+
+}
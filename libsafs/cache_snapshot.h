@@ -0,0 +1,121 @@
+#ifndef __CACHE_SNAPSHOT_H__
+#define __CACHE_SNAPSHOT_H__
+
+/*
+ * Copyright 2014 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of SAFSlib.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+
+#include "io_interface.h"
+
+namespace safs
+{
+
+/**
+ * A range of contiguous pages in a file. Both fields are in pages.
+ */
+struct page_run
+{
+	off_t start;
+	size_t num_pages;
+
+	page_run(off_t start, size_t num_pages) {
+		this->start = start;
+		this->num_pages = num_pages;
+	}
+};
+
+/**
+ * This records the pages in the page cache, so a new process can read
+ * the same data to the page cache when it starts.
+ * Pages are identified by file names instead of file ids, because file ids
+ * are assigned at runtime. The pages of a file are stored as runs of
+ * contiguous pages, so the snapshot is compact and can be loaded with
+ * large sequential reads.
+ */
+class cache_snapshot
+{
+	std::map<std::string, std::vector<page_run> > files;
+public:
+	typedef std::shared_ptr<cache_snapshot> ptr;
+
+	static ptr create() {
+		return ptr(new cache_snapshot());
+	}
+
+	/**
+	 * Read a snapshot from a manifest file.
+	 * It returns NULL if the manifest file can't be read.
+	 */
+	static ptr load(const std::string &file);
+	bool save(const std::string &file) const;
+
+	/**
+	 * Add the pages of a file to the snapshot.
+	 * \param offs the offsets of the pages in bytes. They don't need to
+	 * be sorted and may have duplicates.
+	 */
+	void add_pages(const std::string &file_name, std::vector<off_t> &offs);
+
+	/**
+	 * Add the runs of pages of a file to the snapshot. The runs have to be
+	 * sorted and can't overlap, e.g., the runs from another snapshot.
+	 */
+	void add_runs(const std::string &file_name,
+			const std::vector<page_run> &runs);
+
+	void get_file_names(std::vector<std::string> &names) const {
+		for (auto it = files.begin(); it != files.end(); it++)
+			names.push_back(it->first);
+	}
+
+	/**
+	 * Get the runs of pages of a file. It returns NULL if the file
+	 * isn't in the snapshot.
+	 */
+	const std::vector<page_run> *get_runs(const std::string &file_name) const {
+		auto it = files.find(file_name);
+		if (it == files.end())
+			return NULL;
+		else
+			return &it->second;
+	}
+
+	size_t get_num_files() const {
+		return files.size();
+	}
+
+	size_t get_num_pages() const;
+};
+
+/**
+ * Read the pages in the runs to the page cache. It has to run in a SAFS
+ * thread and the I/O factory has to access the file through the page cache.
+ * It returns the number of pages that are read, or -1 if the page cache
+ * can't be warmed up.
+ */
+ssize_t warm_up_cache(file_io_factory::shared_ptr factory,
+		const std::vector<page_run> &runs, size_t max_num_pages);
+
+}
+
+#endif
@@ -22,6 +22,7 @@
 
 #include <errno.h>
 #include <sys/time.h>
+#include <time.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <sys/types.h>
@@ -84,6 +85,16 @@ inline static long time_diff_us(struct timeval time1, struct timeval time2)
 			+ (time2.tv_usec - time1.tv_usec);
 }
 
+/*
+ * The current time of the monotonic clock in nanoseconds.
+ */
+inline static long get_curr_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
 inline static long min(long v1, long v2)
 {
 	return v1 > v2 ? v2 : v1;
@@ -0,0 +1,288 @@
+/*
+ * Copyright 2014 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of SAFSlib.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "compressed_cache.h"
+
+namespace safs
+{
+
+/*
+ * We only keep a page if it saves at least a quarter of the memory.
+ */
+static const size_t MAX_COMPRESSED_SIZE = PAGE_SIZE * 3 / 4;
+static const int NUM_SHARDS = 64;
+
+static inline bool put_varint(uint32_t v, char *&p, const char *end)
+{
+	while (v >= 0x80) {
+		if (p == end)
+			return false;
+		*p++ = (char) (v | 0x80);
+		v >>= 7;
+	}
+	if (p == end)
+		return false;
+	*p++ = (char) v;
+	return true;
+}
+
+static inline bool get_varint(const char *&p, const char *end, uint32_t &v)
+{
+	v = 0;
+	for (int shift = 0; shift < 35 && p < end; shift += 7) {
+		unsigned char c = *p++;
+		v |= ((uint32_t) (c & 0x7f)) << shift;
+		if ((c & 0x80) == 0)
+			return true;
+	}
+	return false;
+}
+
+/*
+ * A delta is stored as a zigzag-encoded varint, which is never 0.
+ * 0 starts a run of identical integers and is followed by the length of
+ * the run, so a page full of zeros only takes a few bytes.
+ */
+size_t delta_varint_codec::compress(const char *page, char *buf,
+		size_t buf_size)
+{
+	const uint32_t *words = (const uint32_t *) page;
+	const int num_words = PAGE_SIZE / sizeof(uint32_t);
+	char *p = buf;
+	const char *end = buf + buf_size;
+	uint32_t prev = 0;
+	for (int i = 0; i < num_words; ) {
+		if (words[i] == prev) {
+			int run = 1;
+			while (i + run < num_words && words[i + run] == prev)
+				run++;
+			if (!put_varint(0, p, end) || !put_varint(run, p, end))
+				return 0;
+			i += run;
+		}
+		else {
+			uint32_t delta = words[i] - prev;
+			uint32_t zigzag = (delta << 1) ^ (uint32_t) (((int32_t) delta) >> 31);
+			if (!put_varint(zigzag, p, end))
+				return 0;
+			prev = words[i];
+			i++;
+		}
+	}
+	return p - buf;
+}
+
+bool delta_varint_codec::decompress(const char *buf, size_t size, char *page)
+{
+	uint32_t *words = (uint32_t *) page;
+	const uint32_t num_words = PAGE_SIZE / sizeof(uint32_t);
+	const char *p = buf;
+	const char *end = buf + size;
+	uint32_t prev = 0;
+	uint32_t i = 0;
+	while (i < num_words && p < end) {
+		uint32_t v;
+		if (!get_varint(p, end, v))
+			return false;
+		if (v == 0) {
+			uint32_t run;
+			if (!get_varint(p, end, run) || run > num_words - i)
+				return false;
+			for (uint32_t j = 0; j < run; j++)
+				words[i++] = prev;
+		}
+		else {
+			uint32_t delta = (v >> 1) ^ (0 - (v & 1));
+			prev += delta;
+			words[i++] = prev;
+		}
+	}
+	return i == num_words && p == end;
+}
+
+compressed_page_cache::compressed_page_cache(size_t size): max_shard_bytes(
+			size / NUM_SHARDS), codec(new delta_varint_codec()), shards(NUM_SHARDS)
+{
+}
+
+compressed_page_cache::~compressed_page_cache()
+{
+	for (size_t i = 0; i < shards.size(); i++) {
+		for (auto it = shards[i].pages.begin(); it != shards[i].pages.end();
+				it++)
+			free(it->second.data);
+	}
+}
+
+/*
+ * Evict pages from the shard until it has space for `num_bytes' bytes.
+ * It has to be called with the lock of the shard held.
+ */
+void compressed_page_cache::evict(shard &s, size_t num_bytes)
+{
+	while (s.num_bytes + num_bytes > max_shard_bytes && !s.fifo.empty()) {
+		std::pair<uint64_t, uint32_t> key = s.fifo.front();
+		s.fifo.pop_front();
+		auto it = s.pages.find(key.first);
+		// The page has been fetched or added again after this entry.
+		if (it == s.pages.end() || it->second.seq != key.second)
+			continue;
+		s.num_bytes -= it->second.size;
+		free(it->second.data);
+		s.pages.erase(it);
+		num_evictions.inc(1);
+	}
+
+	// Most of pages leave the shard by hits. We need to clean up
+	// the FIFO queue so it doesn't grow forever.
+	if (s.fifo.size() > s.pages.size() * 2 + 1024) {
+		std::deque<std::pair<uint64_t, uint32_t> > fifo;
+		for (size_t i = 0; i < s.fifo.size(); i++) {
+			auto it = s.pages.find(s.fifo[i].first);
+			if (it != s.pages.end() && it->second.seq == s.fifo[i].second)
+				fifo.push_back(s.fifo[i]);
+		}
+		s.fifo.swap(fifo);
+	}
+}
+
+char *compressed_page_cache::compress(const char *page, uint32_t &size)
+{
+	char buf[MAX_COMPRESSED_SIZE];
+	size = codec->compress(page, buf, sizeof(buf));
+	if (size == 0) {
+		num_rejects.inc(1);
+		return NULL;
+	}
+	char *data = (char *) malloc(size);
+	memcpy(data, buf, size);
+	return data;
+}
+
+void compressed_page_cache::insert(const page_id_t &pg_id, char *data,
+		uint32_t size)
+{
+	uint64_t key = get_key(pg_id);
+	shard &s = get_shard(key);
+	s.lock.lock();
+	auto it = s.pages.find(key);
+	if (it != s.pages.end()) {
+		s.num_bytes -= it->second.size;
+		free(it->second.data);
+		s.pages.erase(it);
+	}
+	evict(s, size);
+	entry e;
+	e.data = data;
+	e.size = size;
+	e.seq = s.seq++;
+	s.pages.insert(std::pair<uint64_t, entry>(key, e));
+	s.fifo.push_back(std::pair<uint64_t, uint32_t>(key, e.seq));
+	s.num_bytes += size;
+	s.lock.unlock();
+
+	num_adds.inc(1);
+	uncompressed_bytes.inc(PAGE_SIZE);
+	compressed_bytes.inc(size);
+}
+
+bool compressed_page_cache::add(const page_id_t &pg_id, const char *page)
+{
+	uint32_t size;
+	char *data = compress(page, size);
+	if (data == NULL)
+		return false;
+	insert(pg_id, data, size);
+	return true;
+}
+
+bool compressed_page_cache::fetch(const page_id_t &pg_id, char *page)
+{
+	num_lookups.inc(1);
+	uint64_t key = get_key(pg_id);
+	shard &s = get_shard(key);
+	s.lock.lock();
+	auto it = s.pages.find(key);
+	if (it == s.pages.end()) {
+		s.lock.unlock();
+		return false;
+	}
+	entry e = it->second;
+	s.pages.erase(it);
+	s.num_bytes -= e.size;
+	s.lock.unlock();
+
+	bool ret = codec->decompress(e.data, e.size, page);
+	assert(ret);
+	free(e.data);
+	if (ret)
+		num_hits.inc(1);
+	return ret;
+}
+
+void compressed_page_cache::invalidate(const page_id_t &pg_id)
+{
+	uint64_t key = get_key(pg_id);
+	shard &s = get_shard(key);
+	s.lock.lock();
+	auto it = s.pages.find(key);
+	if (it != s.pages.end()) {
+		s.num_bytes -= it->second.size;
+		free(it->second.data);
+		s.pages.erase(it);
+	}
+	s.lock.unlock();
+}
+
+/*
+ * The two methods below read the shards without locking them,
+ * so they only return an estimate.
+ */
+
+size_t compressed_page_cache::get_num_bytes() const
+{
+	size_t num_bytes = 0;
+	for (size_t i = 0; i < shards.size(); i++)
+		num_bytes += shards[i].num_bytes;
+	return num_bytes;
+}
+
+size_t compressed_page_cache::get_num_pages() const
+{
+	size_t num_pages = 0;
+	for (size_t i = 0; i < shards.size(); i++)
+		num_pages += shards[i].pages.size();
+	return num_pages;
+}
+
+void compressed_page_cache::print_stat() const
+{
+	printf("\tcompressed cache: %ld pages in %ld bytes, %ld adds, %ld rejects, %ld evictions\n",
+			get_num_pages(), get_num_bytes(), num_adds.get(),
+			num_rejects.get(), num_evictions.get());
+	printf("\tcompressed cache: %ld lookups, %ld hits, compression ratio: %.3f\n",
+			num_lookups.get(), num_hits.get(), compressed_bytes.get() > 0
+			? ((double) uncompressed_bytes.get()) / compressed_bytes.get() : 0);
+}
+
+}
@@ -0,0 +1,182 @@
+#ifndef __COMPRESSED_CACHE_H__
+#define __COMPRESSED_CACHE_H__
+
+/*
+ * Copyright 2014 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of SAFSlib.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+
+#include <memory>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+
+#include "cache.h"
+#include "concurrency.h"
+
+namespace safs
+{
+
+/**
+ * This compresses a page.
+ */
+class page_codec
+{
+public:
+	typedef std::unique_ptr<page_codec> ptr;
+
+	virtual ~page_codec() {
+	}
+
+	/**
+	 * Compress a page to the buffer.
+	 * It returns the size of the compressed data or 0 if the compressed
+	 * data can't fit in the buffer.
+	 */
+	virtual size_t compress(const char *page, char *buf, size_t buf_size) = 0;
+	/**
+	 * Decompress data to a page.
+	 * It returns false if the data is broken.
+	 */
+	virtual bool decompress(const char *buf, size_t size, char *page) = 0;
+};
+
+/**
+ * It treats a page as an array of 32-bit integers and stores the deltas of
+ * adjacent integers as varints. It works well for vertex pages, which are
+ * mostly sorted vertex IDs.
+ */
+class delta_varint_codec: public page_codec
+{
+public:
+	virtual size_t compress(const char *page, char *buf, size_t buf_size);
+	virtual bool decompress(const char *buf, size_t size, char *page);
+};
+
+/**
+ * This is the second tier of the page cache. It keeps the clean pages
+ * evicted from the page cache in the compressed form. A page is removed
+ * from this tier when it's read back to the page cache, so a page is never
+ * in both tiers and we don't need to worry about the stale data when
+ * the page is modified in the page cache.
+ * The pages are spread to multiple shards to reduce lock contention.
+ * Each shard evicts pages in the FIFO order. The pages here are already
+ * the cold ones in the page cache and a hit moves a page out of this tier,
+ * so there is nothing to gain from tracking the recency of the pages.
+ */
+class compressed_page_cache
+{
+	struct entry
+	{
+		char *data;
+		uint32_t size;
+		// The sequence number distinguishes the entry from the entries of
+		// the same page added before in the FIFO queue.
+		uint32_t seq;
+	};
+
+	struct shard
+	{
+		spin_lock lock;
+		std::unordered_map<uint64_t, entry> pages;
+		// The pages in the order of insertion. It may contain the pages
+		// that have been removed.
+		std::deque<std::pair<uint64_t, uint32_t> > fifo;
+		size_t num_bytes;
+		uint32_t seq;
+
+		shard() {
+			num_bytes = 0;
+			seq = 0;
+		}
+	};
+
+	const size_t max_shard_bytes;
+	page_codec::ptr codec;
+	std::vector<shard> shards;
+
+	atomic_number<long> num_adds;
+	atomic_number<long> num_rejects;
+	atomic_number<long> num_lookups;
+	atomic_number<long> num_hits;
+	atomic_number<long> num_evictions;
+	atomic_number<long> uncompressed_bytes;
+	atomic_number<long> compressed_bytes;
+
+	static uint64_t get_key(const page_id_t &pg_id) {
+		return (((uint64_t) pg_id.get_file_id()) << 40)
+			+ pg_id.get_offset() / PAGE_SIZE;
+	}
+
+	shard &get_shard(uint64_t key) {
+		return shards[(key * 11400714819323198485UL) >> 32 & (shards.size() - 1)];
+	}
+
+	void evict(shard &s, size_t num_bytes);
+
+	compressed_page_cache(size_t size);
+public:
+	typedef std::shared_ptr<compressed_page_cache> ptr;
+
+	/**
+	 * Create the compressed cache that keeps up to `size' bytes of
+	 * compressed data.
+	 */
+	static ptr create(size_t size) {
+		return ptr(new compressed_page_cache(size));
+	}
+
+	~compressed_page_cache();
+
+	/**
+	 * Compress the page and keep it.
+	 * It returns false if the page can't be compressed well enough.
+	 */
+	bool add(const page_id_t &pg_id, const char *page);
+	/**
+	 * Compress the page to a buffer allocated with malloc.
+	 * It returns NULL if the page can't be compressed well enough.
+	 * It doesn't touch the cache, so the caller doesn't need to hold
+	 * any lock.
+	 */
+	char *compress(const char *page, uint32_t &size);
+	/**
+	 * Keep the compressed page returned by compress().
+	 * The cache takes the ownership of the buffer.
+	 */
+	void insert(const page_id_t &pg_id, char *data, uint32_t size);
+	/**
+	 * Decompress the page to the buffer and remove it from the cache.
+	 * It returns false if the page doesn't exist.
+	 */
+	bool fetch(const page_id_t &pg_id, char *page);
+	/**
+	 * Remove the page from the cache.
+	 */
+	void invalidate(const page_id_t &pg_id);
+
+	size_t get_num_bytes() const;
+	size_t get_num_pages() const;
+
+	void print_stat() const;
+};
+
+}
+
+#endif
@@ -152,6 +152,15 @@ public:
 		} while (count & 1);
 	}
 
+	/*
+	 * Get the current sequence number without waiting for the writer.
+	 * It returns false if another thread is changing the data structure.
+	 */
+	bool try_read_lock(unsigned long &count) const {
+		count = this->count;
+		return !(count & 1);
+	}
+
 	bool read_unlock(unsigned long count) const {
 		return this->count == count;
 	}
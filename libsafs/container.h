@@ -28,6 +28,7 @@
 #include <limits.h>
 
 #include <string>
+#include <memory>
 #include <boost/assert.hpp>
 
 #include "common.h"
@@ -387,6 +388,406 @@ public:
 	}
 };
 
+/*
+ * This is a bounded lock-free ring buffer for multiple producers and
+ * a single consumer. Producers reserve a range of slots with a CAS on
+ * the tail and publish each slot with a sequence number, so they don't
+ * wait for each other while they copy entries to the ring. Only one
+ * thread is allowed to fetch entries from the ring.
+ */
+template<class T>
+class MPSC_ring_buffer
+{
+	// To avoid false sharing between producers and the consumer.
+	static const int PAD_SIZE = 64;
+
+	struct slot {
+		// It's `pos + 1' when the entry at `pos' is published.
+		volatile long seq;
+		T val;
+	};
+
+	slot *slots;
+	long size_mask;
+	std::string name;
+	char pad0[PAD_SIZE];
+	// The location where producers add entries.
+	volatile long tail;
+	char pad1[PAD_SIZE];
+	// The location where the consumer fetches entries.
+	// It's only modified by the consumer.
+	volatile long head;
+	char pad2[PAD_SIZE];
+
+	// It's used for waiting for entries.
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	volatile bool waiting;
+
+	slot &get_slot(long pos) {
+		return slots[pos & size_mask];
+	}
+
+public:
+	// The size of the ring has to be 2^n. If it's not, the smallest
+	// number of 2^n is used.
+	MPSC_ring_buffer(const std::string &name, int size) {
+		int log_size = (int) ceil(log2(size));
+		size = 1 << log_size;
+		this->size_mask = size - 1;
+		this->name = name;
+		slots = new slot[size];
+		for (int i = 0; i < size; i++)
+			slots[i].seq = 0;
+		tail = 0;
+		head = 0;
+		pthread_mutex_init(&mutex, NULL);
+		pthread_cond_init(&cond, NULL);
+		waiting = false;
+	}
+
+	~MPSC_ring_buffer() {
+		delete [] slots;
+		pthread_mutex_destroy(&mutex);
+		pthread_cond_destroy(&cond);
+	}
+
+	/*
+	 * Add entries to the ring. It can be invoked by multiple threads.
+	 * It returns the number of entries added, which is smaller than `num'
+	 * if the ring doesn't have enough space.
+	 */
+	int add(T *entries, int num) {
+		long start;
+		int num_added;
+		do {
+			start = tail;
+			long num_free = get_size() - (start - head);
+			if (num_free <= 0)
+				return 0;
+			num_added = (int) min((long) num, num_free);
+		} while (!__sync_bool_compare_and_swap(&tail, start,
+					start + num_added));
+
+		for (int i = 0; i < num_added; i++) {
+			slot &s = get_slot(start + i);
+			s.val = entries[i];
+			// The entry has to be written before it's published.
+			__sync_synchronize();
+			s.seq = start + i + 1;
+		}
+		wakeup();
+		return num_added;
+	}
+
+	/*
+	 * Fetch entries from the ring. Only the consumer can invoke it.
+	 * It stops at the first entry that is reserved by a producer but
+	 * hasn't been published.
+	 */
+	int fetch(T *entries, int num) {
+		long pos = head;
+		int num_fetches = 0;
+		while (num_fetches < num) {
+			slot &s = get_slot(pos);
+			if (s.seq != pos + 1)
+				break;
+			// The entry is read after we see it's published.
+			__sync_synchronize();
+			entries[num_fetches++] = s.val;
+			pos++;
+		}
+		if (num_fetches > 0) {
+			// Producers can reuse the slots only after we read the entries.
+			__sync_synchronize();
+			head = pos;
+		}
+		return num_fetches;
+	}
+
+	/*
+	 * Wait until the ring has entries or `stop' is set.
+	 * Only the consumer can invoke it.
+	 */
+	void wait4entries(volatile bool *stop = NULL) {
+		pthread_mutex_lock(&mutex);
+		waiting = true;
+		__sync_synchronize();
+		while (is_empty() && (stop == NULL || !*stop))
+			pthread_cond_wait(&cond, &mutex);
+		waiting = false;
+		pthread_mutex_unlock(&mutex);
+	}
+
+	/*
+	 * Wake up the consumer if it's waiting.
+	 */
+	void wakeup() {
+		// Make sure the published entries are visible before checking
+		// the waiting flag.
+		__sync_synchronize();
+		if (waiting) {
+			pthread_mutex_lock(&mutex);
+			pthread_cond_signal(&cond);
+			pthread_mutex_unlock(&mutex);
+		}
+	}
+
+	/*
+	 * The number of entries is approximate if producers are adding
+	 * entries at the same time.
+	 */
+	int get_num_entries() const {
+		return (int) (tail - head);
+	}
+
+	int get_size() const {
+		return size_mask + 1;
+	}
+
+	bool is_empty() const {
+		return tail == head;
+	}
+
+	bool is_full() const {
+		return tail - head >= get_size();
+	}
+
+	const std::string &get_name() const {
+		return name;
+	}
+};
+
+/*
+ * This is a bounded Chase-Lev work-stealing deque. The owner thread pushes
+ * and pops entries at the bottom without locking, and other threads steal
+ * entries from the top with a CAS. The only contention between the owner
+ * and the thieves is on the last entry.
+ * A thief copies an entry before it claims the entry, so T should be
+ * a plain old data type.
+ */
+template<class T>
+class work_stealing_deque
+{
+	// To avoid false sharing between the owner and the thieves.
+	static const int PAD_SIZE = 64;
+
+	T *entries;
+	long size_mask;
+	char pad0[PAD_SIZE];
+	// The location where the owner pushes and pops entries.
+	// It's only modified by the owner.
+	volatile long bottom;
+	char pad1[PAD_SIZE];
+	// The location where thieves steal entries.
+	volatile long top;
+	char pad2[PAD_SIZE];
+
+public:
+	// The size of the deque has to be 2^n. If it's not, the smallest
+	// number of 2^n is used.
+	work_stealing_deque(int size) {
+		int log_size = (int) ceil(log2(size));
+		size = 1 << log_size;
+		this->size_mask = size - 1;
+		entries = new T[size];
+		bottom = 0;
+		top = 0;
+	}
+
+	~work_stealing_deque() {
+		delete [] entries;
+	}
+
+	/*
+	 * Only the owner can push entries. It returns false if the deque is full.
+	 */
+	bool push(const T &entry) {
+		long b = bottom;
+		if (b - top >= get_size())
+			return false;
+		entries[b & size_mask] = entry;
+		// The entry has to be written before it's visible to thieves.
+		__sync_synchronize();
+		bottom = b + 1;
+		return true;
+	}
+
+	/*
+	 * Only the owner can pop entries. It returns false if the deque is empty.
+	 */
+	bool pop(T &entry) {
+		long b = bottom - 1;
+		bottom = b;
+		// Thieves have to see the new bottom before we read the top.
+		// Otherwise, a thief and the owner may both get the last entry.
+		__sync_synchronize();
+		long t = top;
+		if (t > b) {
+			bottom = b + 1;
+			return false;
+		}
+		if (t == b) {
+			// This is the last entry. Thieves may try to steal it as well.
+			bool success = __sync_bool_compare_and_swap(&top, t, t + 1);
+			bottom = b + 1;
+			if (!success)
+				return false;
+		}
+		// Only the owner writes entries, so we can copy the entry after
+		// we claim it.
+		entry = entries[b & size_mask];
+		return true;
+	}
+
+	/*
+	 * Steal an entry from the top. It can be invoked by any thread.
+	 * It returns false if the deque is empty or another thread takes
+	 * the entry first.
+	 */
+	bool steal(T &entry) {
+		long t = top;
+		__sync_synchronize();
+		long b = bottom;
+		if (t >= b)
+			return false;
+		T tmp = entries[t & size_mask];
+		// The owner can't overwrite the entry before the top moves,
+		// so the entry we copied is intact if the CAS succeeds.
+		if (!__sync_bool_compare_and_swap(&top, t, t + 1))
+			return false;
+		entry = tmp;
+		return true;
+	}
+
+	/*
+	 * The number of entries is approximate if thieves are stealing
+	 * entries at the same time.
+	 */
+	int get_num_entries() const {
+		long num = bottom - top;
+		return num > 0 ? (int) num : 0;
+	}
+
+	int get_size() const {
+		return size_mask + 1;
+	}
+
+	bool is_empty() const {
+		return bottom <= top;
+	}
+};
+
+/*
+ * This FIFO queue uses a lock-free ring buffer for multiple producers and
+ * a single consumer. When the ring is full, entries are added to
+ * the locked queue in the base class, so adding entries never fails
+ * as long as the locked queue is allowed to grow. Once entries are in
+ * the locked queue, producers keep adding entries there until
+ * the consumer empties it, so the entries from a producer are always
+ * fetched in the order they are added.
+ *
+ * If the size of the ring is 0, it behaves as thread_safe_FIFO_queue.
+ */
+template<class T>
+class MPSC_FIFO_queue: public thread_safe_FIFO_queue<T>
+{
+	std::unique_ptr<MPSC_ring_buffer<T> > ring;
+	// Indicate whether the locked queue has entries.
+	volatile bool overflow;
+	spin_lock overflow_lock;
+
+	int add_overflow(T *entries, int num) {
+		overflow_lock.lock();
+		overflow = true;
+		int ret = thread_safe_FIFO_queue<T>::add(entries, num);
+		overflow_lock.unlock();
+		ring->wakeup();
+		return ret;
+	}
+public:
+	MPSC_FIFO_queue(const std::string &name, int node_id, int init_size,
+			int max_size, int ring_size): thread_safe_FIFO_queue<T>(name,
+				node_id, init_size, max_size) {
+		if (ring_size > 0)
+			ring = std::unique_ptr<MPSC_ring_buffer<T> >(
+					new MPSC_ring_buffer<T>(name, ring_size));
+		overflow = false;
+	}
+
+	bool is_lockfree() const {
+		return ring != NULL;
+	}
+
+	virtual int fetch(T *entries, int num) {
+		if (ring == NULL)
+			return thread_safe_FIFO_queue<T>::fetch(entries, num);
+
+		int ret = ring->fetch(entries, num);
+		if (ret < num && overflow) {
+			overflow_lock.lock();
+			ret += thread_safe_FIFO_queue<T>::fetch(entries + ret, num - ret);
+			if (thread_safe_FIFO_queue<T>::is_empty())
+				overflow = false;
+			overflow_lock.unlock();
+		}
+		return ret;
+	}
+
+	virtual int add(T *entries, int num) {
+		if (ring == NULL)
+			return thread_safe_FIFO_queue<T>::add(entries, num);
+
+		int ret = 0;
+		if (!overflow)
+			ret = ring->add(entries, num);
+		if (ret < num)
+			ret += add_overflow(entries + ret, num - ret);
+		return ret;
+	}
+
+	virtual int add(fifo_queue<T> *queue) {
+		if (ring == NULL)
+			return thread_safe_FIFO_queue<T>::add(queue);
+
+		const int LOCAL_BUF_SIZE = 16;
+		T buf[LOCAL_BUF_SIZE];
+		while (!queue->is_empty()) {
+			int num = queue->fetch(buf, LOCAL_BUF_SIZE);
+			add(buf, num);
+		}
+		return 0;
+	}
+
+	/*
+	 * Wait until the queue has entries. Only the consumer can invoke it
+	 * and it requires the lock-free ring.
+	 */
+	void wait4entries() {
+		assert(ring);
+		ring->wait4entries(&overflow);
+	}
+
+	int get_num_entries() {
+		int num = thread_safe_FIFO_queue<T>::get_num_entries();
+		if (ring)
+			num += ring->get_num_entries();
+		return num;
+	}
+
+	bool is_empty() {
+		if (ring && !ring->is_empty())
+			return false;
+		return thread_safe_FIFO_queue<T>::is_empty();
+	}
+
+	bool is_full() {
+		if (ring == NULL)
+			return thread_safe_FIFO_queue<T>::is_full();
+		return ring->is_full() && thread_safe_FIFO_queue<T>::is_full();
+	}
+};
+
 /*
  * This FIFO queue can block the thread if
  * a thread wants to add more entries when the queue is full;
@@ -17,10 +17,13 @@
  * limitations under the License.
  */
 
+#include <algorithm>
+
 #include "disk_read_thread.h"
 #include "parameters.h"
 #include "aio_private.h"
 #include "debugger.h"
+#include "cache.h"
 
 namespace safs
 {
@@ -28,6 +31,18 @@ namespace safs
 const int AIO_HIGH_PRIO_SLOTS = 7;
 const int NUM_DIRTY_PAGES_TO_FETCH = 16 * 18;
 
+/*
+ * Sort requests by their locations in the file.
+ */
+struct req_loc_comparator
+{
+	bool operator()(const io_request &req1, const io_request &req2) const {
+		if (req1.get_file_id() != req2.get_file_id())
+			return req1.get_file_id() < req2.get_file_id();
+		return req1.get_offset() < req2.get_offset();
+	}
+};
+
 /*
  * This is run inside the I/O thread, so it's OK to access its data structure.
  */
@@ -43,6 +58,8 @@ void disk_io_thread::open_comm::run()
 
 	logical_file_partition part(indices, mapper);
 	int ret = aio->open_file(part);
+	if (ret == 0 && t.stats)
+		t.stats->register_file(mapper->get_file_id(), mapper->get_name());
 	set_status(ret);
 }
 
@@ -51,11 +68,12 @@ void disk_io_thread::open_comm::run()
 disk_io_thread::disk_io_thread(const logical_file_partition &_partition, int cpu_id,
 		int node_id, int flags): thread(std::string("io-thread-") + itoa(cpu_id),
 			std::vector<int>(1, cpu_id)), queue(node_id, std::string("io-queue-") + itoa(node_id),
-			IO_QUEUE_SIZE, INT_MAX, false),
+			IO_QUEUE_SIZE, INT_MAX, false, params.get_msg_queue_ring_size()),
 		// TODO let's allow the low-priority queue to
 		// be infinitely large for now.
 		low_prio_queue(node_id, std::string("io-queue-low_prio-")
-				+ itoa(node_id), IO_QUEUE_SIZE, INT_MAX, false),
+				+ itoa(node_id), IO_QUEUE_SIZE, INT_MAX, false,
+				params.get_msg_queue_ring_size()),
 		comm_queue(std::string("comm-queue") + itoa(node_id), node_id, 1,
 				INT_MAX), partition(_partition)
 {
@@ -83,6 +101,16 @@ disk_io_thread::disk_io_thread(const logical_file_partition &_partition, int cpu
 	max_flush_delay = 0;
 	min_flush_delay = LONG_MAX;
 	num_msgs = 0;
+	num_merged_reqs = 0;
+	num_merges = 0;
+	if (params.is_io_stats_enabled()) {
+		stats = std::unique_ptr<io_stat_collector>(new io_stat_collector(
+					get_thread_name(), node_id));
+		aio->set_stat_collector(stats.get());
+	}
+	if (params.is_sched_disk_reqs())
+		sched = std::unique_ptr<disk_req_scheduler>(new disk_req_scheduler(
+					params.get_io_class_weights()));
 
 	thread::start();
 }
@@ -90,11 +118,12 @@ disk_io_thread::disk_io_thread(const logical_file_partition &_partition, int cpu
 disk_io_thread::disk_io_thread(const logical_file_partition &_partition,
 		int node_id, int flags): thread(std::string("io-thread-") + itoa(node_id),
 			node_id), queue(node_id, std::string("io-queue-") + itoa(node_id),
-			IO_QUEUE_SIZE, INT_MAX, false),
+			IO_QUEUE_SIZE, INT_MAX, false, params.get_msg_queue_ring_size()),
 		// TODO let's allow the low-priority queue to
 		// be infinitely large for now.
 		low_prio_queue(node_id, std::string("io-queue-low_prio-")
-				+ itoa(node_id), IO_QUEUE_SIZE, INT_MAX, false),
+				+ itoa(node_id), IO_QUEUE_SIZE, INT_MAX, false,
+				params.get_msg_queue_ring_size()),
 		comm_queue(std::string("comm-queue") + itoa(node_id), node_id, 1,
 				INT_MAX), partition(_partition)
 {
@@ -122,6 +151,16 @@ disk_io_thread::disk_io_thread(const logical_file_partition &_partition,
 	max_flush_delay = 0;
 	min_flush_delay = LONG_MAX;
 	num_msgs = 0;
+	num_merged_reqs = 0;
+	num_merges = 0;
+	if (params.is_io_stats_enabled()) {
+		stats = std::unique_ptr<io_stat_collector>(new io_stat_collector(
+					get_thread_name(), node_id));
+		aio->set_stat_collector(stats.get());
+	}
+	if (params.is_sched_disk_reqs())
+		sched = std::unique_ptr<disk_req_scheduler>(new disk_req_scheduler(
+					params.get_io_class_weights()));
 
 	thread::start();
 }
@@ -140,106 +179,139 @@ void notify_ignored_flushes(io_request ignored_flushes[], int num_ignored)
 	}
 }
 
-int disk_io_thread::process_low_prio_msg(message<io_request> &low_prio_msg)
+/*
+ * The flusher doesn't own the pages in a low-priority write, so the pages
+ * may have been evicted, cleaned or written back since the write was
+ * issued. This method grabs the pages that still need to be written back
+ * and splits the write into runs of contiguous pages.
+ */
+void disk_io_thread::get_flush_runs(io_request &req,
+		std::vector<io_request> &runs)
 {
-	assert(0);
-	return -1;
-#if 0
-	int num_accesses = 0;
-
-	struct timeval curr_time;
-	gettimeofday(&curr_time, NULL);
-
-	io_request req;
-	stack_array<io_request> ignored_flushes(low_prio_msg.get_num_objs());
-	int num_ignored = 0;
-	while (low_prio_msg.has_next()
-			&& aio->num_available_IO_slots() > AIO_HIGH_PRIO_SLOTS
-			// We only submit requests to the disk when there aren't
-			// high-prio requests.
-			&& queue.is_empty()) {
-		// We copy the request to the local stack.
-		low_prio_msg.get_next(req);
-		num_low_prio_accesses++;
-		assert(req.get_num_bufs() == 1);
+	page_cache *cache = (page_cache *) req.get_priv();
+	int num_pages = req.get_num_bufs();
+	stack_array<thread_safe_page *> pages(num_pages);
+	for (int i = 0; i < num_pages; i++) {
+		thread_safe_page *orig = req.get_page(i);
+		pages[i] = NULL;
 		// The request doesn't own the page, so the reference count
 		// isn't increased while in the queue. Now we try to write
 		// it back, we need to increase its reference. The only
 		// safe way to do it is to use the search method of
 		// the page cache.
-		page_cache *cache = (page_cache *) req.get_priv();
-		page_id_t pg_id(req.get_file_id(), req.get_offset());
+		page_id_t pg_id(req.get_file_id(), req.get_offset() + i * PAGE_SIZE);
 		thread_safe_page *p = (thread_safe_page *) cache->search(pg_id);
-		// The page has been evicted.
-		if (p == NULL) {
-			// The original page has been evicted, we should clear
-			// the prepare-writeback flag on it.
-			req.get_page(0)->set_prepare_writeback(false);
+		// If the original page has been evicted, the page may not exist
+		// or a new page for the offset has been added to the cache.
+		if (p != orig) {
+			if (p)
+				p->dec_ref();
+			// We should clear the prepare-writeback flag on the original
+			// page.
+			orig->set_prepare_writeback(false);
 			num_ignored_flushes_evicted++;
-			ignored_flushes[num_ignored++] = req;
-			continue;
-		}
-		// If the original page has been evicted and the new page for
-		// the offset has been added to the cache.
-		if (p != req.get_page(0)) {
-			p->dec_ref();
-			// The original page has been evicted, we should clear
-			// the prepare-writeback flag on it.
-			req.get_page(0)->set_prepare_writeback(false);
-			num_ignored_flushes_evicted++;
-			ignored_flushes[num_ignored++] = req;
 			continue;
 		}
 		// If we are here, it means the page is the one we are looking for.
 		// We can be certain that the page won't be evicted because we have
 		// a reference on it.
-
-		// The object of page always exists, so we can always
-		// lock a page.
 		p->lock();
 		// The page may have been written back by the applications.
 		// But in either way, we need to reset the PREPARE_WRITEBACK
 		// flag.
 		p->set_prepare_writeback(false);
 		// If the page is being written back or has been written back,
-		// we can skip the request.
-		if (p->is_io_pending() || !p->is_dirty()
-				|| p->get_flush_score() > DISCARD_FLUSH_THRESHOLD) {
+		// we can skip it. A page merged in a run is written with its
+		// neighbors regardless of its flush score.
+		bool old = num_pages == 1
+			&& p->get_flush_score() > DISCARD_FLUSH_THRESHOLD;
+		if (p->is_io_pending() || !p->is_dirty() || old) {
 			p->unlock();
 			p->dec_ref();
-			if (p->get_flush_score() > DISCARD_FLUSH_THRESHOLD)
+			if (old)
 				num_ignored_flushes_old++;
 			else
 				num_ignored_flushes_cleaned++;
-			ignored_flushes[num_ignored++] = req;
+			continue;
+		}
+		p->set_io_pending(true);
+		p->unlock();
+		pages[i] = p;
+	}
+
+	for (int i = 0; i < num_pages;) {
+		if (pages[i] == NULL) {
+			i++;
+			continue;
+		}
+		data_loc_t loc(req.get_file_id(), req.get_offset() + i * PAGE_SIZE);
+		io_request run(new io_req_extension(), loc, WRITE, req.get_io(),
+				req.get_node_id());
+		run.set_high_prio(false);
+		// The flusher counts the pending flushes with the ones that carry
+		// the page cache, so only the first run carries it.
+		if (runs.empty())
+			run.set_priv(req.get_priv());
+		for (; i < num_pages && pages[i]; i++)
+			run.add_page(pages[i]);
+		runs.push_back(run);
+	}
+}
+
+int disk_io_thread::process_low_prio_msg(message<io_request> &low_prio_msg)
+{
+	int num_accesses = 0;
+
+	struct timeval curr_time;
+	gettimeofday(&curr_time, NULL);
+
+	io_request req;
+	stack_array<io_request> ignored_flushes(low_prio_msg.get_num_objs());
+	int num_ignored = 0;
+	std::vector<io_request> runs;
+	while (low_prio_msg.has_next()
+			&& aio->num_available_IO_slots() > AIO_HIGH_PRIO_SLOTS
+			// We only submit requests to the disk when there aren't
+			// high-prio requests.
+			&& queue.is_empty()) {
+		// We copy the request to the local stack.
+		low_prio_msg.get_next(req);
+		num_low_prio_accesses++;
+		// The page cache reads data ahead with low-priority requests.
+		if (req.get_access_method() == READ) {
+			num_reads++;
+			num_read_bytes += req.get_size();
+			aio->access(&req, 1);
+			num_accesses++;
 			continue;
 		}
 
+		// The flusher writes back dirty pages with low-priority requests.
+		num_requested_flushes++;
 		long delay = time_diff_us(req.get_timestamp(), curr_time);
 		tot_flush_delay += delay;
 		if (delay < min_flush_delay)
 			min_flush_delay = delay;
 		if (delay > max_flush_delay)
 			max_flush_delay = delay;
-		if (req.get_access_method() == READ) {
-			num_reads++;
-			num_read_bytes += req.get_size();
+
+		runs.clear();
+		get_flush_runs(req, runs);
+		if (runs.empty()) {
+			ignored_flushes[num_ignored++] = req;
+			continue;
 		}
-		else {
+		delete req.get_extension();
+		for (size_t i = 0; i < runs.size(); i++) {
 			num_writes++;
-			num_write_bytes += req.get_size();
+			num_write_bytes += runs[i].get_size();
+			// The flusher throttles itself with the latency of the writes
+			// on the disk.
+			runs[i].set_timestamp();
 		}
-
-		assert(p == req.get_page(0));
-		p->set_io_pending(true);
-		p->unlock();
-		num_accesses++;
-		// The current private data points to the page cache.
-		// Now the request owns the page, it's safe to point to
-		// the page directly.
-		req.set_priv(p);
 		// This should block the thread.
-		aio->access(&req, 1);
+		aio->access(runs.data(), runs.size());
+		num_accesses += runs.size();
 	}
 	if (low_prio_msg.is_empty())
 		low_prio_msg.clear();
@@ -248,7 +320,6 @@ int disk_io_thread::process_low_prio_msg(message<io_request> &low_prio_msg)
 		notify_ignored_flushes(ignored_flushes.data(), num_ignored);
 
 	return num_accesses;
-#endif
 }
 
 void disk_io_thread::run_commands(
@@ -275,13 +346,18 @@ size_t disk_io_thread::get_all_reqs(msg_queue<io_request> &queue,
 	while (!queue.is_empty()) {
 		int num = queue.fetch(msg_buffer, LOCAL_BUF_SIZE);
 		num_msgs += num;
+		long now = stats ? get_curr_ns() : 0;
 
 		// Get all I/O requests from the messages.
 		for (int i = 0; i < num; i++) {
 			int num_reqs = msg_buffer[i].get_num_objs();
 			local_reqs.resize(num_reqs);
+			long create_time = msg_buffer[i].get_timestamp();
 			msg_buffer[i].get_next_objs(local_reqs.data(), num_reqs);
 			for (int j = 0; j < num_reqs; j++) {
+				if (stats && create_time > 0)
+					stats->add_queue_wait(local_reqs[j].get_file_id(),
+							now - create_time);
 				if (local_reqs[j].get_access_method() == READ) {
 					num_reads++;
 					num_read_bytes += local_reqs[j].get_size();
@@ -299,6 +375,116 @@ size_t disk_io_thread::get_all_reqs(msg_queue<io_request> &queue,
 	return tot_num_reqs;
 }
 
+/*
+ * Get the requests in the queue. If the requests are scheduled, they are
+ * passed to the scheduler. It returns the number of requests waiting to
+ * be issued.
+ */
+size_t disk_io_thread::fetch_reqs(std::vector<io_request> &reqs)
+{
+	size_t num = get_all_reqs(queue, reqs);
+	if (sched == NULL)
+		return num;
+
+	long now = get_curr_ns();
+	for (size_t i = 0; i < reqs.size(); i++)
+		sched->add(reqs[i], now);
+	reqs.clear();
+	return sched->get_num_reqs();
+}
+
+/*
+ * Wait a little while for more requests, so that the requests issued by
+ * different threads to neighboring locations can be merged. We stop waiting
+ * once we have enough requests to fill the free I/O slots.
+ */
+void disk_io_thread::wait4merge(std::vector<io_request> &reqs)
+{
+	long window = params.get_io_merge_window() * 1000L;
+	long start = get_curr_ns();
+	size_t num_sched = sched ? sched->get_num_reqs() : 0;
+	long elapsed = 0;
+	while ((int) (reqs.size() + num_sched) < aio->num_available_IO_slots()
+			&& elapsed < window) {
+		// The threads that send requests activate the I/O thread.
+		if (queue.is_empty())
+			wait(window - elapsed);
+		else
+			get_all_reqs(queue, reqs);
+		elapsed = get_curr_ns() - start;
+	}
+}
+
+/*
+ * Create a request that accesses the data of the adjacent requests.
+ */
+io_request disk_io_thread::merge_reqs(const io_request reqs[], int num)
+{
+	io_req_extension *ext = new io_req_extension();
+	// The AIO instance completes the original requests when the merged
+	// request completes.
+	ext->set_merged_reqs(new std::vector<io_request>(reqs, reqs + num));
+	data_loc_t loc(reqs[0].get_file_id(), reqs[0].get_offset());
+	io_request merged(ext, loc, reqs[0].get_access_method(), aio,
+			aio->get_node_id());
+	for (int i = 0; i < num; i++) {
+		if (reqs[i].is_extended_req()) {
+			for (int j = 0; j < reqs[i].get_num_bufs(); j++)
+				merged.add_io_buf(reqs[i].get_io_buf(j));
+		}
+		else
+			merged.add_buf(reqs[i].get_buf(), reqs[i].get_size());
+	}
+	return merged;
+}
+
+/*
+ * Sort the requests from all threads and merge the requests that access
+ * contiguous data in a file into vectored requests. We don't merge
+ * the requests that overlap, because the data in the overlapped range can't
+ * be read into two buffers by one request. A merged request has to stay
+ * inside a RAID block, because the block is mapped to a contiguous range
+ * in a disk.
+ */
+void disk_io_thread::merge_reqs(std::vector<io_request> &reqs)
+{
+	if (reqs.size() < 2)
+		return;
+
+	std::stable_sort(reqs.begin(), reqs.end(), req_loc_comparator());
+	std::vector<io_request> merged;
+	merged.reserve(reqs.size());
+	for (size_t i = 0; i < reqs.size();) {
+		const io_request &first = reqs[i];
+		off_t block_size = first.get_io()->get_block_size() * PAGE_SIZE;
+		off_t block_off = ROUND(first.get_offset(), block_size);
+		off_t end = first.get_offset() + first.get_size();
+		int num_bufs = first.get_num_bufs();
+		size_t j = i + 1;
+		for (; j < reqs.size(); j++) {
+			const io_request &next = reqs[j];
+			off_t next_end = next.get_offset() + next.get_size();
+			if (next.get_file_id() != first.get_file_id()
+					|| next.get_access_method() != first.get_access_method()
+					|| next.get_offset() != end
+					|| ROUND(next_end - 1, block_size) != block_off
+					|| num_bufs + next.get_num_bufs() > MAX_MERGED_IOVECS)
+				break;
+			end = next_end;
+			num_bufs += next.get_num_bufs();
+		}
+		if (j - i == 1)
+			merged.push_back(first);
+		else {
+			merged.push_back(merge_reqs(&reqs[i], j - i));
+			num_merged_reqs += j - i;
+			num_merges++;
+		}
+		i = j;
+	}
+	reqs.swap(merged);
+}
+
 void disk_io_thread::run() {
 	// First, check if we need to flush requests.
 	int num_flushes = flush_counter.get();
@@ -318,7 +504,7 @@ void disk_io_thread::run() {
 		if (!comm_queue.is_empty())
 			run_commands(comm_queue);
 
-		int num = get_all_reqs(queue, local_reqs);
+		int num = fetch_reqs(local_reqs);
 
 		if (is_debug_enabled())
 			printf("I/O thread %d: queue size: %d, low-prio queue size: %d\n",
@@ -331,7 +517,9 @@ void disk_io_thread::run() {
 		while (num == 0) {
 			// we can process as many low-prio requests as possible,
 			// but they shouldn't block the thread.
-			if (!low_prio_queue.is_empty()
+			// The message may still have requests that haven't been
+			// submitted.
+			if ((!low_prio_msg.is_empty() || !low_prio_queue.is_empty())
 					&& aio->num_available_IO_slots() > AIO_HIGH_PRIO_SLOTS) {
 				if (low_prio_msg.is_empty()) {
 					int num = low_prio_queue.fetch(&low_prio_msg, 1);
@@ -351,15 +539,33 @@ void disk_io_thread::run() {
 			else
 				break;
 
-			num = get_all_reqs(queue, local_reqs);
+			num = fetch_reqs(local_reqs);
 		}
 
+		if (params.is_merge_disk_reqs() && params.get_io_merge_window() > 0
+				&& num > 0)
+			wait4merge(local_reqs);
+		if (sched) {
+			fetch_reqs(local_reqs);
+			// We only take the requests that can be submitted to the disks
+			// now, so the requests that arrive later can still be issued
+			// before the remaining ones.
+			int num_slots = aio->num_available_IO_slots();
+			if (num_slots == 0) {
+				aio->wait4complete(1);
+				num_slots = std::max(aio->num_available_IO_slots(), 1);
+			}
+			sched->fetch(local_reqs, num_slots, get_curr_ns());
+		}
+		if (params.is_merge_disk_reqs())
+			merge_reqs(local_reqs);
 		aio->access(local_reqs.data(), local_reqs.size());
 		local_reqs.clear();
 
 		// We can't exit the loop if there are still pending AIO requests.
 		// This thread is responsible for processing completed AIO requests.
-	} while (aio->num_pending_ios() > 0);
+		// The requests kept in the scheduler also have to be issued.
+	} while (aio->num_pending_ios() > 0 || (sched && !sched->is_empty()));
 }
 
 void disk_io_thread::print_state()
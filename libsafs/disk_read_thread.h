@@ -31,6 +31,8 @@
 #include "file_partition.h"
 #include "messaging.h"
 #include "thread.h"
+#include "io_stats.h"
+#include "disk_req_scheduler.h"
 
 namespace safs
 {
@@ -143,9 +145,18 @@ class disk_io_thread: public thread
 	long max_flush_delay;
 	long min_flush_delay;
 	long num_msgs;
+	// The number of requests merged with others.
+	long num_merged_reqs;
+	// The number of requests generated by merging.
+	long num_merges;
 
 	atomic_integer flush_counter;
+	// It's NULL if we don't collect I/O statistics.
+	std::unique_ptr<io_stat_collector> stats;
+	// It's NULL if the requests are issued in the order they arrive.
+	std::unique_ptr<disk_req_scheduler> sched;
 
+	void get_flush_runs(io_request &req, std::vector<io_request> &runs);
 	int process_low_prio_msg(message<io_request> &low_prio_msg);
 
 	int get_num_high_prio_reqs() {
@@ -158,6 +169,10 @@ class disk_io_thread: public thread
 
 	size_t get_all_reqs(msg_queue<io_request> &queue,
 			std::vector<io_request> &reqs);
+	size_t fetch_reqs(std::vector<io_request> &reqs);
+	void wait4merge(std::vector<io_request> &reqs);
+	io_request merge_reqs(const io_request reqs[], int num);
+	void merge_reqs(std::vector<io_request> &reqs);
 
 	void run_commands(thread_safe_FIFO_queue<remote_comm *> &);
 
@@ -215,6 +230,10 @@ public:
 	}
 
 	~disk_io_thread() {
+		// The thread has to stop before we destroy the AIO instance it uses.
+		stop();
+		if (get_id() >= 0)
+			join();
 		delete aio;
 	}
 
@@ -241,6 +260,18 @@ public:
 		return num_write_bytes;
 	}
 
+	size_t get_num_merged_reqs() const {
+		return num_merged_reqs;
+	}
+
+	/*
+	 * Add the I/O statistics of the thread to `stats'.
+	 */
+	void get_io_stats(io_stats &stats) {
+		if (this->stats)
+			this->stats->get_stats(stats);
+	}
+
 	void print_stat() {
 #ifdef STATISTICS
 		printf("\t%ld reads (%ld bytes), %ld writes (%ld bytes) and %d io waits, complete %d reqs and %ld low-prio reqs,\n",
@@ -253,6 +284,15 @@ public:
 			printf("\tavg flush delay: %ldus, max flush delay: %ldus, min flush delay: %ldus\n",
 					tot_flush_delay / num_low_prio_accesses, max_flush_delay,
 					min_flush_delay);
+		if (num_merges > 0)
+			printf("\tmerge %ld requests into %ld requests\n",
+					num_merged_reqs, num_merges);
+		if (sched)
+			printf("\tissue %lu latency, %lu normal and %lu bulk requests, %lu requests reach their deadlines\n",
+					sched->get_num_issued(IO_PRIO_LATENCY),
+					sched->get_num_issued(IO_PRIO_NORMAL),
+					sched->get_num_issued(IO_PRIO_BULK),
+					sched->get_num_expired());
 		printf("\tremain %d high-prio requests, %d low-prio requests, %ld messages in total\n",
 				get_num_high_prio_reqs(), get_num_low_prio_reqs(), num_msgs);
 #endif
@@ -0,0 +1,127 @@
+/*
+ * Copyright 2014 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of SAFSlib.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+
+#include "disk_req_scheduler.h"
+
+namespace safs
+{
+
+disk_req_scheduler::disk_req_scheduler(const std::vector<int> &weights)
+{
+	assert(weights.size() == NUM_IO_PRIO_CLASSES);
+	for (int i = 0; i < NUM_IO_PRIO_CLASSES; i++) {
+		assert(weights[i] > 0);
+		queues[i].weight = weights[i];
+	}
+	vclock = 0;
+	num_reqs = 0;
+	num_expired = 0;
+}
+
+void disk_req_scheduler::add(const io_request &req, long arrival)
+{
+	int prio = req.get_prio_class();
+	prio_queue &q = queues[prio];
+	// A class that has been idle can't use the bandwidth it didn't use
+	// to catch up with the other classes.
+	if (q.reqs.empty())
+		q.vtime = std::max(q.vtime, vclock);
+
+	sched_req sreq;
+	sreq.req = req;
+	sreq.deadline = req.get_deadline() > 0
+		? arrival + req.get_deadline() * 1000 : 0;
+	req_set::iterator it = q.reqs.insert(sreq);
+	if (sreq.deadline > 0)
+		deadlines.insert(std::make_pair(sreq.deadline,
+					std::make_pair(prio, it)));
+	num_reqs++;
+}
+
+/*
+ * Pick the backlogged class with the smallest virtual time.
+ */
+int disk_req_scheduler::pick_class() const
+{
+	int prio = -1;
+	for (int i = 0; i < NUM_IO_PRIO_CLASSES; i++) {
+		if (queues[i].reqs.empty())
+			continue;
+		if (prio < 0 || queues[i].vtime < queues[prio].vtime)
+			prio = i;
+	}
+	return prio;
+}
+
+void disk_req_scheduler::issue(int prio, req_set::iterator it,
+		std::vector<io_request> &reqs)
+{
+	prio_queue &q = queues[prio];
+	const io_request &req = it->req;
+	q.vtime += ((double) std::max(req.get_size(), (ssize_t) 1)) / q.weight;
+	q.file_id = req.get_file_id();
+	q.offset = req.get_offset() + req.get_size();
+	q.num_issued++;
+	reqs.push_back(req);
+	q.reqs.erase(it);
+	num_reqs--;
+}
+
+size_t disk_req_scheduler::fetch(std::vector<io_request> &reqs,
+		size_t max_num, long now)
+{
+	size_t num = 0;
+	for (; num < max_num && num_reqs > 0; num++) {
+		if (!deadlines.empty() && deadlines.begin()->first <= now) {
+			int prio = deadlines.begin()->second.first;
+			req_set::iterator it = deadlines.begin()->second.second;
+			deadlines.erase(deadlines.begin());
+			num_expired++;
+			issue(prio, it, reqs);
+			continue;
+		}
+
+		int prio = pick_class();
+		assert(prio >= 0);
+		prio_queue &q = queues[prio];
+		sched_req key;
+		key.req.set_data_loc(data_loc_t(q.file_id, q.offset));
+		req_set::iterator it = q.reqs.lower_bound(key);
+		// The elevator goes back to the beginning.
+		if (it == q.reqs.end())
+			it = q.reqs.begin();
+		if (it->deadline > 0) {
+			auto range = deadlines.equal_range(it->deadline);
+			for (auto dit = range.first; dit != range.second; dit++) {
+				if (dit->second.first == prio
+						&& dit->second.second == it) {
+					deadlines.erase(dit);
+					break;
+				}
+			}
+		}
+		vclock = q.vtime;
+		issue(prio, it, reqs);
+	}
+	return num;
+}
+
+}
@@ -0,0 +1,138 @@
+#ifndef __DISK_REQ_SCHEDULER_H__
+#define __DISK_REQ_SCHEDULER_H__
+
+/*
+ * Copyright 2014 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of SAFSlib.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <set>
+#include <map>
+#include <vector>
+
+#include "io_request.h"
+
+namespace safs
+{
+
+/**
+ * This decides the order in which an I/O thread issues the requests
+ * waiting for the disks.
+ *
+ * The priority classes share the disks with weighted fair queuing:
+ * every class has a virtual time that advances by the bytes it issues
+ * divided by its weight, and the backlogged class with the smallest
+ * virtual time issues the next request. Inside a class, requests are
+ * issued in one direction of the file offsets (C-SCAN), so a class that
+ * streams data still accesses the disks sequentially. A request whose
+ * deadline has passed is issued before all others.
+ *
+ * The scheduler is only used by its I/O thread, so it isn't thread-safe.
+ */
+class disk_req_scheduler
+{
+	struct sched_req
+	{
+		io_request req;
+		// When the request should be issued (in ns). It's 0 if the request
+		// doesn't have a deadline.
+		long deadline;
+	};
+
+	struct sched_req_comparator
+	{
+		bool operator()(const sched_req &req1, const sched_req &req2) const {
+			if (req1.req.get_file_id() != req2.req.get_file_id())
+				return req1.req.get_file_id() < req2.req.get_file_id();
+			return req1.req.get_offset() < req2.req.get_offset();
+		}
+	};
+
+	typedef std::multiset<sched_req, sched_req_comparator> req_set;
+
+	struct prio_queue
+	{
+		req_set reqs;
+		int weight;
+		double vtime;
+		// Where the elevator of the class is.
+		file_id_t file_id;
+		off_t offset;
+		size_t num_issued;
+
+		prio_queue() {
+			weight = 1;
+			vtime = 0;
+			file_id = 0;
+			offset = 0;
+			num_issued = 0;
+		}
+	};
+
+	prio_queue queues[NUM_IO_PRIO_CLASSES];
+	// The requests with deadlines, ordered by their deadlines.
+	std::multimap<long, std::pair<int, req_set::iterator> > deadlines;
+	// The start time of the request issued last time.
+	double vclock;
+	size_t num_reqs;
+	size_t num_expired;
+
+	void issue(int prio, req_set::iterator it, std::vector<io_request> &reqs);
+	int pick_class() const;
+public:
+	/**
+	 * @weights: the weights of the priority classes.
+	 */
+	disk_req_scheduler(const std::vector<int> &weights);
+
+	/**
+	 * Add a request to the scheduler.
+	 * @arrival: when the request arrives at the I/O thread (in ns). The
+	 * deadline of the request starts from this time.
+	 */
+	void add(const io_request &req, long arrival);
+
+	/**
+	 * Get at most `max_num' requests to issue to the disks.
+	 * @now: the current time (in ns).
+	 * It returns the number of requests appended to `reqs'.
+	 */
+	size_t fetch(std::vector<io_request> &reqs, size_t max_num, long now);
+
+	size_t get_num_reqs() const {
+		return num_reqs;
+	}
+
+	bool is_empty() const {
+		return num_reqs == 0;
+	}
+
+	/**
+	 * The number of requests issued because their deadlines have passed.
+	 */
+	size_t get_num_expired() const {
+		return num_expired;
+	}
+
+	size_t get_num_issued(io_prio_class prio) const {
+		return queues[prio].num_issued;
+	}
+};
+
+}
+
+#endif
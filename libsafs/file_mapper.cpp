@@ -19,10 +19,59 @@
 
 #include "file_mapper.h"
 #include "RAID_config.h"
+#include "tiering.h"
 
 namespace safs
 {
 
+/*
+ * The weights in the header of a file overwrite the ones in the RAID config,
+ * because the data of the file has been laid out with them.
+ */
+static file_mapper::ptr create_weighted_mapper(const safs_header &header,
+		const std::vector<part_file_info> &files, const std::string &file_name)
+{
+	std::vector<int> weights = header.get_disk_weights();
+	if (weights.empty())
+		return file_mapper::ptr(new weighted_mapper(file_name, files,
+					header.get_block_size()));
+	if (weights.size() != files.size()) {
+		fprintf(stderr, "%s has %ld disk weights, but there are %ld disks\n",
+				file_name.c_str(), weights.size(), files.size());
+		return file_mapper::ptr();
+	}
+	std::vector<part_file_info> weighted_files;
+	for (size_t i = 0; i < files.size(); i++)
+		weighted_files.push_back(part_file_info(files[i].get_file_name(),
+					files[i].get_disk_id(), files[i].get_node_id(),
+					weights[i], files[i].is_fast()));
+	return file_mapper::ptr(new weighted_mapper(file_name, weighted_files,
+				header.get_block_size()));
+}
+
+static file_mapper::ptr create_tiered_mapper(const safs_header &header,
+		const std::vector<part_file_info> &files, const std::string &file_name)
+{
+	std::vector<bool> fast_parts(files.size());
+	size_t num_fast_parts = 0;
+	for (size_t i = 0; i < files.size(); i++) {
+		fast_parts[i] = header.is_fast_part(i);
+		num_fast_parts += fast_parts[i];
+	}
+	if (num_fast_parts == files.size()) {
+		fprintf(stderr, "%s doesn't have partitions in the capacity tier\n",
+				file_name.c_str());
+		return file_mapper::ptr();
+	}
+	int block_size = header.get_block_size();
+	size_t num_blocks = div_ceil<size_t>(div_ceil<size_t>(header.get_size(),
+				PAGE_SIZE), block_size);
+	block_tier_table::ptr table = block_tier_table::get(file_name, files,
+			fast_parts, block_size, header.get_num_fast_blocks(), num_blocks);
+	return file_mapper::ptr(new tiered_mapper(file_name, files, block_size,
+				table));
+}
+
 file_mapper::ptr file_mapper::create(const safs_header &header,
 		const std::vector<part_file_info> &files, const std::string &file_name)
 {
@@ -41,6 +90,10 @@ file_mapper::ptr file_mapper::create(const safs_header &header,
 		case HASH:
 			return file_mapper::ptr(new hash_mapper(file_name, files,
 						block_size));
+		case WEIGHTED:
+			return create_weighted_mapper(header, files, file_name);
+		case TIERED:
+			return create_tiered_mapper(header, files, file_name);
 		default:
 			fprintf(stderr, "wrong RAID mapping option\n");
 			return file_mapper::ptr();
@@ -77,6 +130,48 @@ std::vector<size_t> file_mapper::get_size_per_disk(size_t size) const
 	return ret;
 }
 
+void weighted_mapper::init()
+{
+	const std::vector<part_file_info> &files = get_files();
+	int tot_weight = 0;
+	for (size_t i = 0; i < files.size(); i++) {
+		ASSERT_TRUE(files[i].get_weight() > 0);
+		tot_weight += files[i].get_weight();
+	}
+
+	// Smooth weighted round-robin: every disk earns its weight in each
+	// round, and the disk with the most credit gets the block.
+	std::vector<int> credits(files.size());
+	std::vector<int> num_blocks(files.size());
+	for (int i = 0; i < tot_weight; i++) {
+		int idx = 0;
+		for (size_t j = 0; j < files.size(); j++) {
+			credits[j] += files[j].get_weight();
+			if (credits[j] > credits[idx])
+				idx = j;
+		}
+		credits[idx] -= tot_weight;
+		cycle.push_back(idx);
+		locs_in_disk.push_back(num_blocks[idx]++);
+	}
+}
+
+std::vector<size_t> weighted_mapper::get_size_per_disk(size_t size) const
+{
+	std::vector<size_t> ret(get_num_files());
+	// The last block of every disk is in the last cycle.
+	for (size_t i = 0; i <= cycle.size(); i++) {
+		if (size < i * STRIPE_BLOCK_SIZE)
+			break;
+		off_t off = (size / STRIPE_BLOCK_SIZE - i) * STRIPE_BLOCK_SIZE
+			+ STRIPE_BLOCK_SIZE - 1;
+		struct block_identifier bid;
+		map(off, bid);
+		ret[bid.idx] = std::max((size_t) bid.off + 1, ret[bid.idx]);
+	}
+	return ret;
+}
+
 std::vector<size_t> hash_mapper::get_size_per_disk(size_t size) const
 {
 	std::vector<size_t> ret(get_num_files());
@@ -93,4 +188,46 @@ std::vector<size_t> hash_mapper::get_size_per_disk(size_t size) const
 	return ret;
 }
 
+void tiered_mapper::map(off_t off, struct block_identifier &bid) const
+{
+	table->map(off, bid);
+}
+
+int tiered_mapper::map2file(off_t off) const
+{
+	return table->map2file(off);
+}
+
+bool tiered_mapper::map_other(off_t off, struct block_identifier &bid) const
+{
+	return table->map_other(off, bid);
+}
+
+int tiered_mapper::map2home(off_t off) const
+{
+	block_identifier bid;
+	table->map_home(off, bid);
+	return bid.idx;
+}
+
+void tiered_mapper::record_read(off_t off)
+{
+	table->record_read(off);
+}
+
+int tiered_mapper::begin_read() const
+{
+	return table->begin_read();
+}
+
+void tiered_mapper::end_read(int epoch) const
+{
+	table->end_read(epoch);
+}
+
+std::vector<size_t> tiered_mapper::get_size_per_disk(size_t size) const
+{
+	return table->get_size_per_disk(size);
+}
+
 }
@@ -129,6 +129,42 @@ public:
 	virtual void map(off_t, struct block_identifier &) const = 0;
 	virtual int map2file(off_t) const = 0;
 
+	/*
+	 * The data in a location may be in more than one place for a short time
+	 * when the mapping of the location changes. This gives the other place
+	 * if there is one.
+	 */
+	virtual bool map_other(off_t, struct block_identifier &) const {
+		return false;
+	}
+
+	/*
+	 * This gives the chunk of a stripe where the data in a location always
+	 * has a valid copy.
+	 */
+	virtual int map2home(off_t off) const {
+		return map2file(off);
+	}
+
+	/*
+	 * The I/O layers notify the mapper of the reads that reach disks.
+	 */
+	virtual void record_read(off_t) {
+	}
+
+	/*
+	 * A read that may access the data in its current location has to be
+	 * counted from before it's mapped until it completes, so the location
+	 * isn't reused by other data in the meantime. This returns the epoch
+	 * that the read is counted in, or -1 if the data never moves.
+	 */
+	virtual int begin_read() const {
+		return -1;
+	}
+
+	virtual void end_read(int epoch) const {
+	}
+
 	// Given the SAFS file size, this calculates physical file sizes in
 	// each disk. `size' is given in the number of pages.
 	virtual std::vector<size_t> get_size_per_disk(size_t size) const;
@@ -236,6 +272,85 @@ public:
 	}
 };
 
+/*
+ * This mapper gives each disk a share of the stripe blocks proportional
+ * to its weight, so a faster disk stores and serves more data. The blocks
+ * are mapped in cycles of `sum(weights)' blocks. Inside a cycle, the blocks
+ * are interleaved among the disks with smooth weighted round-robin, so that
+ * adjacent blocks are still spread over different disks.
+ */
+class weighted_mapper: public file_mapper
+{
+	// The disk that stores each block in a cycle.
+	std::vector<int> cycle;
+	// The location of each block in a cycle among the blocks in the cycle
+	// stored on the same disk.
+	std::vector<int> locs_in_disk;
+
+	void init();
+public:
+	weighted_mapper(const std::string &name,
+			const std::vector<part_file_info> &files,
+			int block_size): file_mapper(name, files, block_size) {
+		init();
+	}
+
+	virtual void map(off_t off, struct block_identifier &bid) const {
+		int idx_in_block = off % STRIPE_BLOCK_SIZE;
+		off_t block_idx = off / STRIPE_BLOCK_SIZE;
+		off_t cycle_idx = block_idx / cycle.size();
+		int idx_in_cycle = block_idx % cycle.size();
+		bid.idx = cycle[idx_in_cycle];
+		bid.off = (cycle_idx * get_files()[bid.idx].get_weight()
+				+ locs_in_disk[idx_in_cycle]) * STRIPE_BLOCK_SIZE
+			+ idx_in_block;
+	}
+
+	virtual int map2file(off_t off) const {
+		off_t block_idx = off / STRIPE_BLOCK_SIZE;
+		return cycle[block_idx % cycle.size()];
+	}
+
+	virtual std::vector<size_t> get_size_per_disk(size_t size) const;
+
+	virtual file_mapper *clone() {
+		return new weighted_mapper(get_name(), get_files(), STRIPE_BLOCK_SIZE);
+	}
+};
+
+class block_tier_table;
+
+/*
+ * This mapper keeps hot stripe blocks in a fast tier of disks.
+ * The location of the blocks is kept by `block_tier_table', which is
+ * shared by all mappers of a file.
+ */
+class tiered_mapper: public file_mapper
+{
+	std::shared_ptr<block_tier_table> table;
+public:
+	tiered_mapper(const std::string &name,
+			const std::vector<part_file_info> &files, int block_size,
+			std::shared_ptr<block_tier_table> table): file_mapper(name, files,
+				block_size) {
+		this->table = table;
+	}
+
+	virtual void map(off_t off, struct block_identifier &bid) const;
+	virtual int map2file(off_t off) const;
+	virtual bool map_other(off_t off, struct block_identifier &bid) const;
+	virtual int map2home(off_t off) const;
+	virtual void record_read(off_t off);
+	virtual int begin_read() const;
+	virtual void end_read(int epoch) const;
+	virtual std::vector<size_t> get_size_per_disk(size_t size) const;
+
+	virtual file_mapper *clone() {
+		return new tiered_mapper(get_name(), get_files(), STRIPE_BLOCK_SIZE,
+				table);
+	}
+};
+
 }
 
 #endif
@@ -92,6 +92,11 @@ public:
 	void map(off_t pg_off, block_identifier &bid) const {
 		assert(mapper);
 		mapper->map(pg_off, bid);
+		// The data may have moved to another disk after the request was
+		// sent to this partition. If so, we access the copy of the data
+		// in this partition.
+		if (file_map[bid.idx] < 0)
+			BOOST_VERIFY(mapper->map_other(pg_off, bid));
 		// We have to make sure the offset does exist in the partition.
 		assert(file_map[bid.idx] >= 0);
 		bid.idx = file_map[bid.idx];
@@ -100,6 +105,11 @@ public:
 	int map2file(off_t pg_off) const {
 		assert(mapper);
 		int idx = mapper->map2file(pg_off);
+		if (file_map[idx] < 0) {
+			block_identifier bid;
+			BOOST_VERIFY(mapper->map_other(pg_off, bid));
+			idx = bid.idx;
+		}
 		assert(file_map[idx] >= 0);
 		return file_map[idx];
 	}
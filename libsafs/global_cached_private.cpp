@@ -49,6 +49,7 @@
 
 #include "global_cached_private.h"
 #include "slab_allocator.h"
+#include "shared_cache.h"
 
 namespace safs
 {
@@ -693,6 +694,14 @@ void queue_requests(std::vector<page_req_pair> &pending_reqs)
 	process_page_reqs_on_io(pending_reqs.data(), pending_reqs.size());
 }
 
+/*
+ * global_cached_io only issues low-priority reads to read data ahead.
+ */
+static inline bool is_prefetch(const io_request &req)
+{
+	return req.get_access_method() == READ && !req.is_high_prio();
+}
+
 int global_cached_io::multibuf_completion(io_request *request)
 {
 	/*
@@ -701,6 +710,7 @@ int global_cached_io::multibuf_completion(io_request *request)
 	std::vector<page_req_pair> pending_reqs;
 	// The pages that are set dirty for the first time.
 	off_t off = request->get_offset();
+	shared_page_cache *scache = shared_page_cache::get_global();
 	for (int i = 0; i < request->get_num_bufs(); i++) {
 		thread_safe_page *p = request->get_page(i);
 		/*
@@ -710,17 +720,30 @@ int global_cached_io::multibuf_completion(io_request *request)
 		assert(p);
 		p->lock();
 		assert(p->is_io_pending());
-		if (request->get_access_method() == READ)
+		page_id_t pg_id(p->get_file_id(), p->get_offset());
+		if (request->get_access_method() == READ) {
 			p->set_data_ready(true);
+			// We copy the page while holding the lock, so no one can
+			// modify it before it's in the shared cache.
+			if (scache)
+				scache->add(pg_id, (char *) p->get_data(),
+						p->get_shared_version());
+		}
 		else {
 			p->set_dirty(false);
 			p->set_old_dirty(false);
+			// The other processes have to read the new data from the disks.
+			if (scache)
+				scache->invalidate(pg_id);
 		}
 		p->set_io_pending(false);
 		original_io_request *pending_req = p->reset_reqs();
 		p->unlock();
 		if (pending_req)
 			pending_reqs.push_back(page_req_pair(p, pending_req));
+		// A page read ahead is referenced by the request that reads it.
+		if (is_prefetch(*request))
+			p->dec_ref();
 		if (request->get_access_method() == WRITE) {
 			// The reference count of a dirty page is always 1 + # original
 			// requests, so we can decrease the extra reference here.
@@ -740,10 +763,20 @@ void global_cached_io::process_disk_completed_requests(io_request requests[],
 {
 	num_from_underlying.inc(num);
 	std::vector<page_req_pair> pending_reqs;
+	shared_page_cache *scache = shared_page_cache::get_global();
 	for (int i = 0; i < num; i++) {
 		io_request *request = &requests[i];
 		num_underlying_pages.dec(request->get_num_bufs());
 
+		// global_cached_io only issues basic requests to the underlying IO
+		// for the reads that skip the page cache.
+		if (!request->is_extended_req()) {
+			original_io_request *orig
+				= (original_io_request *) request->get_user_data();
+			finalize_partial_request(*request, orig);
+			continue;
+		}
+
 		if (request->get_num_bufs() > 1) {
 			multibuf_completion(request);
 			continue;
@@ -757,6 +790,9 @@ void global_cached_io::process_disk_completed_requests(io_request requests[],
 		// the entire page to memory first.
 		if (request->get_access_method() == READ) {
 			p->set_data_ready(true);
+			if (scache)
+				scache->add(page_id_t(p->get_file_id(), p->get_offset()),
+						(char *) p->get_data(), p->get_shared_version());
 		}
 		// We just evict a page with dirty data and write the original
 		// dirty data in the page to a file.
@@ -764,11 +800,18 @@ void global_cached_io::process_disk_completed_requests(io_request requests[],
 			assert(p->is_old_dirty());
 			assert(!p->data_ready());
 			p->set_old_dirty(false);
+			// The page has been assigned to another offset, so we use
+			// the offset of the request.
+			if (scache)
+				scache->invalidate(page_id_t(request->get_file_id(),
+							request->get_offset()));
 		}
 		p->set_io_pending(false);
 		original_io_request *old = p->reset_reqs();
 		p->unlock();
 
+		if (is_prefetch(*request))
+			p->dec_ref();
 		if (request->get_access_method() == WRITE) {
 			// The reference count of a dirty page is always 1 + # original
 			// requests, so we can decrease the extra reference here.
@@ -864,6 +907,8 @@ global_cached_io::global_cached_io(thread *t, io_interface::ptr underlying,
 	num_bytes = 0;
 	num_fast_process = 0;
 	num_evicted_dirty_pages = 0;
+	num_bypass_reads = 0;
+	file_size = 0;
 
 	this->underlying = underlying;
 	this->cache_size = cache->size();
@@ -881,6 +926,9 @@ global_cached_io::global_cached_io(thread *t, io_interface::ptr underlying,
 global_cached_io::~global_cached_io()
 {
 	cleanup();
+	// The tracer may outlive the I/O instance, so the requests buffered
+	// here have to be written before the buffer goes away.
+	flush_trace();
 }
 
 /**
@@ -911,6 +959,8 @@ ssize_t global_cached_io::__write(original_io_request *orig, thread_safe_page *p
 				io_request read_req(ext, pg_loc, READ, this, p->get_node_id());
 				read_req.add_page(p);
 				read_req.set_priv(p);
+				read_req.set_prio_class(orig->get_prio_class());
+				read_req.set_deadline(orig->get_deadline());
 				assert(p->get_io_req() == NULL);
 				p->set_io_pending(true);
 				p->add_req(orig);
@@ -982,6 +1032,10 @@ ssize_t global_cached_io::__read(original_io_request *orig, thread_safe_page *p)
 			io_request req(ext, pg_loc, READ, this, get_node_id());
 			req.set_priv(p);
 			req.add_page(p);
+			// The page is read with the priority of the request that
+			// reads it first.
+			req.set_prio_class(orig->get_prio_class());
+			req.set_deadline(orig->get_deadline());
 			p->add_req(orig);
 			p->unlock();
 			send2underlying(req);
@@ -1214,7 +1268,10 @@ void global_cached_io::write_dirty_page(thread_safe_page *p,
 	io_request req(ext, pg_id, WRITE, this, p->get_node_id());
 	assert(p->get_ref() > 0);
 	req.add_page(p);
-	p->add_req(orig);
+	// The dirty page may be evicted when we read data ahead. There isn't
+	// an original request in this case.
+	if (orig)
+		p->add_req(orig);
 	/*
 	 * I need to add another reference.
 	 * Normally, the reference count of a page should be the same as the number
@@ -1233,9 +1290,10 @@ void global_cached_io::write_dirty_page(thread_safe_page *p,
 	merge_pages2req(req, get_global_cache(), get_block_size());
 	// The writeback data should have no overlap with the original request
 	// that triggered this writeback.
-	assert(!req.has_overlap(orig->get_offset(), orig->get_size()));
+	assert(orig == NULL || !req.has_overlap(orig->get_offset(),
+				orig->get_size()));
 
-	if (orig->is_sync())
+	if (orig && orig->is_sync())
 		req.set_low_latency(true);
 
 	/*
@@ -1354,6 +1412,10 @@ void global_cached_io::process_user_req(
 		} while (p == NULL);
 		processing_req.move_next();
 		num_pg_accesses++;
+		if (prefetcher && processing_req.get_request().get_access_method()
+				== READ)
+			prefetcher->access_page(pg_id.get_offset(),
+					old_id.get_offset() == -1);
 
 		/* 
 		 * If old_off is -1, it means search() didn't evict a page, i.e.,
@@ -1473,6 +1535,10 @@ end:
 		read(req, pages, pg_idx, processing_req.get_orig());
 	}
 
+	if (prefetcher && processing_req.is_empty()
+			&& processing_req.get_request().get_access_method() == READ)
+		prefetch_stream();
+
 	// If all pages accessed by the request are in the cache, the request
 	// can be completed by the time when the functions returns.
 	if (status) {
@@ -1490,6 +1556,171 @@ end:
 	}
 }
 
+/**
+ * A large read skips the page cache if its data can be read to the user
+ * buffer with direct I/O and none of its pages in the cache is newer
+ * than the data on the disks.
+ */
+bool global_cached_io::can_bypass_cache(const io_request &req)
+{
+	if (params.get_cache_bypass_size() == 0
+			|| req.get_access_method() != READ
+			|| req.get_req_type() != io_request::BASIC_REQ
+			|| req.get_size() < params.get_cache_bypass_size()
+			|| req.get_offset() % PAGE_SIZE != 0
+			|| req.get_size() % PAGE_SIZE != 0
+			|| ((long) req.get_buf()) % PAGE_SIZE != 0)
+		return false;
+
+	// A dirty page has to be written back before we can read its data
+	// from the disks, so the read goes through the page cache instead.
+	// The clean pages have the same data as the disks.
+	for (off_t off = req.get_offset(); off < req.get_offset() + req.get_size();
+			off += PAGE_SIZE) {
+		page_id_t pg_id(req.get_file_id(), off);
+		thread_safe_page *p = (thread_safe_page *) get_global_cache().search(
+				pg_id);
+		if (p == NULL)
+			continue;
+		bool dirty = p->is_dirty() || p->is_old_dirty();
+		p->dec_ref();
+		if (dirty)
+			return false;
+	}
+	return true;
+}
+
+/**
+ * Read the data of the request in processing from the disks to the user
+ * buffer directly. The request is split at the boundaries of RAID blocks,
+ * so the underlying IO doesn't split it and returns all parts to
+ * this IO instance.
+ * It returns false if the request can't skip the page cache.
+ */
+bool global_cached_io::bypass_cache(io_status *status)
+{
+	if (!can_bypass_cache(processing_req.get_request()))
+		return false;
+
+	processing_req.init_orig(req_allocator->alloc_obj(), this);
+	original_io_request *orig = processing_req.get_orig();
+	processing_req.finish();
+	num_bypass_reads++;
+
+	const off_t block_size = underlying->get_block_size() * PAGE_SIZE;
+	off_t end = orig->get_offset() + orig->get_size();
+	for (off_t begin = orig->get_offset(); begin < end;
+			begin = ROUND(begin + block_size, block_size)) {
+		off_t part_end = min(ROUND(begin + block_size, block_size), end);
+		io_request req(orig->get_buf() + (begin - orig->get_offset()),
+				data_loc_t(orig->get_file_id(), begin), part_end - begin,
+				READ, this, get_node_id());
+		req.set_high_prio(orig->is_high_prio());
+		req.set_low_latency(orig->is_low_latency());
+		req.set_prio_class(orig->get_prio_class());
+		req.set_deadline(orig->get_deadline());
+		req.set_user_data(orig);
+
+		io_status underlying_status;
+		num_to_underlying.inc(1);
+		num_underlying_pages.inc(req.get_num_bufs());
+		underlying->access(&req, 1, &underlying_status);
+		if (underlying_status == IO_FAIL)
+			throw io_exception("fail to issue an I/O request");
+	}
+	if (status) {
+		*status = IO_PENDING;
+		status->set_priv_data((long) orig);
+	}
+	return true;
+}
+
+void global_cached_io::send_prefetch(io_request &req)
+{
+	if (req.is_empty())
+		return;
+	req.set_high_prio(false);
+	send2underlying(req);
+	io_req_extension *ext = ext_allocator->alloc_obj();
+	io_request tmp(ext, INVALID_DATA_LOC, READ, this, get_node_id());
+	req = tmp;
+}
+
+/**
+ * Read `num_pages' pages from `off' ahead of a sequential stream.
+ * The pages that are already in the page cache are skipped. The data is
+ * read with low-priority requests, so it doesn't delay the users' requests.
+ * A page being read is referenced by the request, so it can't be evicted
+ * before the request completes.
+ * It returns the offset where it stops reading ahead.
+ */
+off_t global_cached_io::prefetch(off_t off, int num_pages, int &num_issued)
+{
+	const off_t block_size = get_block_size() * PAGE_SIZE;
+	off_t end = min(off + ((off_t) num_pages) * PAGE_SIZE,
+			ROUND_PAGE(file_size));
+	num_issued = 0;
+
+	io_req_extension *ext = ext_allocator->alloc_obj();
+	io_request req(ext, INVALID_DATA_LOC, READ, this, get_node_id());
+	for (; off < end; off += PAGE_SIZE) {
+		// An I/O request can't cross the boundary of a RAID block.
+		if (off % block_size == 0)
+			send_prefetch(req);
+
+		page_id_t pg_id(get_file_id(), off);
+		page_id_t old_id;
+		thread_safe_page *p = (thread_safe_page *) get_global_cache().search(
+				pg_id, old_id);
+		// All pages in the page set are referenced. We shouldn't read
+		// more data ahead.
+		if (p == NULL)
+			break;
+
+		// We evict a dirty page, so we have to write it back first.
+		if (old_id.get_offset() != -1 && p->is_old_dirty()) {
+			num_evicted_dirty_pages++;
+			send_prefetch(req);
+			write_dirty_page(p, old_id, NULL);
+			p->dec_ref();
+			continue;
+		}
+
+		p->lock();
+		if (p->data_ready() || p->is_io_pending() || p->is_old_dirty()) {
+			p->unlock();
+			p->dec_ref();
+			send_prefetch(req);
+			continue;
+		}
+		assert(p->get_io_req() == NULL);
+		assert(!p->is_dirty());
+		p->set_io_pending(true);
+		p->unlock();
+		if (req.is_empty())
+			req.set_data_loc(data_loc_t(p->get_file_id(), p->get_offset()));
+		req.add_page(p);
+		req.set_priv(p);
+		num_issued++;
+	}
+	if (!req.is_empty())
+		send_prefetch(req);
+	ext_allocator->free(req.get_extension());
+	return off;
+}
+
+void global_cached_io::prefetch_stream()
+{
+	off_t pf_off;
+	int num_pages = prefetcher->end_read(pf_off);
+	if (num_pages == 0)
+		return;
+
+	int num_issued;
+	off_t end = prefetch(pf_off, num_pages, num_issued);
+	prefetcher->prefetched(end, num_issued);
+}
+
 void global_cached_io::process_user_reqs(queue_interface<io_request> &queue)
 {
 	std::vector<thread_safe_page *> dirty_pages;
@@ -1523,6 +1754,11 @@ void global_cached_io::process_user_reqs(queue_interface<io_request> &queue)
 		}
 		processing_req.init(req);
 		num_bytes += req.get_size();
+		trace_req(req);
+		if (bypass_cache(NULL))
+			continue;
+		if (prefetcher && req.get_access_method() == READ)
+			prefetcher->start_read(req.get_offset(), req.get_size());
 		process_user_req(dirty_pages, NULL);
 	}
 
@@ -1588,9 +1824,15 @@ void global_cached_io::access(io_request *requests, int num, io_status *status)
 		assert(processing_req.is_empty());
 		processing_req.init(requests[i]);
 		num_bytes += requests[i].get_size();
+		trace_req(requests[i]);
 		io_status *stat_p = NULL;
 		if (status)
 			stat_p = &status[i];
+		if (bypass_cache(stat_p))
+			continue;
+		if (prefetcher && requests[i].get_access_method() == READ)
+			prefetcher->start_read(requests[i].get_offset(),
+					requests[i].get_size());
 		process_user_req(dirty_pages, stat_p);
 		// We can't process all requests. Let's queue the remaining requests.
 		if (!processing_req.is_empty() && i < num - 1) {
@@ -1782,7 +2024,8 @@ static bool merge_req(io_request &merged, const io_request &req)
 			|| merged.get_access_method() != req.get_access_method()
 			|| merged.is_sync() != req.is_sync()
 			|| merged.is_high_prio() != req.is_high_prio()
-			|| merged.is_low_latency() != req.is_low_latency())
+			|| merged.is_low_latency() != req.is_low_latency()
+			|| merged.get_prio_class() != req.get_prio_class())
 		return false;
 
 	for (int i = 0; i < req.get_num_bufs(); i++) {
@@ -1799,6 +2042,10 @@ static bool merge_req(io_request &merged, const io_request &req)
 		else
 			merged.add_io_buf(buf);
 	}
+	// The merged request has to meet the earliest deadline.
+	if (merged.get_deadline() == 0 || (req.get_deadline() > 0
+				&& req.get_deadline() < merged.get_deadline()))
+		merged.set_deadline(req.get_deadline());
 	// We don't need to reference the page for a multi-buf request.
 	merged.set_priv(NULL);
 	return true;
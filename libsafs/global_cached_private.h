@@ -26,6 +26,8 @@
 #include "cache.h"
 #include "container.h"
 #include "comp_io_scheduler.h"
+#include "seq_prefetcher.h"
+#include "io_trace.h"
 
 namespace safs
 {
@@ -78,6 +80,13 @@ class global_cached_io: public io_interface
 			curr_pg_offset += PAGE_SIZE;
 		}
 
+		/*
+		 * The request is served without accessing the pages.
+		 */
+		void finish() {
+			curr_pg_offset = end_pg_offset;
+		}
+
 		const io_request &get_request() const {
 			return req;
 		}
@@ -138,11 +147,25 @@ class global_cached_io: public io_interface
 	partial_request processing_req;
 	comp_io_scheduler::ptr comp_io_sched;
 
+	// It detects sequential streams and reads data ahead of them.
+	// It's NULL if readahead is disabled.
+	std::unique_ptr<seq_prefetcher> prefetcher;
+	// We don't read ahead beyond the end of the file.
+	ssize_t file_size;
+	// The number of traced requests written to the tracer at a time.
+	static const int TRACE_BUF_SIZE = 1024;
+	// It's NULL if the requests aren't traced.
+	io_tracer::ptr tracer;
+	// The traced requests that haven't been written to the tracer.
+	std::vector<workload_t> trace_buf;
+
 	size_t num_pg_accesses;
 	size_t num_bytes;		// The number of accessed bytes
 	size_t cache_hits;
 	size_t num_fast_process;
 	size_t num_evicted_dirty_pages;
+	// The number of reads that skip the page cache.
+	size_t num_bypass_reads;
 
 	// Count the number of async requests.
 	// The number of async requests that have been completed.
@@ -167,8 +190,15 @@ class global_cached_io: public io_interface
 		std::vector<thread_safe_page *> &dirty_pages);
 	int multibuf_completion(io_request *request);
 
+	void send_prefetch(io_request &req);
+	off_t prefetch(off_t off, int num_pages, int &num_issued);
+	void prefetch_stream();
+
 	void wait4req(original_io_request *req);
 
+	bool can_bypass_cache(const io_request &req);
+	bool bypass_cache(io_status *status);
+
 	int get_num_underlying_reqs() const {
 		return num_to_underlying.get() - num_from_underlying.get();
 	}
@@ -268,7 +298,16 @@ public:
 		// tasks. We have to make sure all requests are completed.
 		while (num_pending_ios() > 0 || !comp_io_sched->is_empty())
 			wait4complete(num_pending_ios());
+		// The requests that read data ahead don't belong to any user
+		// requests, but we still need to wait for them.
+		process_all_requests();
+		while (get_num_underlying_reqs() > 0) {
+			get_thread()->wait();
+			process_all_requests();
+		}
 		underlying->cleanup();
+		// The user compute tasks may have issued more requests above.
+		flush_trace();
 		assert(num_processed_areqs.get() == num_completed_areqs.get());
 		assert(num_processed_areqs.get() == num_issued_areqs.get());
 		assert(get_num_underlying_reqs() == 0);
@@ -332,6 +371,54 @@ public:
 	size_t get_num_fast_process() const {
 		return num_fast_process;
 	}
+	size_t get_num_bypass_reads() const {
+		return num_bypass_reads;
+	}
+
+	/**
+	 * Enable readahead of sequential streams. The I/O instance has to know
+	 * the size of the file to read ahead.
+	 */
+	void enable_prefetch(ssize_t file_size, int max_prefetch_size) {
+		this->file_size = file_size;
+		prefetcher = std::unique_ptr<seq_prefetcher>(
+				new seq_prefetcher(max_prefetch_size));
+	}
+
+	/**
+	 * Trace the requests issued to the I/O instance.
+	 */
+	void enable_trace(io_tracer::ptr tracer) {
+		this->tracer = tracer;
+	}
+
+	void trace_req(const io_request &req) {
+		if (tracer == NULL)
+			return;
+		workload_t w;
+		w.off = req.get_offset();
+		w.size = req.get_size();
+		w.read = req.get_access_method() == READ;
+		trace_buf.push_back(w);
+		if (trace_buf.size() >= (size_t) TRACE_BUF_SIZE)
+			flush_trace();
+	}
+
+	void flush_trace() {
+		if (tracer && !trace_buf.empty())
+			tracer->write(trace_buf.data(), trace_buf.size());
+		trace_buf.clear();
+	}
+
+	size_t get_num_prefetched_pages() const {
+		return prefetcher ? prefetcher->get_num_prefetched_pages() : 0;
+	}
+	size_t get_num_useful_prefetches() const {
+		return prefetcher ? prefetcher->get_num_useful_pages() : 0;
+	}
+	size_t get_num_evicted_prefetches() const {
+		return prefetcher ? prefetcher->get_num_evicted_pages() : 0;
+	}
 
 	virtual void print_state() {
 #ifdef STATISTICS
@@ -0,0 +1,240 @@
+/*
+ * Copyright 2014 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of SAFSlib.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <assert.h>
+#include <string.h>
+#include <sys/mman.h>
+#ifdef USE_NUMA
+#include <numaif.h>
+#endif
+
+#include <algorithm>
+
+#include "huge_page_arena.h"
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+
+static const size_t SMALL_PAGE_SIZE = 4096;
+static const size_t HUGE_PAGE_2M = 2UL * 1024 * 1024;
+static const size_t HUGE_PAGE_1G = 1024UL * 1024 * 1024;
+/*
+ * The min size of a region backed by 2MB pages. We don't want to map
+ * memory from the kernel too frequently.
+ */
+static const size_t MIN_REGION_SIZE = 64UL * 1024 * 1024;
+
+static inline size_t roundup(size_t size, size_t align)
+{
+	return (size + align - 1) / align * align;
+}
+
+/*
+ * The size of huge pages used by the arenas. 0 means the arenas are disabled.
+ */
+static size_t arena_page_size;
+static pthread_mutex_t arenas_lock = PTHREAD_MUTEX_INITIALIZER;
+// The arena of node i is stored in the location i + 1.
+static std::vector<huge_page_arena *> arenas;
+
+huge_page_arena::stat::stat()
+{
+	memset(mapped_bytes, 0, sizeof(mapped_bytes));
+	memset(num_failures, 0, sizeof(num_failures));
+	used_bytes = 0;
+	free_bytes = 0;
+}
+
+void huge_page_arena::stat::add(const stat &s)
+{
+	for (int i = 0; i < NUM_PAGE_TYPES; i++) {
+		mapped_bytes[i] += s.mapped_bytes[i];
+		num_failures[i] += s.num_failures[i];
+	}
+	used_bytes += s.used_bytes;
+	free_bytes += s.free_bytes;
+}
+
+void huge_page_arena::enable(size_t page_size)
+{
+	assert(page_size == HUGE_PAGE_2M || page_size == HUGE_PAGE_1G);
+	pthread_mutex_lock(&arenas_lock);
+	arena_page_size = page_size;
+	pthread_mutex_unlock(&arenas_lock);
+}
+
+void huge_page_arena::disable()
+{
+	// The arenas aren't destroyed because their memory may still be used.
+	pthread_mutex_lock(&arenas_lock);
+	arena_page_size = 0;
+	pthread_mutex_unlock(&arenas_lock);
+}
+
+bool huge_page_arena::is_enabled()
+{
+	return arena_page_size > 0;
+}
+
+huge_page_arena *huge_page_arena::get(int node_id)
+{
+	assert(node_id >= -1);
+	huge_page_arena *ret = NULL;
+	pthread_mutex_lock(&arenas_lock);
+	if (arena_page_size > 0) {
+		size_t idx = node_id + 1;
+		if (arenas.size() <= idx)
+			arenas.resize(idx + 1);
+		if (arenas[idx] == NULL)
+			arenas[idx] = new huge_page_arena(node_id);
+		ret = arenas[idx];
+	}
+	pthread_mutex_unlock(&arenas_lock);
+	return ret;
+}
+
+huge_page_arena::stat huge_page_arena::get_tot_stat()
+{
+	stat ret;
+	pthread_mutex_lock(&arenas_lock);
+	for (size_t i = 0; i < arenas.size(); i++)
+		if (arenas[i])
+			ret.add(arenas[i]->get_stat());
+	pthread_mutex_unlock(&arenas_lock);
+	return ret;
+}
+
+huge_page_arena::huge_page_arena(int node_id): node_id(node_id)
+{
+	pthread_mutex_init(&lock, NULL);
+}
+
+char *huge_page_arena::map_region(size_t size, page_type type)
+{
+	int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+	char *addr;
+	if (type == PAGE_NORMAL) {
+		// We need the region to be aligned to 2MB, so the kernel can back
+		// it with transparent huge pages.
+		size_t map_size = size + HUGE_PAGE_2M;
+		char *map_addr = (char *) mmap(NULL, map_size, PROT_READ | PROT_WRITE,
+				flags, -1, 0);
+		if (map_addr == MAP_FAILED)
+			return NULL;
+		addr = (char *) roundup((size_t) map_addr, HUGE_PAGE_2M);
+		if (addr > map_addr)
+			munmap(map_addr, addr - map_addr);
+		if (map_addr + map_size > addr + size)
+			munmap(addr + size, map_addr + map_size - (addr + size));
+		// It's fine if the kernel doesn't support transparent huge pages.
+		madvise(addr, size, MADV_HUGEPAGE);
+	}
+	else {
+		int shift = type == PAGE_1G ? 30 : 21;
+		flags |= MAP_HUGETLB | (shift << MAP_HUGE_SHIFT);
+		addr = (char *) mmap(NULL, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+		if (addr == MAP_FAILED)
+			return NULL;
+	}
+#ifdef USE_NUMA
+	if (node_id >= 0) {
+		// We prefer the node instead of binding the memory to the node,
+		// so we don't get SIGBUS if the node runs out of huge pages.
+		unsigned long mask = 1UL << node_id;
+		mbind(addr, size, MPOL_PREFERRED, &mask, sizeof(mask) * 8, 0);
+	}
+#endif
+	return addr;
+}
+
+bool huge_page_arena::add_region(size_t size)
+{
+	page_type types[NUM_PAGE_TYPES];
+	int num_types = 0;
+	if (arena_page_size == HUGE_PAGE_1G)
+		types[num_types++] = PAGE_1G;
+	types[num_types++] = PAGE_2M;
+	types[num_types++] = PAGE_NORMAL;
+
+	size_t region_size = roundup(std::max(size, MIN_REGION_SIZE),
+			std::max(arena_page_size, HUGE_PAGE_2M));
+	for (int i = 0; i < num_types; i++) {
+		char *addr = map_region(region_size, types[i]);
+		if (addr == NULL) {
+			arena_stat.num_failures[types[i]]++;
+			continue;
+		}
+		region r;
+		r.addr = addr;
+		r.size = region_size;
+		r.used = 0;
+		regions.push_back(r);
+		arena_stat.mapped_bytes[types[i]] += region_size;
+		return true;
+	}
+	return false;
+}
+
+char *huge_page_arena::alloc(size_t size)
+{
+	size = roundup(size, SMALL_PAGE_SIZE);
+	char *ret = NULL;
+	pthread_mutex_lock(&lock);
+	auto it = free_chunks.find(size);
+	if (it != free_chunks.end()) {
+		ret = it->second;
+		free_chunks.erase(it);
+		arena_stat.free_bytes -= size;
+	}
+	else {
+		region *r = NULL;
+		for (size_t i = 0; i < regions.size() && r == NULL; i++)
+			if (regions[i].size - regions[i].used >= size)
+				r = &regions[i];
+		if (r == NULL && add_region(size))
+			r = &regions.back();
+		if (r) {
+			ret = r->addr + r->used;
+			r->used += size;
+		}
+	}
+	if (ret)
+		arena_stat.used_bytes += size;
+	pthread_mutex_unlock(&lock);
+	return ret;
+}
+
+void huge_page_arena::free(char *addr, size_t size)
+{
+	size = roundup(size, SMALL_PAGE_SIZE);
+	pthread_mutex_lock(&lock);
+	free_chunks.insert(std::pair<size_t, char *>(size, addr));
+	arena_stat.used_bytes -= size;
+	arena_stat.free_bytes += size;
+	pthread_mutex_unlock(&lock);
+}
+
+huge_page_arena::stat huge_page_arena::get_stat()
+{
+	pthread_mutex_lock(&lock);
+	stat ret = arena_stat;
+	pthread_mutex_unlock(&lock);
+	return ret;
+}
@@ -0,0 +1,127 @@
+#ifndef __HUGE_PAGE_ARENA_H__
+#define __HUGE_PAGE_ARENA_H__
+
+/*
+ * Copyright 2014 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of SAFSlib.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+
+#include <map>
+#include <vector>
+
+/**
+ * An arena hands out large chunks of memory backed by huge pages on
+ * a NUMA node. The slab allocators get their memory from the arenas when
+ * huge pages are enabled, so the pages in the page cache and the message
+ * buffers of I/O requests are mapped with few TLB entries.
+ *
+ * An arena maps memory in regions of huge pages and carves chunks from
+ * the regions. If the system runs out of huge pages of the configured size,
+ * the arena falls back to 2MB huge pages and then to normal pages with
+ * transparent huge pages. The freed chunks are kept in the arena and are
+ * reused by the chunks of the same size.
+ *
+ * The arenas live as long as the process, because the memory they hand out
+ * may be used after the I/O system is destroyed.
+ */
+class huge_page_arena
+{
+public:
+	enum page_type
+	{
+		PAGE_1G,
+		PAGE_2M,
+		// Normal pages, which may be backed by transparent huge pages.
+		PAGE_NORMAL,
+		NUM_PAGE_TYPES,
+	};
+
+	struct stat
+	{
+		// The size of the memory mapped with each type of pages.
+		size_t mapped_bytes[NUM_PAGE_TYPES];
+		// The number of times that we can't map huge pages of a type.
+		size_t num_failures[NUM_PAGE_TYPES];
+		// The size of the chunks being used.
+		size_t used_bytes;
+		// The size of the freed chunks kept in the arena.
+		size_t free_bytes;
+
+		stat();
+		void add(const stat &s);
+	};
+private:
+	struct region
+	{
+		char *addr;
+		size_t size;
+		// The size of the memory that has been carved from the region.
+		size_t used;
+	};
+
+	const int node_id;
+	pthread_mutex_t lock;
+	std::vector<region> regions;
+	// The freed chunks indexed by their sizes.
+	std::multimap<size_t, char *> free_chunks;
+	stat arena_stat;
+
+	huge_page_arena(int node_id);
+
+	char *map_region(size_t size, page_type type);
+	bool add_region(size_t size);
+public:
+	/**
+	 * Enable the arenas with huge pages of the specified size.
+	 * It has to be 2MB or 1GB.
+	 */
+	static void enable(size_t page_size);
+	static void disable();
+	static bool is_enabled();
+
+	/**
+	 * Get the arena of a NUMA node. -1 gets the arena that isn't bound to
+	 * any node. It returns NULL if the arenas are disabled.
+	 */
+	static huge_page_arena *get(int node_id);
+
+	/**
+	 * Get the statistics of all arenas.
+	 */
+	static stat get_tot_stat();
+
+	int get_node_id() const {
+		return node_id;
+	}
+
+	/**
+	 * Allocate a chunk of memory aligned to 4KB.
+	 * It returns NULL if the system runs out of memory.
+	 */
+	char *alloc(size_t size);
+	/**
+	 * Free a chunk of memory allocated from the arena.
+	 */
+	void free(char *addr, size_t size);
+
+	stat get_stat();
+};
+
+#endif
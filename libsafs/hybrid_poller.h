@@ -0,0 +1,106 @@
+#ifndef __HYBRID_POLLER_H__
+#define __HYBRID_POLLER_H__
+
+/*
+ * Copyright 2014 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of SAFSlib.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+
+#include "common.h"
+
+namespace safs
+{
+
+/**
+ * This decides how long a thread spins for I/O completions before it
+ * blocks. It keeps the moving average of the time that the thread waits
+ * for completions. If completions usually arrive within the maximal spin
+ * time, the thread spins for twice the average wait time, so most of
+ * the completions are caught without the wakeup latency of blocking.
+ * Otherwise, spinning only wastes CPU and the thread blocks immediately.
+ * The average keeps being updated while the thread blocks, so the thread
+ * starts to spin again when the device becomes fast.
+ *
+ * Each thread that waits for completions owns its own poller.
+ */
+class hybrid_poller
+{
+	// The weight of a new wait time in the moving average is 1/2^WEIGHT_SHIFT.
+	static const int WEIGHT_SHIFT = 3;
+
+	// 0 means the thread never spins.
+	long max_spin_ns;
+	long avg_wait_ns;
+
+	long num_spin_completes;
+	long num_blocks;
+	long tot_spin_ns;
+public:
+	hybrid_poller(long max_spin_ns) {
+		this->max_spin_ns = max_spin_ns;
+		avg_wait_ns = 0;
+		num_spin_completes = 0;
+		num_blocks = 0;
+		tot_spin_ns = 0;
+	}
+
+	/*
+	 * The time that the thread should spin before it blocks.
+	 */
+	long get_spin_ns() const {
+		if (avg_wait_ns > max_spin_ns)
+			return 0;
+		return min(avg_wait_ns * 2, max_spin_ns);
+	}
+
+	/*
+	 * Record the time that the thread waited for completions.
+	 * `spun' indicates whether the completions arrived when the thread spun.
+	 */
+	void add_wait(long wait_ns, long spin_ns, bool spun) {
+		avg_wait_ns += (wait_ns - avg_wait_ns) >> WEIGHT_SHIFT;
+		tot_spin_ns += spin_ns;
+		if (spun)
+			num_spin_completes++;
+		else
+			num_blocks++;
+	}
+
+	long get_avg_wait_ns() const {
+		return avg_wait_ns;
+	}
+
+	long get_num_spin_completes() const {
+		return num_spin_completes;
+	}
+
+	long get_num_blocks() const {
+		return num_blocks;
+	}
+
+	void print_stat() const {
+		printf("\tget %ld completions when spinning (%ld us in total), block %ld times, avg wait: %ld us\n",
+				num_spin_completes, tot_spin_ns / 1000, num_blocks,
+				avg_wait_ns / 1000);
+	}
+};
+
+}
+
+#endif
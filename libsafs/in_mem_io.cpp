@@ -21,6 +21,9 @@
 #include <numa.h>
 #endif
 
+#include <fcntl.h>
+#include <sys/mman.h>
+
 #include <boost/format.hpp>
 
 #include "in_mem_io.h"
@@ -28,6 +31,8 @@
 #include "native_file.h"
 #include "safs_file.h"
 #include "io_interface.h"
+#include "RAID_config.h"
+#include "file_mapper.h"
 
 namespace safs
 {
@@ -85,7 +90,7 @@ NUMA_buffer::NUMA_buffer(std::shared_ptr<char> data, size_t length,
 NUMA_buffer::NUMA_buffer(size_t length,
 		const NUMA_mapper &_mapper): mapper(_mapper)
 {
-	length = ROUNDUP(length, PAGE_SIZE);
+	length = get_aligned_length(length);
 	this->length = length;
 	bufs.resize(mapper.get_num_nodes());
 	buf_lens.resize(bufs.size());
@@ -160,6 +165,15 @@ NUMA_buffer::data_loc_info NUMA_buffer::get_data_loc(off_t off,
 
 NUMA_buffer::cdata_info NUMA_buffer::get_data(off_t off, size_t size) const
 {
+	if (mapped) {
+		if (off + size > length) {
+			fprintf(stderr, "data of %ld bytes in %ld exceeds length %ld\n",
+					size, off, length);
+			return cdata_info(NULL, 0);
+		}
+		return cdata_info(mapped.get() + off, size);
+	}
+
 	data_loc_info loc = get_data_loc(off, size);
 	if (loc.node_id < 0)
 		return cdata_info(NULL, 0);
@@ -169,6 +183,15 @@ NUMA_buffer::cdata_info NUMA_buffer::get_data(off_t off, size_t size) const
 
 NUMA_buffer::data_info NUMA_buffer::get_data(off_t off, size_t size)
 {
+	if (mapped) {
+		if (off + size > length) {
+			fprintf(stderr, "data of %ld bytes in %ld exceeds length %ld\n",
+					size, off, length);
+			return data_info(NULL, 0);
+		}
+		return data_info(mapped.get() + off, size);
+	}
+
 	data_loc_info loc = get_data_loc(off, size);
 	if (loc.node_id < 0)
 		return data_info(NULL, 0);
@@ -215,6 +238,9 @@ void NUMA_buffer::copy_to(char *buf, size_t size, off_t off) const
 NUMA_buffer::ptr NUMA_buffer::load(const std::string &file_name,
 		const NUMA_mapper &mapper)
 {
+	if (params.is_map_in_mem_data())
+		return map(file_name, mapper);
+
 	native_file local_f(file_name);
 	if (!local_f.exist())
 		throw io_exception(boost::str(
@@ -285,6 +311,12 @@ void NUMA_buffer::dump(const std::string &file_name)
 NUMA_buffer::ptr NUMA_buffer::load_safs(const std::string &file_name,
 		const NUMA_mapper &mapper)
 {
+	if (params.is_map_in_mem_data()) {
+		NUMA_buffer::ptr numa_buf = map_safs(file_name, mapper);
+		if (numa_buf)
+			return numa_buf;
+	}
+
 	file_io_factory::shared_ptr io_factory = create_io_factory(file_name,
 			REMOTE_ACCESS);
 	if (io_factory == NULL)
@@ -314,6 +346,238 @@ NUMA_buffer::ptr NUMA_buffer::load_safs(const std::string &file_name,
 	return numa_buf;
 }
 
+namespace
+{
+
+class munmap_delete
+{
+	size_t size;
+public:
+	munmap_delete(size_t size) {
+		this->size = size;
+	}
+
+	void operator()(char *buf) const {
+		munmap(buf, size);
+	}
+};
+
+/*
+ * This reserves the virtual memory for mapping data from files.
+ */
+std::shared_ptr<char> reserve_mapped(size_t length)
+{
+	void *addr = mmap(NULL, length, PROT_NONE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (addr == MAP_FAILED)
+		throw io_exception(boost::str(boost::format(
+						"can't reserve %1% bytes of memory: %2%")
+					% length % strerror(errno)));
+	return std::shared_ptr<char>((char *) addr, munmap_delete(length));
+}
+
+/*
+ * Map a piece of a file to the given address in the reserved memory.
+ */
+void map_file(const std::string &file_name, int fd, char *addr, size_t size,
+		off_t off, bool populate)
+{
+	int flags = MAP_PRIVATE | MAP_FIXED;
+	if (populate)
+		flags |= MAP_POPULATE;
+	void *ret = mmap(addr, size, PROT_READ | PROT_WRITE, flags, fd, off);
+	if (ret == MAP_FAILED)
+		throw io_exception(boost::str(boost::format("can't map %1%: %2%")
+					% file_name % strerror(errno)));
+	// Huge pages reduce TLB misses, but the kernel may not support them
+	// for the file, so we ignore the error.
+	madvise(addr, size, MADV_HUGEPAGE);
+}
+
+int get_max_map_count()
+{
+	// The default limit in Linux.
+	int count = 65530;
+	FILE *f = fopen("/proc/sys/vm/max_map_count", "r");
+	if (f) {
+		if (fscanf(f, "%d", &count) != 1)
+			count = 65530;
+		fclose(f);
+	}
+	return count;
+}
+
+struct populate_arg
+{
+	const NUMA_mapper *mapper;
+	char *data;
+	size_t length;
+	int node_id;
+	pthread_t tid;
+};
+
+/*
+ * Write the pages in the data ranges of a NUMA node from a thread running
+ * on the node, so that the pages are allocated on the node. Reading
+ * a page of a private file mapping only maps the page in the page cache,
+ * which may be on any node, so we have to write it to get a private copy.
+ */
+void *populate_node(void *arg)
+{
+	populate_arg *parg = (populate_arg *) arg;
+#ifdef USE_NUMA
+	numa_run_on_node(parg->node_id);
+#endif
+	const NUMA_mapper &mapper = *parg->mapper;
+	volatile char *data = parg->data;
+	for (size_t off = 0; off < parg->length; off += mapper.get_range_size()) {
+		if (mapper.map2physical(off).first != parg->node_id)
+			continue;
+		size_t end = std::min(off + mapper.get_range_size(), parg->length);
+		for (size_t pg_off = off; pg_off < end; pg_off += PAGE_SIZE)
+			data[pg_off] = data[pg_off];
+	}
+	return NULL;
+}
+
+}
+
+void NUMA_buffer::populate_mapped()
+{
+	std::vector<populate_arg> args(mapper.get_num_nodes());
+	for (size_t i = 0; i < args.size(); i++) {
+		args[i].mapper = &mapper;
+		args[i].data = mapped.get();
+		args[i].length = length;
+		args[i].node_id = i;
+		BOOST_VERIFY(pthread_create(&args[i].tid, NULL, populate_node,
+					&args[i]) == 0);
+	}
+	for (size_t i = 0; i < args.size(); i++)
+		pthread_join(args[i].tid, NULL);
+}
+
+NUMA_buffer::ptr NUMA_buffer::map(const std::string &file_name,
+		const NUMA_mapper &mapper)
+{
+	native_file local_f(file_name);
+	if (!local_f.exist())
+		throw io_exception(boost::str(
+					boost::format("Linux file %1% doesn't exist") % file_name));
+	ssize_t file_size = local_f.get_size();
+	assert(file_size > 0);
+
+	int fd = open(file_name.c_str(), O_RDONLY);
+	if (fd < 0)
+		throw io_exception(boost::str(boost::format("can't open %1%: %2%")
+					% file_name % strerror(errno)));
+	NUMA_buffer::ptr numa_buf(new NUMA_buffer(mapper));
+	// The length is the same as the buffer loaded from the file.
+	numa_buf->length = get_aligned_length(file_size);
+	numa_buf->mapped = reserve_mapped(numa_buf->length);
+	// If the data is on one NUMA node, the kernel populates the pages
+	// when mapping them. The mapping is private and writable, so
+	// the kernel copies the pages instead of mapping the page cache.
+	bool populate = mapper.get_num_nodes() == 1;
+	try {
+		map_file(file_name, fd, numa_buf->mapped.get(), numa_buf->length, 0,
+				populate);
+	} catch (io_exception &e) {
+		close(fd);
+		throw;
+	}
+	// The mapping keeps a reference to the file.
+	close(fd);
+	if (!populate)
+		numa_buf->populate_mapped();
+	return numa_buf;
+}
+
+NUMA_buffer::ptr NUMA_buffer::map_safs(const std::string &file_name,
+		const NUMA_mapper &mapper)
+{
+	safs_file file(get_sys_RAID_conf(), file_name);
+	if (!file.exist())
+		throw io_exception(std::string("SAFS file doesn't exist: ")
+				+ file_name);
+	file_mapper::ptr block_mapper
+		= get_sys_RAID_conf().create_file_mapper(file_name);
+	if (block_mapper == NULL)
+		throw io_exception(std::string("can't create file mapper for ")
+				+ file_name);
+
+	// Adjacent blocks stored contiguously in the same partition are
+	// mapped together.
+	struct piece {
+		off_t pg_off;
+		block_identifier bid;
+		size_t num_pages;
+	};
+	size_t num_pages = div_ceil<size_t>(file.get_size(), PAGE_SIZE);
+	std::vector<piece> pieces;
+	for (size_t pg_off = 0; pg_off < num_pages;
+			pg_off += block_mapper->STRIPE_BLOCK_SIZE) {
+		block_identifier bid;
+		block_mapper->map(pg_off, bid);
+		size_t size = std::min((size_t) block_mapper->STRIPE_BLOCK_SIZE,
+				num_pages - pg_off);
+		if (!pieces.empty() && pieces.back().bid.idx == bid.idx
+				&& pieces.back().bid.off + (off_t) pieces.back().num_pages
+				== bid.off)
+			pieces.back().num_pages += size;
+		else {
+			piece p;
+			p.pg_off = pg_off;
+			p.bid = bid;
+			p.num_pages = size;
+			pieces.push_back(p);
+		}
+	}
+	// The kernel limits the number of mappings in a process. We leave half
+	// of them to the rest of the process.
+	if (pieces.size() > (size_t) get_max_map_count() / 2) {
+		BOOST_LOG_TRIVIAL(info) << boost::format(
+				"%1% is split into %2% pieces, so we load it to memory instead")
+			% file_name % pieces.size();
+		return NUMA_buffer::ptr();
+	}
+
+	std::vector<int> fds(block_mapper->get_num_files(), -1);
+	for (size_t i = 0; i < fds.size(); i++) {
+		fds[i] = open(block_mapper->get_file_name(i).c_str(), O_RDONLY);
+		if (fds[i] < 0) {
+			int err = errno;
+			for (size_t j = 0; j < i; j++)
+				close(fds[j]);
+			throw io_exception(boost::str(boost::format("can't open %1%: %2%")
+						% block_mapper->get_file_name(i) % strerror(err)));
+		}
+	}
+	NUMA_buffer::ptr numa_buf(new NUMA_buffer(mapper));
+	numa_buf->length = get_aligned_length(file.get_size());
+	bool populate = mapper.get_num_nodes() == 1;
+	try {
+		numa_buf->mapped = reserve_mapped(numa_buf->length);
+		for (size_t i = 0; i < pieces.size(); i++)
+			map_file(block_mapper->get_file_name(pieces[i].bid.idx),
+					fds[pieces[i].bid.idx],
+					numa_buf->mapped.get() + pieces[i].pg_off * PAGE_SIZE,
+					pieces[i].num_pages * PAGE_SIZE,
+					pieces[i].bid.off * PAGE_SIZE, populate);
+	} catch (io_exception &e) {
+		for (size_t i = 0; i < fds.size(); i++)
+			close(fds[i]);
+		throw;
+	}
+	for (size_t i = 0; i < fds.size(); i++)
+		close(fds[i]);
+	if (!populate)
+		numa_buf->populate_mapped();
+	BOOST_LOG_TRIVIAL(info) << boost::format("map %1% in %2% pieces")
+		% file_name % pieces.size();
+	return numa_buf;
+}
+
 NUMA_buffer::ptr NUMA_buffer::create(std::shared_ptr<char> data, size_t length,
 		const NUMA_mapper &mapper)
 {
@@ -449,7 +713,7 @@ void in_mem_io::process_req(const io_request &req)
 	// If the data in the buffer isn't stored in contiguous memory,
 	// we need to copy them to a piece of contiguous memory.
 	// This should happen very rarely if the range size in the NUMA mapper
-	// is very large. TODO but we can avoid the memory copy entirely.
+	// is very large, and it never happens if the data is mapped from files.
 	if (info.second < size) {
 		first_page = (char *) malloc(size);
 		data->copy_to(first_page, size, off);
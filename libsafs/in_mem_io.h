@@ -38,6 +38,11 @@ class NUMA_buffer
 	// This is the total length of the buffer.
 	size_t length;
 	NUMA_mapper mapper;
+	// When the data is mapped from files, all data is in this contiguous
+	// piece of memory in the order of the offsets, and `bufs' is empty.
+	// The data ranges are still placed on the NUMA nodes chosen by
+	// the mapper.
+	std::shared_ptr<char> mapped;
 
 	struct data_loc_info {
 		int node_id;
@@ -51,8 +56,19 @@ class NUMA_buffer
 	};
 	data_loc_info get_data_loc(off_t off, size_t size) const;
 
+	// The buffer always has whole pages, no matter whether the data is
+	// loaded or mapped.
+	static size_t get_aligned_length(size_t size) {
+		return ROUNDUP(size, PAGE_SIZE);
+	}
+
 	NUMA_buffer(std::shared_ptr<char>, size_t length, const NUMA_mapper &mapper);
 	NUMA_buffer(size_t length, const NUMA_mapper &mapper);
+	NUMA_buffer(const NUMA_mapper &mapper): mapper(mapper) {
+		length = 0;
+	}
+
+	void populate_mapped();
 public:
 	typedef std::pair<const char *, size_t> cdata_info;
 	typedef std::pair<char *, size_t> data_info;
@@ -63,6 +79,18 @@ public:
 	 */
 	static ptr load(const std::string &file, const NUMA_mapper &mapper);
 	static ptr load_safs(const std::string &file, const NUMA_mapper &mapper);
+	/*
+	 * Map the data in a file to the buffer instead of copying it.
+	 * The mapping is private, so the data written to the buffer isn't
+	 * written back to the file. load() and load_safs() map the data
+	 * if `map_in_mem_data' is set.
+	 */
+	static ptr map(const std::string &file, const NUMA_mapper &mapper);
+	/*
+	 * It returns NULL if the SAFS file is split into too many pieces
+	 * to be mapped.
+	 */
+	static ptr map_safs(const std::string &file, const NUMA_mapper &mapper);
 
 	static ptr create(std::shared_ptr<char>, size_t length,
 			const NUMA_mapper &mapper);
@@ -70,7 +98,15 @@ public:
 		return ptr(new NUMA_buffer(length, mapper));
 	}
 
+	/*
+	 * Get the memory that stores the data ranges of a NUMA node.
+	 * The data mapped from a file is only split among NUMA nodes
+	 * physically, so all nodes share the same buffer, in which the data
+	 * of a node is at its offsets in the file.
+	 */
 	std::shared_ptr<char> get_buf(int node_id) {
+		if (mapped && (size_t) node_id < mapper.get_num_nodes())
+			return mapped;
 		if ((size_t) node_id >= bufs.size())
 			return std::shared_ptr<char>();
 		else
@@ -38,6 +38,7 @@
 #include "global_cached_private.h"
 #include "part_global_cached_private.h"
 #include "cache_config.h"
+#include "partitioned_cache.h"
 #include "disk_read_thread.h"
 #include "debugger.h"
 #include "mem_tracker.h"
@@ -45,10 +46,72 @@
 #include "safs_file.h"
 #include "safs_exception.h"
 #include "direct_comp_access.h"
+#include "cache_snapshot.h"
+#include "huge_page_arena.h"
+#include "shared_cache.h"
+#include "tiering.h"
 
 namespace safs
 {
 
+/*
+ * This dumps the I/O statistics to a file periodically in its own thread.
+ */
+class io_stats_dumper
+{
+	std::string file;
+	int interval;	// in seconds
+	bool stopped;
+	pthread_t tid;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+
+	static void *run(void *arg);
+public:
+	typedef std::unique_ptr<io_stats_dumper> ptr;
+
+	io_stats_dumper(const std::string &file, int interval) {
+		this->file = file;
+		this->interval = interval;
+		stopped = false;
+		pthread_mutex_init(&mutex, NULL);
+		pthread_cond_init(&cond, NULL);
+		BOOST_VERIFY(pthread_create(&tid, NULL, run, this) == 0);
+	}
+
+	~io_stats_dumper() {
+		pthread_mutex_lock(&mutex);
+		stopped = true;
+		pthread_mutex_unlock(&mutex);
+		pthread_cond_signal(&cond);
+		pthread_join(tid, NULL);
+		pthread_mutex_destroy(&mutex);
+		pthread_cond_destroy(&cond);
+	}
+};
+
+void *io_stats_dumper::run(void *arg)
+{
+	io_stats_dumper *dumper = (io_stats_dumper *) arg;
+	pthread_mutex_lock(&dumper->mutex);
+	while (!dumper->stopped) {
+		struct timespec deadline;
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_sec += dumper->interval;
+		int ret = 0;
+		while (!dumper->stopped && ret != ETIMEDOUT)
+			ret = pthread_cond_timedwait(&dumper->cond, &dumper->mutex,
+					&deadline);
+		if (dumper->stopped)
+			break;
+		pthread_mutex_unlock(&dumper->mutex);
+		dump_io_stats(dumper->file);
+		pthread_mutex_lock(&dumper->mutex);
+	}
+	pthread_mutex_unlock(&dumper->mutex);
+	return NULL;
+}
+
 /*
  * This global data collection is very static.
  * Once the data is initialized, no data needs to be changed.
@@ -70,6 +133,22 @@ struct global_data_collection
 	// TODO there is memory leak here.
 	cache_config::ptr cache_conf;
 	page_cache::ptr global_cache;
+	// It's NULL if the page cache isn't partitioned for files.
+	partitioned_cache::ptr cache_parts;
+	// The snapshot of the page cache used for warming up the page cache.
+	cache_snapshot::ptr snapshot;
+	// The page cache shared with the other processes.
+	shared_page_cache::ptr shared_cache;
+	// The files accessed through the page cache, indexed by their file ids.
+	std::unordered_map<int, std::string> cached_files;
+	// The files that have been warmed up with the snapshot.
+	std::unordered_set<std::string> warmed_files;
+	// The files that are being warmed up with the snapshot.
+	std::unordered_set<std::string> warming_files;
+	std::vector<std::shared_ptr<thread> > warmup_threads;
+	io_stats_dumper::ptr stats_dumper;
+	// It moves hot blocks to the fast tier of disks.
+	tier_migrator::ptr migrator;
 	std::vector<int> io_cpus;
 #ifdef PART_IO
 	// For part_global_cached_io
@@ -127,6 +206,10 @@ void init_io_system(config_map::ptr configs, bool with_cache)
 		throw init_error("config map doesn't contain any options");
 	
 	params.init(configs->get_options());
+	// The slab allocators created from now on get their memory from
+	// the huge page arenas.
+	if (params.is_huge_page_enabled())
+		huge_page_arena::enable(params.get_huge_page_size());
 
 	// The I/O system has been initialized.
 	if (is_safs_init()) {
@@ -134,8 +217,9 @@ void init_io_system(config_map::ptr configs, bool with_cache)
 		return;
 	}
 
-	// If we don't have libaio, we disable the initialization of SAFS.
-#ifdef USE_LIBAIO
+	// If we don't have libaio or io_uring, we disable the initialization
+	// of SAFS.
+#if defined(USE_LIBAIO) || defined(USE_IO_URING)
 	if (!configs->has_option("root_conf"))
 		throw init_error("RAID config file doesn't exist");
 	std::string root_conf_file = configs->get_option("root_conf");
@@ -235,20 +319,53 @@ void init_io_system(config_map::ptr configs, bool with_cache)
 #if 0
 		debug.register_task(new debug_global_data());
 #endif
+		if (!params.get_io_stats_dump_file().empty())
+			global_data.stats_dumper = io_stats_dumper::ptr(new io_stats_dumper(
+						params.get_io_stats_dump_file(),
+						params.get_io_stats_dump_interval()));
+		// The blocks are copied to the fast tier in the background, so
+		// the data can't be modified.
+		if (raid_conf->has_fast_disks() && !params.is_writable()
+				&& params.get_tier_migrate_interval() > 0)
+			global_data.migrator = tier_migrator::ptr(new tier_migrator(
+						params.get_tier_migrate_interval()));
 	}
 
 	if (global_data.global_cache == NULL && with_cache
 			&& params.get_cache_size() > 0) {
+		// The shared cache has to be ready before the page cache is used.
+		if (params.get_shared_cache_size() > 0) {
+			global_data.shared_cache = shared_page_cache::create(
+					params.get_shared_cache_name(),
+					params.get_shared_cache_size());
+			if (global_data.shared_cache)
+				BOOST_LOG_TRIVIAL(info) << boost::format(
+						"attach to the shared cache %1% with %2% processes")
+					% params.get_shared_cache_name()
+					% global_data.shared_cache->get_num_procs();
+			shared_page_cache::set_global(global_data.shared_cache.get());
+		}
+
 		std::vector<int> node_id_array;
 		for (int i = 0; i < params.get_num_nodes(); i++)
 			node_id_array.push_back(i);
 
-		global_data.cache_conf = cache_config::ptr(new even_cache_config(
+		int max_num_pending_flush = MAX_NUM_FLUSHES_PER_FILE
+			* global_data.raid_conf->get_num_disks();
+		if (!params.get_cache_partitions().empty()) {
+			global_data.cache_parts = partitioned_cache::create(
 					params.get_cache_size(), params.get_cache_type(),
-					node_id_array));
-		global_data.global_cache = global_data.cache_conf->create_cache(
-				MAX_NUM_FLUSHES_PER_FILE *
-				global_data.raid_conf->get_num_disks());
+					node_id_array, params.get_cache_partitions(),
+					max_num_pending_flush);
+			global_data.global_cache = global_data.cache_parts;
+		}
+		else {
+			global_data.cache_conf = cache_config::ptr(new even_cache_config(
+						params.get_cache_size(), params.get_cache_type(),
+						node_id_array));
+			global_data.global_cache = global_data.cache_conf->create_cache(
+					max_num_pending_flush);
+		}
 
 		// The remote IO will never be used. It's only used for creating
 		// more remote IOs for flushing dirty pages, so it doesn't matter
@@ -261,6 +378,16 @@ void init_io_system(config_map::ptr configs, bool with_cache)
 		global_data.global_cache->init(underlying);
 #endif
 	}
+	if (global_data.global_cache && global_data.snapshot == NULL
+			&& !params.get_cache_snapshot().empty()
+			&& native_file(params.get_cache_snapshot()).exist()) {
+		global_data.snapshot = cache_snapshot::load(params.get_cache_snapshot());
+		if (global_data.snapshot)
+			BOOST_LOG_TRIVIAL(info) << boost::format(
+					"load the cache snapshot of %1% pages in %2% files")
+				% global_data.snapshot->get_num_pages()
+				% global_data.snapshot->get_num_files();
+	}
 #ifdef PART_IO
 	if (global_data.table == NULL && with_cache) {
 		if (params.get_num_nodes() > 1)
@@ -271,7 +398,7 @@ void init_io_system(config_map::ptr configs, bool with_cache)
 #endif
 	pthread_mutex_unlock(&global_data.mutex);
 #else
-	throw init_error("There isn't libaio. SAFS isn't initialized.");
+	throw init_error("There isn't libaio or io_uring. SAFS isn't initialized.");
 #endif
 }
 
@@ -286,6 +413,17 @@ void destroy_io_system()
 	}
 
 	BOOST_LOG_TRIVIAL(info) << "I/O system is destroyed";
+	wait4cache_warm_up();
+	if (global_data.global_cache && !params.get_cache_snapshot().empty())
+		save_cache_snapshot(params.get_cache_snapshot());
+	global_data.snapshot.reset();
+	global_data.warmed_files.clear();
+	global_data.warming_files.clear();
+	if (global_data.shared_cache) {
+		global_data.shared_cache->print_stat();
+		shared_page_cache::set_global(NULL);
+		global_data.shared_cache.reset();
+	}
 	global_data.raid_conf.reset();
 	if (global_data.global_cache)
 		global_data.global_cache->sanity_check();
@@ -296,6 +434,12 @@ void destroy_io_system()
 		global_data.table = NULL;
 	}
 #endif
+	global_data.migrator.reset();
+	if (global_data.stats_dumper) {
+		global_data.stats_dumper.reset();
+		// Dump the statistics of the entire run.
+		dump_io_stats(params.get_io_stats_dump_file());
+	}
 	size_t num_reads = 0;
 	size_t num_writes = 0;
 	size_t num_read_bytes = 0;
@@ -314,6 +458,17 @@ void destroy_io_system()
 	BOOST_LOG_TRIVIAL(info)
 		<< boost::format("I/O threads get %1% reads (%2% bytes) and %3% writes (%4% bytes)")
 		% num_reads % num_read_bytes % num_writes % num_write_bytes;
+	if (huge_page_arena::is_enabled()) {
+		huge_page_arena::stat stat = huge_page_arena::get_tot_stat();
+		BOOST_LOG_TRIVIAL(info) << boost::format(
+				"huge page arenas map %1% bytes in 1G pages, %2% bytes in 2M pages and %3% bytes in normal pages (%4% and %5% failures), %6% bytes are used")
+			% stat.mapped_bytes[huge_page_arena::PAGE_1G]
+			% stat.mapped_bytes[huge_page_arena::PAGE_2M]
+			% stat.mapped_bytes[huge_page_arena::PAGE_NORMAL]
+			% stat.num_failures[huge_page_arena::PAGE_1G]
+			% stat.num_failures[huge_page_arena::PAGE_2M] % stat.used_bytes;
+		huge_page_arena::disable();
+	}
 
 #ifdef ENABLE_MEM_TRACE
 	BOOST_LOG_TRIVIAL(info) << boost::format("memleak: %1% objects and %2% bytes")
@@ -422,21 +577,37 @@ class global_cached_io_factory: public file_io_factory
 	std::atomic_ulong tot_pg_accesses;
 	std::atomic_ulong tot_hits;
 	std::atomic_ulong tot_fast_process;
+	std::atomic_ulong tot_bypass_reads;
+	std::atomic_ulong tot_prefetched_pages;
+	std::atomic_ulong tot_useful_prefetches;
+	std::atomic_ulong tot_evicted_prefetches;
 
 	page_cache::ptr global_cache;
 	remote_io_factory::shared_ptr remote_factory;
+	// The nodes whose flushers have got an I/O instance of the file.
+	pthread_mutex_t flusher_mutex;
+	std::unordered_set<int> flusher_nodes;
 public:
 	global_cached_io_factory(file_mapper::ptr mapper,
 			page_cache::ptr cache): file_io_factory(mapper->get_name()) {
 		this->global_cache = cache;
+		pthread_mutex_init(&flusher_mutex, NULL);
 		tot_bytes = 0;
 		tot_accesses = 0;
 		tot_pg_accesses = 0;
 		tot_hits = 0;
 		tot_fast_process = 0;
+		tot_bypass_reads = 0;
+		tot_prefetched_pages = 0;
+		tot_useful_prefetches = 0;
+		tot_evicted_prefetches = 0;
 		remote_factory = remote_io_factory::shared_ptr(new remote_io_factory(mapper));
 	}
 
+	~global_cached_io_factory() {
+		pthread_mutex_destroy(&flusher_mutex);
+	}
+
 	virtual io_interface::ptr create_io(thread *t);
 
 	virtual void destroy_io(io_interface &io);
@@ -447,12 +618,16 @@ public:
 
 	virtual void collect_stat(io_interface &io) {
 		global_cached_io &gio = (global_cached_io &) io;
+		tot_prefetched_pages += gio.get_num_prefetched_pages();
+		tot_useful_prefetches += gio.get_num_useful_prefetches();
+		tot_evicted_prefetches += gio.get_num_evicted_prefetches();
 
 		tot_bytes += gio.get_num_bytes();
 		tot_accesses += gio.get_num_areqs();
 		tot_pg_accesses += gio.get_num_pg_accesses();
 		tot_hits += gio.get_cache_hits();
 		tot_fast_process += gio.get_num_fast_process();
+		tot_bypass_reads += gio.get_num_bypass_reads();
 	}
 
 	virtual void print_statistics() const {
@@ -462,6 +637,17 @@ public:
 		BOOST_LOG_TRIVIAL(info)
 			<< boost::format("There are %1% pages accessed, %2% cache hits, %3% of them are in the fast process")
 			% tot_pg_accesses.load() % tot_hits.load() % tot_fast_process.load();
+		if (tot_bypass_reads.load() > 0)
+			BOOST_LOG_TRIVIAL(info)
+				<< boost::format("%1% reads skip the page cache")
+				% tot_bypass_reads.load();
+		if (tot_prefetched_pages.load() > 0)
+			BOOST_LOG_TRIVIAL(info)
+				<< boost::format("%1% pages are read ahead, %2% of them are used and %3% are evicted unused, prefetch accuracy: %4%")
+				% tot_prefetched_pages.load() % tot_useful_prefetches.load()
+				% tot_evicted_prefetches.load()
+				% (((double) tot_useful_prefetches.load())
+						/ tot_prefetched_pages.load());
 	}
 };
 
@@ -633,6 +819,27 @@ io_interface::ptr global_cached_io_factory::create_io(thread *t)
 		scheduler = get_sched_creator()->create(underlying->get_node_id());
 	global_cached_io *io = new global_cached_io(t, underlying,
 			global_cache, scheduler);
+	// The flusher writes back the dirty pages of the file with the I/O
+	// instances cloned from the underlying I/O, so it only needs one of
+	// them. The flusher of a cache is only created with an I/O instance
+	// on the same node, so we still register one for each node.
+	// Other threads wait until it's registered, so none of them can dirty
+	// pages of the file before the flusher can write them back.
+	if (params.is_use_flusher()) {
+		pthread_mutex_lock(&flusher_mutex);
+		if (flusher_nodes.insert(underlying->get_node_id()).second)
+			global_cache->init(underlying);
+		pthread_mutex_unlock(&flusher_mutex);
+	}
+	if (params.get_max_prefetch_size() > 0) {
+		// The data files of a SAFS file may be larger than the file.
+		const safs_header &header = io->get_header();
+		ssize_t file_size = header.is_valid() && header.get_size() > 0
+			? header.get_size() : get_file_size();
+		io->enable_prefetch(file_size, params.get_max_prefetch_size());
+	}
+	if (!params.get_io_trace_dir().empty())
+		io->enable_trace(io_tracer::get(get_name()));
 	return io_interface::ptr(io);
 }
 
@@ -683,6 +890,135 @@ public:
 	}
 };
 
+/*
+ * This warms up the page cache with the pages of a file in the snapshot.
+ * It runs in the background, so opening a file doesn't wait for
+ * the warm-up, and files opened together are warmed up in parallel.
+ */
+class cache_warmup_thread: public thread
+{
+	file_io_factory::shared_ptr factory;
+	const std::vector<page_run> &runs;
+public:
+	cache_warmup_thread(file_io_factory::shared_ptr factory,
+			const std::vector<page_run> &_runs, int node_id): thread(
+				"cache_warmup", node_id, false), runs(_runs) {
+		this->factory = factory;
+	}
+
+	void run();
+};
+
+void cache_warmup_thread::run()
+{
+	struct timeval start, end;
+	gettimeofday(&start, NULL);
+	ssize_t num_pages = warm_up_cache(factory, runs,
+			params.get_cache_size() / PAGE_SIZE);
+	gettimeofday(&end, NULL);
+
+	pthread_mutex_lock(&global_data.mutex);
+	global_data.warming_files.erase(factory->get_name());
+	// If the warm-up fails, we try again when the file is opened next time.
+	if (num_pages >= 0)
+		global_data.warmed_files.insert(factory->get_name());
+	pthread_mutex_unlock(&global_data.mutex);
+	if (num_pages >= 0)
+		BOOST_LOG_TRIVIAL(info) << boost::format(
+				"warm up the page cache with %1% pages of %2% in %3% seconds")
+			% num_pages % factory->get_name() % time_diff(start, end);
+	else
+		BOOST_LOG_TRIVIAL(error) << boost::format(
+				"can't warm up the page cache with %1%") % factory->get_name();
+	stop();
+}
+
+/*
+ * Remember the name of a file accessed through the page cache, so we can
+ * save its pages in the snapshot. If the file is in the snapshot loaded
+ * at the initialization, we warm up the page cache with its pages.
+ */
+static void register_cached_file(file_io_factory::shared_ptr factory)
+{
+	const std::string &name = factory->get_name();
+	pthread_mutex_lock(&global_data.mutex);
+	global_data.cached_files[factory->get_file_id()] = name;
+	if (global_data.shared_cache)
+		global_data.shared_cache->add_file(factory->get_file_id(),
+				*global_data.raid_conf, name);
+	const std::vector<page_run> *runs = NULL;
+	if (global_data.snapshot && global_data.warmed_files.count(name) == 0
+			&& global_data.warming_files.count(name) == 0)
+		runs = global_data.snapshot->get_runs(name);
+	if (runs) {
+		global_data.warming_files.insert(name);
+		// The warm-up runs on the same node as the thread that opens
+		// the file.
+		thread *curr = thread::get_curr_thread();
+		int node_id = curr && curr->get_node_id() >= 0 ? curr->get_node_id() : 0;
+		std::shared_ptr<thread> t(new cache_warmup_thread(factory, *runs,
+					node_id));
+		global_data.warmup_threads.push_back(t);
+		t->start();
+	}
+	pthread_mutex_unlock(&global_data.mutex);
+}
+
+void wait4cache_warm_up()
+{
+	std::vector<std::shared_ptr<thread> > threads;
+	pthread_mutex_lock(&global_data.mutex);
+	threads.swap(global_data.warmup_threads);
+	pthread_mutex_unlock(&global_data.mutex);
+	// The warm-up threads need the lock when they finish.
+	for (size_t i = 0; i < threads.size(); i++)
+		threads[i]->join();
+}
+
+bool save_cache_snapshot(const std::string &file)
+{
+	if (global_data.global_cache == NULL)
+		return false;
+
+	std::vector<page_id_t> pages;
+	global_data.global_cache->get_resident_pages(pages);
+	std::unordered_map<int, std::vector<off_t> > file_pages;
+	for (size_t i = 0; i < pages.size(); i++)
+		file_pages[pages[i].get_file_id()].push_back(pages[i].get_offset());
+
+	cache_snapshot::ptr snapshot = cache_snapshot::create();
+	pthread_mutex_lock(&global_data.mutex);
+	for (auto it = file_pages.begin(); it != file_pages.end(); it++) {
+		auto name_it = global_data.cached_files.find(it->first);
+		// The pages may belong to files that aren't accessed with
+		// the global cache IO. We don't know their names.
+		if (name_it != global_data.cached_files.end())
+			snapshot->add_pages(name_it->second, it->second);
+	}
+	// The files in the old snapshot that aren't opened in this run keep
+	// their pages, so they can still be warmed up next time.
+	if (global_data.snapshot) {
+		std::unordered_set<std::string> opened_files;
+		for (auto it = global_data.cached_files.begin();
+				it != global_data.cached_files.end(); it++)
+			opened_files.insert(it->second);
+		std::vector<std::string> names;
+		global_data.snapshot->get_file_names(names);
+		for (size_t i = 0; i < names.size(); i++) {
+			if (opened_files.count(names[i]) == 0)
+				snapshot->add_runs(names[i],
+						*global_data.snapshot->get_runs(names[i]));
+		}
+	}
+	pthread_mutex_unlock(&global_data.mutex);
+	bool ret = snapshot->save(file);
+	if (ret)
+		BOOST_LOG_TRIVIAL(info) << boost::format(
+				"save the cache snapshot of %1% pages in %2% files to %3%")
+			% snapshot->get_num_pages() % snapshot->get_num_files() % file;
+	return ret;
+}
+
 file_io_factory::shared_ptr create_io_factory(const std::string &file_name,
 		const int access_option)
 {
@@ -717,7 +1053,13 @@ file_io_factory::shared_ptr create_io_factory(const std::string &file_name,
 			factory = new remote_io_factory(mapper);
 			break;
 		case GLOBAL_CACHE_ACCESS:
-			if (global_data.global_cache)
+			// A file accesses its own partition of the page cache
+			// if the page cache is partitioned.
+			if (global_data.cache_parts)
+				factory = new global_cached_io_factory(mapper,
+						global_data.cache_parts->get_file_cache(
+							mapper->get_file_id(), file_name));
+			else if (global_data.global_cache)
 				factory = new global_cached_io_factory(mapper,
 						global_data.global_cache);
 			else
@@ -738,7 +1080,10 @@ file_io_factory::shared_ptr create_io_factory(const std::string &file_name,
 		default:
 			throw io_exception("a wrong access option");
 	}
-	return file_io_factory::shared_ptr(factory, destroy_io_factory());
+	file_io_factory::shared_ptr ret(factory, destroy_io_factory());
+	if (access_option == GLOBAL_CACHE_ACCESS)
+		register_cached_file(ret);
+	return ret;
 }
 
 io_interface::ptr create_io(file_io_factory::shared_ptr factory, thread *t)
@@ -777,6 +1122,39 @@ void print_io_summary()
 			num_read_bytes, num_reads, num_write_bytes, num_writes);
 }
 
+void get_io_stats(io_stats &stats)
+{
+	BOOST_FOREACH(disk_io_thread::ptr t, global_data.read_thread_set) {
+		if (t)
+			t->get_io_stats(stats);
+	}
+	if (global_data.cache_parts)
+		global_data.cache_parts->get_part_stats(stats.cache_parts);
+}
+
+bool dump_io_stats(const std::string &file)
+{
+	io_stats stats;
+	get_io_stats(stats);
+	// We write the statistics to a temporary file first, so the readers
+	// of the file never see a partially written file.
+	std::string tmp_file = file + ".tmp";
+	FILE *f = fopen(tmp_file.c_str(), "w");
+	if (f == NULL) {
+		BOOST_LOG_TRIVIAL(error) << boost::format("can't open %1%: %2%")
+			% tmp_file % strerror(errno);
+		return false;
+	}
+	stats.print_json(f);
+	fclose(f);
+	if (rename(tmp_file.c_str(), file.c_str()) < 0) {
+		BOOST_LOG_TRIVIAL(error) << boost::format("can't rename %1% to %2%: %3%")
+			% tmp_file % file % strerror(errno);
+		return false;
+	}
+	return true;
+}
+
 ssize_t file_io_factory::get_file_size() const
 {
 	safs_file f(*global_data.raid_conf, name);
@@ -892,6 +1270,12 @@ std::string get_supported_features()
 #else
 	ret += "-libaio ";
 #endif
+
+#ifdef USE_IO_URING
+	ret += "+io_uring ";
+#else
+	ret += "-io_uring ";
+#endif
 	return ret;
 }
 
@@ -33,6 +33,7 @@
 #include "io_request.h"
 #include "comm_exception.h"
 #include "safs_header.h"
+#include "io_stats.h"
 
 namespace safs
 {
@@ -566,6 +567,26 @@ void print_io_thread_stat();
  */
 void print_io_summary();
 
+/**
+ * This function gets the latency histograms and the queue depth of disks
+ * collected by the I/O threads. The statistics are only collected when SAFS
+ * is initialized with the `io_stats' option. It also gets the hits and
+ * misses of the partitions of the page cache if the page cache is
+ * partitioned with the `cache_partitions' option.
+ * \param stats the statistics of the I/O threads, the disks, the files and
+ * the cache partitions.
+ */
+void get_io_stats(io_stats &stats);
+
+/**
+ * This function writes the I/O statistics to a file in JSON. When SAFS
+ * is initialized with the `io_stats_dump_file' option, the statistics are
+ * dumped to the file periodically.
+ * \param file the file where the statistics are written to.
+ * \return true if the statistics are written successfully.
+ */
+bool dump_io_stats(const std::string &file);
+
 /**
  * The users can set the weight of a file. The file weight is used by
  * the page cache. The file with a higher weight can have its data in
@@ -577,6 +598,23 @@ void print_io_summary();
  */
 void set_file_weight(const std::string &file_name, int weight);
 
+/**
+ * This function saves the offsets of the pages in the page cache to
+ * a manifest file. When SAFS starts with the `cache_snapshot' option
+ * pointing to the manifest file, it warms up the page cache with the same
+ * pages when the files are opened. If the option is set, SAFS saves
+ * the manifest file automatically when it is destroyed.
+ * \param file the manifest file.
+ * \return true if the manifest file is saved successfully.
+ */
+bool save_cache_snapshot(const std::string &file);
+
+/**
+ * The page cache is warmed up with the snapshot in the background when
+ * files are opened. This function waits until all of the warm-ups finish.
+ */
+void wait4cache_warm_up();
+
 /**
  * This gets the string that indicates the features compiled into SAFS.
  */
@@ -145,6 +145,7 @@ int user_compute::fetch_requests(io_interface *io, user_comp_req_queue &reqs,
 		compute->inc_ref();
 		io_request req(compute, range.get_loc(), range.get_size(),
 				range.get_access_method(), io, io->get_node_id());
+		req.set_prio_class(range.get_prio_class());
 		reqs.push_back(req);
 		num_issues++;
 	}
@@ -161,6 +162,7 @@ bool user_compute::fetch_request(io_interface *io, io_request &req)
 	compute->inc_ref();
 	req = io_request(compute, range.get_loc(), range.get_size(),
 			range.get_access_method(), io, io->get_node_id());
+	req.set_prio_class(range.get_prio_class());
 	return true;
 }
 
@@ -27,6 +27,7 @@
 
 #include <algorithm>
 #include <queue>
+#include <vector>
 
 #include "common.h"
 #include "concurrency.h"
@@ -92,6 +93,8 @@ class io_request;
 class io_req_extension
 {
 	void *priv;
+	// The original requests if an I/O thread merges them into this request.
+	std::vector<io_request> *merged_reqs;
 
 	int num_bufs: 16;
 	int vec_capacity: 15;
@@ -121,6 +124,7 @@ public:
 
 	void init() {
 		this->priv = NULL;
+		this->merged_reqs = NULL;
 		this->num_bufs = 0;
 		memset(vec_pointer, 0, vec_capacity * sizeof(io_buf));
 		memset(&issue_time, 0, sizeof(issue_time));
@@ -128,6 +132,7 @@ public:
 
 	void init(const io_req_extension &ext) {
 		this->priv = ext.priv;
+		this->merged_reqs = ext.merged_reqs;
 		this->num_bufs = ext.num_bufs;
 		assert(this->vec_capacity >= ext.vec_capacity);
 		memcpy(vec_pointer, ext.vec_pointer, num_bufs * sizeof(*vec_pointer));
@@ -142,6 +147,14 @@ public:
 		this->priv = priv;
 	}
 
+	std::vector<io_request> *get_merged_reqs() const {
+		return merged_reqs;
+	}
+
+	void set_merged_reqs(std::vector<io_request> *reqs) {
+		this->merged_reqs = reqs;
+	}
+
 	void set_timestamp() {
 		gettimeofday(&issue_time, NULL);
 	}
@@ -223,6 +236,29 @@ public:
 
 const data_loc_t INVALID_DATA_LOC;
 
+/**
+ * The priority classes of I/O requests. An I/O thread shares the disk
+ * bandwidth among the classes by their weights, so the requests in
+ * a class with a larger weight wait for a shorter time.
+ */
+enum io_prio_class
+{
+	/**
+	 * Latency-sensitive requests, e.g., point queries.
+	 */
+	IO_PRIO_LATENCY,
+	/**
+	 * The default class.
+	 */
+	IO_PRIO_NORMAL,
+	/**
+	 * Bulk requests that care about throughput, e.g., streaming reads
+	 * of a large matrix.
+	 */
+	IO_PRIO_BULK,
+	NUM_IO_PRIO_CLASSES,
+};
+
 class user_compute;
 
 /**
@@ -234,11 +270,13 @@ class request_range
 	data_loc_t loc;
 	unsigned long size: 63;
 	unsigned long access_method: 1;
+	io_prio_class prio_class;
 	user_compute *compute;
 public:
 	request_range() {
 		size = 0;
 		access_method = 0;
+		prio_class = IO_PRIO_NORMAL;
 		compute = NULL;
 	}
 
@@ -248,12 +286,14 @@ public:
 	 * \param size the data size of the request.
 	 * \param access_method indicates whether to read or write.
 	 * \param compute the user task associated with the I/O request.
+	 * \param prio_class the priority class of the I/O request.
 	 */
 	request_range(const data_loc_t &loc, size_t size, int access_method,
-			user_compute *compute) {
+			user_compute *compute, io_prio_class prio_class = IO_PRIO_NORMAL) {
 		this->loc = loc;
 		this->size = size;
 		this->access_method = access_method & 0x1;
+		this->prio_class = prio_class;
 		this->compute = compute;
 	}
 
@@ -281,6 +321,14 @@ public:
 		return access_method & 0x1;
 	}
 
+	/**
+	 * This method gets the priority class of the I/O request.
+	 * \return the priority class.
+	 */
+	io_prio_class get_prio_class() const {
+		return prio_class;
+	}
+
 	/**
 	 * This method gets the user task associated with the I/O request.
 	 * \return the user task.
@@ -330,6 +378,7 @@ public:
 	 */
 	user_compute(compute_allocator *alloc) {
 		this->alloc = alloc;
+		num_refs = 0;
 	}
 
 	/**
@@ -493,6 +542,9 @@ class io_request
 {
 	static const off_t MAX_FILE_SIZE = LONG_MAX;
 	static const int MAX_NODE_ID = (1 << 8) - 1;
+	// A deadline is kept in the unit of 100us.
+	static const int DEADLINE_UNIT = 100;
+	static const int MAX_DEADLINE = (1 << 12) - 1;
 
 	size_t buf_size;
 	off_t offset;
@@ -515,6 +567,12 @@ class io_request
 	unsigned int low_latency: 1;
 	unsigned int discarded: 1;
 	unsigned int node_id: 8;
+	unsigned int prio_class: 2;
+	unsigned int deadline: 12;
+	// The read is counted by the file mapper in the epoch until it
+	// completes. See file_mapper::begin_read().
+	unsigned int tier_tracked: 1;
+	unsigned int tier_epoch: 1;
 	int file_id;
 
 	io_interface *io;
@@ -544,12 +602,20 @@ class io_request
 		high_prio = 1;
 		low_latency = 0;
 		discarded = 0;
+		prio_class = IO_PRIO_NORMAL;
+		deadline = 0;
+		tier_tracked = 0;
+		tier_epoch = 0;
 	}
 
 	void copy_flags(const io_request &req) {
 		this->sync = req.sync;
 		this->high_prio = req.high_prio;
 		this->low_latency = req.low_latency;
+		this->prio_class = req.prio_class;
+		this->deadline = req.deadline;
+		this->tier_tracked = req.tier_tracked;
+		this->tier_epoch = req.tier_epoch;
 	}
 
 	void set_int_buf_size(size_t size) {
@@ -676,6 +742,10 @@ public:
 		offset = 0;
 		high_prio = 0;
 		sync = 0;
+		prio_class = IO_PRIO_NORMAL;
+		deadline = 0;
+		tier_tracked = 0;
+		tier_epoch = 0;
 		node_id = MAX_NODE_ID;
 		io = NULL;
 		access_method = 0;
@@ -775,6 +845,48 @@ public:
 		this->low_latency = low_latency;
 	}
 
+	io_prio_class get_prio_class() const {
+		return (io_prio_class) prio_class;
+	}
+
+	void set_prio_class(io_prio_class prio_class) {
+		assert(prio_class < NUM_IO_PRIO_CLASSES);
+		this->prio_class = prio_class;
+	}
+
+	/*
+	 * The deadline is the time (in us) that the request can wait in
+	 * an I/O thread before it's issued to the disk. It's 0 if the request
+	 * doesn't have a deadline. The deadline is rounded up to 100us and
+	 * can't be longer than 0.4 seconds.
+	 */
+	long get_deadline() const {
+		return ((long) deadline) * DEADLINE_UNIT;
+	}
+
+	void set_deadline(long deadline_us) {
+		assert(deadline_us >= 0);
+		long deadline = (deadline_us + DEADLINE_UNIT - 1) / DEADLINE_UNIT;
+		this->deadline = std::min(deadline, (long) MAX_DEADLINE);
+	}
+
+	bool is_tier_tracked() const {
+		return tier_tracked;
+	}
+
+	int get_tier_epoch() const {
+		return tier_epoch;
+	}
+
+	/*
+	 * The read has been counted by the file mapper in `epoch'.
+	 * A negative epoch means it isn't counted.
+	 */
+	void set_tier_epoch(int epoch) {
+		tier_tracked = epoch >= 0;
+		tier_epoch = epoch > 0;
+	}
+
 	/*
 	 * The requested data is inside a page on the disk.
 	 */
@@ -827,6 +939,17 @@ public:
 		return get_extension()->get_priv();
 	}
 
+	/**
+	 * This method gets the original requests if an I/O thread merges
+	 * them into this request.
+	 * \return the original requests or NULL if the request isn't merged.
+	 */
+	std::vector<io_request> *get_merged_reqs() const {
+		if (!is_extended_req())
+			return NULL;
+		return get_extension()->get_merged_reqs();
+	}
+
 	void set_priv(void *priv) {
 		get_extension()->set_priv(priv);
 	}
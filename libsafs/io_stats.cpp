@@ -0,0 +1,230 @@
+/*
+ * Copyright 2014 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of SAFSlib.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <assert.h>
+
+#include <algorithm>
+
+#include "io_stats.h"
+
+namespace safs
+{
+
+int log_histogram::get_idx(uint64_t val)
+{
+	const uint64_t max_val = (1UL << MAX_BITS) - 1;
+	if (val > max_val)
+		val = max_val;
+	if (val < (uint64_t) NUM_SUB_BUCKETS)
+		return val;
+	int msb = 63 - __builtin_clzl(val);
+	int shift = msb - SUB_BUCKET_BITS;
+	return (shift + 1) * NUM_SUB_BUCKETS + (int) ((val >> shift)
+			- NUM_SUB_BUCKETS);
+}
+
+uint64_t log_histogram::get_value(int idx)
+{
+	if (idx < NUM_SUB_BUCKETS)
+		return idx;
+	int shift = idx / NUM_SUB_BUCKETS - 1;
+	uint64_t low = ((uint64_t) (NUM_SUB_BUCKETS + idx % NUM_SUB_BUCKETS))
+		<< shift;
+	return low + (1UL << shift) - 1;
+}
+
+void log_histogram::reset()
+{
+	std::fill(counts.begin(), counts.end(), 0);
+	tot_count = 0;
+	min_val = UINT64_MAX;
+	max_val = 0;
+	sum = 0;
+}
+
+void log_histogram::merge(const log_histogram &hist)
+{
+	for (size_t i = 0; i < counts.size(); i++)
+		counts[i] += hist.counts[i];
+	tot_count += hist.tot_count;
+	sum += hist.sum;
+	min_val = std::min(min_val, hist.min_val);
+	max_val = std::max(max_val, hist.max_val);
+}
+
+uint64_t log_histogram::get_percentile(double percent) const
+{
+	if (tot_count == 0)
+		return 0;
+	percent = std::min(std::max(percent, 0.0), 100.0);
+	uint64_t target = (uint64_t) (percent / 100 * tot_count + 0.5);
+	if (target == 0)
+		target = 1;
+	uint64_t count = 0;
+	for (size_t i = 0; i < counts.size(); i++) {
+		count += counts[i];
+		if (count >= target)
+			return std::max(std::min(get_value(i), max_val), min_val);
+	}
+	return max_val;
+}
+
+static void print_hist_json(FILE *f, const char *name,
+		const log_histogram &hist, double scale)
+{
+	fprintf(f, "\"%s\": {\"count\": %lu, \"min\": %.3f, \"mean\": %.3f, "
+			"\"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f, \"p99.9\": %.3f, "
+			"\"max\": %.3f}", name, hist.get_count(), hist.get_min() / scale,
+			hist.get_mean() / scale, hist.get_percentile(50) / scale,
+			hist.get_percentile(90) / scale, hist.get_percentile(99) / scale,
+			hist.get_percentile(99.9) / scale, hist.get_max() / scale);
+}
+
+void io_stats::print_json(FILE *f) const
+{
+	fprintf(f, "{\n\"threads\": [");
+	for (size_t i = 0; i < threads.size(); i++) {
+		fprintf(f, "%s\n  {\"name\": \"%s\", \"node\": %d, ", i ? "," : "",
+				threads[i].name.c_str(), threads[i].node_id);
+		print_hist_json(f, "latency_us", threads[i].latency, 1000);
+		fprintf(f, ", ");
+		print_hist_json(f, "queue_wait_us", threads[i].queue_wait, 1000);
+		fprintf(f, "}");
+	}
+	fprintf(f, "\n],\n\"disks\": [");
+	for (size_t i = 0; i < disks.size(); i++) {
+		fprintf(f, "%s\n  {\"disk\": %d, ", i ? "," : "", disks[i].disk_id);
+		print_hist_json(f, "latency_us", disks[i].latency, 1000);
+		fprintf(f, ", ");
+		// The count of the depth histogram is the time in ns.
+		print_hist_json(f, "depth", disks[i].depth, 1);
+		fprintf(f, "}");
+	}
+	fprintf(f, "\n],\n\"files\": [");
+	for (size_t i = 0; i < files.size(); i++) {
+		fprintf(f, "%s\n  {\"file\": \"%s\", \"id\": %d, ", i ? "," : "",
+				files[i].name.c_str(), files[i].file_id);
+		print_hist_json(f, "latency_us", files[i].latency, 1000);
+		fprintf(f, ", ");
+		print_hist_json(f, "queue_wait_us", files[i].queue_wait, 1000);
+		fprintf(f, "}");
+	}
+	fprintf(f, "\n],\n\"cache_parts\": [");
+	for (size_t i = 0; i < cache_parts.size(); i++) {
+		const cache_part_stat &part = cache_parts[i];
+		fprintf(f, "%s\n  {\"name\": \"%s\", \"size\": %ld, "
+				"\"accesses\": %ld, \"misses\": %ld, \"hit_rate\": %.3f}",
+				i ? "," : "", part.name.c_str(), part.size, part.num_accesses,
+				part.num_misses, part.num_accesses > 0
+				? 1 - ((double) part.num_misses) / part.num_accesses : 0);
+	}
+	fprintf(f, "\n]\n}\n");
+}
+
+io_stat_collector::disk_state &io_stat_collector::get_disk(int disk_id,
+		long now)
+{
+	auto it = disks.find(disk_id);
+	if (it == disks.end()) {
+		disk_state state;
+		state.stat.disk_id = disk_id;
+		state.num_inflight = 0;
+		state.last_change = now;
+		it = disks.insert(std::pair<int, disk_state>(disk_id, state)).first;
+	}
+	return it->second;
+}
+
+file_io_stat &io_stat_collector::get_file(int file_id)
+{
+	auto it = files.find(file_id);
+	if (it == files.end()) {
+		file_io_stat stat;
+		stat.file_id = file_id;
+		it = files.insert(std::pair<int, file_io_stat>(file_id, stat)).first;
+	}
+	return it->second;
+}
+
+void io_stat_collector::register_file(int file_id, const std::string &name)
+{
+	lock.lock();
+	get_file(file_id).name = name;
+	lock.unlock();
+}
+
+void io_stat_collector::add_queue_wait(int file_id, long wait)
+{
+	lock.lock();
+	thread_stat.queue_wait.record(wait);
+	get_file(file_id).queue_wait.record(wait);
+	lock.unlock();
+}
+
+void io_stat_collector::submit(int disk_id, long now)
+{
+	lock.lock();
+	disk_state &disk = get_disk(disk_id, now);
+	disk.stat.depth.record(disk.num_inflight, now - disk.last_change);
+	disk.num_inflight++;
+	disk.last_change = now;
+	lock.unlock();
+}
+
+void io_stat_collector::complete(int disk_id, int file_id, long submit_time,
+		long now)
+{
+	long latency = now - submit_time;
+	lock.lock();
+	thread_stat.latency.record(latency);
+	get_file(file_id).latency.record(latency);
+	disk_state &disk = get_disk(disk_id, now);
+	assert(disk.num_inflight > 0);
+	disk.stat.latency.record(latency);
+	disk.stat.depth.record(disk.num_inflight, now - disk.last_change);
+	disk.num_inflight--;
+	disk.last_change = now;
+	lock.unlock();
+}
+
+void io_stat_collector::get_stats(io_stats &stats)
+{
+	lock.lock();
+	stats.threads.push_back(thread_stat);
+	for (auto it = disks.begin(); it != disks.end(); it++)
+		stats.disks.push_back(it->second.stat);
+	for (auto it = files.begin(); it != files.end(); it++) {
+		const file_io_stat &stat = it->second;
+		size_t i;
+		for (i = 0; i < stats.files.size(); i++)
+			if (stats.files[i].file_id == stat.file_id)
+				break;
+		if (i == stats.files.size())
+			stats.files.push_back(stat);
+		else {
+			if (stats.files[i].name.empty())
+				stats.files[i].name = stat.name;
+			stats.files[i].latency.merge(stat.latency);
+			stats.files[i].queue_wait.merge(stat.queue_wait);
+		}
+	}
+	lock.unlock();
+}
+
+}
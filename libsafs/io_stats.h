@@ -0,0 +1,233 @@
+#ifndef __IO_STATS_H__
+#define __IO_STATS_H__
+
+/*
+ * Copyright 2014 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of SAFSlib.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "concurrency.h"
+
+namespace safs
+{
+
+/**
+ * A histogram in the style of HdrHistogram. The range of values is split
+ * into buckets of powers of 2 and each bucket is split into 32 linear
+ * sub-buckets, so a value is recorded with a relative error of at most 1/32
+ * and the histogram has a fixed size regardless of the range of values.
+ * Values smaller than 32 are recorded exactly.
+ */
+class log_histogram
+{
+	static const int SUB_BUCKET_BITS = 5;
+	static const int NUM_SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+	// Values that need more bits are recorded as the largest value.
+	// In nanoseconds, it's a little more than an hour.
+	static const int MAX_BITS = 42;
+	static const int NUM_COUNTS
+		= (MAX_BITS - SUB_BUCKET_BITS + 1) * NUM_SUB_BUCKETS;
+
+	std::vector<uint64_t> counts;
+	uint64_t tot_count;
+	uint64_t min_val;
+	uint64_t max_val;
+	// The sum of all values weighted by their counts.
+	double sum;
+public:
+	static int get_idx(uint64_t val);
+	/*
+	 * The largest value recorded in the slot `idx'.
+	 */
+	static uint64_t get_value(int idx);
+
+	log_histogram(): counts(NUM_COUNTS) {
+		reset();
+	}
+
+	/**
+	 * Record a value `count' times. When the histogram samples a value
+	 * over time, `count' can be the length of the period that the value lasts.
+	 */
+	void record(uint64_t val, uint64_t count = 1) {
+		if (count == 0)
+			return;
+		counts[get_idx(val)] += count;
+		tot_count += count;
+		sum += ((double) val) * count;
+		if (val < min_val)
+			min_val = val;
+		if (val > max_val)
+			max_val = val;
+	}
+
+	void merge(const log_histogram &hist);
+	void reset();
+
+	uint64_t get_count() const {
+		return tot_count;
+	}
+
+	uint64_t get_min() const {
+		return tot_count == 0 ? 0 : min_val;
+	}
+
+	uint64_t get_max() const {
+		return max_val;
+	}
+
+	double get_mean() const {
+		return tot_count == 0 ? 0 : sum / tot_count;
+	}
+
+	/**
+	 * Get the value below which `percent' percent of the recorded values
+	 * fall.
+	 */
+	uint64_t get_percentile(double percent) const;
+};
+
+/**
+ * The I/O statistics of an I/O thread.
+ * Latency is the time from submitting a request to the kernel to
+ * the completion of the request. Queue wait is the time that a request
+ * waits in the sender and the queue of the I/O thread before the I/O thread
+ * fetches it. Both are in nanoseconds.
+ */
+struct thread_io_stat
+{
+	std::string name;
+	int node_id;
+	log_histogram latency;
+	log_histogram queue_wait;
+};
+
+/**
+ * The I/O statistics of a disk.
+ * Depth is the number of in-flight requests in the disk. Each depth is
+ * recorded with the number of nanoseconds that the disk stays in the depth,
+ * so its percentiles are the fraction of time that the disk runs below
+ * the depth.
+ */
+struct disk_io_stat
+{
+	int disk_id;
+	log_histogram latency;
+	log_histogram depth;
+};
+
+/**
+ * The I/O statistics of an SAFS file.
+ */
+struct file_io_stat
+{
+	int file_id;
+	std::string name;
+	log_histogram latency;
+	log_histogram queue_wait;
+};
+
+/**
+ * The statistics of a partition of the page cache.
+ * A miss is counted when a page is added to the partition.
+ */
+struct cache_part_stat
+{
+	std::string name;
+	// The size of the partition in bytes.
+	long size;
+	long num_accesses;
+	long num_misses;
+};
+
+/**
+ * The I/O statistics of all I/O threads in SAFS.
+ */
+struct io_stats
+{
+	std::vector<thread_io_stat> threads;
+	std::vector<disk_io_stat> disks;
+	std::vector<file_io_stat> files;
+	// It's empty if the page cache isn't partitioned for files.
+	std::vector<cache_part_stat> cache_parts;
+
+	/**
+	 * Write the statistics in JSON. Time is in microseconds.
+	 */
+	void print_json(FILE *f) const;
+};
+
+/**
+ * This collects the I/O statistics in an I/O thread.
+ * Only the I/O thread updates the statistics, but other threads can read
+ * them at any time, so the statistics are protected by a lock.
+ */
+class io_stat_collector
+{
+	struct disk_state
+	{
+		disk_io_stat stat;
+		int num_inflight;
+		// When the number of in-flight requests changed last time.
+		long last_change;
+	};
+
+	spin_lock lock;
+	thread_io_stat thread_stat;
+	std::unordered_map<int, disk_state> disks;
+	std::unordered_map<int, file_io_stat> files;
+
+	disk_state &get_disk(int disk_id, long now);
+	file_io_stat &get_file(int file_id);
+public:
+	io_stat_collector(const std::string &thread_name, int node_id) {
+		thread_stat.name = thread_name;
+		thread_stat.node_id = node_id;
+	}
+
+	void register_file(int file_id, const std::string &name);
+
+	/*
+	 * A request of the file has waited in the queue for `wait' ns.
+	 */
+	void add_queue_wait(int file_id, long wait);
+	/*
+	 * A request is submitted to the disk.
+	 */
+	void submit(int disk_id, long now);
+	/*
+	 * A request of the file submitted at `submit_time' completes in the disk.
+	 */
+	void complete(int disk_id, int file_id, long submit_time, long now);
+
+	/*
+	 * Add the statistics to `stats'. The statistics of a file is merged
+	 * with the statistics of the file collected by other I/O threads.
+	 */
+	void get_stats(io_stats &stats);
+};
+
+}
+
+#endif
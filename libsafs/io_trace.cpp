@@ -0,0 +1,113 @@
+/*
+ * Copyright 2014 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of SAFSlib.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include <unordered_map>
+
+#include <boost/format.hpp>
+
+#include "log.h"
+#include "io_trace.h"
+#include "parameters.h"
+#include "native_file.h"
+
+namespace safs
+{
+
+static pthread_mutex_t tracers_lock = PTHREAD_MUTEX_INITIALIZER;
+static std::unordered_map<std::string, std::weak_ptr<io_tracer> > tracers;
+
+io_tracer::ptr io_tracer::get(const std::string &file_name)
+{
+	pthread_mutex_lock(&tracers_lock);
+	auto it = tracers.find(file_name);
+	ptr tracer;
+	if (it != tracers.end())
+		tracer = it->second.lock();
+	if (tracer == NULL) {
+		std::string trace_file = params.get_io_trace_dir() + "/" + file_name
+			+ ".trace";
+		FILE *f = fopen(trace_file.c_str(), "w");
+		if (f == NULL)
+			BOOST_LOG_TRIVIAL(error) << boost::format("can't open %1%: %2%")
+				% trace_file % strerror(errno);
+		else {
+			tracer = ptr(new io_tracer(trace_file, f));
+			tracers[file_name] = tracer;
+		}
+	}
+	pthread_mutex_unlock(&tracers_lock);
+	return tracer;
+}
+
+io_tracer::io_tracer(const std::string &trace_file, FILE *f)
+{
+	this->trace_file = trace_file;
+	this->f = f;
+	num_reqs = 0;
+	pthread_mutex_init(&lock, NULL);
+}
+
+io_tracer::~io_tracer()
+{
+	fclose(f);
+	pthread_mutex_destroy(&lock);
+	BOOST_LOG_TRIVIAL(info) << boost::format("write %1% requests to %2%")
+		% num_reqs % trace_file;
+}
+
+void io_tracer::write(const workload_t *reqs, size_t num)
+{
+	pthread_mutex_lock(&lock);
+	if (fwrite(reqs, sizeof(reqs[0]), num, f) != num)
+		BOOST_LOG_TRIVIAL(error) << boost::format("can't write to %1%: %2%")
+			% trace_file % strerror(errno);
+	num_reqs += num;
+	pthread_mutex_unlock(&lock);
+}
+
+std::vector<workload_t> load_io_trace(const std::string &trace_file)
+{
+	std::vector<workload_t> reqs;
+	native_file f(trace_file);
+	if (!f.exist()) {
+		BOOST_LOG_TRIVIAL(error) << boost::format("%1% doesn't exist")
+			% trace_file;
+		return reqs;
+	}
+	FILE *fp = fopen(trace_file.c_str(), "r");
+	if (fp == NULL) {
+		BOOST_LOG_TRIVIAL(error) << boost::format("can't open %1%: %2%")
+			% trace_file % strerror(errno);
+		return reqs;
+	}
+	reqs.resize(f.get_size() / sizeof(workload_t));
+	if (fread(reqs.data(), sizeof(workload_t), reqs.size(), fp)
+			!= reqs.size()) {
+		BOOST_LOG_TRIVIAL(error) << boost::format("can't read %1%")
+			% trace_file;
+		reqs.clear();
+	}
+	fclose(fp);
+	return reqs;
+}
+
+}
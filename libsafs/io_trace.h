@@ -0,0 +1,86 @@
+#ifndef __IO_TRACE_H__
+#define __IO_TRACE_H__
+
+/*
+ * Copyright 2014 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of SAFSlib.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace safs
+{
+
+/*
+ * A request in an I/O trace. A trace is a binary file of these records
+ * in the order that the requests are issued. The workload tools in
+ * test/ read and generate traces in the same format.
+ */
+typedef struct workload_type
+{
+	off_t off;
+	int size: 31;
+	int read: 1;
+} workload_t;
+
+/*
+ * This writes the requests issued to the page cache for a SAFS file to
+ * the trace `<io_trace_dir>/<file name>.trace'. All I/O instances of
+ * the file in a process share the same tracer. Each I/O instance buffers
+ * its requests and writes them to the tracer in batches, so the order
+ * of the requests from different threads is only preserved in batches.
+ */
+class io_tracer
+{
+	std::string trace_file;
+	FILE *f;
+	pthread_mutex_t lock;
+	size_t num_reqs;
+
+	io_tracer(const std::string &trace_file, FILE *f);
+public:
+	typedef std::shared_ptr<io_tracer> ptr;
+
+	/*
+	 * Get the tracer of a SAFS file. It returns NULL if the trace can't be
+	 * created.
+	 */
+	static ptr get(const std::string &file_name);
+
+	~io_tracer();
+
+	void write(const workload_t *reqs, size_t num);
+
+	const std::string &get_trace_file() const {
+		return trace_file;
+	}
+};
+
+/*
+ * Read all requests in a trace.
+ */
+std::vector<workload_t> load_io_trace(const std::string &trace_file);
+
+}
+
+#endif
@@ -18,6 +18,7 @@
  */
 
 #include "memory_manager.h"
+#include "wpaio.h"
 
 namespace safs
 {
@@ -82,4 +83,12 @@ void memory_manager::free_pages(int npages, char **pages) {
 	slab_allocator::free(pages, npages);
 }
 
+/*
+ * The pages in the page cache are used as I/O buffers all the time,
+ * so we register them to the I/O layer together with their node.
+ */
+void memory_manager::add_alloc_buf(char *buf, long size) {
+	register_io_buf(buf, size, get_node_id());
+}
+
 }
@@ -148,6 +148,9 @@ class message
 	short num_objs;
 	// Indicate whether the data of an object can be inline in the message.
 	short accept_inline: 1;
+	// When the first object is added to the message (in ns). It's 0 if
+	// the sender doesn't timestamp messages.
+	long timestamp;
 
 	void init() {
 		alloc = NULL;
@@ -156,6 +159,7 @@ class message
 		curr_add_off = 0;
 		num_objs = 0;
 		accept_inline = 0;
+		timestamp = 0;
 	}
 
 	void destroy();
@@ -210,6 +214,14 @@ public:
 		return get_num_objs() == 0;
 	}
 
+	void set_timestamp(long timestamp) {
+		this->timestamp = timestamp;
+	}
+
+	long get_timestamp() const {
+		return timestamp;
+	}
+
 	int size() const;
 
 	bool has_next() const {
@@ -278,6 +290,7 @@ public:
 		msg.curr_add_off = this->curr_add_off;
 		msg.num_objs = this->num_objs;
 		msg.accept_inline = this->accept_inline;
+		msg.timestamp = this->timestamp;
 		// After we copy all objects to another message, the current
 		// message doesn't contain objects.
 		this->num_objs = 0;
@@ -296,6 +309,7 @@ class msg_buffer: public fifo_queue<message<T> >
 
 	slab_allocator *alloc;
 	bool accept_inline;
+	bool timestamp_msgs;
 
 	void add_msg(message<T> &msg) {
 		if (fifo_queue<message<T> >::is_full()) {
@@ -311,6 +325,17 @@ public:
 			node_id, INIT_MSG_BUF_SIZE, true) {
 		this->alloc = alloc;
 		this->accept_inline = accept_inline;
+		timestamp_msgs = false;
+	}
+
+	/*
+	 * Record in a message when its first object is added, so the receiver
+	 * knows how long the objects wait in the sender's buffer and in
+	 * the queue before they are received. The objects added to a message
+	 * later wait a little less than the timestamp indicates.
+	 */
+	void set_timestamp_msgs(bool timestamp_msgs) {
+		this->timestamp_msgs = timestamp_msgs;
 	}
 
 	int add_objs(T *objs, int num = 1) {
@@ -320,7 +345,9 @@ public:
 			add_msg(tmp);
 		}
 		while (num > 0) {
-			int ret = fifo_queue<message<T> >::back().add(objs, num);
+			message<T> &last = fifo_queue<message<T> >::back();
+			bool first = last.is_empty();
+			int ret = last.add(objs, num);
 			// The last message is full. We need to add a new message
 			// to the queue.
 			if (ret == 0) {
@@ -328,6 +355,8 @@ public:
 				add_msg(tmp);
 			}
 			else {
+				if (first && timestamp_msgs)
+					last.set_timestamp(get_curr_ns());
 				num_added += ret;
 				objs += ret;
 				num -= ret;
@@ -338,21 +367,26 @@ public:
 };
 
 template<class T>
-class msg_queue: public thread_safe_FIFO_queue<message<T> >
+class msg_queue: public MPSC_FIFO_queue<message<T> >
 {
 	// TODO I may need to make sure all messages are compatible with the flag.
 	bool accept_inline;
 public:
+	/*
+	 * If `ring_size' is larger than 0, producers add messages to
+	 * a lock-free ring and only one thread can fetch messages.
+	 */
 	msg_queue(int node_id, const std::string _name, int init_size, int max_size,
-			bool accept_inline): thread_safe_FIFO_queue<message<T> >(_name,
-				node_id, init_size, max_size) {
+			bool accept_inline, int ring_size = 0): MPSC_FIFO_queue<message<T> >(
+				_name, node_id, init_size, max_size, ring_size) {
 		this->accept_inline = accept_inline;
 	}
 
 	static msg_queue<T> *create(int node_id, const std::string name,
-			int init_size, int max_size, bool accept_inline) {
+			int init_size, int max_size, bool accept_inline,
+			int ring_size = 0) {
 		return new msg_queue<T>(node_id, name, init_size, max_size,
-				accept_inline);
+				accept_inline, ring_size);
 	}
 
 	static void destroy(msg_queue<T> *q) {
@@ -371,14 +405,14 @@ public:
 	 * It is also a heavy operation.
 	 */
 	int get_num_objs() {
-		int num = thread_safe_FIFO_queue<message<T> >::get_num_entries();
+		int num = MPSC_FIFO_queue<message<T> >::get_num_entries();
 		stack_array<message<T> > msgs(num);
-		int ret = thread_safe_FIFO_queue<message<T> >::fetch(msgs.data(), num);
+		int ret = MPSC_FIFO_queue<message<T> >::fetch(msgs.data(), num);
 		int num_objs = 0;
 		for (int i = 0; i < ret; i++) {
 			num_objs += msgs[i].get_num_objs();
 		}
-		BOOST_VERIFY(ret == thread_safe_FIFO_queue<message<T> >::add(
+		BOOST_VERIFY(ret == MPSC_FIFO_queue<message<T> >::add(
 					msgs.data(), ret));
 		return num_objs;
 	}
@@ -504,6 +538,10 @@ public:
 	msg_queue<T> *get_queue() const {
 		return queue;
 	}
+
+	void set_timestamp_msgs(bool timestamp_msgs) {
+		buf.set_timestamp_msgs(timestamp_msgs);
+	}
 };
 
 class request_sender: public simple_msg_sender<io_request>
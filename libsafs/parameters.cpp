@@ -27,6 +27,7 @@
 #include "common.h"
 #include "RAID_config.h"
 #include "cache_config.h"
+#include "wpaio.h"
 
 namespace safs
 {
@@ -37,6 +38,8 @@ str2int RAID_options[] = {
 	{"RAID0", RAID0},
 	{"RAID5", RAID5},
 	{"HASH", HASH},
+	{"WEIGHTED", WEIGHTED},
+	{"TIERED", TIERED},
 };
 
 str2int cache_types[] = {
@@ -46,6 +49,12 @@ str2int cache_types[] = {
 	{ "cuckoo", CUCKOO_CACHE },
 	{ "lru2q", LRU2Q_CACHE },
 	{ "gclock", GCLOCK_CACHE },
+	{ "arc", ARC_CACHE },
+};
+
+str2int aio_types[] = {
+	{"libaio", LIBAIO_CTX},
+	{"io_uring", IO_URING_CTX},
 };
 
 sys_parameters::sys_parameters()
@@ -70,10 +79,36 @@ sys_parameters::sys_parameters()
 	writable = true;
 	max_num_pending_ios = 1000;
 	huge_page_enabled = false;
+	huge_page_size = 2 * 1024 * 1024;
 	busy_wait = false;
+#if defined(USE_IO_URING) && !defined(USE_LIBAIO)
+	aio_type = IO_URING_CTX;
+#else
+	aio_type = LIBAIO_CTX;
+#endif
+	io_uring_sqpoll = false;
 	// The number of I/O threads will be determined based on the number of SSDs.
 	num_io_threads = 0;
 	bind_io_thread = false;
+	compressed_cache_size = 0;
+	max_prefetch_size = 0;
+	io_stats = false;
+	io_stats_dump_interval = 10;
+	flush_latency_target = 10000;
+	merge_disk_reqs = false;
+	io_merge_window = 0;
+	sched_disk_reqs = false;
+	cache_bypass_size = 0;
+	shared_cache_size = 0;
+	shared_cache_name = "safs_page_cache";
+	msg_queue_ring_size = 0;
+	max_spin_time = 0;
+	fast_tier_size = 0;
+	tier_migrate_interval = 1000;
+	map_in_mem_data = false;
+	io_class_weights.push_back(16);
+	io_class_weights.push_back(4);
+	io_class_weights.push_back(1);
 }
 
 void sys_parameters::init(const std::map<std::string, std::string> &configs)
@@ -82,6 +117,8 @@ void sys_parameters::init(const std::map<std::string, std::string> &configs)
 			sizeof(cache_types) / sizeof(cache_types[0]));
 	str2int_map RAID_option_map(RAID_options,
 			sizeof(RAID_options) / sizeof(RAID_options[0]));
+	str2int_map aio_type_map(aio_types,
+			sizeof(aio_types) / sizeof(aio_types[0]));
 	std::map<std::string, std::string>::const_iterator it;
 
 	it = configs.find("RAID_block_size");
@@ -171,7 +208,8 @@ void sys_parameters::init(const std::map<std::string, std::string> &configs)
 
 	it = configs.find("writable");
 	if (it != configs.end()) {
-		writable = true;
+		// SAFS is read-only with "writable=0".
+		writable = it->second != "0";
 	}
 
 	it = configs.find("max_num_pending_ios");
@@ -184,6 +222,14 @@ void sys_parameters::init(const std::map<std::string, std::string> &configs)
 		huge_page_enabled = true;
 	}
 
+	it = configs.find("huge_page_size");
+	if (it != configs.end()) {
+		huge_page_size = str2size(it->second);
+		if (huge_page_size != 2L * 1024 * 1024
+				&& huge_page_size != 1024L * 1024 * 1024)
+			throw std::invalid_argument("huge_page_size must be 2M or 1G");
+	}
+
 	it = configs.find("busy_wait");
 	if (it != configs.end()) {
 		busy_wait = true;
@@ -198,6 +244,139 @@ void sys_parameters::init(const std::map<std::string, std::string> &configs)
 	if (it != configs.end()) {
 		bind_io_thread = true;
 	}
+
+	it = configs.find("aio_type");
+	if (it != configs.end()) {
+		aio_type = aio_type_map.map(it->second);
+		if (aio_type < 0)
+			throw std::invalid_argument("can't find the right aio type");
+	}
+
+	it = configs.find("io_uring_sqpoll");
+	if (it != configs.end()) {
+		io_uring_sqpoll = true;
+	}
+
+	it = configs.find("cache_snapshot");
+	if (it != configs.end()) {
+		cache_snapshot = it->second;
+	}
+
+	it = configs.find("compressed_cache_size");
+	if (it != configs.end()) {
+		compressed_cache_size = str2size(it->second);
+	}
+
+	it = configs.find("max_prefetch_size");
+	if (it != configs.end()) {
+		max_prefetch_size = (int) (str2size(it->second) / PAGE_SIZE);
+	}
+
+	it = configs.find("io_stats");
+	if (it != configs.end()) {
+		io_stats = true;
+	}
+
+	it = configs.find("io_stats_dump_file");
+	if (it != configs.end()) {
+		io_stats_dump_file = it->second;
+		// We can't dump the statistics if we don't collect them.
+		io_stats = true;
+	}
+
+	it = configs.find("io_stats_dump_interval");
+	if (it != configs.end()) {
+		io_stats_dump_interval = atoi(it->second.c_str());
+		if (io_stats_dump_interval <= 0)
+			throw std::invalid_argument("io_stats_dump_interval must be positive");
+	}
+
+	it = configs.find("flush_latency_target");
+	if (it != configs.end()) {
+		flush_latency_target = atoi(it->second.c_str());
+	}
+
+	it = configs.find("merge_disk_reqs");
+	if (it != configs.end()) {
+		merge_disk_reqs = true;
+	}
+
+	it = configs.find("io_merge_window");
+	if (it != configs.end()) {
+		io_merge_window = atoi(it->second.c_str());
+		if (io_merge_window < 0)
+			throw std::invalid_argument("io_merge_window can't be negative");
+	}
+
+	it = configs.find("cache_partitions");
+	if (it != configs.end()) {
+		cache_partitions = it->second;
+	}
+
+	it = configs.find("sched_disk_reqs");
+	if (it != configs.end()) {
+		sched_disk_reqs = true;
+	}
+
+	it = configs.find("io_class_weights");
+	if (it != configs.end()) {
+		std::vector<std::string> strs;
+		split_string(it->second, ':', strs);
+		if (strs.size() != io_class_weights.size())
+			throw std::invalid_argument(
+					"io_class_weights needs a weight for each class");
+		for (size_t i = 0; i < strs.size(); i++) {
+			io_class_weights[i] = atoi(strs[i].c_str());
+			if (io_class_weights[i] <= 0)
+				throw std::invalid_argument(
+						"io_class_weights must be positive");
+		}
+	}
+
+	it = configs.find("cache_bypass_size");
+	if (it != configs.end()) {
+		cache_bypass_size = str2size(it->second);
+	}
+
+	it = configs.find("shared_cache_size");
+	if (it != configs.end()) {
+		shared_cache_size = str2size(it->second);
+	}
+
+	it = configs.find("shared_cache_name");
+	if (it != configs.end()) {
+		shared_cache_name = it->second;
+	}
+
+	it = configs.find("msg_queue_ring_size");
+	if (it != configs.end()) {
+		msg_queue_ring_size = atoi(it->second.c_str());
+	}
+
+	it = configs.find("max_spin_time");
+	if (it != configs.end()) {
+		max_spin_time = atoi(it->second.c_str());
+	}
+
+	it = configs.find("fast_tier_size");
+	if (it != configs.end()) {
+		fast_tier_size = str2size(it->second);
+	}
+
+	it = configs.find("tier_migrate_interval");
+	if (it != configs.end()) {
+		tier_migrate_interval = atoi(it->second.c_str());
+	}
+
+	it = configs.find("map_in_mem_data");
+	if (it != configs.end()) {
+		map_in_mem_data = true;
+	}
+
+	it = configs.find("io_trace_dir");
+	if (it != configs.end()) {
+		io_trace_dir = it->second;
+	}
 }
 
 void sys_parameters::print()
@@ -221,9 +400,34 @@ void sys_parameters::print()
 	BOOST_LOG_TRIVIAL(info) << "\twritable: " << writable;
 	BOOST_LOG_TRIVIAL(info) << "\tmax_num_pending_ios: " << max_num_pending_ios;
 	BOOST_LOG_TRIVIAL(info) << "\thuge_page_enabled: " << huge_page_enabled;
+	BOOST_LOG_TRIVIAL(info) << "\thuge_page_size: " << huge_page_size;
 	BOOST_LOG_TRIVIAL(info) << "\tbusy_wait: " << busy_wait;
 	BOOST_LOG_TRIVIAL(info) << "\tnum_io_threads: " << num_io_threads;
 	BOOST_LOG_TRIVIAL(info) << "\tbind_io_thread: " << bind_io_thread;
+	BOOST_LOG_TRIVIAL(info) << "\taio_type: " << aio_type;
+	BOOST_LOG_TRIVIAL(info) << "\tio_uring_sqpoll: " << io_uring_sqpoll;
+	BOOST_LOG_TRIVIAL(info) << "\tcache_snapshot: " << cache_snapshot;
+	BOOST_LOG_TRIVIAL(info) << "\tcompressed_cache_size: " << compressed_cache_size;
+	BOOST_LOG_TRIVIAL(info) << "\tmax_prefetch_size: " << max_prefetch_size;
+	BOOST_LOG_TRIVIAL(info) << "\tio_stats: " << io_stats;
+	BOOST_LOG_TRIVIAL(info) << "\tio_stats_dump_file: " << io_stats_dump_file;
+	BOOST_LOG_TRIVIAL(info) << "\tio_stats_dump_interval: " << io_stats_dump_interval;
+	BOOST_LOG_TRIVIAL(info) << "\tflush_latency_target: " << flush_latency_target;
+	BOOST_LOG_TRIVIAL(info) << "\tmerge_disk_reqs: " << merge_disk_reqs;
+	BOOST_LOG_TRIVIAL(info) << "\tio_merge_window: " << io_merge_window;
+	BOOST_LOG_TRIVIAL(info) << "\tcache_partitions: " << cache_partitions;
+	BOOST_LOG_TRIVIAL(info) << "\tsched_disk_reqs: " << sched_disk_reqs;
+	BOOST_LOG_TRIVIAL(info) << "\tio_class_weights: " << io_class_weights[0]
+		<< ":" << io_class_weights[1] << ":" << io_class_weights[2];
+	BOOST_LOG_TRIVIAL(info) << "\tcache_bypass_size: " << cache_bypass_size;
+	BOOST_LOG_TRIVIAL(info) << "\tshared_cache_size: " << shared_cache_size;
+	BOOST_LOG_TRIVIAL(info) << "\tshared_cache_name: " << shared_cache_name;
+	BOOST_LOG_TRIVIAL(info) << "\tmsg_queue_ring_size: " << msg_queue_ring_size;
+	BOOST_LOG_TRIVIAL(info) << "\tmax_spin_time: " << max_spin_time;
+	BOOST_LOG_TRIVIAL(info) << "\tfast_tier_size: " << fast_tier_size;
+	BOOST_LOG_TRIVIAL(info) << "\ttier_migrate_interval: " << tier_migrate_interval;
+	BOOST_LOG_TRIVIAL(info) << "\tmap_in_mem_data: " << map_in_mem_data;
+	BOOST_LOG_TRIVIAL(info) << "\tio_trace_dir: " << io_trace_dir;
 }
 
 void sys_parameters::print_help()
@@ -232,6 +436,8 @@ void sys_parameters::print_help()
 			sizeof(cache_types) / sizeof(cache_types[0]));
 	str2int_map RAID_option_map(RAID_options,
 			sizeof(RAID_options) / sizeof(RAID_options[0]));
+	str2int_map aio_type_map(aio_types,
+			sizeof(aio_types) / sizeof(aio_types[0]));
 
 	std::cout << "system parameters: " << std::endl;
 	std::cout << "\tRAID_block_size: x(k, K, m, M, g, G)" << std::endl;
@@ -258,17 +464,64 @@ void sys_parameters::print_help()
 		<< std::endl;
 	std::cout << "\tmax_obj_alloc_size: the maximal size that an object allocator can use."
 		<< std::endl;
-	std::cout << "\twritable: indicate whether or not to write data" << std::endl;
+	std::cout << "\twritable: indicate whether or not to write data. writable=0 makes SAFS read-only" << std::endl;
 	std::cout << "\tmax_num_pending_ios: the max number of pending IOs in an I/O instance"
 		<< std::endl;
 	std::cout << "\thuge_page_enabled: determine whether we use huge page for large chunk of memory"
 		<< std::endl;
+	std::cout << "\thuge_page_size: x(M, G). The size of huge pages (2M or 1G) used by the page cache and the message buffers when huge pages are enabled."
+		<< std::endl;
 	std::cout << "\tbusy_wait: determine whether remote I/O busy wait for I/O completion"
 		<< std::endl;
 	std::cout << "\tnum_io_threads: the number of threads per NUMA node for I/O processing."
 		<< std::endl;
 	std::cout << "\tbind_io_thread: determine whether to bind an I/O thread to a CPU core and use the core exclusivly."
 		<< std::endl;
+	aio_type_map.print("\taio_type: ");
+	std::cout << "\tio_uring_sqpoll: use a kernel thread to poll I/O requests in io_uring."
+		<< std::endl;
+	std::cout << "\tcache_snapshot: the file that records the pages in the page cache. The page cache is warmed up with it and saved to it when SAFS is destroyed."
+		<< std::endl;
+	std::cout << "\tcompressed_cache_size: x(k, K, m, M, g, G). The size of the compressed tier of the page cache."
+		<< std::endl;
+	std::cout << "\tmax_prefetch_size: x(k, K, m, M, g, G). The max size of data read ahead of a sequential stream in the page cache. 0 disables readahead."
+		<< std::endl;
+	std::cout << "\tio_stats: collect the latency histograms and the queue depth of disks in the I/O threads."
+		<< std::endl;
+	std::cout << "\tio_stats_dump_file: the file where the I/O statistics are dumped in JSON periodically. It implies io_stats."
+		<< std::endl;
+	std::cout << "\tio_stats_dump_interval: the interval (in seconds) of dumping the I/O statistics."
+		<< std::endl;
+	std::cout << "\tflush_latency_target: the target latency (in us) of writing back dirty pages. The flusher issues fewer writes when the writes take longer. 0 disables the throttling."
+		<< std::endl;
+	std::cout << "\tmerge_disk_reqs: whether or not I/O threads merge adjacent requests from different threads"
+		<< std::endl;
+	std::cout << "\tio_merge_window: how long (in us) an I/O thread waits for more requests to merge. It only works with merge_disk_reqs."
+		<< std::endl;
+	std::cout << "\tcache_partitions: files1:size1,files2:size2,... The partitions of the page cache reserved for groups of files. The files in a group are separated by '+'. A partition only caches the pages of its files, and the other files share the rest of the page cache."
+		<< std::endl;
+	std::cout << "\tsched_disk_reqs: schedule the requests in the I/O threads by their priority classes and deadlines."
+		<< std::endl;
+	std::cout << "\tio_class_weights: latency:normal:bulk. The weights of the priority classes of I/O requests. It only works with sched_disk_reqs."
+		<< std::endl;
+	std::cout << "\tcache_bypass_size: x(k, K, m, M, g, G). The page-aligned reads at least this large skip the page cache and read data from the disks to the user buffers directly."
+		<< std::endl;
+	std::cout << "\tshared_cache_size: x(k, K, m, M, g, G). The size of the page cache shared by the processes on the machine. The process that creates the shared cache decides its size."
+		<< std::endl;
+	std::cout << "\tshared_cache_name: the name of the shared memory segment of the shared page cache."
+		<< std::endl;
+	std::cout << "\tmsg_queue_ring_size: the number of messages in the lock-free ring of the message queues of I/O threads and graph worker threads. 0 uses locked queues."
+		<< std::endl;
+	std::cout << "\tmax_spin_time: the maximal time in microseconds that a thread spins for I/O completions before it blocks. A thread only spins if completions usually arrive within this time."
+		<< std::endl;
+	std::cout << "\tfast_tier_size: x(k, K, m, M, g, G). The space in the fast tier for each file created with the TIERED mapping. The disks in the fast tier are marked with `fast' in the RAID config."
+		<< std::endl;
+	std::cout << "\ttier_migrate_interval: the interval in milliseconds of moving hot blocks to the fast tier. Blocks are only moved if SAFS isn't writable."
+		<< std::endl;
+	std::cout << "\tmap_in_mem_data: map files to memory instead of copying them when loading data to memory"
+		<< std::endl;
+	std::cout << "\tio_trace_dir: the directory where the requests to the page cache are traced. The trace of a file is <file>.trace"
+		<< std::endl;
 }
 
 }
@@ -25,6 +25,7 @@
 #include <iostream>
 #include <map>
 #include <string>
+#include <vector>
 #include <memory>
 
 #define USE_GCLOCK
@@ -54,12 +55,64 @@ class sys_parameters
 	bool writable;
 	int max_num_pending_ios;
 	bool huge_page_enabled;
+	// The size of huge pages used by the memory allocators (2MB or 1GB).
+	long huge_page_size;
 	bool busy_wait;
+	// The implementation of async I/O used by the I/O threads.
+	int aio_type;
+	// Use a kernel thread to poll the submission queue of io_uring.
+	bool io_uring_sqpoll;
 	// The number of I/O threads per NUMA node.
 	int num_io_threads;
 	// Bind a I/O thread to a specific CPU core and ensure no other threads
 	// to use this core.
 	bool bind_io_thread;
+	// The manifest file that records the pages in the page cache.
+	std::string cache_snapshot;
+	// The size of the compressed tier of the page cache.
+	long compressed_cache_size;
+	// The max number of pages read ahead of a sequential stream.
+	int max_prefetch_size;
+	// Collect the latency histograms and queue depth in the I/O threads.
+	bool io_stats;
+	// The file where the I/O statistics are dumped periodically.
+	std::string io_stats_dump_file;
+	// The interval of dumping the I/O statistics in seconds.
+	int io_stats_dump_interval;
+	// The target latency (in us) of the writes issued by the flusher.
+	int flush_latency_target;
+	// Merge the adjacent requests from different threads in the I/O threads.
+	bool merge_disk_reqs;
+	// How long (in us) an I/O thread waits for more requests to merge.
+	int io_merge_window;
+	// The partitions of the page cache reserved for groups of files.
+	std::string cache_partitions;
+	// Schedule the requests in the I/O threads by their priority classes
+	// and deadlines.
+	bool sched_disk_reqs;
+	// The weights of the priority classes of I/O requests.
+	std::vector<int> io_class_weights;
+	// The reads at least this large skip the page cache. 0 disables it.
+	long cache_bypass_size;
+	// The size of the page cache shared by the processes. 0 disables it.
+	long shared_cache_size;
+	// The name of the shared memory segment of the shared page cache.
+	std::string shared_cache_name;
+	// The number of messages in the lock-free ring of the message queues
+	// of I/O threads and FlashGraph worker threads. 0 uses locked queues.
+	int msg_queue_ring_size;
+	// The maximal time in microseconds that a thread spins for I/O
+	// completions before it blocks. 0 disables spinning.
+	int max_spin_time;
+	// The space in the fast tier for each file with the tiered mapping.
+	long fast_tier_size;
+	// The interval in milliseconds of moving hot blocks to the fast tier.
+	int tier_migrate_interval;
+	// Map files to memory instead of copying them when loading data to
+	// memory.
+	bool map_in_mem_data;
+	// The directory where the requests to the page cache are traced.
+	std::string io_trace_dir;
 public:
 	sys_parameters();
 
@@ -145,6 +198,10 @@ public:
 		return huge_page_enabled;
 	}
 
+	long get_huge_page_size() const {
+		return huge_page_size;
+	}
+
 	// The number of I/O threads per NUMA node.
 	int get_num_io_threads() const {
 		return num_io_threads;
@@ -153,6 +210,98 @@ public:
 	bool is_bind_io_thread() const {
 		return bind_io_thread;
 	}
+
+	int get_aio_type() const {
+		return aio_type;
+	}
+
+	bool is_io_uring_sqpoll() const {
+		return io_uring_sqpoll;
+	}
+
+	const std::string &get_cache_snapshot() const {
+		return cache_snapshot;
+	}
+
+	long get_compressed_cache_size() const {
+		return compressed_cache_size;
+	}
+
+	int get_max_prefetch_size() const {
+		return max_prefetch_size;
+	}
+
+	bool is_io_stats_enabled() const {
+		return io_stats;
+	}
+
+	const std::string &get_io_stats_dump_file() const {
+		return io_stats_dump_file;
+	}
+
+	int get_io_stats_dump_interval() const {
+		return io_stats_dump_interval;
+	}
+
+	int get_flush_latency_target() const {
+		return flush_latency_target;
+	}
+
+	bool is_merge_disk_reqs() const {
+		return merge_disk_reqs;
+	}
+
+	int get_io_merge_window() const {
+		return io_merge_window;
+	}
+
+	const std::string &get_cache_partitions() const {
+		return cache_partitions;
+	}
+
+	bool is_sched_disk_reqs() const {
+		return sched_disk_reqs;
+	}
+
+	const std::vector<int> &get_io_class_weights() const {
+		return io_class_weights;
+	}
+
+	long get_cache_bypass_size() const {
+		return cache_bypass_size;
+	}
+
+	long get_shared_cache_size() const {
+		return shared_cache_size;
+	}
+
+	const std::string &get_shared_cache_name() const {
+		return shared_cache_name;
+	}
+
+	int get_msg_queue_ring_size() const {
+		return msg_queue_ring_size;
+	}
+
+	int get_max_spin_time() const {
+		return max_spin_time;
+	}
+
+	long get_fast_tier_size() const {
+		return fast_tier_size;
+	}
+
+	int get_tier_migrate_interval() const {
+		return tier_migrate_interval;
+	}
+
+	bool is_map_in_mem_data() const {
+		return map_in_mem_data;
+	}
+
+	const std::string &get_io_trace_dir() const {
+		return io_trace_dir;
+	}
 };
 
 extern sys_parameters params;
@@ -192,6 +341,10 @@ const int NUM_REQS_BY_USER = 1000;
  */
 const int MIN_NUM_ALLOC_IOVECS = 16;
 const int NUM_EMBEDDED_IOVECS = 1;
+/**
+ * The max number of buffers in a request merged by an I/O thread.
+ */
+const int MAX_MERGED_IOVECS = 256;
 
 const int CELL_SIZE = 16;
 const int CELL_MIN_NUM_PAGES = 8;
@@ -201,6 +354,11 @@ const int DIRTY_PAGES_THRESHOLD = 1;
 const int NUM_WRITEBACK_DIRTY_PAGES = 2;
 const int MAX_NUM_WRITEBACK = 4;
 const int DISCARD_FLUSH_THRESHOLD = 6;
+/**
+ * The min number of flushes the flusher can have in the I/O queues when
+ * it's throttled by the write latency.
+ */
+const int MIN_NUM_PENDING_FLUSHES = 16;
 
 const long MAX_CACHE_SIZE = 512L * 1024 * 1024 * 1024;
 
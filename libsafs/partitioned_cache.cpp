@@ -0,0 +1,177 @@
+/*
+ * Copyright 2014 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of SAFSlib.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdexcept>
+
+#include <boost/format.hpp>
+
+#include "log.h"
+#include "partitioned_cache.h"
+#include "io_request.h"
+
+namespace safs
+{
+
+partitioned_cache::partitioned_cache(long cache_size, int type,
+		const std::vector<int> &node_ids, const std::string &spec,
+		int max_num_pending_flush)
+{
+	parts.resize(1);
+	parts[0].name = "shared";
+
+	std::vector<std::string> part_strs;
+	split_string(spec, ',', part_strs);
+	long tot_size = 0;
+	for (size_t i = 0; i < part_strs.size(); i++) {
+		size_t found = part_strs[i].rfind(':');
+		if (found == std::string::npos || found == 0)
+			throw std::invalid_argument(boost::str(boost::format(
+							"wrong cache partition: %1%") % part_strs[i]));
+		partition part;
+		part.name = part_strs[i].substr(0, found);
+		part.size = str2size(part_strs[i].substr(found + 1));
+		if (part.size <= 0)
+			throw std::invalid_argument(boost::str(boost::format(
+							"wrong size of cache partition: %1%") % part.name));
+		std::vector<std::string> files;
+		split_string(part.name, '+', files);
+		for (size_t j = 0; j < files.size(); j++) {
+			for (size_t k = 0; k < parts.size(); k++)
+				if (parts[k].files.find(files[j]) != parts[k].files.end())
+					throw std::invalid_argument(boost::str(boost::format(
+									"%1% is in multiple cache partitions")
+								% files[j]));
+			part.files.insert(files[j]);
+		}
+		tot_size += part.size;
+		parts.push_back(part);
+	}
+	if (tot_size >= cache_size)
+		throw std::invalid_argument(
+				"the cache partitions are larger than the page cache");
+	parts[0].size = cache_size - tot_size;
+
+	for (size_t i = 0; i < parts.size(); i++) {
+		parts[i].conf = cache_config::ptr(new even_cache_config(parts[i].size,
+					type, node_ids));
+		parts[i].cache = parts[i].conf->create_cache(max_num_pending_flush);
+		BOOST_LOG_TRIVIAL(info) << boost::format(
+				"cache partition %1%: size: %2%") % parts[i].name % parts[i].size;
+	}
+}
+
+page_cache &partitioned_cache::get_part(int file_id)
+{
+	int idx = 0;
+	lock.lock();
+	auto it = file_parts.find(file_id);
+	if (it != file_parts.end())
+		idx = it->second;
+	lock.unlock();
+	return *parts[idx].cache;
+}
+
+page_cache::ptr partitioned_cache::get_file_cache(int file_id,
+		const std::string &file_name)
+{
+	int idx = 0;
+	for (size_t i = 1; i < parts.size(); i++)
+		if (parts[i].files.find(file_name) != parts[i].files.end())
+			idx = i;
+	// The files in the shared partition don't need to be registered.
+	if (idx > 0) {
+		lock.lock();
+		file_parts[file_id] = idx;
+		lock.unlock();
+	}
+	return parts[idx].cache;
+}
+
+void partitioned_cache::get_part_stats(std::vector<cache_part_stat> &stats) const
+{
+	for (size_t i = 0; i < parts.size(); i++) {
+		cache_part_stat stat;
+		long num_ghost_hits;
+		stat.name = parts[i].name;
+		stat.size = parts[i].size;
+		parts[i].cache->get_access_stat(stat.num_accesses, stat.num_misses,
+				num_ghost_hits);
+		stats.push_back(stat);
+	}
+}
+
+long partitioned_cache::size()
+{
+	long tot = 0;
+	for (size_t i = 0; i < parts.size(); i++)
+		tot += parts[i].cache->size();
+	return tot;
+}
+
+void partitioned_cache::flush_callback(io_request &req)
+{
+	get_part(req.get_file_id()).flush_callback(req);
+}
+
+int partitioned_cache::flush_dirty_pages(page_filter *filter, int max_num)
+{
+	int tot = 0;
+	for (size_t i = 0; i < parts.size(); i++)
+		tot += parts[i].cache->flush_dirty_pages(filter,
+				max_num / parts.size());
+	return tot;
+}
+
+void partitioned_cache::get_resident_pages(std::vector<page_id_t> &pages) const
+{
+	for (size_t i = 0; i < parts.size(); i++)
+		parts[i].cache->get_resident_pages(pages);
+}
+
+void partitioned_cache::get_access_stat(long &num_accesses, long &num_misses,
+		long &num_ghost_hits) const
+{
+	num_accesses = 0;
+	num_misses = 0;
+	num_ghost_hits = 0;
+	for (size_t i = 0; i < parts.size(); i++) {
+		long accesses, misses, ghost_hits;
+		parts[i].cache->get_access_stat(accesses, misses, ghost_hits);
+		num_accesses += accesses;
+		num_misses += misses;
+		num_ghost_hits += ghost_hits;
+	}
+}
+
+void partitioned_cache::print_stat() const
+{
+	for (size_t i = 0; i < parts.size(); i++) {
+		printf("cache partition %s (%ld bytes):\n", parts[i].name.c_str(),
+				parts[i].size);
+		parts[i].cache->print_stat();
+	}
+}
+
+void partitioned_cache::sanity_check() const
+{
+	for (size_t i = 0; i < parts.size(); i++)
+		parts[i].cache->sanity_check();
+}
+
+}
@@ -0,0 +1,127 @@
+#ifndef __PARTITIONED_CACHE_H__
+#define __PARTITIONED_CACHE_H__
+
+/*
+ * Copyright 2014 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of SAFSlib.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "cache.h"
+#include "cache_config.h"
+#include "io_stats.h"
+
+namespace safs
+{
+
+/*
+ * This cache divides the page cache into partitions for groups of files.
+ * A partition only caches the pages of its own files, so a file can't
+ * evict the pages of the files in other partitions. The files that don't
+ * belong to any partition share the rest of the page cache.
+ *
+ * Each partition is a complete page cache with its own flusher and is
+ * distributed in the NUMA nodes in the same way as an unpartitioned cache.
+ * The I/O instances of a file access the partition of the file directly,
+ * so this cache only needs to route pages to partitions for the code that
+ * accesses the page cache as a whole.
+ */
+class partitioned_cache: public page_cache
+{
+	struct partition
+	{
+		std::string name;
+		std::unordered_set<std::string> files;
+		long size;
+		cache_config::ptr conf;
+		page_cache::ptr cache;
+	};
+
+	// The first partition is shared by the files that don't belong to
+	// other partitions.
+	std::vector<partition> parts;
+
+	spin_lock lock;
+	// file id <-> the index of the partition.
+	std::unordered_map<int, int> file_parts;
+
+	partitioned_cache(long cache_size, int type,
+			const std::vector<int> &node_ids, const std::string &spec,
+			int max_num_pending_flush);
+
+	page_cache &get_part(int file_id);
+public:
+	typedef std::shared_ptr<partitioned_cache> ptr;
+
+	/*
+	 * The partitions are specified in the form of
+	 * "files1:size1,files2:size2,...", and the files in a group are
+	 * separated by '+'.
+	 */
+	static ptr create(long cache_size, int type,
+			const std::vector<int> &node_ids, const std::string &spec,
+			int max_num_pending_flush) {
+		return ptr(new partitioned_cache(cache_size, type, node_ids, spec,
+					max_num_pending_flush));
+	}
+
+	/*
+	 * Get the partition that caches the pages of a file.
+	 * The file id is registered, so the pages of the file can be routed
+	 * to the partition.
+	 */
+	page_cache::ptr get_file_cache(int file_id, const std::string &file_name);
+
+	void get_part_stats(std::vector<cache_part_stat> &stats) const;
+
+	virtual page *search(const page_id_t &pg_id, page_id_t &old_id) {
+		return get_part(pg_id.get_file_id()).search(pg_id, old_id);
+	}
+
+	virtual page *search(const page_id_t &pg_id) {
+		return get_part(pg_id.get_file_id()).search(pg_id);
+	}
+
+	virtual long size();
+
+	virtual void init(std::shared_ptr<io_interface> underlying) {
+		for (size_t i = 0; i < parts.size(); i++)
+			parts[i].cache->init(underlying);
+	}
+
+	virtual void mark_dirty_pages(thread_safe_page *pages[], int num,
+			io_interface &io) {
+		for (int i = 0; i < num; i++)
+			get_part(pages[i]->get_file_id()).mark_dirty_pages(&pages[i], 1, io);
+	}
+
+	virtual void flush_callback(io_request &req);
+	virtual int flush_dirty_pages(page_filter *filter, int max_num);
+	virtual void get_resident_pages(std::vector<page_id_t> &pages) const;
+	virtual void get_access_stat(long &num_accesses, long &num_misses,
+			long &num_ghost_hits) const;
+	virtual void print_stat() const;
+	virtual void sanity_check() const;
+};
+
+}
+
+#endif
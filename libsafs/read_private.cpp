@@ -51,10 +51,13 @@ buffered_io::buffered_io(const logical_file_partition &partition_, thread *t,
 io_status buffered_io::access(char *buf, off_t offset, ssize_t size, int access_method) {
 	ASSERT_EQ(get_thread(), thread::get_curr_thread());
 	int fd;
+	int epoch = -1;
 	if (fds.size() == 1)
 		fd = fds[0];
 	else {
 		struct block_identifier bid;
+		if (access_method == READ)
+			epoch = partition.get_mapper()->begin_read();
 		partition.map(offset / PAGE_SIZE, bid);
 		fd = fds[bid.idx];
 		offset = bid.off * PAGE_SIZE;
@@ -65,6 +68,8 @@ io_status buffered_io::access(char *buf, off_t offset, ssize_t size, int access_
 		ret = pwrite(fd, buf, size, offset);
 	else
 		ret = pread(fd, buf, size, offset);
+	if (epoch >= 0)
+		partition.get_mapper()->end_read(epoch);
 	io_status status;
 	if (ret < 0)
 		status = IO_FAIL;
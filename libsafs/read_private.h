@@ -57,6 +57,11 @@ public:
 		return fds[idx];
 	}
 
+	/* get the file descriptor of the file `idx' in the partition. */
+	int get_fd_by_idx(int idx) const {
+		return fds[idx];
+	}
+
 	const std::vector<int> &get_fds() const {
 		return fds;
 	}
@@ -81,7 +81,8 @@ remote_io::remote_io(const std::vector<disk_io_thread::ptr> &remotes,
 			header), max_disk_cached_reqs(max_reqs), complete_queue(std::string(
 					"disk_complete_queue-") + itoa(t->get_node_id()), t->get_node_id(),
 				COMPLETE_QUEUE_SIZE, std::numeric_limits<int>::max()),
-			msg_allocator(_msg_allocator)
+			msg_allocator(_msg_allocator),
+			poller(params.get_max_spin_time() * 1000L)
 {
 	int node_id = t->get_node_id();
 	num_ios.inc(1);
@@ -94,6 +95,9 @@ remote_io::remote_io(const std::vector<disk_io_thread::ptr> &remotes,
 				remotes[i]->get_queue());
 		low_prio_senders[i] = request_sender::create(node_id, &msg_allocator,
 				remotes[i]->get_low_prio_queue());
+		// The I/O threads measure how long the requests wait in the queue.
+		if (params.is_io_stats_enabled())
+			senders[i]->set_timestamp_msgs(true);
 	}
 	cb = NULL;
 	this->block_mapper = mapper;
@@ -198,6 +202,14 @@ void remote_io::access(io_request *requests, int num,
 		// If the request accesses one RAID block, it's simple.
 		if (requests[i].inside_RAID_block(get_block_size())) {
 			off_t pg_off = requests[i].get_offset() / PAGE_SIZE;
+			// The reads here have missed the page cache, so they tell
+			// the mapper which blocks are hot on the disks.
+			// The read is counted until it completes, so the location
+			// that it's mapped to keeps its data.
+			if (requests[i].get_access_method() == READ) {
+				block_mapper->record_read(pg_off);
+				requests[i].set_tier_epoch(block_mapper->begin_read());
+			}
 			int idx = block_mapper->map2file(pg_off);
 			// Map to the right disk.
 			idx = block_mapper->get_disk_id(idx);
@@ -236,10 +248,16 @@ void remote_io::access(io_request *requests, int num,
 				// a single-buffer request.
 				orig->extract(begin, size, req);
 				req.set_io(this);
+				req.set_prio_class(orig->get_prio_class());
+				req.set_deadline(orig->get_deadline());
 				assert(req.inside_RAID_block(get_block_size()));
 
 				// Send a request.
 				off_t pg_off = req.get_offset() / PAGE_SIZE;
+				if (req.get_access_method() == READ) {
+					block_mapper->record_read(pg_off);
+					req.set_tier_epoch(block_mapper->begin_read());
+				}
 				int idx = block_mapper->map2file(pg_off);
 				// Map to the right disk.
 				idx = block_mapper->get_disk_id(idx);
@@ -400,6 +418,26 @@ int remote_io::get_file_id() const
 	return block_mapper->get_file_id();
 }
 
+/*
+ * Wait until I/O threads return completed requests. If completions usually
+ * arrive soon, we poll the completion queue for a while before we block.
+ */
+void remote_io::wait4reqs()
+{
+	long spin_ns = poller.get_spin_ns();
+	long start = get_curr_ns();
+	long now = start;
+	while (now - start < spin_ns) {
+		if (has_completed_reqs()) {
+			poller.add_wait(now - start, now - start, true);
+			return;
+		}
+		now = get_curr_ns();
+	}
+	get_thread()->wait();
+	poller.add_wait(get_curr_ns() - start, now - start, false);
+}
+
 /**
  * We wait for at least the specified number of requests to complete.
  */
@@ -412,7 +450,7 @@ int remote_io::wait4complete(int num_to_complete)
 	process_all_completed_requests();
 	while (pending - num_pending_ios() < num_to_complete) {
 		if (!params.is_busy_wait())
-			get_thread()->wait();
+			wait4reqs();
 		process_all_completed_requests();
 	}
 	return pending - num_pending_ios();
@@ -422,6 +460,7 @@ void remote_io::print_state()
 {
 	printf("remote_io %d has %d pending reqs, %d completed reqs\n",
 			get_io_id(), num_pending_ios(), complete_queue.get_num_entries());
+	poller.print_stat();
 	for (unsigned i = 0; i < senders.size(); i++)
 		printf("\tsender %d: remain %d reqs\n", i,
 				senders[i]->get_num_remaining());
@@ -436,7 +475,19 @@ class remote_io_select: public io_select
 	// an IO interface is destroyed.
 	std::vector<remote_io::ptr> ios;
 	std::set<remote_io::ptr> io_set;
+	hybrid_poller poller;
+
+	bool has_completed_reqs() const {
+		for (size_t i = 0; i < ios.size(); i++)
+			if (ios[i]->has_completed_reqs())
+				return true;
+		return false;
+	}
+	void wait4reqs(thread *curr);
 public:
+	remote_io_select(): poller(params.get_max_spin_time() * 1000L) {
+	}
+
 	virtual bool add_io(io_interface::ptr io);
 	virtual int num_pending_ios() const;
 	virtual int wait4complete(int num_to_complete);
@@ -462,6 +513,22 @@ int remote_io_select::num_pending_ios() const
 	return num_pending;
 }
 
+void remote_io_select::wait4reqs(thread *curr)
+{
+	long spin_ns = poller.get_spin_ns();
+	long start = get_curr_ns();
+	long now = start;
+	while (now - start < spin_ns) {
+		if (has_completed_reqs()) {
+			poller.add_wait(now - start, now - start, true);
+			return;
+		}
+		now = get_curr_ns();
+	}
+	curr->wait();
+	poller.add_wait(get_curr_ns() - start, now - start, false);
+}
+
 int remote_io_select::wait4complete(int num_to_complete)
 {
 	thread *curr = thread::get_curr_thread();
@@ -481,7 +548,7 @@ int remote_io_select::wait4complete(int num_to_complete)
 	// I/O threads wake us up.
 	while (num_complete < num_to_complete) {
 		if (!params.is_busy_wait())
-			curr->wait();
+			wait4reqs(curr);
 		for (size_t i = 0; i < ios.size(); i++) {
 			ios[i]->flush_requests();
 			num_complete += ios[i]->process_all_completed_requests();
@@ -23,6 +23,7 @@
 #include "slab_allocator.h"
 #include "io_interface.h"
 #include "container.h"
+#include "hybrid_poller.h"
 
 namespace safs
 {
@@ -54,6 +55,10 @@ class remote_io: public io_interface
 
 	atomic_integer num_completed_reqs;
 	atomic_integer num_issued_reqs;
+	// It decides how long we spin for completions before blocking.
+	hybrid_poller poller;
+
+	void wait4reqs();
 public:
 	typedef std::shared_ptr<remote_io> ptr;
 
@@ -109,6 +114,10 @@ public:
 		return num_issued_reqs.get();
 	}
 
+	bool has_completed_reqs() {
+		return !complete_queue.is_empty();
+	}
+
 	virtual io_select::ptr create_io_select() const;
 };
 
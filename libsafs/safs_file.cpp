@@ -48,7 +48,8 @@ safs_file::safs_file(const RAID_config &conf, const std::string &file_name)
 	for (unsigned i = 0; i < native_dirs.size(); i++)
 		native_dirs[i] = part_file_info(
 				native_dirs[i].get_file_name() + "/" + file_name,
-				native_dirs[i].get_disk_id(), native_dirs[i].get_node_id());
+				native_dirs[i].get_disk_id(), native_dirs[i].get_node_id(),
+				native_dirs[i].get_weight(), native_dirs[i].is_fast());
 	this->name = file_name;
 }
 
@@ -136,7 +137,10 @@ bool safs_file::resize(size_t new_size)
 		std::vector<size_t> sizes_per_disk = get_size_per_disk(new_size);
 		for (size_t i = 0; i < data_files.size(); i++) {
 			native_file f(data_files[i]);
-			bool ret = f.resize(sizes_per_disk[i]);
+			// The sizes are indexed by the partition ids, which are
+			// the names of the data files.
+			int part_id = atoi(f.get_file_name().c_str());
+			bool ret = f.resize(sizes_per_disk[part_id]);
 			if (!ret)
 				return false;
 		}
@@ -154,8 +158,8 @@ bool safs_file::resize(size_t new_size)
 	}
 
 	safs_header header;
-	size_t num_reads = fread(&header, sizeof(header), 1, f);
-	if (num_reads != 1) {
+	size_t num_reads = fread(&header, 1, sizeof(header), f);
+	if (num_reads < safs_header::get_min_size()) {
 		perror("fread");
 		fclose(f);
 		return false;
@@ -167,9 +171,10 @@ bool safs_file::resize(size_t new_size)
 		return false;
 	}
 
-	safs_header new_header(header.get_block_size(),
-			header.get_mapping_option(), header.is_writable(),
-			new_size);
+	// The other fields of the header, e.g., the weights of the disks,
+	// are kept.
+	safs_header new_header = header;
+	new_header.resize(new_size);
 	size_t num_writes = fwrite(&new_header, sizeof(new_header), 1, f);
 	if (num_writes != 1) {
 		perror("fwrite");
@@ -197,7 +202,8 @@ bool safs_file::rename(const std::string &new_name)
 	for (unsigned i = 0; i < native_dirs.size(); i++) {
 		native_file f(native_dirs[i].get_file_name());
 		native_dirs[i] = part_file_info(f.get_dir_name() + "/" + new_name,
-				native_dirs[i].get_disk_id(), native_dirs[i].get_node_id());
+				native_dirs[i].get_disk_id(), native_dirs[i].get_node_id(),
+				native_dirs[i].get_weight(), native_dirs[i].is_fast());
 	}
 	return true;
 }
@@ -230,8 +236,40 @@ bool safs_file::create_file(size_t file_size, int block_size,
 	else
 		dir_idxs = group->add_file(*this);
 
+	// The partition `i' is stored in the directory `dir_idxs[i]'.
+	std::vector<part_file_info> parts(native_dirs.size());
+	for (size_t i = 0; i < parts.size(); i++)
+		parts[i] = native_dirs[dir_idxs[i]];
 	safs_header header(block_size, mapping_option, true, file_size);
-	std::vector<size_t> sizes_per_disk = get_size_per_disk(file_size);
+	if (mapping_option == WEIGHTED) {
+		std::vector<int> weights(parts.size());
+		for (size_t i = 0; i < parts.size(); i++)
+			weights[i] = parts[i].get_weight();
+		header.set_disk_weights(weights);
+	}
+	else if (mapping_option == TIERED) {
+		std::vector<bool> fast_parts(parts.size());
+		bool has_fast = false;
+		for (size_t i = 0; i < parts.size(); i++) {
+			fast_parts[i] = parts[i].is_fast();
+			has_fast |= fast_parts[i];
+		}
+		size_t num_fast_blocks = params.get_fast_tier_size()
+			/ ((size_t) block_size * PAGE_SIZE);
+		if (!has_fast || num_fast_blocks == 0) {
+			fprintf(stderr,
+					"the tiered mapping needs fast disks and fast_tier_size\n");
+			return false;
+		}
+		header.set_tiers(fast_parts, num_fast_blocks);
+	}
+	file_mapper::ptr mapper = file_mapper::create(header, parts, name);
+	if (mapper == NULL)
+		return false;
+	std::vector<size_t> sizes_per_disk = mapper->get_size_per_disk(
+			div_ceil<size_t>(file_size, PAGE_SIZE));
+	for (size_t i = 0; i < sizes_per_disk.size(); i++)
+		sizes_per_disk[i] = sizes_per_disk[i] * PAGE_SIZE;
 	for (unsigned i = 0; i < native_dirs.size(); i++) {
 		native_dir dir(native_dirs[dir_idxs[i]].get_file_name());
 		bool ret = dir.create_dir(true);
@@ -301,8 +339,8 @@ safs_header safs_file::get_header() const
 		return safs_header();
 	}
 	safs_header header;
-	size_t num_reads = fread(&header, sizeof(header), 1, f);
-	if (num_reads != 1) {
+	size_t num_reads = fread(&header, 1, sizeof(header), f);
+	if (num_reads < safs_header::get_min_size()) {
 		perror("fread");
 		return safs_header();
 	}
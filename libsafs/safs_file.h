@@ -46,16 +46,27 @@ class part_file_info
 	int disk_id;
 	// The NUMA node id where the disk is connected to.
 	int node_id;
+	// The relative bandwidth of the disk. It decides the share of
+	// the stripe blocks stored on the disk in the weighted mapping.
+	int weight;
+	// Whether the disk is in the fast tier. In the tiered mapping,
+	// the disks in the fast tier keep copies of the hot stripe blocks.
+	bool fast;
 public:
 	part_file_info() {
 		disk_id = 0;
 		node_id = 0;
+		weight = 1;
+		fast = false;
 	}
 
-	part_file_info(const std::string &name, int disk_id, int node_id) {
+	part_file_info(const std::string &name, int disk_id, int node_id,
+			int weight = 1, bool fast = false) {
 		this->name = name;
 		this->disk_id = disk_id;
 		this->node_id = node_id;
+		this->weight = weight;
+		this->fast = fast;
 	}
 
 	std::string get_file_name() const {
@@ -69,6 +80,14 @@ public:
 	int get_node_id() const {
 		return node_id;
 	}
+
+	int get_weight() const {
+		return weight;
+	}
+
+	bool is_fast() const {
+		return fast;
+	}
 };
 
 class RAID_config;
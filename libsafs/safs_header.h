@@ -20,6 +20,10 @@
  * limitations under the License.
  */
 
+#include <stddef.h>
+
+#include <vector>
+
 #include "io_request.h"
 
 namespace safs
@@ -29,6 +33,7 @@ class safs_header
 {
 	static const int64_t MAGIC_NUMBER = 0x123456789FFFFFEL;
 	static const int CURR_VERSION = 1;
+	static const int MAX_NUM_WEIGHTS = 256;
 
 	int64_t magic_number;
 	int version_number;
@@ -37,22 +42,44 @@ class safs_header
 	uint32_t mapping_option;
 	uint32_t writable;
 	uint64_t num_bytes;
+	/*
+	 * The weights of the disks in the weighted mapping, in the order of
+	 * the partitions of the file. The data of a file is laid out with
+	 * the weights when the file is created, so they are kept with the file
+	 * instead of the RAID config. The headers written before the weights
+	 * were added don't have these fields, and they are read as 0.
+	 */
+	uint32_t num_weights;
+	uint32_t weights[MAX_NUM_WEIGHTS];
+	/*
+	 * The tiers of the partitions in the tiered mapping. The partitions
+	 * in the fast tier keep the copies of `num_fast_blocks' hot stripe
+	 * blocks of the file.
+	 */
+	uint32_t num_fast_blocks;
+	uint8_t fast_parts[MAX_NUM_WEIGHTS];
 public:
 	static size_t get_header_size() {
 		return PAGE_SIZE;
 	}
 
+	/*
+	 * The size of the header written by the older versions of SAFS.
+	 * A header file has at least this many bytes.
+	 */
+	static size_t get_min_size() {
+		return offsetof(safs_header, num_weights);
+	}
+
 	safs_header() {
+		memset(this, 0, sizeof(*this));
 		this->magic_number = MAGIC_NUMBER;
 		this->version_number = CURR_VERSION;
-		this->block_size = 0;
-		this->mapping_option = 0;
-		this->writable = false;
-		this->num_bytes = 0;
 	}
 
 	safs_header(int block_size, int mapping_option, bool writable,
 			size_t file_size) {
+		memset(this, 0, sizeof(*this));
 		this->magic_number = MAGIC_NUMBER;
 		this->version_number = CURR_VERSION;
 		this->block_size = block_size;
@@ -61,6 +88,35 @@ public:
 		this->num_bytes = file_size;
 	}
 
+	void set_disk_weights(const std::vector<int> &weights) {
+		assert(weights.size() <= (size_t) MAX_NUM_WEIGHTS);
+		this->num_weights = weights.size();
+		for (size_t i = 0; i < weights.size(); i++)
+			this->weights[i] = weights[i];
+	}
+
+	/*
+	 * It returns an empty vector if the header doesn't have weights.
+	 */
+	std::vector<int> get_disk_weights() const {
+		return std::vector<int>(weights, weights + num_weights);
+	}
+
+	void set_tiers(const std::vector<bool> &fast_parts, int num_fast_blocks) {
+		assert(fast_parts.size() <= (size_t) MAX_NUM_WEIGHTS);
+		this->num_fast_blocks = num_fast_blocks;
+		for (size_t i = 0; i < fast_parts.size(); i++)
+			this->fast_parts[i] = fast_parts[i];
+	}
+
+	bool is_fast_part(int idx) const {
+		return fast_parts[idx];
+	}
+
+	int get_num_fast_blocks() const {
+		return num_fast_blocks;
+	}
+
 	int get_block_size() const {
 		return block_size;
 	}
@@ -0,0 +1,153 @@
+/*
+ * Copyright 2014 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of SAFSlib.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <assert.h>
+
+#include <algorithm>
+
+#include "seq_prefetcher.h"
+#include "io_request.h"
+
+namespace safs
+{
+
+/*
+ * The number of streams tracked by an I/O instance.
+ */
+static const int NUM_STREAMS = 8;
+/*
+ * The number of sequential reads before we start to read ahead.
+ */
+static const int MIN_SEQ_READS = 2;
+/*
+ * The initial readahead window in pages.
+ */
+static const int INIT_WINDOW = 4;
+
+seq_prefetcher::seq_prefetcher(int max_window): max_window(max_window),
+	streams(NUM_STREAMS)
+{
+	curr = NULL;
+	curr_end = 0;
+	curr_byte_end = 0;
+	num_reads = 0;
+	num_prefetched_pages = 0;
+	num_useful_pages = 0;
+	num_evicted_pages = 0;
+}
+
+void seq_prefetcher::start_read(off_t off, size_t size)
+{
+	off_t begin = ROUND_PAGE(off);
+	num_reads++;
+	curr = NULL;
+	curr_end = ROUNDUP_PAGE(off + size);
+	curr_byte_end = off + size;
+
+	stream *lru = &streams[0];
+	for (size_t i = 0; i < streams.size(); i++) {
+		stream &s = streams[i];
+		// The read may start in the middle of the last page of the previous
+		// read.
+		if (s.next >= 0 && (begin == s.next || off == s.last_end)) {
+			curr = &s;
+			break;
+		}
+		if (s.last_access < lru->last_access)
+			lru = &s;
+	}
+
+	if (curr) {
+		curr->num_seq_reads++;
+	}
+	else {
+		// Replace the least recently used stream.
+		curr = lru;
+		*curr = stream();
+		curr->next = begin;
+		curr->prefetch_end = begin;
+		curr->first_unused = begin;
+		curr->num_seq_reads = 1;
+	}
+	curr->last_access = num_reads;
+}
+
+void seq_prefetcher::access_page(off_t pg_off, bool hit)
+{
+	if (curr == NULL || pg_off < curr->next || pg_off >= curr->prefetch_end)
+		return;
+	// A page read ahead is counted only when it's accessed the first time.
+	if (pg_off < curr->first_unused)
+		return;
+	curr->first_unused = pg_off + PAGE_SIZE;
+
+	if (hit)
+		num_useful_pages++;
+	else {
+		num_evicted_pages++;
+		curr->num_evicted++;
+	}
+}
+
+int seq_prefetcher::end_read(off_t &pf_off)
+{
+	if (curr == NULL)
+		return 0;
+
+	stream &s = *curr;
+	s.next = std::max(s.next, curr_end);
+	s.last_end = curr_byte_end;
+	s.prefetch_end = std::max(s.prefetch_end, s.next);
+	if (s.num_seq_reads < MIN_SEQ_READS) {
+		curr = NULL;
+		return 0;
+	}
+
+	int num_ahead = (s.prefetch_end - s.next) / PAGE_SIZE;
+	if (s.num_evicted > 0) {
+		// We read too much ahead of the stream.
+		s.window = std::max(s.window / 2, 1);
+		s.num_evicted = 0;
+	}
+	else if (s.window == 0)
+		s.window = std::min(INIT_WINDOW, max_window);
+	else if (num_ahead <= s.window / 2)
+		s.window = std::min(s.window * 2, max_window);
+
+	off_t end = s.next + ((off_t) s.window) * PAGE_SIZE;
+	int num_pages = (end - s.prefetch_end) / PAGE_SIZE;
+	// We don't want to issue many small requests to read ahead. The data
+	// is read ahead in batches of at least half of the window.
+	if (num_pages <= 0 || (num_ahead > 0 && num_pages < s.window / 2)) {
+		curr = NULL;
+		return 0;
+	}
+	pf_off = s.prefetch_end;
+	return num_pages;
+}
+
+void seq_prefetcher::prefetched(off_t end, int num_pages)
+{
+	assert(curr);
+	curr->prefetch_end = std::max(curr->prefetch_end, end);
+	num_prefetched_pages += num_pages;
+	curr = NULL;
+}
+
+}
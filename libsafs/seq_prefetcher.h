@@ -0,0 +1,135 @@
+#ifndef __SEQ_PREFETCHER_H__
+#define __SEQ_PREFETCHER_H__
+
+/*
+ * Copyright 2014 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of SAFSlib.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <sys/types.h>
+
+#include <vector>
+
+namespace safs
+{
+
+/**
+ * This detects sequential streams in the reads of an I/O instance and
+ * decides how much data to read ahead for them.
+ *
+ * A stream gets a readahead window after it has been read sequentially
+ * a few times. The window is doubled when the stream consumes half of
+ * the data read ahead for it, and is halved when the stream finds that
+ * the pages read ahead have been evicted from the page cache before
+ * they are used.
+ *
+ * An I/O instance is only used by one thread, so it isn't thread-safe.
+ */
+class seq_prefetcher
+{
+	struct stream
+	{
+		// The page where the next read of the stream is expected.
+		off_t next;
+		// The end of the last read in the stream.
+		off_t last_end;
+		// The end of the data read ahead for the stream.
+		off_t prefetch_end;
+		// The pages read ahead before it have been counted as useful
+		// or evicted.
+		off_t first_unused;
+		// The number of sequential reads in the stream.
+		int num_seq_reads;
+		// The readahead window in pages.
+		int window;
+		// The number of pages read ahead that have been evicted unused.
+		int num_evicted;
+		// When the stream was accessed last time.
+		size_t last_access;
+
+		stream() {
+			next = -1;
+			last_end = -1;
+			prefetch_end = -1;
+			first_unused = -1;
+			num_seq_reads = 0;
+			window = 0;
+			num_evicted = 0;
+			last_access = 0;
+		}
+	};
+
+	const int max_window;
+	std::vector<stream> streams;
+	// The stream that the current read belongs to.
+	stream *curr;
+	off_t curr_end;
+	off_t curr_byte_end;
+	size_t num_reads;
+
+	size_t num_prefetched_pages;
+	size_t num_useful_pages;
+	size_t num_evicted_pages;
+public:
+	/**
+	 * @max_window: the max number of pages read ahead for a stream.
+	 */
+	seq_prefetcher(int max_window);
+
+	/**
+	 * A read starts. It must be invoked before any pages of the read
+	 * are accessed.
+	 */
+	void start_read(off_t off, size_t size);
+	/**
+	 * A page accessed by the current read is found in the page cache or not.
+	 */
+	void access_page(off_t pg_off, bool hit);
+	/**
+	 * The current read ends. It returns the number of pages that should
+	 * be read ahead from `pf_off'.
+	 */
+	int end_read(off_t &pf_off);
+	/**
+	 * The data has been read ahead to `end'. It may stop before the range
+	 * returned by end_read() if it can't get more pages from the page cache.
+	 */
+	void prefetched(off_t end, int num_pages);
+
+	size_t get_num_prefetched_pages() const {
+		return num_prefetched_pages;
+	}
+
+	/**
+	 * The number of the pages read ahead that are used by the streams.
+	 */
+	size_t get_num_useful_pages() const {
+		return num_useful_pages;
+	}
+
+	/**
+	 * The number of the pages read ahead that are evicted before the streams
+	 * use them.
+	 */
+	size_t get_num_evicted_pages() const {
+		return num_evicted_pages;
+	}
+};
+
+}
+
+#endif
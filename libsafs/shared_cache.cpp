@@ -0,0 +1,450 @@
+/*
+ * Copyright 2014 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of SAFSlib.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <boost/format.hpp>
+
+#include "log.h"
+#include "shared_cache.h"
+#include "RAID_config.h"
+
+namespace safs
+{
+
+static const uint64_t SEGMENT_MAGIC = 0x5AF5CAC4E5E60002UL;
+// The number of pages in a set.
+static const int SET_SIZE = 16;
+// How long we wait for the process that creates the segment to initialize
+// it (in ms).
+static const int MAX_INIT_WAIT = 1000;
+static const int MAX_NUM_PROCS = 256;
+
+struct shm_segment_header
+{
+	volatile uint64_t magic;
+	uint64_t num_sets;
+	// It protects the list of the processes attached to the segment.
+	pthread_mutex_t procs_lock;
+	int num_procs;
+	pid_t procs[MAX_NUM_PROCS];
+};
+
+struct page_slot
+{
+	uint64_t file_key;
+	// The index of the page in the file + 1. It's 0 if the slot is empty.
+	uint64_t pg_idx;
+	uint32_t referenced;
+};
+
+struct shm_page_set
+{
+	pthread_mutex_t lock;
+	// It's increased when a page in the set is invalidated.
+	uint32_t version;
+	// The slots are replaced with the CLOCK algorithm.
+	uint32_t clock_hand;
+	page_slot slots[SET_SIZE];
+};
+
+shared_page_cache *shared_page_cache::global_cache;
+
+static size_t get_sets_off()
+{
+	return ROUNDUP(sizeof(shm_segment_header), 64);
+}
+
+static size_t get_frames_off(size_t num_sets)
+{
+	return ROUNDUP_PAGE(get_sets_off()
+			+ num_sets * sizeof(shm_page_set));
+}
+
+static void lock_robust(pthread_mutex_t *lock)
+{
+	if (pthread_mutex_lock(lock) == EOWNERDEAD)
+		pthread_mutex_consistent(lock);
+}
+
+/*
+ * Remove the processes that exited without detaching from the segment,
+ * so the segment can still be removed when the other processes detach.
+ */
+static void remove_dead_procs(shm_segment_header *header)
+{
+	for (int i = 0; i < header->num_procs; ) {
+		if (kill(header->procs[i], 0) < 0 && errno == ESRCH)
+			header->procs[i] = header->procs[--header->num_procs];
+		else
+			i++;
+	}
+}
+
+/*
+ * The FNV-1a hash of the file name. It doesn't depend on the process.
+ */
+static uint64_t hash_file_name(const std::string &name)
+{
+	uint64_t hash = 14695981039346656037UL;
+	for (size_t i = 0; i < name.size(); i++) {
+		hash ^= (unsigned char) name[i];
+		hash *= 1099511628211UL;
+	}
+	return hash;
+}
+
+shared_page_cache::shared_page_cache(const std::string &name)
+{
+	if (name.empty() || name[0] != '/')
+		this->name = "/" + name;
+	else
+		this->name = name;
+	seg_size = 0;
+	pid = getpid();
+	header = NULL;
+	sets = NULL;
+	frames = NULL;
+}
+
+shared_page_cache::ptr shared_page_cache::create(const std::string &name,
+		size_t size)
+{
+	ptr cache = ptr(new shared_page_cache(name));
+	if (!cache->attach(size))
+		return ptr();
+	return cache;
+}
+
+bool shared_page_cache::attach(size_t size)
+{
+	bool creator = true;
+	int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0666);
+	if (fd < 0 && errno == EEXIST) {
+		creator = false;
+		fd = shm_open(name.c_str(), O_RDWR, 0);
+	}
+	if (fd < 0) {
+		BOOST_LOG_TRIVIAL(error) << boost::format("can't open %1%: %2%")
+			% name % strerror(errno);
+		return false;
+	}
+
+	size_t num_sets = std::max(size / PAGE_SIZE / SET_SIZE, 1UL);
+	if (creator) {
+		seg_size = get_frames_off(num_sets) + num_sets * SET_SIZE * PAGE_SIZE;
+		if (ftruncate(fd, seg_size) < 0) {
+			BOOST_LOG_TRIVIAL(error) << boost::format(
+					"can't set the size of %1%: %2%") % name % strerror(errno);
+			close(fd);
+			shm_unlink(name.c_str());
+			return false;
+		}
+	}
+	else {
+		// The size of the segment is decided by the process that creates it.
+		struct stat st;
+		for (int i = 0; i < MAX_INIT_WAIT; i++) {
+			if (fstat(fd, &st) == 0 && st.st_size > 0)
+				break;
+			usleep(1000);
+		}
+		seg_size = st.st_size;
+	}
+
+	void *addr = NULL;
+	if (seg_size > 0)
+		addr = mmap(NULL, seg_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (addr == NULL || addr == MAP_FAILED) {
+		BOOST_LOG_TRIVIAL(error) << boost::format("can't map %1%: %2%")
+			% name % strerror(errno);
+		if (creator)
+			shm_unlink(name.c_str());
+		return false;
+	}
+	header = (shm_segment_header *) addr;
+	sets = (shm_page_set *) ((char *) addr + get_sets_off());
+
+	if (creator) {
+		header->num_sets = num_sets;
+		header->num_procs = 0;
+		pthread_mutexattr_t attr;
+		pthread_mutexattr_init(&attr);
+		pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+		pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+		pthread_mutex_init(&header->procs_lock, &attr);
+		for (size_t i = 0; i < num_sets; i++) {
+			pthread_mutex_init(&sets[i].lock, &attr);
+			sets[i].version = 0;
+			sets[i].clock_hand = 0;
+			memset(sets[i].slots, 0, sizeof(sets[i].slots));
+		}
+		pthread_mutexattr_destroy(&attr);
+		// The other processes can use the segment once they see the magic
+		// number.
+		__sync_synchronize();
+		header->magic = SEGMENT_MAGIC;
+	}
+	else {
+		for (int i = 0; i < MAX_INIT_WAIT && header->magic != SEGMENT_MAGIC; i++)
+			usleep(1000);
+		__sync_synchronize();
+		if (header->magic != SEGMENT_MAGIC || seg_size < get_frames_off(
+					header->num_sets) + header->num_sets * SET_SIZE * PAGE_SIZE) {
+			BOOST_LOG_TRIVIAL(error) << boost::format(
+					"%1% isn't a valid shared page cache") % name;
+			munmap(header, seg_size);
+			header = NULL;
+			return false;
+		}
+	}
+	frames = (char *) addr + get_frames_off(header->num_sets);
+
+	lock_robust(&header->procs_lock);
+	remove_dead_procs(header);
+	bool attached = header->num_procs < MAX_NUM_PROCS;
+	if (attached)
+		header->procs[header->num_procs++] = pid;
+	pthread_mutex_unlock(&header->procs_lock);
+	if (!attached) {
+		BOOST_LOG_TRIVIAL(error) << boost::format(
+				"too many processes are attached to %1%") % name;
+		munmap(header, seg_size);
+		header = NULL;
+		return false;
+	}
+	return true;
+}
+
+shared_page_cache::~shared_page_cache()
+{
+	if (header == NULL)
+		return;
+	// A child process inherits the mapping, but it isn't attached.
+	if (pid == getpid()) {
+		lock_robust(&header->procs_lock);
+		remove_dead_procs(header);
+		bool last = false;
+		for (int i = 0; i < header->num_procs; i++) {
+			if (header->procs[i] == pid) {
+				header->procs[i] = header->procs[--header->num_procs];
+				last = header->num_procs == 0;
+				break;
+			}
+		}
+		// The last process removes the segment.
+		if (last)
+			shm_unlink(name.c_str());
+		pthread_mutex_unlock(&header->procs_lock);
+	}
+	munmap(header, seg_size);
+}
+
+void shared_page_cache::add_file(int file_id, const std::string &file_name)
+{
+	file_lock.lock();
+	file_keys[file_id] = hash_file_name(file_name);
+	file_lock.unlock();
+}
+
+void shared_page_cache::add_file(int file_id, const RAID_config &conf,
+		const std::string &file_name)
+{
+	std::string name;
+	for (int i = 0; i < conf.get_num_disks(); i++)
+		name += conf.get_disk(i).get_file_name() + "/" + file_name + ":";
+	add_file(file_id, name);
+}
+
+bool shared_page_cache::get_file_key(int file_id, uint64_t &key)
+{
+	file_lock.lock();
+	auto it = file_keys.find(file_id);
+	bool found = it != file_keys.end();
+	if (found)
+		key = it->second;
+	file_lock.unlock();
+	return found;
+}
+
+shm_page_set &shared_page_cache::get_set(uint64_t file_key,
+		uint64_t pg_idx, size_t &set_idx)
+{
+	set_idx = (file_key ^ (pg_idx * 11400714819323198485UL))
+		% header->num_sets;
+	return sets[set_idx];
+}
+
+void shared_page_cache::lock_set(shm_page_set &set)
+{
+	int ret = pthread_mutex_lock(&set.lock);
+	if (ret == EOWNERDEAD) {
+		// The process holding the lock died in the middle of updating
+		// the set, so we can't trust the pages in the set.
+		for (int i = 0; i < SET_SIZE; i++)
+			set.slots[i].pg_idx = 0;
+		set.version++;
+		pthread_mutex_consistent(&set.lock);
+	}
+}
+
+void shared_page_cache::unlock_set(shm_page_set &set)
+{
+	pthread_mutex_unlock(&set.lock);
+}
+
+int shared_page_cache::find_slot(const shm_page_set &set, uint64_t file_key,
+		uint64_t pg_idx) const
+{
+	for (int i = 0; i < SET_SIZE; i++)
+		if (set.slots[i].pg_idx == pg_idx && set.slots[i].file_key == file_key)
+			return i;
+	return -1;
+}
+
+uint32_t shared_page_cache::get_version(const page_id_t &pg_id)
+{
+	uint64_t file_key;
+	if (!get_file_key(pg_id.get_file_id(), file_key))
+		return 0;
+	uint64_t pg_idx = pg_id.get_offset() / PAGE_SIZE + 1;
+	size_t set_idx;
+	shm_page_set &set = get_set(file_key, pg_idx, set_idx);
+	lock_set(set);
+	uint32_t version = set.version;
+	unlock_set(set);
+	return version;
+}
+
+bool shared_page_cache::add(const page_id_t &pg_id, const char *page,
+		uint32_t version)
+{
+	uint64_t file_key;
+	if (!get_file_key(pg_id.get_file_id(), file_key))
+		return false;
+	uint64_t pg_idx = pg_id.get_offset() / PAGE_SIZE + 1;
+	size_t set_idx;
+	shm_page_set &set = get_set(file_key, pg_idx, set_idx);
+	lock_set(set);
+	// The page may have been written by another process after we read it.
+	if (set.version != version) {
+		unlock_set(set);
+		num_stale_adds.inc(1);
+		return false;
+	}
+	int idx = find_slot(set, file_key, pg_idx);
+	for (int i = 0; i < SET_SIZE && idx < 0; i++)
+		if (set.slots[i].pg_idx == 0)
+			idx = i;
+	while (idx < 0) {
+		page_slot &slot = set.slots[set.clock_hand];
+		if (slot.referenced)
+			slot.referenced = 0;
+		else
+			idx = set.clock_hand;
+		set.clock_hand = (set.clock_hand + 1) % SET_SIZE;
+	}
+	set.slots[idx].file_key = file_key;
+	set.slots[idx].pg_idx = pg_idx;
+	set.slots[idx].referenced = 0;
+	memcpy(frames + (set_idx * SET_SIZE + idx) * PAGE_SIZE, page, PAGE_SIZE);
+	unlock_set(set);
+	num_adds.inc(1);
+	return true;
+}
+
+bool shared_page_cache::fetch(const page_id_t &pg_id, char *page)
+{
+	num_lookups.inc(1);
+	uint64_t file_key;
+	if (!get_file_key(pg_id.get_file_id(), file_key))
+		return false;
+	uint64_t pg_idx = pg_id.get_offset() / PAGE_SIZE + 1;
+	size_t set_idx;
+	shm_page_set &set = get_set(file_key, pg_idx, set_idx);
+	lock_set(set);
+	int idx = find_slot(set, file_key, pg_idx);
+	if (idx >= 0) {
+		set.slots[idx].referenced = 1;
+		memcpy(page, frames + (set_idx * SET_SIZE + idx) * PAGE_SIZE,
+				PAGE_SIZE);
+	}
+	unlock_set(set);
+	if (idx >= 0)
+		num_hits.inc(1);
+	return idx >= 0;
+}
+
+void shared_page_cache::invalidate(const page_id_t &pg_id)
+{
+	uint64_t file_key;
+	if (!get_file_key(pg_id.get_file_id(), file_key))
+		return;
+	uint64_t pg_idx = pg_id.get_offset() / PAGE_SIZE + 1;
+	size_t set_idx;
+	shm_page_set &set = get_set(file_key, pg_idx, set_idx);
+	lock_set(set);
+	int idx = find_slot(set, file_key, pg_idx);
+	if (idx >= 0)
+		set.slots[idx].pg_idx = 0;
+	// Another process may be reading the page from the disks, so we have
+	// to invalidate its copy even if the page isn't in the set yet.
+	set.version++;
+	unlock_set(set);
+	num_invalidates.inc(1);
+}
+
+/*
+ * It reads the sets without locking them, so it only returns an estimate.
+ */
+size_t shared_page_cache::get_num_pages() const
+{
+	size_t num_pages = 0;
+	for (size_t i = 0; i < header->num_sets; i++)
+		for (int j = 0; j < SET_SIZE; j++)
+			if (sets[i].slots[j].pg_idx)
+				num_pages++;
+	return num_pages;
+}
+
+int shared_page_cache::get_num_procs() const
+{
+	return header->num_procs;
+}
+
+void shared_page_cache::print_stat() const
+{
+	BOOST_LOG_TRIVIAL(info) << boost::format(
+			"shared cache %1%: %2% pages, %3% processes, %4% adds, %5% stale adds, %6% invalidates")
+		% name % get_num_pages() % get_num_procs() % num_adds.get()
+		% num_stale_adds.get() % num_invalidates.get();
+	BOOST_LOG_TRIVIAL(info) << boost::format(
+			"shared cache %1%: %2% lookups, %3% hits") % name
+		% num_lookups.get() % num_hits.get();
+}
+
+}
@@ -0,0 +1,172 @@
+#ifndef __SHARED_CACHE_H__
+#define __SHARED_CACHE_H__
+
+/*
+ * Copyright 2014 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of SAFSlib.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "cache.h"
+#include "concurrency.h"
+
+namespace safs
+{
+
+struct shm_segment_header;
+struct shm_page_set;
+class RAID_config;
+
+/**
+ * This is a tier of the page cache shared by all processes on the machine.
+ * It keeps clean pages in a named POSIX shared memory segment, so
+ * the processes that access the same files read the data from the disks
+ * only once.
+ *
+ * The page cache of a process can't be shared directly because its pages
+ * refer to the I/O requests and the I/O instances of the process. Instead,
+ * a process copies the pages it reads from the disks to this tier and
+ * looks for the pages here before it reads them from the disks.
+ *
+ * File ids are assigned by each process, so a page is identified by
+ * the hash of its file name and its location in the file. The name has to
+ * identify the file among all processes, so it should include the disks
+ * where the file is stored. The pages of the files that haven't been added
+ * with add_file() aren't shared.
+ *
+ * A process may read a page from the disks while another process writes
+ * the page. To avoid adding the old data after the writer invalidates
+ * the page, each set has a version that is increased by invalidations.
+ * A process gets the version before it reads the page from the disks and
+ * the page is added only if the version hasn't changed.
+ *
+ * The segment is a set-associative cache. Each set is protected by
+ * a robust process-shared mutex, so a process that dies while holding
+ * the lock doesn't block the others. The segment keeps the list of
+ * the processes attached to it and is removed when the last one detaches.
+ * The processes that exit without detaching are removed from the list.
+ */
+class shared_page_cache
+{
+	std::string name;
+	// The size of the mapped segment.
+	size_t seg_size;
+	// The process that attaches to the segment.
+	pid_t pid;
+	shm_segment_header *header;
+	shm_page_set *sets;
+	char *frames;
+
+	// The hashes of the file names, indexed by the file ids in the process.
+	spin_lock file_lock;
+	std::unordered_map<int, uint64_t> file_keys;
+
+	atomic_number<long> num_lookups;
+	atomic_number<long> num_hits;
+	atomic_number<long> num_adds;
+	atomic_number<long> num_stale_adds;
+	atomic_number<long> num_invalidates;
+
+	static shared_page_cache *global_cache;
+
+	shared_page_cache(const std::string &name);
+	bool attach(size_t size);
+
+	bool get_file_key(int file_id, uint64_t &key);
+	shm_page_set &get_set(uint64_t file_key, uint64_t pg_idx, size_t &set_idx);
+	void lock_set(shm_page_set &set);
+	void unlock_set(shm_page_set &set);
+	int find_slot(const shm_page_set &set, uint64_t file_key, uint64_t pg_idx) const;
+public:
+	typedef std::shared_ptr<shared_page_cache> ptr;
+
+	/**
+	 * Attach to the shared memory segment with the name. If the segment
+	 * doesn't exist, create one with `size' bytes of pages.
+	 * It returns NULL if it can't map the segment.
+	 */
+	static ptr create(const std::string &name, size_t size);
+
+	/**
+	 * The shared cache used by the page cache of the process.
+	 * It's NULL if the shared cache isn't enabled.
+	 */
+	static shared_page_cache *get_global() {
+		return global_cache;
+	}
+
+	static void set_global(shared_page_cache *cache) {
+		global_cache = cache;
+	}
+
+	~shared_page_cache();
+
+	/**
+	 * Share the pages of a file opened in the process.
+	 * `file_name' should identify the file on the machine.
+	 */
+	void add_file(int file_id, const std::string &file_name);
+	/**
+	 * Share the pages of a SAFS file. The file is identified by its name
+	 * and the disks in `conf', so the files with the same name in
+	 * different SAFS instances don't share pages.
+	 */
+	void add_file(int file_id, const RAID_config &conf,
+			const std::string &file_name);
+
+	/**
+	 * Get the version of the page. It has to be called before the page
+	 * is read from the disks.
+	 */
+	uint32_t get_version(const page_id_t &pg_id);
+
+	/**
+	 * Copy a clean page to the shared cache. It replaces the old data of
+	 * the page if the page is already in the shared cache.
+	 * It returns false if the pages of the file aren't shared or the page
+	 * has been invalidated since we got `version'.
+	 */
+	bool add(const page_id_t &pg_id, const char *page, uint32_t version);
+	/**
+	 * Copy the data of the page to the buffer.
+	 * It returns false if the page doesn't exist.
+	 */
+	bool fetch(const page_id_t &pg_id, char *page);
+	/**
+	 * Remove the page from the shared cache.
+	 */
+	void invalidate(const page_id_t &pg_id);
+
+	size_t get_num_pages() const;
+	/**
+	 * The number of processes attached to the shared cache.
+	 */
+	int get_num_procs() const;
+
+	void print_stat() const;
+};
+
+}
+
+#endif
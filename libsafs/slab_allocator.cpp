@@ -24,6 +24,7 @@
 #include <sys/mman.h>
 
 #include "slab_allocator.h"
+#include "huge_page_arena.h"
 
 static atomic_number<size_t> tot_slab_size;
 
@@ -48,6 +49,7 @@ slab_allocator::slab_allocator(const std::string &name, int _obj_size,
 	this->name = name + "-" + itoa(alloc_counter.inc(1));
 	this->init = init;
 	this->pinned = pinned;
+	arena = huge_page_arena::get(node_id);
 	assert((unsigned) obj_size >= sizeof(linked_obj));
 	// we only need to initialize them when we want to buffer objects locally.
 	if (local_buf_size > 0) {
@@ -130,14 +132,18 @@ int slab_allocator::alloc(char **objs, int nobjs) {
 			if (thread_safe)
 				lock.unlock();
 			char *objs;
+			if (arena)
+				objs = arena->alloc(increase_size);
+			else {
 #ifdef USE_NUMA
-			if (node_id == -1)
-				objs = (char *) numa_alloc_local(increase_size);
-			else
-				objs = (char *) numa_alloc_onnode(increase_size, node_id);
+				if (node_id == -1)
+					objs = (char *) numa_alloc_local(increase_size);
+				else
+					objs = (char *) numa_alloc_onnode(increase_size, node_id);
 #else
-			objs = (char *) malloc_aligned(increase_size, PAGE_SIZE);
+				objs = (char *) malloc_aligned(increase_size, PAGE_SIZE);
 #endif
+			}
 			assert(objs);
 #ifdef USE_IOAT
 			if (pinned) {
@@ -163,6 +169,7 @@ int slab_allocator::alloc(char **objs, int nobjs) {
 			list.add_list(&tmp_list);
 			if (thread_safe)
 				lock.unlock();
+			add_alloc_buf(objs, increase_size);
 		}
 		else {
 			if (thread_safe)
@@ -190,11 +197,16 @@ slab_allocator::~slab_allocator()
 			munlock(alloc_bufs[i], increase_size);
 		}
 #endif
+		if (arena)
+			arena->free(alloc_bufs[i], increase_size);
+		else {
 #ifdef USE_NUMA
-		numa_free(alloc_bufs[i], increase_size);
+			numa_free(alloc_bufs[i], increase_size);
 #else
-		free(alloc_bufs[i]);
+			// free() in the class returns an object to the allocator.
+			::free(alloc_bufs[i]);
 #endif
+		}
 	}
 #ifdef ENABLE_MEM_TRACE
 	printf("%s allocate %ld bytes\n", name.c_str(), alloc_bufs.size() * increase_size);
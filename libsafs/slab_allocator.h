@@ -31,6 +31,8 @@
 
 static const int SLAB_LOCAL_BUF_SIZE = 100;
 
+class huge_page_arena;
+
 class slab_allocator
 {
 public:
@@ -140,6 +142,9 @@ private:
 	atomic_number<long> curr_size;
 	bool init;
 	bool pinned;
+	// The arena where we get memory from. It's NULL if huge pages aren't
+	// enabled when the allocator is created.
+	huge_page_arena *arena;
 
 	std::vector<char *> alloc_bufs;
 
@@ -166,6 +171,13 @@ private:
 #ifdef MEMCHECK
 	aligned_allocator allocator;
 #endif
+protected:
+	/*
+	 * This is invoked when the allocator gets a new chunk of memory
+	 * from the system.
+	 */
+	virtual void add_alloc_buf(char *buf, long size) {
+	}
 public:
 	slab_allocator(const std::string &name, int _obj_size, long _increase_size,
 			// We allow pages to be pinned when allocated.
@@ -178,6 +190,10 @@ public:
 		return obj_size;
 	}
 
+	int get_node_id() const {
+		return node_id;
+	}
+
 	int alloc(char **objs, int num);
 
 	void free(char **objs, int num);
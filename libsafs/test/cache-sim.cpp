@@ -0,0 +1,266 @@
+/*
+ * Copyright 2014 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of SAFSlib.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * This replays I/O traces against the page cache without accessing disks.
+ * It runs an associative_cache with the given size and policy in a single
+ * thread, so we can see how a cache configuration works for a workload
+ * before running it on the real system.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "workload.h"
+#include "associative_cache.h"
+#include "seq_prefetcher.h"
+
+using namespace safs;
+
+struct sim_stats
+{
+	size_t num_reqs;
+	size_t num_page_accesses;
+	size_t num_hits;
+	size_t num_read_ios;
+	size_t num_read_pages;
+	size_t num_write_pages;
+	size_t num_prefetch_ios;
+
+	sim_stats() {
+		num_reqs = 0;
+		num_page_accesses = 0;
+		num_hits = 0;
+		num_read_ios = 0;
+		num_read_pages = 0;
+		num_write_pages = 0;
+		num_prefetch_ios = 0;
+	}
+};
+
+class cache_sim
+{
+	page_cache &cache;
+	seq_prefetcher *prefetcher;
+	int file_id;
+	off_t file_size;
+	off_t block_size;
+	sim_stats &stats;
+
+	/*
+	 * Get a page from the cache. It returns true if the page was cached.
+	 * The page is always cached afterwards.
+	 */
+	bool fetch_page(off_t pg_off) {
+		page_id_t old_id;
+		thread_safe_page *p = (thread_safe_page *) cache.search(
+				page_id_t(file_id, pg_off), old_id);
+		// We release every page right away, so it can't happen.
+		assert(p);
+		bool hit = p->data_ready();
+		p->set_data_ready(true);
+		p->dec_ref();
+		return hit;
+	}
+
+	void prefetch();
+public:
+	cache_sim(page_cache &_cache, seq_prefetcher *prefetcher, int file_id,
+			off_t file_size, sim_stats &_stats): cache(_cache), stats(_stats) {
+		this->prefetcher = prefetcher;
+		this->file_id = file_id;
+		this->file_size = file_size;
+		this->block_size = params.get_RAID_block_size() * PAGE_SIZE;
+	}
+
+	void access(const workload_t &req);
+};
+
+/*
+ * This follows global_cached_io::prefetch(). The pages that are read
+ * ahead together are counted as one I/O unless they cross a RAID block.
+ */
+void cache_sim::prefetch()
+{
+	off_t off;
+	int num_pages = prefetcher->end_read(off);
+	if (num_pages == 0)
+		return;
+
+	off_t end = std::min(off + ((off_t) num_pages) * PAGE_SIZE,
+			ROUND_PAGE(file_size));
+	int num_issued = 0;
+	bool in_io = false;
+	for (; off < end; off += PAGE_SIZE) {
+		if (off % block_size == 0)
+			in_io = false;
+		if (fetch_page(off))
+			in_io = false;
+		else {
+			if (!in_io)
+				stats.num_prefetch_ios++;
+			in_io = true;
+			num_issued++;
+		}
+	}
+	prefetcher->prefetched(off, num_issued);
+}
+
+void cache_sim::access(const workload_t &req)
+{
+	stats.num_reqs++;
+	if (prefetcher && req.read)
+		prefetcher->start_read(req.off, req.size);
+
+	off_t begin = req.off;
+	off_t end = req.off + req.size;
+	bool in_io = false;
+	for (off_t pg_off = ROUND_PAGE(begin); pg_off < end; pg_off += PAGE_SIZE) {
+		stats.num_page_accesses++;
+		bool hit = fetch_page(pg_off);
+		if (hit)
+			stats.num_hits++;
+		if (prefetcher && req.read)
+			prefetcher->access_page(pg_off, hit);
+		if (!req.read)
+			stats.num_write_pages++;
+
+		// A page partially overwritten has to be read first.
+		bool full_write = !req.read && pg_off >= begin
+			&& pg_off + PAGE_SIZE <= end;
+		if (pg_off % block_size == 0 || hit || full_write)
+			in_io = false;
+		if (!hit && !full_write) {
+			if (!in_io)
+				stats.num_read_ios++;
+			in_io = true;
+			stats.num_read_pages++;
+		}
+	}
+	if (prefetcher && req.read)
+		prefetch();
+}
+
+void print_usage()
+{
+	fprintf(stderr, "cache-sim [options] trace_files\n");
+	fprintf(stderr, "-c size: the cache size (default: 512M)\n");
+	fprintf(stderr, "-C num: the min number of pages in a cell\n");
+	fprintf(stderr, "-a: use ARC in the cells\n");
+	fprintf(stderr, "-p num: the max number of pages read ahead for a stream\n");
+	fprintf(stderr, "-b size: the RAID block size\n");
+}
+
+int main(int argc, char *argv[])
+{
+	long cache_size = 512L * 1024 * 1024;
+	bool use_arc = false;
+	int max_prefetch = 0;
+	std::map<std::string, std::string> configs;
+	int opt;
+	while ((opt = getopt(argc, argv, "c:C:ap:b:")) != -1) {
+		switch (opt) {
+			case 'c':
+				cache_size = str2size(optarg);
+				break;
+			case 'C':
+				configs["SA_min_cell_size"] = optarg;
+				break;
+			case 'a':
+				use_arc = true;
+				break;
+			case 'p':
+				max_prefetch = atoi(optarg);
+				break;
+			case 'b':
+				configs["RAID_block_size"] = optarg;
+				break;
+			default:
+				print_usage();
+				exit(1);
+		}
+	}
+	if (optind >= argc) {
+		print_usage();
+		exit(1);
+	}
+	params.init(configs);
+
+	page_cache::ptr cache = associative_cache::create(cache_size,
+			MAX_CACHE_SIZE, 0, 1, 100, false, use_arc);
+	// A trace has the requests to a single file, so each trace has its
+	// own prefetcher, and its requests are replayed in order. The requests
+	// of multiple traces are interleaved one by one.
+	std::vector<std::vector<workload_t> > traces;
+	std::vector<std::unique_ptr<seq_prefetcher> > prefetchers;
+	std::vector<cache_sim> sims;
+	sim_stats stats;
+	for (int i = optind; i < argc; i++) {
+		traces.push_back(load_io_trace(argv[i]));
+		off_t file_size = 0;
+		for (size_t j = 0; j < traces.back().size(); j++)
+			file_size = std::max(file_size,
+					traces.back()[j].off + traces.back()[j].size);
+		printf("%s has %ld requests and accesses %ld bytes of the file\n",
+				argv[i], traces.back().size(), file_size);
+		prefetchers.emplace_back(max_prefetch > 0
+				? new seq_prefetcher(max_prefetch) : NULL);
+		sims.push_back(cache_sim(*cache, prefetchers.back().get(),
+					i - optind, file_size, stats));
+	}
+
+	for (size_t j = 0; ; j++) {
+		bool has_reqs = false;
+		for (size_t i = 0; i < traces.size(); i++) {
+			if (j < traces[i].size()) {
+				sims[i].access(traces[i][j]);
+				has_reqs = true;
+			}
+		}
+		if (!has_reqs)
+			break;
+	}
+
+	cache->print_stat();
+	printf("cache size: %ld, ARC: %d, max prefetch: %d pages\n",
+			cache_size, use_arc, max_prefetch);
+	printf("%ld requests access %ld pages, %ld hits, hit rate: %.2f%%\n",
+			stats.num_reqs, stats.num_page_accesses, stats.num_hits,
+			stats.num_page_accesses == 0 ? 0
+			: ((double) stats.num_hits) / stats.num_page_accesses * 100);
+	printf("read %ld pages in %ld I/Os, write %ld pages\n",
+			stats.num_read_pages, stats.num_read_ios, stats.num_write_pages);
+	if (max_prefetch > 0) {
+		size_t num_prefetched = 0;
+		size_t num_useful = 0;
+		size_t num_evicted = 0;
+		for (size_t i = 0; i < prefetchers.size(); i++) {
+			num_prefetched += prefetchers[i]->get_num_prefetched_pages();
+			num_useful += prefetchers[i]->get_num_useful_pages();
+			num_evicted += prefetchers[i]->get_num_evicted_pages();
+		}
+		printf("read ahead %ld pages in %ld I/Os, %ld are used, %ld are evicted unused\n",
+				num_prefetched, stats.num_prefetch_ios, num_useful, num_evicted);
+	}
+}
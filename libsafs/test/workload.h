@@ -33,6 +33,7 @@
 
 #include "container.h"
 #include "cache.h"
+#include "io_trace.h"
 
 #define CHUNK_SLOTS 1024
 
@@ -41,12 +42,7 @@ const int WORKLOAD_BUF_SIZE = 1024 * 32;
 void permute_offsets(int num, int repeats, int stride, off_t start,
 		off_t offsets[]);
 
-typedef struct workload_type
-{
-	off_t off;
-	int size: 31;
-	int read: 1;
-} workload_t;
+typedef safs::workload_t workload_t;
 
 class workload_pack
 {
@@ -21,6 +21,8 @@
  */
 
 #include <pthread.h>
+#include <errno.h>
+#include <time.h>
 #ifdef USE_HWLOC
 #include <hwloc.h>
 #endif
@@ -106,6 +108,35 @@ public:
 		pthread_mutex_unlock(&mutex);
 	}
 
+	/*
+	 * Wait until the thread is activated or `timeout_ns' nanoseconds pass.
+	 * It returns true if the thread is activated.
+	 */
+	bool wait(long timeout_ns) {
+		struct timespec deadline;
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_sec += timeout_ns / 1000000000L;
+		deadline.tv_nsec += timeout_ns % 1000000000L;
+		if (deadline.tv_nsec >= 1000000000L) {
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000L;
+		}
+		pthread_mutex_lock(&mutex);
+		while (!_is_activated && _is_running) {
+			_is_sleeping = true;
+			int ret = pthread_cond_timedwait(&cond, &mutex, &deadline);
+			_is_sleeping = false;
+			if (ret == ETIMEDOUT)
+				break;
+			if (ret)
+				perror("pthread_cond_timedwait");
+		}
+		bool activated = _is_activated;
+		_is_activated = false;
+		pthread_mutex_unlock(&mutex);
+		return activated;
+	}
+
 	bool is_running() const {
 		return _is_running;
 	}
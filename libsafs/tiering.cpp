@@ -0,0 +1,409 @@
+/*
+ * Copyright 2014 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of SAFSlib.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <unordered_map>
+
+#include <boost/format.hpp>
+
+#include "log.h"
+#include "tiering.h"
+
+namespace safs
+{
+
+static pthread_mutex_t tables_lock = PTHREAD_MUTEX_INITIALIZER;
+static std::unordered_map<std::string, std::weak_ptr<block_tier_table> > tables;
+
+block_tier_table::ptr block_tier_table::get(const std::string &name,
+		const std::vector<part_file_info> &files,
+		const std::vector<bool> &fast_parts, int block_size, int num_slots,
+		size_t num_blocks)
+{
+	pthread_mutex_lock(&tables_lock);
+	auto it = tables.find(name);
+	ptr table;
+	if (it != tables.end())
+		table = it->second.lock();
+	// The mappers created for the directories of a file when the file is
+	// created or resized don't access data, and they don't share the table
+	// with the mappers used by the I/O layers.
+	if (table && table->files[0].get_file_name() != files[0].get_file_name())
+		table = ptr(new block_tier_table(name, files, fast_parts, block_size,
+					num_slots, num_blocks));
+	else if (table == NULL) {
+		table = ptr(new block_tier_table(name, files, fast_parts, block_size,
+					num_slots, num_blocks));
+		tables[name] = table;
+	}
+	pthread_mutex_unlock(&tables_lock);
+	return table;
+}
+
+block_tier_table::ptr block_tier_table::find(const std::string &name)
+{
+	pthread_mutex_lock(&tables_lock);
+	auto it = tables.find(name);
+	ptr table;
+	if (it != tables.end())
+		table = it->second.lock();
+	pthread_mutex_unlock(&tables_lock);
+	return table;
+}
+
+std::vector<block_tier_table::ptr> block_tier_table::get_all()
+{
+	std::vector<ptr> ret;
+	pthread_mutex_lock(&tables_lock);
+	for (auto it = tables.begin(); it != tables.end(); ) {
+		ptr table = it->second.lock();
+		if (table) {
+			ret.push_back(table);
+			it++;
+		}
+		else
+			it = tables.erase(it);
+	}
+	pthread_mutex_unlock(&tables_lock);
+	return ret;
+}
+
+block_tier_table::block_tier_table(const std::string &name,
+		const std::vector<part_file_info> &files,
+		const std::vector<bool> &fast_parts, int block_size, int num_slots,
+		size_t num_blocks): slots(num_blocks, -1), retired(num_blocks, -1),
+	heat(num_blocks), slot_owners(num_slots, -1), fds(files.size(), -1)
+{
+	this->name = name;
+	this->files = files;
+	this->block_size = block_size;
+	this->num_slots = num_slots;
+	this->num_blocks = num_blocks;
+	for (size_t i = 0; i < files.size(); i++) {
+		if (fast_parts[i])
+			fast_idxs.push_back(i);
+		else
+			cap_idxs.push_back(i);
+	}
+	assert(!cap_idxs.empty());
+	// The fast tier can't have any blocks if it doesn't have partitions.
+	if (fast_idxs.empty())
+		this->num_slots = 0;
+	epoch = 0;
+	buf = NULL;
+	num_promotions = 0;
+	num_demotions = 0;
+}
+
+block_tier_table::~block_tier_table()
+{
+	for (size_t i = 0; i < fds.size(); i++)
+		if (fds[i] >= 0)
+			close(fds[i]);
+	free(buf);
+}
+
+void block_tier_table::map_slot(int slot, int idx_in_block,
+		block_identifier &bid) const
+{
+	bid.idx = fast_idxs[slot % fast_idxs.size()];
+	bid.off = (slot / fast_idxs.size()) * block_size + idx_in_block;
+}
+
+void block_tier_table::map_home(off_t off, block_identifier &bid) const
+{
+	int idx_in_block = off % block_size;
+	off_t block_idx = off / block_size;
+	bid.idx = cap_idxs[block_idx % cap_idxs.size()];
+	bid.off = block_idx / cap_idxs.size() * block_size + idx_in_block;
+}
+
+void block_tier_table::map(off_t off, block_identifier &bid) const
+{
+	int slot = get_slot(off / block_size);
+	if (slot >= 0)
+		map_slot(slot, off % block_size, bid);
+	else
+		map_home(off, bid);
+}
+
+int block_tier_table::map2file(off_t off) const
+{
+	block_identifier bid;
+	map(off, bid);
+	return bid.idx;
+}
+
+int block_tier_table::begin_read()
+{
+	while (true) {
+		int e = __atomic_load_n(&epoch, __ATOMIC_SEQ_CST);
+		num_reads[e].inc(1);
+		// If the migrator has started a new epoch before we count the read,
+		// it may not wait for the read, so we count it in the new epoch.
+		if (__atomic_load_n(&epoch, __ATOMIC_SEQ_CST) == e)
+			return e;
+		num_reads[e].dec(1);
+	}
+}
+
+bool block_tier_table::map_other(off_t off, block_identifier &bid) const
+{
+	off_t block_idx = off / block_size;
+	if (get_slot(block_idx) >= 0) {
+		map_home(off, bid);
+		return true;
+	}
+	if ((size_t) block_idx >= num_blocks)
+		return false;
+	int slot = __atomic_load_n(&retired[block_idx], __ATOMIC_ACQUIRE);
+	if (slot < 0)
+		return false;
+	map_slot(slot, off % block_size, bid);
+	return true;
+}
+
+std::vector<size_t> block_tier_table::get_size_per_disk(size_t size) const
+{
+	std::vector<size_t> ret(files.size());
+	size_t num_blocks = div_ceil<size_t>(size, block_size);
+	for (size_t i = 0; i < cap_idxs.size(); i++) {
+		// The number of blocks stored in the partition.
+		size_t num = num_blocks / cap_idxs.size()
+			+ (i < num_blocks % cap_idxs.size());
+		ret[cap_idxs[i]] = num * block_size;
+	}
+	for (size_t i = 0; i < fast_idxs.size(); i++) {
+		size_t num = num_slots / fast_idxs.size()
+			+ (i < num_slots % fast_idxs.size());
+		ret[fast_idxs[i]] = num * block_size;
+	}
+	return ret;
+}
+
+int block_tier_table::get_num_fast_blocks() const
+{
+	int num = 0;
+	for (size_t i = 0; i < num_blocks; i++)
+		if (get_slot(i) >= 0)
+			num++;
+	return num;
+}
+
+bool block_tier_table::copy_block(off_t block_idx, int slot)
+{
+	block_identifier from, to;
+	map_home(block_idx * block_size, from);
+	map_slot(slot, 0, to);
+	int idxs[] = {from.idx, to.idx};
+	for (int i = 0; i < 2; i++) {
+		if (fds[idxs[i]] >= 0)
+			continue;
+		int flags = O_DIRECT | (files[idxs[i]].is_fast() ? O_RDWR : O_RDONLY);
+		fds[idxs[i]] = open(files[idxs[i]].get_file_name().c_str(), flags);
+		if (fds[idxs[i]] < 0) {
+			BOOST_LOG_TRIVIAL(error) << boost::format("open %1%: %2%")
+				% files[idxs[i]].get_file_name() % strerror(errno);
+			return false;
+		}
+	}
+	size_t size = block_size * PAGE_SIZE;
+	if (buf == NULL)
+		buf = (char *) valloc(size);
+	// The last block may be incomplete.
+	ssize_t ret = pread(fds[from.idx], buf, size, from.off * PAGE_SIZE);
+	if (ret <= 0) {
+		BOOST_LOG_TRIVIAL(error) << boost::format(
+				"can't read block %1% of %2% for migration") % block_idx % name;
+		return false;
+	}
+	size = ROUNDUP(ret, PAGE_SIZE);
+	if (pwrite(fds[to.idx], buf, size, to.off * PAGE_SIZE) != (ssize_t) size) {
+		BOOST_LOG_TRIVIAL(error) << boost::format(
+				"can't write block %1% of %2% to the fast tier")
+			% block_idx % name;
+		return false;
+	}
+	return true;
+}
+
+void block_tier_table::promote(off_t block_idx, int slot)
+{
+	slot_owners[slot] = block_idx;
+	// The data has been copied before the block is mapped to the slot.
+	__atomic_store_n(&slots[block_idx], slot, __ATOMIC_RELEASE);
+	num_promotions++;
+}
+
+void block_tier_table::demote(off_t block_idx)
+{
+	int slot = slots[block_idx];
+	__atomic_store_n(&retired[block_idx], slot, __ATOMIC_RELEASE);
+	__atomic_store_n(&slots[block_idx], -1, __ATOMIC_RELEASE);
+	retired_slots.push_back(slot);
+	num_demotions++;
+}
+
+struct heat_greater
+{
+	const std::vector<uint32_t> &heat;
+
+	heat_greater(const std::vector<uint32_t> &_heat): heat(_heat) {
+	}
+
+	bool operator()(off_t b1, off_t b2) const {
+		return heat[b1] > heat[b2];
+	}
+};
+
+void block_tier_table::migrate(int max_blocks)
+{
+	if (num_slots == 0)
+		return;
+
+	// The reads that may access the slots retired before the current epoch
+	// have completed, so the slots can be reused.
+	if (!draining_slots.empty() && num_reads[1 - epoch].get() == 0) {
+		for (size_t i = 0; i < draining_slots.size(); i++) {
+			int slot = draining_slots[i];
+			off_t block_idx = slot_owners[slot];
+			__atomic_store_n(&retired[block_idx], -1, __ATOMIC_RELEASE);
+			slot_owners[slot] = -1;
+		}
+		draining_slots.clear();
+	}
+	// The blocks have been removed from the fast tier, so the reads that
+	// start in the new epoch don't map them to the retired slots.
+	if (draining_slots.empty() && !retired_slots.empty()) {
+		draining_slots.swap(retired_slots);
+		__atomic_store_n(&epoch, 1 - epoch, __ATOMIC_SEQ_CST);
+	}
+
+	// Find the hottest blocks that fit in the fast tier.
+	std::vector<off_t> hot_blocks;
+	for (size_t i = 0; i < num_blocks; i++)
+		if (heat[i] >= MIN_HEAT)
+			hot_blocks.push_back(i);
+	heat_greater comp(heat);
+	if (hot_blocks.size() > (size_t) num_slots) {
+		std::nth_element(hot_blocks.begin(), hot_blocks.begin() + num_slots,
+				hot_blocks.end(), comp);
+		hot_blocks.resize(num_slots);
+	}
+	std::sort(hot_blocks.begin(), hot_blocks.end(), comp);
+
+	// The hot blocks that aren't in the fast tier. We skip the blocks whose
+	// old slots are still in use.
+	std::vector<off_t> candidates;
+	for (size_t i = 0; i < hot_blocks.size()
+			&& candidates.size() < (size_t) max_blocks; i++)
+		if (slots[hot_blocks[i]] < 0 && retired[hot_blocks[i]] < 0)
+			candidates.push_back(hot_blocks[i]);
+
+	std::vector<int> free_slots;
+	for (int i = 0; i < num_slots; i++)
+		if (slot_owners[i] < 0)
+			free_slots.push_back(i);
+
+	// Remove the coldest blocks from the fast tier to make room for
+	// the candidates, as long as they are colder than the candidates.
+	if (free_slots.size() < candidates.size()) {
+		std::vector<off_t> fast_blocks;
+		for (int i = 0; i < num_slots; i++)
+			if (slot_owners[i] >= 0 && slots[slot_owners[i]] == i)
+				fast_blocks.push_back(slot_owners[i]);
+		std::sort(fast_blocks.begin(), fast_blocks.end(), comp);
+		size_t num_needed = candidates.size() - free_slots.size();
+		for (size_t i = 0; i < num_needed && !fast_blocks.empty(); i++) {
+			off_t coldest = fast_blocks.back();
+			off_t hottest = candidates[free_slots.size() + i];
+			if (heat[coldest] >= heat[hottest])
+				break;
+			fast_blocks.pop_back();
+			demote(coldest);
+		}
+	}
+
+	for (size_t i = 0; i < candidates.size() && i < free_slots.size(); i++)
+		if (copy_block(candidates[i], free_slots[i]))
+			promote(candidates[i], free_slots[i]);
+
+	// Only the recent reads decide the hot blocks.
+	for (size_t i = 0; i < num_blocks; i++)
+		heat[i] /= 2;
+}
+
+tier_migrator::tier_migrator(int interval)
+{
+	this->interval = interval;
+	stopped = false;
+	pthread_mutex_init(&mutex, NULL);
+	pthread_cond_init(&cond, NULL);
+	BOOST_VERIFY(pthread_create(&tid, NULL, run, this) == 0);
+}
+
+tier_migrator::~tier_migrator()
+{
+	pthread_mutex_lock(&mutex);
+	stopped = true;
+	pthread_mutex_unlock(&mutex);
+	pthread_cond_signal(&cond);
+	pthread_join(tid, NULL);
+	pthread_mutex_destroy(&mutex);
+	pthread_cond_destroy(&cond);
+
+	std::vector<block_tier_table::ptr> tables = block_tier_table::get_all();
+	for (size_t i = 0; i < tables.size(); i++)
+		BOOST_LOG_TRIVIAL(info) << boost::format(
+				"%1%: %2% blocks in the fast tier, %3% promotions, %4% demotions")
+			% tables[i]->get_name() % tables[i]->get_num_fast_blocks()
+			% tables[i]->get_num_promotions() % tables[i]->get_num_demotions();
+}
+
+void *tier_migrator::run(void *arg)
+{
+	tier_migrator *migrator = (tier_migrator *) arg;
+	pthread_mutex_lock(&migrator->mutex);
+	while (!migrator->stopped) {
+		struct timespec deadline;
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		long nsec = deadline.tv_nsec + migrator->interval * 1000000L;
+		deadline.tv_sec += nsec / 1000000000L;
+		deadline.tv_nsec = nsec % 1000000000L;
+		int ret = 0;
+		while (!migrator->stopped && ret != ETIMEDOUT)
+			ret = pthread_cond_timedwait(&migrator->cond, &migrator->mutex,
+					&deadline);
+		if (migrator->stopped)
+			break;
+		pthread_mutex_unlock(&migrator->mutex);
+		std::vector<block_tier_table::ptr> tables = block_tier_table::get_all();
+		for (size_t i = 0; i < tables.size(); i++)
+			tables[i]->migrate(MAX_MIGRATES);
+		pthread_mutex_lock(&migrator->mutex);
+	}
+	pthread_mutex_unlock(&migrator->mutex);
+	return NULL;
+}
+
+}
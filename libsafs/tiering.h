@@ -0,0 +1,214 @@
+#ifndef __TIERING_H__
+#define __TIERING_H__
+
+/*
+ * Copyright 2014 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of SAFSlib.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <pthread.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "file_mapper.h"
+#include "concurrency.h"
+
+namespace safs
+{
+
+/**
+ * This keeps the location of the stripe blocks of a file with the tiered
+ * mapping. The partitions of the file in the capacity tier store all
+ * blocks with RAID0. The partitions in the fast tier are split into slots
+ * of a stripe block, and each slot keeps a copy of a hot block.
+ *
+ * The I/O layers record the reads that reach the disks, i.e., the misses of
+ * the page cache, and the migrator copies the hottest blocks to the fast
+ * tier in the background. A block is only copied when SAFS isn't writable,
+ * so the copy in the capacity tier is always valid and a block can be
+ * dropped from the fast tier without being written back.
+ *
+ * A request is sent to the I/O thread of the disk where its block is and
+ * the I/O thread maps the request again. If the block moves in between,
+ * the I/O thread finds the block with map_other(). A slot of a block
+ * removed from the fast tier can't be reused while any read that mapped
+ * the block before the removal is in progress. The reads are counted in
+ * two epochs from before they are mapped until they complete. The slots
+ * retired in an epoch are reused only after the migrator starts a new
+ * epoch and all reads of the old epoch complete, because the reads in
+ * the new epoch can't map the blocks to the retired slots.
+ *
+ * All file mappers of a file in a process share the same table.
+ */
+class block_tier_table
+{
+	// A block is only moved to the fast tier if it's read at least this
+	// many times recently.
+	static const uint32_t MIN_HEAT = 2;
+
+	std::string name;
+	// In the number of pages.
+	int block_size;
+	std::vector<part_file_info> files;
+	// The partitions in the capacity tier and in the fast tier.
+	std::vector<int> cap_idxs;
+	std::vector<int> fast_idxs;
+	int num_slots;
+	size_t num_blocks;
+
+	// The slot of each block in the fast tier. It's -1 if the block is
+	// only in the capacity tier.
+	std::vector<int> slots;
+	// The slot that a block occupied before it was removed from
+	// the fast tier.
+	std::vector<int> retired;
+	// The approximate number of recent reads of each block.
+	std::vector<uint32_t> heat;
+	// The current epoch and the number of reads in progress in each epoch.
+	volatile int epoch;
+	atomic_number<long> num_reads[2];
+
+	// These are only accessed by the migrator.
+	// The block in each slot. It's -1 if the slot is free.
+	std::vector<int> slot_owners;
+	std::vector<int> retired_slots;
+	// The slots retired before the current epoch. They are reused after
+	// the reads of the previous epoch complete.
+	std::vector<int> draining_slots;
+	std::vector<int> fds;
+	char *buf;
+	size_t num_promotions;
+	size_t num_demotions;
+
+	block_tier_table(const std::string &name,
+			const std::vector<part_file_info> &files,
+			const std::vector<bool> &fast_parts, int block_size,
+			int num_slots, size_t num_blocks);
+
+	void map_slot(int slot, int idx_in_block, block_identifier &bid) const;
+	int get_slot(off_t block_idx) const {
+		if ((size_t) block_idx >= num_blocks)
+			return -1;
+		return __atomic_load_n(&slots[block_idx], __ATOMIC_ACQUIRE);
+	}
+	bool copy_block(off_t block_idx, int slot);
+	void promote(off_t block_idx, int slot);
+	void demote(off_t block_idx);
+public:
+	typedef std::shared_ptr<block_tier_table> ptr;
+
+	/**
+	 * Get the table of a file. If the table doesn't exist, create one.
+	 * `num_slots' is the number of blocks that the fast tier can keep and
+	 * `num_blocks' is the number of blocks in the file.
+	 */
+	static ptr get(const std::string &name,
+			const std::vector<part_file_info> &files,
+			const std::vector<bool> &fast_parts, int block_size,
+			int num_slots, size_t num_blocks);
+	/**
+	 * Find the table of a file. It returns NULL if the file isn't opened
+	 * with the tiered mapping.
+	 */
+	static ptr find(const std::string &name);
+	/**
+	 * Get the tables of all files opened with the tiered mapping.
+	 */
+	static std::vector<ptr> get_all();
+
+	~block_tier_table();
+
+	void map(off_t off, block_identifier &bid) const;
+	int map2file(off_t off) const;
+	void map_home(off_t off, block_identifier &bid) const;
+	bool map_other(off_t off, block_identifier &bid) const;
+	std::vector<size_t> get_size_per_disk(size_t size) const;
+
+	/**
+	 * A read is counted in the current epoch before it's mapped.
+	 * It returns the epoch that should be given to end_read().
+	 */
+	int begin_read();
+
+	void end_read(int epoch) {
+		num_reads[epoch].dec(1);
+	}
+
+	void record_read(off_t off) {
+		off_t block_idx = off / block_size;
+		// We don't need an accurate count, so we avoid atomic operations
+		// on hot blocks.
+		if ((size_t) block_idx < num_blocks)
+			heat[block_idx]++;
+	}
+
+	/**
+	 * Move at most `max_blocks' hot blocks to the fast tier and remove
+	 * colder blocks from the fast tier to make room for them.
+	 * Only the migrator invokes it.
+	 */
+	void migrate(int max_blocks);
+
+	bool is_fast(off_t off) const {
+		return get_slot(off / block_size) >= 0;
+	}
+
+	int get_num_fast_blocks() const;
+
+	size_t get_num_promotions() const {
+		return num_promotions;
+	}
+
+	size_t get_num_demotions() const {
+		return num_demotions;
+	}
+
+	const std::string &get_name() const {
+		return name;
+	}
+};
+
+/**
+ * This thread moves hot blocks of all files with the tiered mapping to
+ * the fast tier periodically.
+ */
+class tier_migrator
+{
+	// The maximal number of blocks moved to the fast tier for a file
+	// in a round.
+	static const int MAX_MIGRATES = 64;
+
+	int interval;	// in milliseconds
+	bool stopped;
+	pthread_t tid;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+
+	static void *run(void *arg);
+public:
+	typedef std::unique_ptr<tier_migrator> ptr;
+
+	tier_migrator(int interval);
+	~tier_migrator();
+};
+
+}
+
+#endif
@@ -0,0 +1,59 @@
+#include <stdio.h>
+
+#include "associative_cache.h"
+
+using namespace safs;
+
+const int NUM_HOT_PAGES = 4;
+const int NUM_SCAN_PAGES = 1000;
+
+/*
+ * Access a page in the cache and return true if it's a cache hit.
+ */
+static bool access_page(page_cache &cache, const page_id_t &pg_id)
+{
+	page_id_t old_id;
+	thread_safe_page *pg = (thread_safe_page *) cache.search(pg_id, old_id);
+	assert(pg);
+	bool hit = pg->data_ready();
+	pg->set_data_ready(true);
+	pg->dec_ref();
+	return hit;
+}
+
+/*
+ * Access a small hot set twice and then scan many pages once.
+ * It returns the number of hot pages that are still in the cache.
+ */
+static int run_scan(bool use_arc)
+{
+	// A single cell with the min number of pages.
+	page_cache::ptr cache = associative_cache::create(
+			params.get_SA_min_cell_size() * PAGE_SIZE, MAX_CACHE_SIZE, 0, 1,
+			100, false, use_arc);
+	for (int k = 0; k < 2; k++)
+		for (int i = 0; i < NUM_HOT_PAGES; i++)
+			access_page(*cache, page_id_t(0, i * PAGE_SIZE));
+	for (int i = 0; i < NUM_SCAN_PAGES; i++)
+		access_page(*cache, page_id_t(1, i * PAGE_SIZE));
+
+	int num_hits = 0;
+	for (int i = 0; i < NUM_HOT_PAGES; i++) {
+		page *pg = cache->search(page_id_t(0, i * PAGE_SIZE));
+		if (pg) {
+			num_hits++;
+			pg->dec_ref();
+		}
+	}
+	cache->print_stat();
+	return num_hits;
+}
+
+int main()
+{
+	int num_hits = run_scan(false);
+	printf("%d hot pages survive the scan with the default policy\n", num_hits);
+	num_hits = run_scan(true);
+	printf("%d hot pages survive the scan with ARC\n", num_hits);
+	assert(num_hits == NUM_HOT_PAGES);
+}
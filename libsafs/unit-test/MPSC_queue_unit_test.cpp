@@ -0,0 +1,110 @@
+#include <stdio.h>
+#include <pthread.h>
+
+#include <vector>
+
+#include "container.h"
+
+const int NUM_PRODUCERS = 16;
+const int NUM_ENTRIES = 100000;
+const int BATCH_SIZE = 7;
+
+/*
+ * An entry contains the producer that adds it and the sequence number
+ * in the producer.
+ */
+struct entry_t
+{
+	int producer;
+	int seq;
+};
+
+struct producer_arg
+{
+	MPSC_FIFO_queue<entry_t> *q;
+	int id;
+};
+
+void *produce(void *arg)
+{
+	producer_arg *parg = (producer_arg *) arg;
+	entry_t entries[BATCH_SIZE];
+	for (int i = 0; i < NUM_ENTRIES; i += BATCH_SIZE) {
+		int num = min(BATCH_SIZE, NUM_ENTRIES - i);
+		for (int j = 0; j < num; j++) {
+			entries[j].producer = parg->id;
+			entries[j].seq = i + j;
+		}
+		BOOST_VERIFY(parg->q->add(entries, num) == num);
+	}
+	return NULL;
+}
+
+/*
+ * All entries are fetched and the entries from a producer are fetched
+ * in the order they are added.
+ */
+void test_queue(int ring_size, bool blocking)
+{
+	MPSC_FIFO_queue<entry_t> q("test", -1, 16, INT_MAX, ring_size);
+	assert(q.is_lockfree() == (ring_size > 0));
+	pthread_t producers[NUM_PRODUCERS];
+	producer_arg args[NUM_PRODUCERS];
+	for (int i = 0; i < NUM_PRODUCERS; i++) {
+		args[i].q = &q;
+		args[i].id = i;
+		pthread_create(&producers[i], NULL, produce, &args[i]);
+	}
+
+	std::vector<int> next_seqs(NUM_PRODUCERS);
+	long num_fetched = 0;
+	entry_t entries[32];
+	while (num_fetched < (long) NUM_PRODUCERS * NUM_ENTRIES) {
+		if (blocking)
+			q.wait4entries();
+		int num = q.fetch(entries, 32);
+		for (int i = 0; i < num; i++) {
+			assert(entries[i].seq == next_seqs[entries[i].producer]);
+			next_seqs[entries[i].producer]++;
+		}
+		num_fetched += num;
+	}
+	for (int i = 0; i < NUM_PRODUCERS; i++)
+		pthread_join(producers[i], NULL);
+	assert(q.is_empty());
+	for (int i = 0; i < NUM_PRODUCERS; i++)
+		assert(next_seqs[i] == NUM_ENTRIES);
+	printf("ring size: %d, blocking: %d, the queue is correct\n",
+			ring_size, blocking);
+}
+
+void test_ring()
+{
+	MPSC_ring_buffer<int> ring("test", 5);
+	assert(ring.get_size() == 8);
+	int vals[10];
+	for (int i = 0; i < 10; i++)
+		vals[i] = i;
+	// The ring only has space for 8 entries.
+	assert(ring.add(vals, 10) == 8);
+	assert(ring.is_full());
+	assert(ring.add(vals, 1) == 0);
+	int fetched[10];
+	assert(ring.fetch(fetched, 3) == 3);
+	assert(ring.add(vals + 8, 2) == 2);
+	assert(ring.fetch(fetched + 3, 10) == 7);
+	assert(ring.is_empty());
+	for (int i = 0; i < 10; i++)
+		assert(fetched[i] == i);
+	printf("the ring buffer is correct\n");
+}
+
+int main()
+{
+	test_ring();
+	test_queue(0, false);
+	test_queue(1024, false);
+	// A small ring makes producers add entries to the locked queue.
+	test_queue(16, false);
+	test_queue(16, true);
+}
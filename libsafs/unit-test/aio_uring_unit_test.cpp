@@ -0,0 +1,202 @@
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+
+#include <vector>
+#include <map>
+#include <string>
+
+#include "wpaio.h"
+#include "parameters.h"
+#include "io_request.h"
+
+using namespace safs;
+
+const int NUM_PAGES = 64;
+const int MAX_AIO = 16;
+
+/*
+ * The callback of a request, which records the result of the request.
+ */
+struct test_callback: public io_callback_s
+{
+	char *buf;
+	size_t size;
+	long res;
+	bool completed;
+};
+
+int num_completed;
+
+void complete_reqs(io_context_t ctx, struct iocb *iocbs[], void *cbs[],
+		long res[], long res2[], int num)
+{
+	for (int i = 0; i < num; i++) {
+		test_callback *cb = (test_callback *) cbs[i];
+		assert(!cb->completed);
+		cb->completed = true;
+		cb->res = res[i];
+	}
+	num_completed += num;
+}
+
+char *alloc_pages(int num)
+{
+	char *buf = NULL;
+	int ret = posix_memalign((void **) &buf, PAGE_SIZE, num * PAGE_SIZE);
+	assert(ret == 0);
+	return buf;
+}
+
+void fill_page(char *page, int page_no, int seed)
+{
+	for (int i = 0; i < PAGE_SIZE / (int) sizeof(int); i++)
+		((int *) page)[i] = page_no * seed + i;
+}
+
+bool check_page(const char *page, int page_no, int seed)
+{
+	for (int i = 0; i < PAGE_SIZE / (int) sizeof(int); i++)
+		if (((const int *) page)[i] != page_no * seed + i)
+			return false;
+	return true;
+}
+
+/*
+ * Issue a request for every page and wait for all of them. The odd pages
+ * are accessed with iovec requests that split a page into two buffers.
+ */
+void access_pages(aio_ctx *ctx, int fd, char *bufs, int io_type,
+		std::vector<test_callback> &cbs)
+{
+	std::vector<struct iovec> iovs(NUM_PAGES * 2);
+	num_completed = 0;
+	for (int i = 0; i < NUM_PAGES; ) {
+		int num = std::min(ctx->max_io_slot(), NUM_PAGES - i);
+		struct iocb *reqs[num];
+		for (int j = 0; j < num; j++, i++) {
+			test_callback &cb = cbs[i];
+			cb.func = complete_reqs;
+			cb.buf = bufs + i * PAGE_SIZE;
+			cb.size = PAGE_SIZE;
+			cb.res = 0;
+			cb.completed = false;
+			if (i % 2 == 0)
+				reqs[j] = ctx->make_io_request(fd, PAGE_SIZE,
+						((long long) i) * PAGE_SIZE, cb.buf, io_type, &cb);
+			else {
+				iovs[i * 2].iov_base = cb.buf;
+				iovs[i * 2].iov_len = PAGE_SIZE / 2;
+				iovs[i * 2 + 1].iov_base = cb.buf + PAGE_SIZE / 2;
+				iovs[i * 2 + 1].iov_len = PAGE_SIZE / 2;
+				reqs[j] = ctx->make_iovec_request(fd, &iovs[i * 2], 2,
+						((long long) i) * PAGE_SIZE, io_type, &cb);
+			}
+		}
+		ctx->submit_io_request(reqs, num);
+		// Leave some requests in flight while we submit more requests.
+		if (ctx->max_io_slot() == 0)
+			ctx->io_wait(NULL, 1);
+	}
+	while (num_completed < NUM_PAGES)
+		ctx->io_wait(NULL, 1);
+	assert(num_completed == NUM_PAGES);
+	for (int i = 0; i < NUM_PAGES; i++) {
+		assert(cbs[i].completed);
+		assert(cbs[i].res == PAGE_SIZE);
+	}
+}
+
+/*
+ * Write pages to a file and read them back with the aio context.
+ */
+void test_rw(aio_ctx *ctx, const std::string &file_name, char *write_bufs,
+		char *read_bufs, int seed)
+{
+	int fd = open(file_name.c_str(), O_RDWR | O_CREAT | O_DIRECT, 0644);
+	// Some file systems (e.g., tmpfs) don't support direct I/O.
+	if (fd < 0 && errno == EINVAL)
+		fd = open(file_name.c_str(), O_RDWR | O_CREAT, 0644);
+	assert(fd >= 0);
+	std::vector<int> fds(1, fd);
+	ctx->register_files(fds);
+
+	std::vector<test_callback> cbs(NUM_PAGES);
+	for (int i = 0; i < NUM_PAGES; i++)
+		fill_page(write_bufs + i * PAGE_SIZE, i, seed);
+	access_pages(ctx, fd, write_bufs, A_WRITE, cbs);
+
+	memset(read_bufs, 0, NUM_PAGES * PAGE_SIZE);
+	access_pages(ctx, fd, read_bufs, A_READ, cbs);
+	for (int i = 0; i < NUM_PAGES; i++)
+		assert(check_page(read_bufs + i * PAGE_SIZE, i, seed));
+
+	ctx->unregister_files(fds);
+	close(fd);
+}
+
+/*
+ * Both the I/O buffers registered to the kernel and the ones that aren't
+ * registered should work.
+ */
+void test_uring(const std::string &file_name)
+{
+#ifdef USE_IO_URING
+	// The write buffers are on the node of the aio context, so they are
+	// registered. The read buffers are on another node, so they aren't.
+	char *write_bufs = alloc_pages(NUM_PAGES);
+	char *read_bufs = alloc_pages(NUM_PAGES);
+	register_io_buf(write_bufs, NUM_PAGES * PAGE_SIZE, 0);
+	register_io_buf(read_bufs, NUM_PAGES * PAGE_SIZE, 1);
+
+	aio_ctx *ctx;
+	try {
+		ctx = new aio_ctx_uring(0, MAX_AIO, false);
+	} catch (std::system_error &e) {
+		printf("io_uring isn't available: %s, skip the test\n", e.what());
+		free(write_bufs);
+		free(read_bufs);
+		return;
+	}
+	test_rw(ctx, file_name, write_bufs, read_bufs, 3);
+	// Run it again with the data in the file overwritten.
+	test_rw(ctx, file_name, write_bufs, read_bufs, 7);
+	ctx->print_stat();
+	delete ctx;
+	free(write_bufs);
+	free(read_bufs);
+	printf("test io_uring: OK\n");
+#endif
+}
+
+/*
+ * If the kernel can't create the ring, we fall back to libaio.
+ */
+void test_fallback(const std::string &file_name)
+{
+	std::map<std::string, std::string> configs;
+	configs["aio_type"] = "io_uring";
+	params.init(configs);
+
+	// A ring can't have more than 32768 entries, but libaio accepts it.
+	aio_ctx *ctx = create_aio_ctx(0, 40000);
+	assert(dynamic_cast<aio_ctx_impl *>(ctx));
+#ifdef USE_LIBAIO
+	char *write_bufs = alloc_pages(NUM_PAGES);
+	char *read_bufs = alloc_pages(NUM_PAGES);
+	test_rw(ctx, file_name, write_bufs, read_bufs, 5);
+	free(write_bufs);
+	free(read_bufs);
+#endif
+	delete ctx;
+	printf("test fallback: OK\n");
+}
+
+int main()
+{
+	std::string file_name = "/tmp/aio_uring_unit_test.dat";
+	test_uring(file_name);
+	test_fallback(file_name);
+	unlink(file_name.c_str());
+}
@@ -0,0 +1,117 @@
+#include <stdio.h>
+
+#include "io_interface.h"
+#include "safs_file.h"
+#include "global_cached_private.h"
+
+using namespace safs;
+
+const int NUM_PAGES = 1024;
+// The reads of 64 pages skip the page cache.
+const int BYPASS_PAGES = 64;
+
+config_map::ptr get_configs(const std::string &root_conf)
+{
+	std::string opts[] = {
+		std::string("root_conf=") + root_conf,
+		"cache_size=16M",
+		"cache_bypass_size=256K",
+		"writable=1",
+	};
+	const char *opt_strs[4];
+	for (int i = 0; i < 4; i++)
+		opt_strs[i] = opts[i].c_str();
+	config_map::ptr configs = config_map::create();
+	configs->add_options(opt_strs, 4);
+	return configs;
+}
+
+static void check_data(long *buf, off_t off, size_t size)
+{
+	for (size_t j = 0; j < size / sizeof(long); j++)
+		assert(buf[j] == (long) (off + j * sizeof(long)));
+}
+
+/*
+ * Large reads skip the page cache and small reads go through it.
+ * A large read still sees the data written to the page cache.
+ */
+void test_bypass(const std::string &root_conf)
+{
+	std::string file_name = "test-bypass";
+	init_io_system(get_configs(root_conf));
+	safs_file file(get_sys_RAID_conf(), file_name);
+	assert(file.create_file(NUM_PAGES * PAGE_SIZE));
+
+	size_t buf_size = BYPASS_PAGES * 4 * PAGE_SIZE;
+	long *buf = (long *) valloc(buf_size);
+	file_io_factory::shared_ptr factory = create_io_factory(file_name,
+			REMOTE_ACCESS);
+	io_interface::ptr io = create_io(factory, thread::get_curr_thread());
+	for (int i = 0; i < NUM_PAGES; i++) {
+		for (size_t j = 0; j < PAGE_SIZE / sizeof(long); j++)
+			buf[j] = i * PAGE_SIZE + j * sizeof(long);
+		// The remote I/O only supports asynchronous requests.
+		data_loc_t loc(io->get_file_id(), i * PAGE_SIZE);
+		io_request req((char *) buf, loc, PAGE_SIZE, WRITE);
+		io->access(&req, 1);
+		io->wait4complete(1);
+	}
+	io->cleanup();
+	io = NULL;
+
+	factory = create_io_factory(file_name, GLOBAL_CACHE_ACCESS);
+	io = create_io(factory, thread::get_curr_thread());
+	global_cached_io *gio = (global_cached_io *) io.get();
+	size_t size = BYPASS_PAGES * PAGE_SIZE;
+	io->access((char *) buf, 0, size, READ);
+	check_data(buf, 0, size);
+	assert(gio->get_num_bypass_reads() == 1);
+	assert(gio->get_num_pg_accesses() == 0);
+
+	// A small read goes through the page cache.
+	io->access((char *) buf, size, PAGE_SIZE, READ);
+	check_data(buf, size, PAGE_SIZE);
+	assert(gio->get_num_bypass_reads() == 1);
+	assert(gio->get_num_pg_accesses() == 1);
+
+	// An asynchronous read across multiple RAID blocks.
+	data_loc_t loc(io->get_file_id(), size * 2);
+	io_request req((char *) buf, loc, buf_size, READ);
+	io->access(&req, 1);
+	io->wait4complete(1);
+	check_data(buf, size * 2, buf_size);
+	assert(gio->get_num_bypass_reads() == 2);
+
+	// The read covers a dirty page, so it reads the page cache.
+	off_t dirty_off = PAGE_SIZE * 2;
+	for (size_t j = 0; j < PAGE_SIZE / sizeof(long); j++)
+		buf[j] = -1;
+	io->access((char *) buf, dirty_off, PAGE_SIZE, WRITE);
+	io->access((char *) buf, 0, size, READ);
+	assert(gio->get_num_bypass_reads() == 2);
+	for (size_t j = 0; j < size / sizeof(long); j++) {
+		off_t off = j * sizeof(long);
+		if (off >= dirty_off && off < dirty_off + PAGE_SIZE)
+			assert(buf[j] == -1);
+		else
+			assert(buf[j] == off);
+	}
+	io->cleanup();
+	io = NULL;
+	factory = NULL;
+	free(buf);
+
+	file.delete_file();
+	destroy_io_system();
+	printf("large reads skip the page cache correctly\n");
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2) {
+		fprintf(stderr, "cache_bypass_unit_test conf_file\n");
+		return -1;
+	}
+	test_bypass(argv[1]);
+}
@@ -0,0 +1,60 @@
+#include <stdio.h>
+#include <pthread.h>
+
+#include "associative_cache.h"
+
+using namespace safs;
+
+const int NUM_THREADS = 8;
+const int NUM_ACCESSES = 1000000;
+// The number of pages accessed by the threads. It's a little larger than
+// the cache, so there are evictions while other threads hit in the cache.
+const int NUM_PAGES = 1024 + 128;
+
+page_cache::ptr cache;
+
+/*
+ * Every page returned by the cache has to be the one we ask for and
+ * it can't be changed while we hold the reference.
+ */
+void *run_accesses(void *arg)
+{
+	unsigned long seed = (long) arg;
+	long num_hits = 0;
+	for (int i = 0; i < NUM_ACCESSES; i++) {
+		seed = seed * 1103515245 + 12345;
+		off_t off = ((seed >> 16) % NUM_PAGES) * PAGE_SIZE;
+		page_id_t pg_id(0, off);
+		page_id_t old_id;
+		thread_safe_page *pg = (thread_safe_page *) cache->search(pg_id,
+				old_id);
+		assert(pg);
+		assert(pg->get_offset() == off);
+		assert(pg->get_file_id() == 0);
+		if (pg->data_ready())
+			num_hits++;
+		else
+			pg->set_data_ready(true);
+		assert(pg->get_offset() == off);
+		pg->dec_ref();
+	}
+	return (void *) num_hits;
+}
+
+int main()
+{
+	cache = associative_cache::create(1024 * PAGE_SIZE, MAX_CACHE_SIZE,
+			0, 1, 100);
+	pthread_t threads[NUM_THREADS];
+	for (long i = 0; i < NUM_THREADS; i++)
+		pthread_create(&threads[i], NULL, run_accesses, (void *) (i + 1));
+	long num_hits = 0;
+	for (int i = 0; i < NUM_THREADS; i++) {
+		void *ret;
+		pthread_join(threads[i], &ret);
+		num_hits += (long) ret;
+	}
+	printf("%ld hits in %d accesses\n", num_hits, NUM_THREADS * NUM_ACCESSES);
+	cache->sanity_check();
+	cache.reset();
+}
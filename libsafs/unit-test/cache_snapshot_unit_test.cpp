@@ -0,0 +1,124 @@
+#include <stdio.h>
+
+#include "io_interface.h"
+#include "safs_file.h"
+#include "cache_snapshot.h"
+
+using namespace safs;
+
+const int NUM_PAGES = 256;
+const char *SNAPSHOT_FILE = "/tmp/safs_cache_snapshot";
+
+void test_runs()
+{
+	cache_snapshot::ptr snapshot = cache_snapshot::create();
+	std::vector<off_t> offs;
+	for (int i = 10; i > 0; i--)
+		offs.push_back(i * PAGE_SIZE);
+	offs.push_back(20 * PAGE_SIZE);
+	snapshot->add_pages("file1", offs);
+	// Duplicated pages and pages adjacent to an existing run.
+	offs.clear();
+	offs.push_back(5 * PAGE_SIZE);
+	offs.push_back(11 * PAGE_SIZE);
+	snapshot->add_pages("file1", offs);
+	offs.clear();
+	offs.push_back(0);
+	snapshot->add_pages("file2", offs);
+
+	const std::vector<page_run> *runs = snapshot->get_runs("file1");
+	assert(runs && runs->size() == 2);
+	assert((*runs)[0].start == 1 && (*runs)[0].num_pages == 11);
+	assert((*runs)[1].start == 20 && (*runs)[1].num_pages == 1);
+	assert(snapshot->get_num_pages() == 13);
+	assert(snapshot->get_runs("file3") == NULL);
+
+	assert(snapshot->save(SNAPSHOT_FILE));
+	cache_snapshot::ptr loaded = cache_snapshot::load(SNAPSHOT_FILE);
+	assert(loaded);
+	assert(loaded->get_num_files() == 2);
+	assert(loaded->get_num_pages() == 13);
+	runs = loaded->get_runs("file1");
+	assert(runs && runs->size() == 2);
+	assert((*runs)[1].start == 20 && (*runs)[1].num_pages == 1);
+	unlink(SNAPSHOT_FILE);
+	printf("snapshot runs are correct\n");
+}
+
+config_map::ptr get_configs(const std::string &root_conf)
+{
+	std::string opts[] = {
+		std::string("root_conf=") + root_conf,
+		"cache_size=16M",
+		std::string("cache_snapshot=") + SNAPSHOT_FILE,
+	};
+	const char *opt_strs[3];
+	for (int i = 0; i < 3; i++)
+		opt_strs[i] = opts[i].c_str();
+	config_map::ptr configs = config_map::create();
+	configs->add_options(opt_strs, 3);
+	return configs;
+}
+
+/*
+ * Read every other page of the file through the page cache. The page cache
+ * is saved to the snapshot when SAFS is destroyed. Then it's warmed up
+ * with the snapshot when the file is opened again, so we should get
+ * the same snapshot. The file that isn't opened again should stay in
+ * the snapshot.
+ */
+void test_warm_up(const std::string &root_conf)
+{
+	unlink(SNAPSHOT_FILE);
+	std::string file_name = "test-snapshot";
+	init_io_system(get_configs(root_conf));
+	safs_file file(get_sys_RAID_conf(), file_name);
+	assert(file.create_file(NUM_PAGES * PAGE_SIZE));
+	{
+		file_io_factory::shared_ptr factory = create_io_factory(file_name,
+				GLOBAL_CACHE_ACCESS);
+		io_interface::ptr io = create_io(factory, thread::get_curr_thread());
+		char *buf = (char *) valloc(PAGE_SIZE);
+		for (int i = 0; i < NUM_PAGES; i += 2)
+			io->access(buf, i * PAGE_SIZE, PAGE_SIZE, READ);
+		io->cleanup();
+		free(buf);
+	}
+	destroy_io_system();
+
+	cache_snapshot::ptr snapshot = cache_snapshot::load(SNAPSHOT_FILE);
+	assert(snapshot);
+	const std::vector<page_run> *runs = snapshot->get_runs(file_name);
+	assert(runs && runs->size() == NUM_PAGES / 2);
+	for (size_t i = 0; i < runs->size(); i++)
+		assert((*runs)[i].start == (off_t) i * 2 && (*runs)[i].num_pages == 1);
+	std::vector<off_t> offs;
+	offs.push_back(0);
+	offs.push_back(PAGE_SIZE);
+	snapshot->add_pages("other-file", offs);
+	assert(snapshot->save(SNAPSHOT_FILE));
+
+	init_io_system(get_configs(root_conf));
+	create_io_factory(file_name, GLOBAL_CACHE_ACCESS);
+	// The page cache is warmed up in the background.
+	wait4cache_warm_up();
+	unlink(SNAPSHOT_FILE);
+	assert(save_cache_snapshot(SNAPSHOT_FILE));
+	cache_snapshot::ptr snapshot1 = cache_snapshot::load(SNAPSHOT_FILE);
+	assert(snapshot1);
+	runs = snapshot1->get_runs(file_name);
+	assert(runs && runs->size() == NUM_PAGES / 2);
+	runs = snapshot1->get_runs("other-file");
+	assert(runs && runs->size() == 1 && (*runs)[0].num_pages == 2);
+	safs_file(get_sys_RAID_conf(), file_name).delete_file();
+	destroy_io_system();
+	unlink(SNAPSHOT_FILE);
+	printf("the page cache is warmed up with the snapshot\n");
+}
+
+int main(int argc, char *argv[])
+{
+	test_runs();
+	if (argc >= 2)
+		test_warm_up(argv[1]);
+}
@@ -0,0 +1,108 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "associative_cache.h"
+#include "compressed_cache.h"
+
+using namespace safs;
+
+const int NUM_CACHE_PAGES = 1024;
+const int NUM_PAGES = NUM_CACHE_PAGES * 3;
+
+/*
+ * Fill a page with something like an adjacency list: sorted vertex IDs
+ * with a small gap.
+ */
+static void fill_page(char *page, off_t off)
+{
+	uint32_t *words = (uint32_t *) page;
+	uint32_t id = off / PAGE_SIZE * 1000;
+	for (size_t i = 0; i < PAGE_SIZE / sizeof(uint32_t); i++) {
+		id += i % 7;
+		words[i] = id;
+	}
+}
+
+void test_codec()
+{
+	delta_varint_codec codec;
+	char page[PAGE_SIZE];
+	char buf[PAGE_SIZE];
+	char out[PAGE_SIZE];
+
+	fill_page(page, 12345 * PAGE_SIZE);
+	size_t size = codec.compress(page, buf, sizeof(buf));
+	assert(size > 0 && size < PAGE_SIZE / 2);
+	assert(codec.decompress(buf, size, out));
+	assert(memcmp(page, out, PAGE_SIZE) == 0);
+	printf("a vertex page is compressed to %ld bytes\n", size);
+
+	memset(page, 0, sizeof(page));
+	size = codec.compress(page, buf, sizeof(buf));
+	assert(size > 0 && size < 8);
+	assert(codec.decompress(buf, size, out));
+	assert(memcmp(page, out, PAGE_SIZE) == 0);
+
+	// Random data can't be compressed.
+	for (size_t i = 0; i < PAGE_SIZE; i++)
+		page[i] = random();
+	assert(codec.compress(page, buf, PAGE_SIZE * 3 / 4) == 0);
+	size = codec.compress(page, buf, sizeof(buf));
+	if (size > 0) {
+		assert(codec.decompress(buf, size, out));
+		assert(memcmp(page, out, PAGE_SIZE) == 0);
+	}
+	// Broken data.
+	assert(!codec.decompress(buf, 3, out));
+}
+
+/*
+ * Access a page. If the page isn't ready, it's read from the "disk".
+ * It returns true if the page doesn't need to be read from the disk.
+ */
+static bool access_page(page_cache &cache, off_t off)
+{
+	page_id_t pg_id(0, off);
+	page_id_t old_id;
+	thread_safe_page *pg = (thread_safe_page *) cache.search(pg_id, old_id);
+	assert(pg);
+	bool ready = pg->data_ready();
+	char page[PAGE_SIZE];
+	fill_page(page, off);
+	if (ready)
+		assert(memcmp(pg->get_data(), page, PAGE_SIZE) == 0);
+	else {
+		memcpy(pg->get_data(), page, PAGE_SIZE);
+		pg->set_data_ready(true);
+	}
+	pg->dec_ref();
+	return ready;
+}
+
+void test_cache()
+{
+	std::map<std::string, std::string> configs;
+	configs["cache_size"] = "4M";
+	configs["compressed_cache_size"] = "4M";
+	params.init(configs);
+
+	page_cache::ptr cache = associative_cache::create(
+			NUM_CACHE_PAGES * PAGE_SIZE, MAX_CACHE_SIZE, 0, 1, 100);
+	for (int i = 0; i < NUM_PAGES; i++)
+		assert(!access_page(*cache, i * PAGE_SIZE));
+	int num_ready = 0;
+	for (int i = 0; i < NUM_PAGES; i++)
+		if (access_page(*cache, i * PAGE_SIZE))
+			num_ready++;
+	cache->print_stat();
+	printf("%d of %d pages don't need to be read from the disk\n",
+			num_ready, NUM_PAGES);
+	// A 4MB page cache can't keep all pages without the compressed tier.
+	assert(num_ready > NUM_CACHE_PAGES * 2);
+}
+
+int main()
+{
+	test_codec();
+	test_cache();
+}
@@ -0,0 +1,120 @@
+#include <stdio.h>
+
+#include "io_interface.h"
+#include "safs_file.h"
+#include "RAID_config.h"
+#include "io_stats.h"
+
+using namespace safs;
+
+const int NUM_PAGES = 1024;
+const int BATCH_SIZE = 64;
+
+config_map::ptr get_configs(const std::string &root_conf)
+{
+	std::string opts[] = {
+		std::string("root_conf=") + root_conf,
+		"merge_disk_reqs=",
+		"io_merge_window=1000",
+		"io_stats=",
+	};
+	const int num_opts = sizeof(opts) / sizeof(opts[0]);
+	const char *opt_strs[num_opts];
+	for (int i = 0; i < num_opts; i++)
+		opt_strs[i] = opts[i].c_str();
+	config_map::ptr configs = config_map::create();
+	configs->add_options(opt_strs, num_opts);
+	return configs;
+}
+
+size_t get_num_disk_reqs()
+{
+	io_stats stats;
+	get_io_stats(stats);
+	size_t num = 0;
+	for (size_t i = 0; i < stats.disks.size(); i++)
+		num += stats.disks[i].latency.get_count();
+	return num;
+}
+
+/*
+ * The buffer of a page is placed in the reverse order of the pages,
+ * so a merged request has to scatter the data to different buffers.
+ */
+char *get_page_buf(char *buf, int pg_idx)
+{
+	return buf + (NUM_PAGES - 1 - pg_idx) * PAGE_SIZE;
+}
+
+/*
+ * Access a batch of pages in two rounds. The even pages are sent in
+ * the first round and the odd pages in the second round, so the adjacent
+ * pages are sent to the I/O thread in different messages.
+ */
+void access_batch(io_interface &io, char *buf, int batch_idx, int access_method)
+{
+	std::vector<io_request> reqs;
+	for (int round = 0; round < 2; round++) {
+		reqs.clear();
+		for (int i = round; i < BATCH_SIZE; i += 2) {
+			int pg_idx = batch_idx * BATCH_SIZE + i;
+			data_loc_t loc(io.get_file_id(), pg_idx * PAGE_SIZE);
+			reqs.push_back(io_request(get_page_buf(buf, pg_idx), loc,
+						PAGE_SIZE, access_method));
+		}
+		io.access(reqs.data(), reqs.size());
+		io.flush_requests();
+	}
+	io.wait4complete(BATCH_SIZE);
+}
+
+void test_merge(const std::string &root_conf)
+{
+	std::string file_name = "test-disk-merge";
+	init_io_system(get_configs(root_conf));
+	safs_file file(get_sys_RAID_conf(), file_name);
+	assert(file.create_file(NUM_PAGES * PAGE_SIZE));
+
+	char *buf = (char *) valloc(NUM_PAGES * PAGE_SIZE);
+	for (int i = 0; i < NUM_PAGES; i++) {
+		long *pg = (long *) get_page_buf(buf, i);
+		for (size_t j = 0; j < PAGE_SIZE / sizeof(long); j++)
+			pg[j] = i * PAGE_SIZE + j * sizeof(long);
+	}
+	file_io_factory::shared_ptr factory = create_io_factory(file_name,
+			REMOTE_ACCESS);
+	io_interface::ptr io = create_io(factory, thread::get_curr_thread());
+	for (int i = 0; i < NUM_PAGES / BATCH_SIZE; i++)
+		access_batch(*io, buf, i, WRITE);
+	size_t num_writes = get_num_disk_reqs();
+
+	memset(buf, 0, NUM_PAGES * PAGE_SIZE);
+	for (int i = 0; i < NUM_PAGES / BATCH_SIZE; i++)
+		access_batch(*io, buf, i, READ);
+	size_t num_reads = get_num_disk_reqs() - num_writes;
+	for (int i = 0; i < NUM_PAGES; i++) {
+		long *pg = (long *) get_page_buf(buf, i);
+		for (size_t j = 0; j < PAGE_SIZE / sizeof(long); j++)
+			assert(pg[j] == (long) (i * PAGE_SIZE + j * sizeof(long)));
+	}
+	io->cleanup();
+	printf("%d pages are written in %ld writes and read in %ld reads\n",
+			NUM_PAGES, num_writes, num_reads);
+	// The I/O thread merges the adjacent requests in different messages.
+	assert(num_writes < (size_t) NUM_PAGES);
+	assert(num_reads < (size_t) NUM_PAGES);
+
+	io = NULL;
+	factory = NULL;
+	free(buf);
+	file.delete_file();
+	destroy_io_system();
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2)
+		return 0;
+	test_merge(argv[1]);
+	printf("the I/O threads merge requests correctly\n");
+}
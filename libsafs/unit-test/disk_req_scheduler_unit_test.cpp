@@ -0,0 +1,134 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "disk_req_scheduler.h"
+
+using namespace safs;
+
+const int NUM_REQS = 1000;
+
+static std::vector<int> get_weights(int latency, int normal, int bulk)
+{
+	std::vector<int> weights;
+	weights.push_back(latency);
+	weights.push_back(normal);
+	weights.push_back(bulk);
+	return weights;
+}
+
+static io_request create_req(int file_id, off_t off, size_t size,
+		io_prio_class prio)
+{
+	data_loc_t loc(file_id, off);
+	io_request req((char *) NULL, loc, size, READ);
+	req.set_prio_class(prio);
+	return req;
+}
+
+/*
+ * The requests in a class are issued in the order of their locations,
+ * starting from where the last request ends.
+ */
+void test_elevator()
+{
+	disk_req_scheduler sched(get_weights(16, 4, 1));
+	off_t offs[] = {5, 2, 9, 7, 1};
+	for (size_t i = 0; i < sizeof(offs) / sizeof(offs[0]); i++)
+		sched.add(create_req(0, offs[i] * PAGE_SIZE, PAGE_SIZE,
+					IO_PRIO_NORMAL), 0);
+	std::vector<io_request> reqs;
+	assert(sched.fetch(reqs, 2, 0) == 2);
+	assert(reqs[0].get_offset() == 1 * PAGE_SIZE);
+	assert(reqs[1].get_offset() == 2 * PAGE_SIZE);
+
+	// A request behind the elevator waits for the next round.
+	sched.add(create_req(0, 0, PAGE_SIZE, IO_PRIO_NORMAL), 0);
+	sched.add(create_req(0, 6 * PAGE_SIZE, PAGE_SIZE, IO_PRIO_NORMAL), 0);
+	reqs.clear();
+	assert(sched.fetch(reqs, 10, 0) == 5);
+	off_t expected[] = {5, 6, 7, 9, 0};
+	for (size_t i = 0; i < reqs.size(); i++)
+		assert(reqs[i].get_offset() == expected[i] * PAGE_SIZE);
+	assert(sched.is_empty());
+}
+
+/*
+ * The classes share the disks by their weights.
+ */
+void test_fair_queuing()
+{
+	disk_req_scheduler sched(get_weights(16, 4, 1));
+	for (int i = 0; i < NUM_REQS; i++) {
+		sched.add(create_req(0, i * PAGE_SIZE, PAGE_SIZE, IO_PRIO_LATENCY), 0);
+		sched.add(create_req(1, i * PAGE_SIZE, PAGE_SIZE, IO_PRIO_NORMAL), 0);
+		sched.add(create_req(2, i * PAGE_SIZE, PAGE_SIZE, IO_PRIO_BULK), 0);
+	}
+	std::vector<io_request> reqs;
+	sched.fetch(reqs, 21 * 10, 0);
+	int num[NUM_IO_PRIO_CLASSES] = {0, 0, 0};
+	for (size_t i = 0; i < reqs.size(); i++)
+		num[reqs[i].get_prio_class()]++;
+	printf("latency: %d, normal: %d, bulk: %d\n", num[0], num[1], num[2]);
+	assert(abs(num[IO_PRIO_LATENCY] - 160) <= 1);
+	assert(abs(num[IO_PRIO_NORMAL] - 40) <= 1);
+	assert(abs(num[IO_PRIO_BULK] - 10) <= 1);
+
+	// A class that has been idle doesn't get more than its share.
+	disk_req_scheduler sched2(get_weights(1, 1, 1));
+	for (int i = 0; i < NUM_REQS; i++)
+		sched2.add(create_req(2, i * PAGE_SIZE, PAGE_SIZE, IO_PRIO_BULK), 0);
+	reqs.clear();
+	sched2.fetch(reqs, NUM_REQS / 2, 0);
+	for (int i = 0; i < NUM_REQS; i++)
+		sched2.add(create_req(0, i * PAGE_SIZE, PAGE_SIZE, IO_PRIO_LATENCY), 0);
+	reqs.clear();
+	sched2.fetch(reqs, 100, 0);
+	int num_latency = 0;
+	for (size_t i = 0; i < reqs.size(); i++)
+		if (reqs[i].get_prio_class() == IO_PRIO_LATENCY)
+			num_latency++;
+	assert(abs(num_latency - 50) <= 1);
+}
+
+/*
+ * A request is issued first once its deadline passes.
+ */
+void test_deadline()
+{
+	disk_req_scheduler sched(get_weights(16, 4, 1));
+	for (int i = 1; i <= NUM_REQS; i++)
+		sched.add(create_req(0, i * PAGE_SIZE, PAGE_SIZE, IO_PRIO_NORMAL), 0);
+	std::vector<io_request> reqs;
+	sched.fetch(reqs, 10, 0);
+	// The request is behind the elevator, so it has to wait for
+	// the elevator to go back without a deadline.
+	io_request req = create_req(0, 0, PAGE_SIZE, IO_PRIO_NORMAL);
+	req.set_deadline(1000);
+	assert(req.get_deadline() == 1000);
+	sched.add(req, 0);
+
+	reqs.clear();
+	sched.fetch(reqs, 1, 999 * 1000);
+	assert(reqs[0].get_offset() == 11 * PAGE_SIZE);
+	reqs.clear();
+	sched.fetch(reqs, 1, 1000 * 1000);
+	assert(reqs[0].get_offset() == 0);
+	assert(sched.get_num_expired() == 1);
+
+	// The deadline is removed if the request is issued before it.
+	req = create_req(0, 0, PAGE_SIZE, IO_PRIO_NORMAL);
+	req.set_deadline(1000);
+	sched.add(req, 0);
+	reqs.clear();
+	sched.fetch(reqs, NUM_REQS * 2, 0);
+	assert(sched.is_empty());
+	assert(sched.get_num_expired() == 1);
+	assert(sched.get_num_issued(IO_PRIO_NORMAL) == NUM_REQS + 2);
+}
+
+int main()
+{
+	test_elevator();
+	test_fair_queuing();
+	test_deadline();
+}
@@ -97,4 +97,40 @@ int main()
 	printf("hash mapper\n");
 	hash_mapper mapperh("", files, BLOCK_SIZE);
 	test_get_file_sizes(mapperh, BLOCK_SIZE);
+
+	printf("weighted mapper\n");
+	std::vector<part_file_info> wfiles;
+	int total_weight = 0;
+	for (int i = 0; i < 3; i++) {
+		wfiles.push_back(part_file_info("", i, 0, i + 1));
+		total_weight += i + 1;
+	}
+	weighted_mapper mapperw("", wfiles, BLOCK_SIZE);
+	test_get_file_sizes(mapperw, BLOCK_SIZE);
+	int num_blocks = 600;
+	std::unique_ptr<id_vec[]> locsw
+		= std::unique_ptr<id_vec[]>(new id_vec[wfiles.size()]);
+	for (int i = 0; i < num_blocks; i++) {
+		off_t off = i * BLOCK_SIZE;
+		block_identifier bid;
+		mapperw.map(off, bid);
+		struct extended_block_identifier ebid;
+		ebid.bid = bid;
+		assert(bid.idx == mapperw.map2file(off));
+		ebid.orig_off = off;
+		locsw[bid.idx].push_back(ebid);
+	}
+	for (size_t i = 0; i < wfiles.size(); i++) {
+		printf("file %ld: has %ld blocks\n", i, locsw[i].size());
+		// A disk gets blocks in proportion to its weight.
+		assert(locsw[i].size() == (size_t) num_blocks
+				* wfiles[i].get_weight() / total_weight);
+		// The blocks on a disk are stored contiguously in the order of
+		// their offsets in the file.
+		for (size_t j = 0; j < locsw[i].size(); j++) {
+			assert(locsw[i][j].bid.off == (off_t) j * BLOCK_SIZE);
+			if (j > 0)
+				assert(locsw[i][j - 1].orig_off < locsw[i][j].orig_off);
+		}
+	}
 }
@@ -0,0 +1,128 @@
+#include <stdio.h>
+
+#include "io_interface.h"
+#include "safs_file.h"
+#include "RAID_config.h"
+#include "io_stats.h"
+
+using namespace safs;
+
+const int NUM_PAGES = 16384;
+
+config_map::ptr get_configs(const std::string &root_conf,
+		const std::string &latency_target)
+{
+	std::string opts[] = {
+		std::string("root_conf=") + root_conf,
+		"cache_size=16M",
+		"use_flusher=",
+		"io_stats=",
+		std::string("flush_latency_target=") + latency_target,
+	};
+	const int num_opts = sizeof(opts) / sizeof(opts[0]);
+	const char *opt_strs[num_opts];
+	for (int i = 0; i < num_opts; i++)
+		opt_strs[i] = opts[i].c_str();
+	config_map::ptr configs = config_map::create();
+	configs->add_options(opt_strs, num_opts);
+	return configs;
+}
+
+size_t get_num_disk_reqs()
+{
+	io_stats stats;
+	get_io_stats(stats);
+	size_t num = 0;
+	for (size_t i = 0; i < stats.disks.size(); i++)
+		num += stats.disks[i].latency.get_count();
+	return num;
+}
+
+void fill_page(long *buf, int pg_idx)
+{
+	for (size_t j = 0; j < PAGE_SIZE / sizeof(long); j++)
+		buf[j] = pg_idx * PAGE_SIZE + j * sizeof(long);
+}
+
+bool check_page(const long *buf, int pg_idx)
+{
+	for (size_t j = 0; j < PAGE_SIZE / sizeof(long); j++)
+		if (buf[j] != (long) (pg_idx * PAGE_SIZE + j * sizeof(long)))
+			return false;
+	return true;
+}
+
+/*
+ * Write a file through the page cache and check the dirty pages written
+ * back by the flusher.
+ */
+void test_flush(const std::string &root_conf, const std::string &latency_target)
+{
+	std::string file_name = "test-flusher";
+	init_io_system(get_configs(root_conf, latency_target));
+	safs_file file(get_sys_RAID_conf(), file_name);
+	assert(file.create_file(NUM_PAGES * PAGE_SIZE));
+
+	// The page cache is much smaller than the file, so the flusher has to
+	// write back the dirty pages before they are evicted.
+	long *buf = (long *) valloc(PAGE_SIZE);
+	file_io_factory::shared_ptr factory = create_io_factory(file_name,
+			GLOBAL_CACHE_ACCESS);
+	io_interface::ptr io = create_io(factory, thread::get_curr_thread());
+	// Overwrite entire pages, so the page cache doesn't read the pages.
+	for (int i = 0; i < NUM_PAGES; i++) {
+		fill_page(buf, i);
+		io->access((char *) buf, i * PAGE_SIZE, PAGE_SIZE, WRITE);
+	}
+	// Wait for the flushes to complete.
+	sleep(1);
+	size_t num_flushes = get_num_disk_reqs();
+
+	// The page cache has the latest data.
+	for (int i = 0; i < NUM_PAGES; i++) {
+		io->access((char *) buf, i * PAGE_SIZE, PAGE_SIZE, READ);
+		assert(check_page(buf, i));
+	}
+	io->cleanup();
+	io = NULL;
+
+	// A page on the disks either has been written back or is still empty,
+	// as the new file is filled with 0.
+	factory = create_io_factory(file_name, REMOTE_ACCESS);
+	io = create_io(factory, thread::get_curr_thread());
+	int num_flushed_pages = 0;
+	for (int i = 0; i < NUM_PAGES; i++) {
+		data_loc_t loc(io->get_file_id(), i * PAGE_SIZE);
+		io_request req((char *) buf, loc, PAGE_SIZE, READ);
+		io->access(&req, 1);
+		io->wait4complete(1);
+		if (check_page(buf, i))
+			num_flushed_pages++;
+		else
+			for (size_t j = 0; j < PAGE_SIZE / sizeof(long); j++)
+				assert(buf[j] == 0);
+	}
+	io->cleanup();
+	printf("%d pages are written back in %ld writes\n", num_flushed_pages,
+			num_flushes);
+	// The flusher merges adjacent dirty pages in a write.
+	assert(num_flushed_pages > 0);
+	assert(num_flushes > 0 && num_flushes < (size_t) num_flushed_pages);
+	io = NULL;
+	factory = NULL;
+	free(buf);
+
+	file.delete_file();
+	destroy_io_system();
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2)
+		return 0;
+	// The page cache outlives the I/O system, so we can only test
+	// the flusher once in a process.
+	std::string latency_target = argc >= 3 ? argv[2] : "10000";
+	test_flush(argv[1], latency_target);
+	printf("the flusher writes back dirty pages correctly\n");
+}
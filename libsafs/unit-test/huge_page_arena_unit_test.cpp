@@ -0,0 +1,131 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "huge_page_arena.h"
+#include "slab_allocator.h"
+
+const size_t MB = 1024 * 1024;
+
+size_t get_tot_mapped(const huge_page_arena::stat &stat)
+{
+	size_t tot = 0;
+	for (int i = 0; i < huge_page_arena::NUM_PAGE_TYPES; i++)
+		tot += stat.mapped_bytes[i];
+	return tot;
+}
+
+void test_alloc()
+{
+	assert(!huge_page_arena::is_enabled());
+	assert(huge_page_arena::get(0) == NULL);
+	huge_page_arena::enable(2 * MB);
+	huge_page_arena *arena = huge_page_arena::get(0);
+	assert(arena);
+	assert(arena == huge_page_arena::get(0));
+	assert(arena != huge_page_arena::get(-1));
+	assert(arena->get_node_id() == 0);
+
+	// Allocate chunks of different sizes and make sure they don't overlap.
+	const int NUM_CHUNKS = 40;
+	char *chunks[NUM_CHUNKS];
+	size_t sizes[NUM_CHUNKS];
+	size_t tot_size = 0;
+	for (int i = 0; i < NUM_CHUNKS; i++) {
+		sizes[i] = (i % 4 + 1) * MB + (i % 3) * 4096;
+		chunks[i] = arena->alloc(sizes[i]);
+		assert(chunks[i]);
+		assert(((long) chunks[i]) % 4096 == 0);
+		memset(chunks[i], i, sizes[i]);
+		tot_size += sizes[i];
+	}
+	for (int i = 0; i < NUM_CHUNKS; i++) {
+		assert(chunks[i][0] == i && chunks[i][sizes[i] - 1] == i);
+		for (int j = 0; j < NUM_CHUNKS; j++)
+			assert(i == j || chunks[i] + sizes[i] <= chunks[j]
+					|| chunks[j] + sizes[j] <= chunks[i]);
+	}
+	huge_page_arena::stat stat = arena->get_stat();
+	assert(stat.used_bytes == tot_size);
+	assert(get_tot_mapped(stat) >= tot_size);
+	assert(stat.mapped_bytes[huge_page_arena::PAGE_1G] == 0);
+	printf("%ld bytes in 2M pages, %ld bytes in normal pages, %ld failures\n",
+			stat.mapped_bytes[huge_page_arena::PAGE_2M],
+			stat.mapped_bytes[huge_page_arena::PAGE_NORMAL],
+			stat.num_failures[huge_page_arena::PAGE_2M]);
+
+	// The freed chunks are reused.
+	arena->free(chunks[3], sizes[3]);
+	assert(arena->get_stat().free_bytes == sizes[3]);
+	assert(arena->alloc(sizes[3]) == chunks[3]);
+	assert(arena->get_stat().free_bytes == 0);
+	size_t mapped = get_tot_mapped(arena->get_stat());
+	for (int i = 0; i < NUM_CHUNKS; i++)
+		arena->free(chunks[i], sizes[i]);
+	stat = arena->get_stat();
+	assert(stat.used_bytes == 0);
+	assert(stat.free_bytes == tot_size);
+	for (int i = 0; i < NUM_CHUNKS; i++)
+		chunks[i] = arena->alloc(sizes[i]);
+	assert(get_tot_mapped(arena->get_stat()) == mapped);
+	for (int i = 0; i < NUM_CHUNKS; i++)
+		arena->free(chunks[i], sizes[i]);
+	printf("the arena allocates memory correctly\n");
+}
+
+void test_slab()
+{
+	huge_page_arena *arena = huge_page_arena::get(0);
+	size_t used = arena->get_stat().used_bytes;
+	slab_allocator *alloc = new slab_allocator("test-slab", 4096, 8 * MB,
+			64 * MB, 0);
+	char *objs[1024];
+	assert(alloc->alloc(objs, 1024) == 1024);
+	// The slab allocator gets its memory from the arena.
+	assert(arena->get_stat().used_bytes == used + 8 * MB);
+	for (int i = 0; i < 1024; i++)
+		memset(objs[i], 0, 4096);
+	alloc->free(objs, 1024);
+	delete alloc;
+	assert(arena->get_stat().used_bytes == used);
+
+	// The allocators created after the arenas are disabled don't use them.
+	huge_page_arena::disable();
+	assert(huge_page_arena::get(0) == NULL);
+	alloc = new slab_allocator("test-slab", 4096, 8 * MB, 64 * MB, 0);
+	assert(alloc->alloc(objs, 1024) == 1024);
+	assert(arena->get_stat().used_bytes == used);
+	alloc->free(objs, 1024);
+	delete alloc;
+	printf("the slab allocator uses the arena correctly\n");
+}
+
+void test_fallback()
+{
+	huge_page_arena::enable(1024 * MB);
+	huge_page_arena *arena = huge_page_arena::get(0);
+	huge_page_arena::stat stat = arena->get_stat();
+	// The chunk is larger than any free space in the arena, so the arena
+	// has to map a new region.
+	char *buf = arena->alloc(200 * MB);
+	assert(buf);
+	memset(buf, 0, MB);
+	huge_page_arena::stat new_stat = arena->get_stat();
+	// We either get 1G pages or fall back.
+	assert(new_stat.mapped_bytes[huge_page_arena::PAGE_1G]
+			> stat.mapped_bytes[huge_page_arena::PAGE_1G]
+			|| new_stat.num_failures[huge_page_arena::PAGE_1G]
+			> stat.num_failures[huge_page_arena::PAGE_1G]);
+	arena->free(buf, 200 * MB);
+
+	huge_page_arena::stat tot = huge_page_arena::get_tot_stat();
+	assert(tot.used_bytes == 0);
+	huge_page_arena::disable();
+	printf("the arena falls back correctly\n");
+}
+
+int main()
+{
+	test_alloc();
+	test_slab();
+	test_fallback();
+}
@@ -0,0 +1,52 @@
+#include <stdio.h>
+#include <assert.h>
+
+#include "hybrid_poller.h"
+
+using namespace safs;
+
+/*
+ * A thread spins for fast devices and blocks for slow devices.
+ */
+void test_adapt()
+{
+	// The thread spins for at most 50us.
+	hybrid_poller poller(50000);
+	// We don't know the device latency in the beginning, so we block.
+	assert(poller.get_spin_ns() == 0);
+
+	// Completions arrive in 10us.
+	for (int i = 0; i < 100; i++)
+		poller.add_wait(10000, 0, false);
+	long spin_ns = poller.get_spin_ns();
+	assert(spin_ns > 10000 && spin_ns <= 50000);
+
+	// The device becomes slow.
+	for (int i = 0; i < 100; i++)
+		poller.add_wait(5000000, spin_ns, false);
+	assert(poller.get_spin_ns() == 0);
+
+	// The device becomes fast again.
+	for (int i = 0; i < 100; i++)
+		poller.add_wait(5000, 0, false);
+	assert(poller.get_spin_ns() > 0);
+	poller.add_wait(4000, 4000, true);
+	assert(poller.get_num_spin_completes() == 1);
+	assert(poller.get_num_blocks() == 300);
+	printf("the poller adapts to the device latency\n");
+}
+
+void test_disabled()
+{
+	hybrid_poller poller(0);
+	for (int i = 0; i < 100; i++)
+		poller.add_wait(1000, 0, false);
+	assert(poller.get_spin_ns() == 0);
+	printf("the poller never spins if spinning is disabled\n");
+}
+
+int main()
+{
+	test_adapt();
+	test_disabled();
+}
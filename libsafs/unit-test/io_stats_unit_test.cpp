@@ -0,0 +1,160 @@
+#include <stdio.h>
+
+#include "io_interface.h"
+#include "safs_file.h"
+#include "native_file.h"
+#include "RAID_config.h"
+#include "io_stats.h"
+
+using namespace safs;
+
+const int NUM_PAGES = 1024;
+
+void test_histogram()
+{
+	log_histogram hist;
+	assert(hist.get_count() == 0);
+	assert(hist.get_percentile(50) == 0);
+
+	// Small values are recorded exactly.
+	for (uint64_t i = 0; i < 32; i++)
+		assert(log_histogram::get_value(log_histogram::get_idx(i)) == i);
+	// Large values are recorded with a relative error of at most 1/32.
+	for (uint64_t v = 32; v < (1UL << 40); v = v * 3 / 2 + 1) {
+		uint64_t recorded = log_histogram::get_value(log_histogram::get_idx(v));
+		assert(recorded >= v);
+		assert(recorded - v <= v / 32);
+	}
+
+	for (uint64_t i = 1; i <= 10000; i++)
+		hist.record(i * 1000);
+	assert(hist.get_count() == 10000);
+	assert(hist.get_min() == 1000);
+	assert(hist.get_max() == 10000000);
+	assert(hist.get_mean() == 5000500);
+	double percents[] = {50, 90, 99, 99.9};
+	for (size_t i = 0; i < sizeof(percents) / sizeof(percents[0]); i++) {
+		uint64_t expected = (uint64_t) (percents[i] * 100) * 1000;
+		uint64_t v = hist.get_percentile(percents[i]);
+		assert(v >= expected && v - expected <= expected / 32);
+	}
+	assert(hist.get_percentile(100) == hist.get_max());
+
+	// A value recorded with a weight.
+	log_histogram depth;
+	depth.record(0, 900);
+	depth.record(16, 100);
+	assert(depth.get_percentile(50) == 0);
+	assert(depth.get_percentile(95) == 16);
+	assert(depth.get_mean() == 1.6);
+
+	log_histogram merged;
+	merged.merge(hist);
+	merged.merge(depth);
+	assert(merged.get_count() == hist.get_count() + depth.get_count());
+	assert(merged.get_min() == 0);
+	assert(merged.get_max() == hist.get_max());
+	printf("the histogram is correct\n");
+}
+
+config_map::ptr get_configs(const std::string &root_conf,
+		const std::string &dump_file)
+{
+	std::string opts[] = {
+		std::string("root_conf=") + root_conf,
+		std::string("io_stats_dump_file=") + dump_file,
+	};
+	const char *opt_strs[2];
+	for (int i = 0; i < 2; i++)
+		opt_strs[i] = opts[i].c_str();
+	config_map::ptr configs = config_map::create();
+	configs->add_options(opt_strs, 2);
+	return configs;
+}
+
+/*
+ * Access a file with the remote I/O and check the statistics collected by
+ * the I/O threads.
+ */
+void test_io(const std::string &root_conf)
+{
+	std::string file_name = "test-io-stats";
+	std::string dump_file = "/tmp/safs_io_stats.json";
+	init_io_system(get_configs(root_conf, dump_file));
+	safs_file file(get_sys_RAID_conf(), file_name);
+	assert(file.create_file(NUM_PAGES * PAGE_SIZE));
+
+	char *buf = (char *) valloc(PAGE_SIZE);
+	memset(buf, 0, PAGE_SIZE);
+	file_io_factory::shared_ptr factory = create_io_factory(file_name,
+			REMOTE_ACCESS);
+	io_interface::ptr io = create_io(factory, thread::get_curr_thread());
+	for (int i = 0; i < NUM_PAGES; i++) {
+		data_loc_t loc(io->get_file_id(), i * PAGE_SIZE);
+		io_request req(buf, loc, PAGE_SIZE, i % 2 ? READ : WRITE);
+		io->access(&req, 1);
+		io->wait4complete(1);
+	}
+	io->cleanup();
+
+	io_stats stats;
+	get_io_stats(stats);
+	assert(!stats.threads.empty());
+	assert(stats.disks.size() == (size_t) get_sys_RAID_conf().get_num_disks());
+	uint64_t num_thread_reqs = 0;
+	uint64_t num_waits = 0;
+	for (size_t i = 0; i < stats.threads.size(); i++) {
+		num_thread_reqs += stats.threads[i].latency.get_count();
+		num_waits += stats.threads[i].queue_wait.get_count();
+	}
+	assert(num_thread_reqs == NUM_PAGES);
+	assert(num_waits == NUM_PAGES);
+	uint64_t num_disk_reqs = 0;
+	for (size_t i = 0; i < stats.disks.size(); i++) {
+		num_disk_reqs += stats.disks[i].latency.get_count();
+		// We send one request at a time, so a disk never has more than
+		// one in-flight request.
+		assert(stats.disks[i].depth.get_max() <= 1);
+	}
+	assert(num_disk_reqs == NUM_PAGES);
+	bool found = false;
+	for (size_t i = 0; i < stats.files.size(); i++) {
+		if (stats.files[i].file_id == io->get_file_id()) {
+			assert(stats.files[i].name == file_name);
+			assert(stats.files[i].latency.get_count() == NUM_PAGES);
+			found = true;
+		}
+	}
+	assert(found);
+	printf("p50 latency: %.3fus, p99 latency: %.3fus\n",
+			stats.threads[0].latency.get_percentile(50) / 1000.0,
+			stats.threads[0].latency.get_percentile(99) / 1000.0);
+
+	assert(dump_io_stats(dump_file));
+	FILE *f = fopen(dump_file.c_str(), "r");
+	assert(f);
+	char line[4096];
+	bool has_file = false;
+	while (fgets(line, sizeof(line), f))
+		if (strstr(line, file_name.c_str()) && strstr(line, "p99"))
+			has_file = true;
+	fclose(f);
+	assert(has_file);
+
+	io = NULL;
+	factory = NULL;
+	free(buf);
+	file.delete_file();
+	destroy_io_system();
+	// The statistics are dumped when SAFS is destroyed.
+	assert(native_file(dump_file).exist());
+	unlink(dump_file.c_str());
+	printf("the I/O statistics are collected correctly\n");
+}
+
+int main(int argc, char *argv[])
+{
+	test_histogram();
+	if (argc >= 2)
+		test_io(argv[1]);
+}
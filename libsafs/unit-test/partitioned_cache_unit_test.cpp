@@ -0,0 +1,100 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "partitioned_cache.h"
+
+using namespace safs;
+
+const int GRAPH_FILE_ID = 1;
+const int MATRIX_FILE_ID = 2;
+// The number of pages in the graph file. It fits in the partition.
+const int NUM_GRAPH_PAGES = 256;
+// The number of pages scanned in the matrix file. It's much larger than
+// the page cache.
+const int NUM_MATRIX_PAGES = 4096;
+
+/*
+ * Access a page. If the page isn't ready, it's read from the "disk".
+ * It returns true if the page is in the page cache.
+ */
+static bool access_page(page_cache &cache, int file_id, off_t off)
+{
+	page_id_t pg_id(file_id, off);
+	page_id_t old_id;
+	thread_safe_page *pg = (thread_safe_page *) cache.search(pg_id, old_id);
+	assert(pg);
+	bool ready = pg->data_ready();
+	if (!ready)
+		pg->set_data_ready(true);
+	pg->dec_ref();
+	return ready;
+}
+
+void test_spec()
+{
+	std::vector<int> node_ids(1, 0);
+	try {
+		partitioned_cache::create(4 * 1024 * 1024, ASSOCIATIVE_CACHE,
+				node_ids, "graph", 100);
+		assert(0);
+	} catch (std::invalid_argument &e) {
+	}
+	try {
+		partitioned_cache::create(4 * 1024 * 1024, ASSOCIATIVE_CACHE,
+				node_ids, "graph:4M", 100);
+		assert(0);
+	} catch (std::invalid_argument &e) {
+	}
+	try {
+		partitioned_cache::create(4 * 1024 * 1024, ASSOCIATIVE_CACHE,
+				node_ids, "graph:1M,graph+matrix:1M", 100);
+		assert(0);
+	} catch (std::invalid_argument &e) {
+	}
+}
+
+/*
+ * A scan on the matrix file can't evict the pages of the graph file
+ * in its own partition.
+ */
+void test_isolation()
+{
+	std::vector<int> node_ids(1, 0);
+	partitioned_cache::ptr cache = partitioned_cache::create(4 * 1024 * 1024,
+			ASSOCIATIVE_CACHE, node_ids, "graph+graph.index:2M", 100);
+	page_cache::ptr graph_cache = cache->get_file_cache(GRAPH_FILE_ID, "graph");
+	page_cache::ptr matrix_cache = cache->get_file_cache(MATRIX_FILE_ID,
+			"matrix");
+	assert(graph_cache != matrix_cache);
+	assert(cache->get_file_cache(3, "graph.index") == graph_cache);
+
+	for (int i = 0; i < NUM_GRAPH_PAGES; i++)
+		assert(!access_page(*graph_cache, GRAPH_FILE_ID, i * PAGE_SIZE));
+	for (int i = 0; i < NUM_MATRIX_PAGES; i++)
+		access_page(*matrix_cache, MATRIX_FILE_ID, i * PAGE_SIZE);
+	// The pages are routed to the partitions by their file ids.
+	for (int i = 0; i < NUM_GRAPH_PAGES; i++)
+		assert(access_page(*cache, GRAPH_FILE_ID, i * PAGE_SIZE));
+
+	std::vector<cache_part_stat> stats;
+	cache->get_part_stats(stats);
+	assert(stats.size() == 2);
+	assert(stats[0].name == "shared");
+	assert(stats[0].size == 2 * 1024 * 1024);
+	assert(stats[0].num_misses == NUM_MATRIX_PAGES);
+	assert(stats[1].name == "graph+graph.index");
+	assert(stats[1].num_accesses == NUM_GRAPH_PAGES * 2);
+	assert(stats[1].num_misses == NUM_GRAPH_PAGES);
+	for (size_t i = 0; i < stats.size(); i++)
+		printf("partition %s: %ld accesses, %ld misses\n",
+				stats[i].name.c_str(), stats[i].num_accesses,
+				stats[i].num_misses);
+}
+
+int main()
+{
+	std::map<std::string, std::string> configs;
+	params.init(configs);
+	test_spec();
+	test_isolation();
+}
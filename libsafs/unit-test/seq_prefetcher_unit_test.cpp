@@ -0,0 +1,170 @@
+#include <stdio.h>
+
+#include "io_interface.h"
+#include "safs_file.h"
+#include "seq_prefetcher.h"
+#include "global_cached_private.h"
+
+using namespace safs;
+
+const int MAX_WINDOW = 64;
+const int NUM_PAGES = 1024;
+
+/*
+ * Read a stream page by page and pretend every page read ahead
+ * is still in the page cache.
+ */
+void test_window()
+{
+	seq_prefetcher prefetcher(MAX_WINDOW);
+	off_t prefetch_end = 0;
+	int max_window = 0;
+	for (int i = 0; i < NUM_PAGES; i++) {
+		off_t off = ((off_t) i) * PAGE_SIZE;
+		prefetcher.start_read(off, PAGE_SIZE);
+		prefetcher.access_page(off, off < prefetch_end);
+		off_t pf_off;
+		int num_pages = prefetcher.end_read(pf_off);
+		if (i == 0)
+			assert(num_pages == 0);
+		if (num_pages > 0) {
+			// The data is read ahead right after the data read before.
+			assert(pf_off == std::max(prefetch_end, off + PAGE_SIZE));
+			prefetch_end = pf_off + ((off_t) num_pages) * PAGE_SIZE;
+			prefetcher.prefetched(prefetch_end, num_pages);
+			max_window = std::max(max_window,
+					(int) ((prefetch_end - off) / PAGE_SIZE) - 1);
+		}
+		assert(prefetch_end - off <= (MAX_WINDOW + 1) * PAGE_SIZE);
+	}
+	assert(max_window == MAX_WINDOW);
+	assert(prefetcher.get_num_evicted_pages() == 0);
+	// All pages except the ones read before the stream is detected
+	// are read ahead and all of them are used.
+	assert(prefetcher.get_num_useful_pages() >= NUM_PAGES - MAX_WINDOW - 2);
+	printf("the window grows to %d pages, %ld pages read ahead, %ld used\n",
+			max_window, prefetcher.get_num_prefetched_pages(),
+			prefetcher.get_num_useful_pages());
+
+	// The pages read ahead are evicted before they are used,
+	// so the window should shrink.
+	off_t off = ((off_t) NUM_PAGES) * PAGE_SIZE;
+	off_t pf_off;
+	int num_pages;
+
+	// A page read ahead is useful only once no matter how many times
+	// it's accessed.
+	size_t num_useful = prefetcher.get_num_useful_pages();
+	assert(off < prefetch_end);
+	prefetcher.start_read(off, PAGE_SIZE);
+	prefetcher.access_page(off, true);
+	prefetcher.access_page(off, true);
+	assert(prefetcher.get_num_useful_pages() == num_useful + 1);
+	num_pages = prefetcher.end_read(pf_off);
+	if (num_pages > 0)
+		prefetcher.prefetched(pf_off + ((off_t) num_pages) * PAGE_SIZE,
+				num_pages);
+	off += PAGE_SIZE;
+
+	for (int i = 0; i < 8; i++) {
+		prefetcher.start_read(off, PAGE_SIZE);
+		prefetcher.access_page(off, false);
+		num_pages = prefetcher.end_read(pf_off);
+		if (num_pages > 0)
+			prefetcher.prefetched(pf_off + ((off_t) num_pages) * PAGE_SIZE,
+					num_pages);
+		off += PAGE_SIZE;
+	}
+	assert(prefetcher.get_num_evicted_pages() > 0);
+	// The readahead window is reduced to a page.
+	for (int i = 0; i < 64; i++) {
+		prefetcher.start_read(off, PAGE_SIZE);
+		prefetcher.access_page(off, false);
+		num_pages = prefetcher.end_read(pf_off);
+		if (num_pages > 0)
+			prefetcher.prefetched(pf_off + ((off_t) num_pages) * PAGE_SIZE,
+					num_pages);
+		off += PAGE_SIZE;
+	}
+	assert(num_pages <= 1);
+
+	// Random reads don't trigger readahead.
+	seq_prefetcher rand_prefetcher(MAX_WINDOW);
+	for (int i = 0; i < NUM_PAGES; i++) {
+		off_t off = ((off_t) (random() % NUM_PAGES)) * PAGE_SIZE * 4;
+		rand_prefetcher.start_read(off, PAGE_SIZE);
+		assert(rand_prefetcher.end_read(pf_off) == 0);
+	}
+	printf("the readahead window is adjusted correctly\n");
+}
+
+config_map::ptr get_configs(const std::string &root_conf)
+{
+	std::string opts[] = {
+		std::string("root_conf=") + root_conf,
+		"cache_size=16M",
+		"max_prefetch_size=256K",
+	};
+	const char *opt_strs[3];
+	for (int i = 0; i < 3; i++)
+		opt_strs[i] = opts[i].c_str();
+	config_map::ptr configs = config_map::create();
+	configs->add_options(opt_strs, 3);
+	return configs;
+}
+
+/*
+ * Read a file sequentially through the page cache with readahead and
+ * check the data.
+ */
+void test_read(const std::string &root_conf)
+{
+	std::string file_name = "test-prefetch";
+	init_io_system(get_configs(root_conf));
+	safs_file file(get_sys_RAID_conf(), file_name);
+	assert(file.create_file(NUM_PAGES * PAGE_SIZE));
+
+	long *buf = (long *) valloc(PAGE_SIZE);
+	file_io_factory::shared_ptr factory = create_io_factory(file_name,
+			REMOTE_ACCESS);
+	io_interface::ptr io = create_io(factory, thread::get_curr_thread());
+	for (int i = 0; i < NUM_PAGES; i++) {
+		for (size_t j = 0; j < PAGE_SIZE / sizeof(long); j++)
+			buf[j] = i * PAGE_SIZE + j * sizeof(long);
+		// The remote I/O only supports asynchronous requests.
+		data_loc_t loc(io->get_file_id(), i * PAGE_SIZE);
+		io_request req((char *) buf, loc, PAGE_SIZE, WRITE);
+		io->access(&req, 1);
+		io->wait4complete(1);
+	}
+	io->cleanup();
+	io = NULL;
+
+	factory = create_io_factory(file_name, GLOBAL_CACHE_ACCESS);
+	io = create_io(factory, thread::get_curr_thread());
+	for (int i = 0; i < NUM_PAGES; i++) {
+		io->access((char *) buf, i * PAGE_SIZE, PAGE_SIZE, READ);
+		for (size_t j = 0; j < PAGE_SIZE / sizeof(long); j++)
+			assert(buf[j] == (long) (i * PAGE_SIZE + j * sizeof(long)));
+	}
+	io->cleanup();
+	global_cached_io *gio = (global_cached_io *) io.get();
+	printf("%ld pages are read ahead, %ld are used\n",
+			gio->get_num_prefetched_pages(), gio->get_num_useful_prefetches());
+	assert(gio->get_num_prefetched_pages() > NUM_PAGES / 2);
+	assert(gio->get_num_useful_prefetches() > NUM_PAGES / 2);
+	io = NULL;
+	factory = NULL;
+	free(buf);
+
+	file.delete_file();
+	destroy_io_system();
+	printf("the file is read correctly with readahead\n");
+}
+
+int main(int argc, char *argv[])
+{
+	test_window();
+	if (argc >= 2)
+		test_read(argv[1]);
+}
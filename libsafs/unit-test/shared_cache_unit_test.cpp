@@ -0,0 +1,234 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include <boost/format.hpp>
+
+#include "io_interface.h"
+#include "safs_file.h"
+#include "shared_cache.h"
+
+using namespace safs;
+
+const int NUM_PAGES = 1024;
+
+static std::string get_shm_name()
+{
+	return (boost::format("safs_shared_cache_test-%1%") % getpid()).str();
+}
+
+static void fill_page(long *page, off_t off)
+{
+	for (size_t j = 0; j < PAGE_SIZE / sizeof(long); j++)
+		page[j] = off + j * sizeof(long);
+}
+
+static void check_page(long *page, off_t off)
+{
+	for (size_t j = 0; j < PAGE_SIZE / sizeof(long); j++)
+		assert(page[j] == (long) (off + j * sizeof(long)));
+}
+
+static bool shm_exists(const std::string &name)
+{
+	int fd = shm_open(("/" + name).c_str(), O_RDONLY, 0);
+	if (fd < 0)
+		return false;
+	close(fd);
+	return true;
+}
+
+/*
+ * The pages are shared by the file names, even if the file ids are
+ * different in the processes.
+ */
+void test_share()
+{
+	std::string name = get_shm_name();
+	shared_page_cache::ptr cache1 = shared_page_cache::create(name,
+			1024 * 1024);
+	shared_page_cache::ptr cache2 = shared_page_cache::create(name, 0);
+	assert(cache1 && cache2);
+	assert(cache1->get_num_procs() == 2);
+	cache1->add_file(1, "graph");
+	cache2->add_file(5, "graph");
+
+	long *page = (long *) valloc(PAGE_SIZE);
+	for (int i = 0; i < NUM_PAGES; i++) {
+		fill_page(page, i * PAGE_SIZE);
+		page_id_t pg_id(1, i * PAGE_SIZE);
+		assert(cache1->add(pg_id, (char *) page, cache1->get_version(pg_id)));
+	}
+	// The pages of an unknown file aren't shared.
+	assert(!cache1->add(page_id_t(2, 0), (char *) page, 0));
+	// The cache has 256 pages.
+	assert(cache2->get_num_pages() == 256);
+	int num_hits = 0;
+	for (int i = 0; i < NUM_PAGES; i++) {
+		if (cache2->fetch(page_id_t(5, i * PAGE_SIZE), (char *) page)) {
+			check_page(page, i * PAGE_SIZE);
+			num_hits++;
+		}
+	}
+	assert(num_hits == 256);
+	for (int i = 0; i < NUM_PAGES; i++)
+		cache1->invalidate(page_id_t(1, i * PAGE_SIZE));
+	assert(cache2->get_num_pages() == 0);
+	free(page);
+
+	cache1.reset();
+	assert(shm_exists(name));
+	cache2.reset();
+	// The last process removes the shared memory.
+	assert(!shm_exists(name));
+	printf("the pages are shared correctly\n");
+}
+
+/*
+ * A page added by another process can be read.
+ */
+void test_processes()
+{
+	std::string name = get_shm_name();
+	shared_page_cache::ptr cache = shared_page_cache::create(name,
+			1024 * 1024);
+	cache->add_file(1, "graph");
+	pid_t pid = fork();
+	if (pid == 0) {
+		shared_page_cache::ptr child = shared_page_cache::create(name, 0);
+		assert(child->get_num_procs() == 2);
+		child->add_file(3, "graph");
+		long *page = (long *) valloc(PAGE_SIZE);
+		fill_page(page, PAGE_SIZE * 10);
+		page_id_t pg_id(3, PAGE_SIZE * 10);
+		child->add(pg_id, (char *) page, child->get_version(pg_id));
+		// The child exits without detaching from the shared cache.
+		_exit(0);
+	}
+	int status;
+	waitpid(pid, &status, 0);
+	assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+	long *page = (long *) valloc(PAGE_SIZE);
+	assert(cache->fetch(page_id_t(1, PAGE_SIZE * 10), (char *) page));
+	check_page(page, PAGE_SIZE * 10);
+	free(page);
+	cache.reset();
+	// The exited child doesn't keep the shared memory.
+	assert(!shm_exists(name));
+	printf("the pages are shared by processes correctly\n");
+}
+
+/*
+ * A page read before another process writes it can't be added after
+ * the writer invalidates it.
+ */
+void test_stale_add()
+{
+	std::string name = get_shm_name();
+	shared_page_cache::ptr reader = shared_page_cache::create(name,
+			1024 * 1024);
+	shared_page_cache::ptr writer = shared_page_cache::create(name, 0);
+	reader->add_file(1, "graph");
+	writer->add_file(2, "graph");
+
+	long *page = (long *) valloc(PAGE_SIZE);
+	fill_page(page, 0);
+	page_id_t pg_id(1, 0);
+	// The reader gets the version before it reads the page from the disks.
+	uint32_t version = reader->get_version(pg_id);
+	// The page isn't in the shared cache, but the writer still has to
+	// invalidate it.
+	writer->invalidate(page_id_t(2, 0));
+	assert(!reader->add(pg_id, (char *) page, version));
+	assert(!writer->fetch(page_id_t(2, 0), (char *) page));
+	// The page read after the write can be added.
+	assert(reader->add(pg_id, (char *) page, reader->get_version(pg_id)));
+	assert(writer->fetch(page_id_t(2, 0), (char *) page));
+	check_page(page, 0);
+	free(page);
+	printf("the stale pages aren't added\n");
+}
+
+config_map::ptr get_configs(const std::string &root_conf)
+{
+	std::string opts[] = {
+		std::string("root_conf=") + root_conf,
+		"cache_size=16M",
+		"shared_cache_size=16M",
+		std::string("shared_cache_name=") + get_shm_name(),
+	};
+	const char *opt_strs[4];
+	for (int i = 0; i < 4; i++)
+		opt_strs[i] = opts[i].c_str();
+	config_map::ptr configs = config_map::create();
+	configs->add_options(opt_strs, 4);
+	return configs;
+}
+
+/*
+ * The pages read through the page cache are in the shared cache.
+ */
+void test_read(const std::string &root_conf)
+{
+	std::string file_name = "test-shared-cache";
+	init_io_system(get_configs(root_conf));
+	safs_file file(get_sys_RAID_conf(), file_name);
+	assert(file.create_file(NUM_PAGES * PAGE_SIZE));
+
+	long *buf = (long *) valloc(PAGE_SIZE);
+	file_io_factory::shared_ptr factory = create_io_factory(file_name,
+			REMOTE_ACCESS);
+	io_interface::ptr io = create_io(factory, thread::get_curr_thread());
+	for (int i = 0; i < NUM_PAGES; i++) {
+		fill_page(buf, i * PAGE_SIZE);
+		// The remote I/O only supports asynchronous requests.
+		data_loc_t loc(io->get_file_id(), i * PAGE_SIZE);
+		io_request req((char *) buf, loc, PAGE_SIZE, WRITE);
+		io->access(&req, 1);
+		io->wait4complete(1);
+	}
+	io->cleanup();
+	io = NULL;
+
+	factory = create_io_factory(file_name, GLOBAL_CACHE_ACCESS);
+	io = create_io(factory, thread::get_curr_thread());
+	for (int i = 0; i < NUM_PAGES; i++) {
+		io->access((char *) buf, i * PAGE_SIZE, PAGE_SIZE, READ);
+		check_page(buf, i * PAGE_SIZE);
+	}
+	io->cleanup();
+	io = NULL;
+
+	// Another process attaches to the shared cache and reads the pages.
+	shared_page_cache::ptr other = shared_page_cache::create(get_shm_name(), 0);
+	other->add_file(100, get_sys_RAID_conf(), file_name);
+	int num_hits = 0;
+	for (int i = 0; i < NUM_PAGES; i++) {
+		if (other->fetch(page_id_t(100, i * PAGE_SIZE), (char *) buf)) {
+			check_page(buf, i * PAGE_SIZE);
+			num_hits++;
+		}
+	}
+	printf("%d pages are in the shared cache\n", num_hits);
+	assert(num_hits > NUM_PAGES / 2);
+	other.reset();
+	factory = NULL;
+	free(buf);
+
+	file.delete_file();
+	destroy_io_system();
+	assert(!shm_exists(get_shm_name()));
+	printf("the pages read from the disks are shared correctly\n");
+}
+
+int main(int argc, char *argv[])
+{
+	test_share();
+	test_processes();
+	test_stale_add();
+	if (argc >= 2)
+		test_read(argv[1]);
+}
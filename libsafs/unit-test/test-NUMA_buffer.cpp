@@ -120,8 +120,83 @@ void test_load_save()
 		test_load_save(i * range_size + range_size / 2);
 }
 
+/*
+ * The data mapped from a file is the same as the data loaded from it,
+ * and it's stored contiguously.
+ */
+void test_map(size_t length, size_t num_nodes)
+{
+	printf("test mapping %ld bytes on %ld nodes\n", length, num_nodes);
+	NUMA_mapper mapper(num_nodes, range_size_log);
+	NUMA_buffer::ptr buf = create_buf(length, mapper);
+	char *tmp_file = tempnam("/tmp/", "test");
+	buf->dump(tmp_file);
+
+	NUMA_buffer::ptr buf1 = NUMA_buffer::map(tmp_file, mapper);
+	assert(buf1->get_length() == buf->get_length());
+	for (size_t i = 0; i < num_nodes; i++)
+		assert(buf1->get_buf(i));
+	NUMA_buffer::cdata_info data = ((const NUMA_buffer &) *buf1).get_data(0,
+			buf1->get_length());
+	assert(data.second == buf1->get_length());
+	std::unique_ptr<char[]> raw_buf(new char[length]);
+	buf->copy_to(raw_buf.get(), length, 0);
+	assert(memcmp(raw_buf.get(), data.first, length) == 0);
+
+	// The data written to the buffer isn't written back to the file.
+	long val = -1;
+	buf1->copy_from((char *) &val, sizeof(val), 0);
+	NUMA_buffer::ptr buf2 = NUMA_buffer::map(tmp_file, mapper);
+	long *lptr = (long *) buf2->get_data(0, sizeof(long)).first;
+	assert(*lptr == 0);
+	assert(*(long *) buf1->get_data(0, sizeof(long)).first == -1);
+
+	int ret = unlink(tmp_file);
+	assert(ret == 0);
+}
+
+/*
+ * A file whose size isn't a multiple of pages has the same length
+ * whether it's loaded or mapped.
+ */
+void test_map_unaligned(size_t num_nodes)
+{
+	size_t length = range_size + 100;
+	printf("test mapping a file of %ld bytes on %ld nodes\n", length,
+			num_nodes);
+	NUMA_mapper mapper(num_nodes, range_size_log);
+	char *tmp_file = tempnam("/tmp/", "test");
+	std::unique_ptr<char[]> raw_buf(new char[length]);
+	for (size_t i = 0; i < length; i++)
+		raw_buf[i] = random();
+	FILE *f = fopen(tmp_file, "w");
+	assert(f);
+	assert(fwrite(raw_buf.get(), length, 1, f) == 1);
+	fclose(f);
+
+	NUMA_buffer::ptr loaded = NUMA_buffer::load(tmp_file, mapper);
+	NUMA_buffer::ptr mapped = NUMA_buffer::map(tmp_file, mapper);
+	assert(loaded->get_length() == mapped->get_length());
+	std::unique_ptr<char[]> raw_buf1(new char[length]);
+	mapped->copy_to(raw_buf1.get(), length, 0);
+	assert(memcmp(raw_buf.get(), raw_buf1.get(), length) == 0);
+
+	int ret = unlink(tmp_file);
+	assert(ret == 0);
+}
+
+void test_map()
+{
+	for (size_t num_nodes = 1; num_nodes <= 2; num_nodes *= 2) {
+		for (size_t i = 0; i < 4; i++)
+			test_map(i * range_size + range_size / 2, num_nodes);
+		test_map_unaligned(num_nodes);
+	}
+}
+
 int main()
 {
 	test_in_mem();
 	test_load_save();
+	test_map();
 }
@@ -0,0 +1,187 @@
+#include <stdio.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "io_interface.h"
+#include "safs_file.h"
+#include "native_file.h"
+#include "RAID_config.h"
+#include "tiering.h"
+
+using namespace safs;
+
+const int NUM_PAGES = 1024;
+// The RAID block has 4 pages.
+const int BLOCK_PAGES = 4;
+const int NUM_HOT_BLOCKS = 4;
+// The number of blocks that the fast tier can keep.
+const int NUM_FAST_BLOCKS = 8;
+const std::string ROOT_DIR = "/tmp/safs_tier";
+
+config_map::ptr get_configs(const std::string &root_conf)
+{
+	// The blocks are only moved when SAFS isn't writable.
+	std::string opts[] = {
+		std::string("root_conf=") + root_conf,
+		"RAID_mapping=TIERED",
+		"RAID_block_size=16K",
+		// The fast tier can keep 8 blocks.
+		"fast_tier_size=128K",
+		"tier_migrate_interval=50",
+		"writable=0",
+	};
+	const char *opt_strs[6];
+	for (int i = 0; i < 6; i++)
+		opt_strs[i] = opts[i].c_str();
+	config_map::ptr configs = config_map::create();
+	configs->add_options(opt_strs, 6);
+	return configs;
+}
+
+/*
+ * Two disks are in the capacity tier and one disk is in the fast tier.
+ */
+std::string create_conf()
+{
+	native_dir root(ROOT_DIR);
+	if (root.exist())
+		root.delete_dir(true);
+	assert(root.create_dir(true));
+	std::string conf_file = ROOT_DIR + "/conf";
+	FILE *f = fopen(conf_file.c_str(), "w");
+	assert(f);
+	for (int i = 0; i < 3; i++) {
+		std::string dir_name = ROOT_DIR + "/disk" + itoa(i);
+		assert(native_dir(dir_name).create_dir(false));
+		fprintf(f, "0:%s%s\n", dir_name.c_str(), i == 2 ? "::fast" : "");
+	}
+	fclose(f);
+	return conf_file;
+}
+
+static void read_check(io_interface &io, char *buf, off_t off, size_t size)
+{
+	data_loc_t loc(io.get_file_id(), off);
+	io_request req(buf, loc, size, READ);
+	io.access(&req, 1);
+	io.wait4complete(1);
+	long *lbuf = (long *) buf;
+	for (size_t j = 0; j < size / sizeof(long); j++)
+		assert(lbuf[j] == (long) (off + j * sizeof(long)));
+}
+
+/*
+ * The blocks read frequently are copied to the fast tier, and they are
+ * still read correctly from there.
+ */
+void test_migrate(const std::string &root_conf)
+{
+	std::string file_name = "test-tier";
+	init_io_system(get_configs(root_conf));
+	safs_file file(get_sys_RAID_conf(), file_name);
+	assert(file.create_file(NUM_PAGES * PAGE_SIZE));
+
+	// SAFS isn't writable, so we write data to the files on the disks
+	// directly. All blocks are in the capacity tier now.
+	file_mapper::ptr mapper = get_sys_RAID_conf().create_file_mapper(
+			file_name);
+	std::vector<int> fds(mapper->get_num_files());
+	for (size_t i = 0; i < fds.size(); i++) {
+		fds[i] = open(mapper->get_file_name(i).c_str(), O_WRONLY);
+		assert(fds[i] >= 0);
+	}
+	size_t block_size = BLOCK_PAGES * PAGE_SIZE;
+	char *buf = (char *) valloc(block_size);
+	for (int i = 0; i < NUM_PAGES; i++) {
+		long *lbuf = (long *) buf;
+		for (size_t j = 0; j < PAGE_SIZE / sizeof(long); j++)
+			lbuf[j] = i * PAGE_SIZE + j * sizeof(long);
+		block_identifier bid;
+		mapper->map(i, bid);
+		assert(mapper->get_file_name(bid.idx).find(ROOT_DIR + "/disk2/")
+				== std::string::npos);
+		assert(pwrite(fds[bid.idx], buf, PAGE_SIZE, bid.off * PAGE_SIZE)
+				== PAGE_SIZE);
+	}
+	for (size_t i = 0; i < fds.size(); i++)
+		close(fds[i]);
+
+	file_io_factory::shared_ptr factory = create_io_factory(file_name,
+			REMOTE_ACCESS);
+	io_interface::ptr io = create_io(factory, thread::get_curr_thread());
+	block_tier_table::ptr table = block_tier_table::find(file_name);
+	assert(table);
+	assert(table->get_num_fast_blocks() == 0);
+	// The hot blocks are in the middle of the file.
+	off_t hot_start = 64 * block_size;
+	for (int k = 0; k < 200
+			&& table->get_num_fast_blocks() < NUM_HOT_BLOCKS; k++) {
+		for (int i = 0; i < NUM_HOT_BLOCKS; i++)
+			read_check(*io, buf, hot_start + i * block_size, block_size);
+		usleep(5000);
+	}
+	assert(table->get_num_fast_blocks() == NUM_HOT_BLOCKS);
+	for (int i = 0; i < NUM_HOT_BLOCKS; i++)
+		assert(table->is_fast((hot_start + i * block_size) / PAGE_SIZE));
+	assert(!table->is_fast(0));
+
+	// Read the hot blocks from the fast tier.
+	for (int i = 0; i < NUM_HOT_BLOCKS; i++) {
+		off_t off = hot_start + i * block_size;
+		block_identifier bid;
+		mapper->map(off / PAGE_SIZE, bid);
+		assert(mapper->get_file_name(bid.idx).find(ROOT_DIR + "/disk2/")
+				== 0);
+		read_check(*io, buf, off, block_size);
+	}
+	// The other blocks are still read from the capacity tier.
+	for (int i = 0; i < NUM_PAGES / BLOCK_PAGES; i++)
+		read_check(*io, buf, i * block_size, block_size);
+	printf("%ld blocks are moved to the fast tier\n",
+			table->get_num_promotions());
+
+	// The slots of the blocks removed from the fast tier aren't reused
+	// while a read that may have mapped the blocks before is in progress.
+	int epoch = table->begin_read();
+	size_t num_demotions = table->get_num_demotions();
+	off_t new_hot_start = 128 * block_size;
+	for (int k = 0; k < 200
+			&& table->get_num_demotions() == num_demotions; k++) {
+		for (int i = 0; i < NUM_FAST_BLOCKS; i++)
+			read_check(*io, buf, new_hot_start + i * block_size, block_size);
+		usleep(5000);
+	}
+	assert(table->get_num_demotions() > num_demotions);
+	// Wait for a few rounds of migration.
+	for (int k = 0; k < 40; k++) {
+		for (int i = 0; i < NUM_FAST_BLOCKS; i++)
+			read_check(*io, buf, new_hot_start + i * block_size, block_size);
+		usleep(5000);
+	}
+	assert(table->get_num_fast_blocks() < NUM_FAST_BLOCKS);
+	table->end_read(epoch);
+	for (int k = 0; k < 200
+			&& table->get_num_fast_blocks() < NUM_FAST_BLOCKS; k++) {
+		for (int i = 0; i < NUM_FAST_BLOCKS; i++)
+			read_check(*io, buf, new_hot_start + i * block_size, block_size);
+		usleep(5000);
+	}
+	assert(table->get_num_fast_blocks() == NUM_FAST_BLOCKS);
+	printf("the retired slots are reused after the reads complete\n");
+	table = NULL;
+	mapper = NULL;
+
+	io->cleanup();
+	io = NULL;
+	factory = NULL;
+	free(buf);
+	file.delete_file();
+	destroy_io_system();
+	printf("hot blocks are moved to the fast tier correctly\n");
+}
+
+int main()
+{
+	test_migrate(create_conf());
+	native_dir(ROOT_DIR).delete_dir(true);
+}
@@ -0,0 +1,95 @@
+#include <stdio.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include <vector>
+
+#include "container.h"
+
+const int NUM_THIEVES = 4;
+const int NUM_ENTRIES = 100000;
+const int DEQUE_SIZE = 64;
+
+struct thief_arg
+{
+	work_stealing_deque<int> *q;
+	std::vector<atomic_integer> *taken;
+	volatile bool *done;
+	long num_stolen;
+	pthread_t tid;
+};
+
+void *steal(void *arg)
+{
+	thief_arg *targ = (thief_arg *) arg;
+	targ->num_stolen = 0;
+	int entry;
+	while (!*targ->done || !targ->q->is_empty()) {
+		if (targ->q->steal(entry)) {
+			(*targ->taken)[entry].inc(1);
+			targ->num_stolen++;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * The owner pushes and pops entries while the thieves steal them.
+ * Every entry is taken exactly once, either by the owner or by a thief.
+ */
+void test_steal()
+{
+	work_stealing_deque<int> q(DEQUE_SIZE);
+	std::vector<atomic_integer> taken(NUM_ENTRIES);
+	volatile bool done = false;
+	thief_arg args[NUM_THIEVES];
+	for (int i = 0; i < NUM_THIEVES; i++) {
+		args[i].q = &q;
+		args[i].taken = &taken;
+		args[i].done = &done;
+		pthread_create(&args[i].tid, NULL, steal, &args[i]);
+	}
+
+	long num_popped = 0;
+	int entry;
+	for (int next = 0; next < NUM_ENTRIES; ) {
+		// Push a few entries and pop some of them, so the owner often
+		// competes with the thieves for the last entry.
+		int num_pushes = random() % 8 + 1;
+		for (int i = 0; i < num_pushes && next < NUM_ENTRIES; i++) {
+			if (!q.push(next))
+				break;
+			next++;
+		}
+		int num_pops = random() % 8;
+		for (int i = 0; i < num_pops && q.pop(entry); i++) {
+			taken[entry].inc(1);
+			num_popped++;
+		}
+		// Give the thieves a chance to run if they share the CPU.
+		if (random() % 64 == 0)
+			sched_yield();
+	}
+	while (q.pop(entry)) {
+		taken[entry].inc(1);
+		num_popped++;
+	}
+	done = true;
+
+	long num_stolen = 0;
+	for (int i = 0; i < NUM_THIEVES; i++) {
+		pthread_join(args[i].tid, NULL);
+		num_stolen += args[i].num_stolen;
+	}
+	assert(q.is_empty());
+	for (int i = 0; i < NUM_ENTRIES; i++)
+		assert(taken[i].get() == 1);
+	assert(num_popped + num_stolen == NUM_ENTRIES);
+	printf("the owner pops %ld entries and the thieves steal %ld entries\n",
+			num_popped, num_stolen);
+}
+
+int main()
+{
+	test_steal();
+}
@@ -27,9 +27,17 @@
 #include <stdlib.h>
 #include <assert.h>
 #include <sys/select.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <signal.h>
+#include <string.h>
+
+#include <boost/format.hpp>
 
 #include "wpaio.h"
 #include "parameters.h"
+#include "concurrency.h"
+#include "log.h"
 
 #define INIT_CAPACITY 8
 
@@ -40,6 +48,64 @@
 namespace safs
 {
 
+/*
+ * A memory region registered as long-lived I/O buffers.
+ */
+struct io_buf_region
+{
+	char *buf;
+	size_t size;
+	int node_id;
+};
+
+/*
+ * The memory regions registered as long-lived I/O buffers.
+ * Regions are only added, so the number of regions works as a version
+ * number of the registry.
+ */
+static struct io_buf_registry
+{
+	spin_lock lock;
+	std::vector<io_buf_region> bufs;
+	atomic_number<size_t> num_bufs;
+} io_bufs;
+
+void register_io_buf(char *buf, size_t size, int node_id)
+{
+	io_buf_region region;
+	region.buf = buf;
+	region.size = size;
+	region.node_id = node_id;
+	io_bufs.lock.lock();
+	io_bufs.bufs.push_back(region);
+	io_bufs.num_bufs.inc(1);
+	io_bufs.lock.unlock();
+}
+
+static std::vector<io_buf_region> get_io_bufs()
+{
+	io_bufs.lock.lock();
+	std::vector<io_buf_region> ret = io_bufs.bufs;
+	io_bufs.lock.unlock();
+	return ret;
+}
+
+aio_ctx *create_aio_ctx(int node_id, int max_aio)
+{
+#ifdef USE_IO_URING
+	if (params.get_aio_type() == IO_URING_CTX) {
+		try {
+			return new aio_ctx_uring(node_id, max_aio,
+					params.is_io_uring_sqpoll());
+		} catch (std::system_error &e) {
+			BOOST_LOG_TRIVIAL(warning) << boost::format(
+					"can't use io_uring (%1%), fall back to libaio") % e.what();
+		}
+	}
+#endif
+	return new aio_ctx_impl(node_id, max_aio);
+}
+
 aio_ctx::aio_ctx(int node_id, int max_aio): iocb_allocator(std::string(
 			"iocb_allocator-") + itoa(node_id), node_id, true,
 		sizeof(struct iocb) * max_aio, params.get_max_obj_alloc_size())
@@ -107,6 +173,8 @@ int aio_ctx_impl::io_wait(struct timespec* to, int num)
   } while (ret == -EINTR);
   if (ret < 0)
 	  throw std::system_error(std::make_error_code((std::errc) ret), "io_wait");
+  if (n == 0)
+	  return 0;
 
   struct iocb *iocbs[n];
   long res[n];
@@ -154,4 +222,452 @@ int aio_ctx_impl::max_io_slot()
 #endif
 }
 
+#ifdef USE_IO_URING
+
+/*
+ * The number of slots in the fixed file table of an io_uring instance.
+ */
+const int NUM_FIXED_FILES = 1024;
+/*
+ * The max number of buffers that can be registered to io_uring in old kernels.
+ */
+const size_t MAX_FIXED_BUFS = 1024;
+/*
+ * The max size of a registered buffer.
+ */
+const size_t MAX_FIXED_BUF_SIZE = 1024 * 1024 * 1024;
+/*
+ * How long the SQ polling kernel thread spins before it goes to sleep (in ms).
+ */
+const unsigned SQ_THREAD_IDLE = 1000;
+
+static inline int sys_io_uring_setup(unsigned entries,
+		struct io_uring_params *p)
+{
+	return syscall(__NR_io_uring_setup, entries, p);
+}
+
+static inline int sys_io_uring_enter(int fd, unsigned to_submit,
+		unsigned min_complete, unsigned flags, void *arg, size_t argsz)
+{
+	return syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags,
+			arg, argsz);
+}
+
+static inline int sys_io_uring_register(int fd, unsigned opcode, void *arg,
+		unsigned nr_args)
+{
+	return syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+aio_ctx_uring::aio_ctx_uring(int node_id, int max_aio,
+		bool sq_poll): aio_ctx(node_id, max_aio), req_allocator(std::string(
+			"uring_req_allocator-") + itoa(node_id), node_id, true,
+		sizeof(uring_iocb) * max_aio, params.get_max_obj_alloc_size())
+{
+	this->node_id = node_id;
+	this->max_aio = max_aio;
+	this->busy_aio = 0;
+	this->sq_poll = sq_poll;
+	sq_ptr = MAP_FAILED;
+	cq_ptr = MAP_FAILED;
+	sqes_ptr = MAP_FAILED;
+	fixed_files = false;
+	fixed_bufs = true;
+	buf_gen = 0;
+	num_submit_calls = 0;
+	num_wait_calls = 0;
+	num_reqs = 0;
+	num_fixed_buf_reqs = 0;
+
+	struct io_uring_params p;
+	memset(&p, 0, sizeof(p));
+	if (sq_poll) {
+		p.flags |= IORING_SETUP_SQPOLL;
+		p.sq_thread_idle = SQ_THREAD_IDLE;
+	}
+	ring_fd = sys_io_uring_setup(max_aio, &p);
+	// SQ polling requires privileges in old kernels.
+	if (ring_fd < 0 && sq_poll && errno == EPERM) {
+		BOOST_LOG_TRIVIAL(warning)
+			<< "no permission to use SQ polling in io_uring";
+		this->sq_poll = false;
+		memset(&p, 0, sizeof(p));
+		ring_fd = sys_io_uring_setup(max_aio, &p);
+	}
+	if (ring_fd < 0)
+		throw std::system_error(errno, std::system_category(),
+				"io_uring_setup");
+	features = p.features;
+
+	sq_map_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	cq_map_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	// The SQ and CQ rings can be mapped with a single mmap.
+	if (features & IORING_FEAT_SINGLE_MMAP) {
+		sq_map_size = std::max(sq_map_size, cq_map_size);
+		cq_map_size = sq_map_size;
+	}
+	sq_ptr = mmap(0, sq_map_size, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+	if (sq_ptr != MAP_FAILED && features & IORING_FEAT_SINGLE_MMAP)
+		cq_ptr = sq_ptr;
+	else if (sq_ptr != MAP_FAILED)
+		cq_ptr = mmap(0, cq_map_size, PROT_READ | PROT_WRITE,
+				MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+	sqes_map_size = p.sq_entries * sizeof(struct io_uring_sqe);
+	if (cq_ptr != MAP_FAILED)
+		sqes_ptr = mmap(0, sqes_map_size, PROT_READ | PROT_WRITE,
+				MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+	if (sqes_ptr == MAP_FAILED) {
+		int err = errno;
+		if (cq_ptr != MAP_FAILED && cq_ptr != sq_ptr)
+			munmap(cq_ptr, cq_map_size);
+		if (sq_ptr != MAP_FAILED)
+			munmap(sq_ptr, sq_map_size);
+		close(ring_fd);
+		throw std::system_error(err, std::system_category(), "mmap io_uring");
+	}
+
+	sq.head = (unsigned *) ((char *) sq_ptr + p.sq_off.head);
+	sq.tail = (unsigned *) ((char *) sq_ptr + p.sq_off.tail);
+	sq.ring_mask = (unsigned *) ((char *) sq_ptr + p.sq_off.ring_mask);
+	sq.flags = (unsigned *) ((char *) sq_ptr + p.sq_off.flags);
+	sq.array = (unsigned *) ((char *) sq_ptr + p.sq_off.array);
+	sq.sqes = (struct io_uring_sqe *) sqes_ptr;
+	cq.head = (unsigned *) ((char *) cq_ptr + p.cq_off.head);
+	cq.tail = (unsigned *) ((char *) cq_ptr + p.cq_off.tail);
+	cq.ring_mask = (unsigned *) ((char *) cq_ptr + p.cq_off.ring_mask);
+	cq.cqes = (struct io_uring_cqe *) ((char *) cq_ptr + p.cq_off.cqes);
+
+	// We register an empty file table in advance, so we can add files
+	// to the table when they are opened.
+	std::vector<int> fds(NUM_FIXED_FILES, -1);
+	if (sys_io_uring_register(ring_fd, IORING_REGISTER_FILES, fds.data(),
+				fds.size()) == 0) {
+		fixed_files = true;
+		for (int i = NUM_FIXED_FILES - 1; i >= 0; i--)
+			free_file_slots.push_back(i);
+	}
+	else
+		BOOST_LOG_TRIVIAL(warning) << boost::format(
+				"can't register files to io_uring: %1%") % strerror(errno);
+}
+
+aio_ctx_uring::~aio_ctx_uring()
+{
+	munmap(sqes_ptr, sqes_map_size);
+	if (cq_ptr != sq_ptr)
+		munmap(cq_ptr, cq_map_size);
+	munmap(sq_ptr, sq_map_size);
+	// Closing the ring also releases the registered files and buffers.
+	close(ring_fd);
+}
+
+struct iocb* aio_ctx_uring::make_io_request(int fd, size_t iosize,
+		long long offset, void* buffer, int io_type, io_callback_s *cb)
+{
+	if (io_type != A_READ && io_type != A_WRITE) {
+		fprintf(stderr, "unknown operation");
+		return NULL;
+	}
+
+	uring_iocb *req = req_allocator.alloc_obj();
+	req->cb = cb;
+	req->fd = fd;
+	req->io_type = io_type;
+	req->num_bufs = 0;
+	req->buf = buffer;
+	req->size = iosize;
+	req->offset = offset;
+	return (struct iocb *) req;
+}
+
+struct iocb *aio_ctx_uring::make_iovec_request(int fd, const struct iovec iov[],
+		int count, long long offset, int io_type, io_callback_s *cb)
+{
+	if (io_type != A_READ && io_type != A_WRITE) {
+		fprintf(stderr, "unknown operation");
+		return NULL;
+	}
+
+	uring_iocb *req = req_allocator.alloc_obj();
+	req->cb = cb;
+	req->fd = fd;
+	req->io_type = io_type;
+	req->num_bufs = count;
+	req->iov = iov;
+	req->size = 0;
+	req->offset = offset;
+	return (struct iocb *) req;
+}
+
+void aio_ctx_uring::register_files(const std::vector<int> &fds)
+{
+	if (!fixed_files)
+		return;
+
+	for (size_t i = 0; i < fds.size(); i++) {
+		if (file_slots.find(fds[i]) != file_slots.end()
+				|| free_file_slots.empty())
+			continue;
+
+		int fd = fds[i];
+		struct io_uring_files_update up;
+		memset(&up, 0, sizeof(up));
+		up.offset = free_file_slots.back();
+		up.fds = (__u64) &fd;
+		if (sys_io_uring_register(ring_fd, IORING_REGISTER_FILES_UPDATE,
+					&up, 1) == 1) {
+			file_slots.insert(std::pair<int, int>(fd, up.offset));
+			free_file_slots.pop_back();
+		}
+	}
+}
+
+void aio_ctx_uring::unregister_files(const std::vector<int> &fds)
+{
+	for (size_t i = 0; i < fds.size(); i++) {
+		auto it = file_slots.find(fds[i]);
+		if (it == file_slots.end())
+			continue;
+
+		// The kernel keeps a reference to the file for the pending requests,
+		// so it's safe to remove it from the table now.
+		int fd = -1;
+		struct io_uring_files_update up;
+		memset(&up, 0, sizeof(up));
+		up.offset = it->second;
+		up.fds = (__u64) &fd;
+		sys_io_uring_register(ring_fd, IORING_REGISTER_FILES_UPDATE, &up, 1);
+		free_file_slots.push_back(it->second);
+		file_slots.erase(it);
+	}
+}
+
+/*
+ * Register the I/O buffers in the registry to the kernel. An I/O thread
+ * mostly accesses the pages on its own node, and pinning the whole page
+ * cache in every ring is likely to exceed the limit of locked memory,
+ * so we only register the buffers on the node of the aio context.
+ * It should only be invoked when there aren't pending requests.
+ */
+void aio_ctx_uring::update_bufs()
+{
+	std::vector<io_buf_region> regions = get_io_bufs();
+	buf_gen = regions.size();
+
+	std::vector<struct iovec> iovs;
+	size_t num_skipped = 0;
+	for (size_t i = 0; i < regions.size(); i++) {
+		if (regions[i].node_id != node_id)
+			continue;
+		for (size_t off = 0; off < regions[i].size;
+				off += MAX_FIXED_BUF_SIZE) {
+			if (iovs.size() >= MAX_FIXED_BUFS) {
+				num_skipped++;
+				continue;
+			}
+			struct iovec iov;
+			iov.iov_base = regions[i].buf + off;
+			iov.iov_len = std::min(regions[i].size - off, MAX_FIXED_BUF_SIZE);
+			iovs.push_back(iov);
+		}
+	}
+	if (num_skipped > 0)
+		BOOST_LOG_TRIVIAL(warning) << boost::format(
+				"only %1% I/O buffers on node %2% are registered to io_uring, %3% aren't")
+			% iovs.size() % node_id % num_skipped;
+	if (iovs.empty())
+		return;
+
+	if (!bufs.empty())
+		sys_io_uring_register(ring_fd, IORING_UNREGISTER_BUFFERS, NULL, 0);
+	bufs.clear();
+	if (sys_io_uring_register(ring_fd, IORING_REGISTER_BUFFERS, iovs.data(),
+				iovs.size()) < 0) {
+		// It usually fails because of the limit of locked memory.
+		// We can still access the buffers without registering them.
+		BOOST_LOG_TRIVIAL(warning) << boost::format(
+				"can't register %1% I/O buffers on node %2% to io_uring: %3%")
+			% iovs.size() % node_id % strerror(errno);
+		fixed_bufs = false;
+		return;
+	}
+	for (size_t i = 0; i < iovs.size(); i++) {
+		char *start = (char *) iovs[i].iov_base;
+		bufs.insert(std::pair<char *, std::pair<char *, int> >(
+					start + iovs[i].iov_len,
+					std::pair<char *, int>(start, i)));
+	}
+}
+
+int aio_ctx_uring::get_buf_idx(const void *buf, size_t size) const
+{
+	const char *start = (const char *) buf;
+	auto it = bufs.upper_bound((char *) start);
+	if (it == bufs.end() || it->second.first > start
+			|| start + size > it->first)
+		return -1;
+	return it->second.second;
+}
+
+int aio_ctx_uring::enter(unsigned to_submit, unsigned min_complete,
+		unsigned flags, struct timespec *to)
+{
+	void *arg = NULL;
+	size_t argsz = 0;
+	struct io_uring_getevents_arg garg;
+	struct __kernel_timespec ts;
+	if (to && features & IORING_FEAT_EXT_ARG) {
+		ts.tv_sec = to->tv_sec;
+		ts.tv_nsec = to->tv_nsec;
+		memset(&garg, 0, sizeof(garg));
+		garg.sigmask_sz = _NSIG / 8;
+		garg.ts = (__u64) &ts;
+		arg = &garg;
+		argsz = sizeof(garg);
+		flags |= IORING_ENTER_EXT_ARG;
+	}
+	int ret;
+	do {
+		ret = sys_io_uring_enter(ring_fd, to_submit, min_complete, flags,
+				arg, argsz);
+	} while (ret < 0 && errno == EINTR);
+	return ret < 0 ? -errno : ret;
+}
+
+void aio_ctx_uring::submit_io_request(struct iocb* ioq[], int num)
+{
+	// The registered buffers can only be changed when they aren't used
+	// by any requests.
+	if (fixed_bufs && busy_aio == 0 && io_bufs.num_bufs.get() > buf_gen)
+		update_bufs();
+
+	unsigned mask = *sq.ring_mask;
+	unsigned tail = *sq.tail;
+	for (int i = 0; i < num; i++) {
+		uring_iocb *req = (uring_iocb *) ioq[i];
+		unsigned idx = tail & mask;
+		struct io_uring_sqe *sqe = &sq.sqes[idx];
+		memset(sqe, 0, sizeof(*sqe));
+		int slot = get_file_slot(req->fd);
+		if (slot >= 0) {
+			sqe->fd = slot;
+			sqe->flags |= IOSQE_FIXED_FILE;
+		}
+		else
+			sqe->fd = req->fd;
+		sqe->off = req->offset;
+		sqe->user_data = (__u64) req;
+		if (req->num_bufs == 0) {
+			int buf_idx = bufs.empty() ? -1 : get_buf_idx(req->buf, req->size);
+			if (buf_idx >= 0) {
+				sqe->opcode = req->io_type == A_READ
+					? IORING_OP_READ_FIXED : IORING_OP_WRITE_FIXED;
+				sqe->buf_index = buf_idx;
+				num_fixed_buf_reqs++;
+			}
+			else
+				sqe->opcode = req->io_type == A_READ
+					? IORING_OP_READ : IORING_OP_WRITE;
+			sqe->addr = (__u64) req->buf;
+			sqe->len = req->size;
+		}
+		else {
+			sqe->opcode = req->io_type == A_READ
+				? IORING_OP_READV : IORING_OP_WRITEV;
+			sqe->addr = (__u64) req->iov;
+			sqe->len = req->num_bufs;
+		}
+		sq.array[idx] = idx;
+		tail++;
+	}
+	// The kernel should see the requests before it sees the new tail.
+	__atomic_store_n(sq.tail, tail, __ATOMIC_RELEASE);
+	busy_aio += num;
+	num_reqs += num;
+
+	if (sq_poll) {
+		// The polling thread may have gone to sleep and we need to wake it up.
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+		if (__atomic_load_n(sq.flags, __ATOMIC_RELAXED) & IORING_SQ_NEED_WAKEUP) {
+			num_submit_calls++;
+			int ret = enter(0, 0, IORING_ENTER_SQ_WAKEUP, NULL);
+			if (ret < 0)
+				throw std::system_error(std::make_error_code((std::errc) -ret),
+						"io_uring_enter");
+		}
+		return;
+	}
+
+	// All requests are submitted with a single system call in most cases.
+	int num_submitted = 0;
+	while (num_submitted < num) {
+		num_submit_calls++;
+		int ret = enter(num - num_submitted, 0, 0, NULL);
+		if (ret < 0)
+			throw std::system_error(std::make_error_code((std::errc) -ret),
+					"io_uring_enter");
+		num_submitted += ret;
+	}
+}
+
+/*
+ * If `to' isn't NULL and the kernel doesn't support timeout in io_uring_enter,
+ * it only returns the requests that have completed.
+ */
+int aio_ctx_uring::io_wait(struct timespec* to, int num)
+{
+	unsigned head = *cq.head;
+	unsigned tail = __atomic_load_n(cq.tail, __ATOMIC_ACQUIRE);
+	if ((int) (tail - head) < num
+			&& (to == NULL || features & IORING_FEAT_EXT_ARG)) {
+		num_wait_calls++;
+		int ret = enter(0, num, IORING_ENTER_GETEVENTS, to);
+		if (ret < 0 && ret != -ETIME)
+			throw std::system_error(std::make_error_code((std::errc) -ret),
+					"io_wait");
+		tail = __atomic_load_n(cq.tail, __ATOMIC_ACQUIRE);
+	}
+
+	int n = tail - head;
+	if (n == 0)
+		return 0;
+
+	unsigned mask = *cq.ring_mask;
+	struct iocb *iocbs[n];
+	long res[n];
+	long res2[n];
+	io_callback_s *cbs[n];
+	callback_t cb_func = NULL;
+	for (int i = 0; i < n; i++, head++) {
+		struct io_uring_cqe *cqe = &cq.cqes[head & mask];
+		uring_iocb *req = (uring_iocb *) cqe->user_data;
+		cbs[i] = req->cb;
+		if (cb_func == NULL)
+			cb_func = cbs[i]->func;
+		assert(cb_func == cbs[i]->func);
+		iocbs[i] = (struct iocb *) req;
+		res[i] = cqe->res;
+		res2[i] = 0;
+	}
+	// The CQ entries can be reused by the kernel now.
+	__atomic_store_n(cq.head, head, __ATOMIC_RELEASE);
+
+	cb_func((io_context_t) 0, iocbs, (void **) cbs, res, res2, n);
+
+	busy_aio -= n;
+	destroy_io_requests(iocbs, n);
+	return n;
+}
+
+void aio_ctx_uring::print_stat()
+{
+	printf("io_uring: %ld reqs (%ld with registered bufs), %ld submit calls, %ld wait calls, %ld registered files\n",
+			num_reqs, num_fixed_buf_reqs, num_submit_calls, num_wait_calls,
+			file_slots.size());
+}
+
+#endif
+
 }
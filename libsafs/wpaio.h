@@ -33,7 +33,13 @@
 #ifdef USE_LIBAIO
 #include <libaio.h>
 #endif
+#ifdef USE_IO_URING
+#include <linux/io_uring.h>
+#endif
 #include <system_error>
+#include <vector>
+#include <map>
+#include <unordered_map>
 
 #include "slab_allocator.h"
 
@@ -49,6 +55,16 @@ struct iocb {
 namespace safs
 {
 
+struct io_callback_s;
+
+/*
+ * The implementations of asynchronous I/O that can be used by async_io.
+ */
+enum {
+	LIBAIO_CTX,
+	IO_URING_CTX,
+};
+
 class aio_ctx
 {
 	obj_allocator<struct iocb> iocb_allocator;
@@ -57,21 +73,53 @@ public:
 	virtual ~aio_ctx() {
 	}
 
-	struct iocb* make_io_request(int fd, size_t iosize, long long offset,
+	/*
+	 * To the users of aio_ctx, a request is an opaque handle. An aio_ctx
+	 * implementation may use its own request structure.
+	 */
+	virtual struct iocb* make_io_request(int fd, size_t iosize, long long offset,
 			void* buffer, int io_type, struct io_callback_s *cb);
-	struct iocb *make_iovec_request(int fd, const struct iovec iov[],
+	virtual struct iocb *make_iovec_request(int fd, const struct iovec iov[],
 			int count, long long offset, int io_type, struct io_callback_s *cb);
-	void destroy_io_requests(struct iocb **iocbs, int num) {
+	virtual void destroy_io_requests(struct iocb **iocbs, int num) {
 		iocb_allocator.free(iocbs, num);
 	}
 
+	/*
+	 * These notify the context of the files that are going to be accessed
+	 * and the files that won't be accessed any more, so the context can
+	 * register them in the kernel.
+	 */
+	virtual void register_files(const std::vector<int> &fds) {
+	}
+	virtual void unregister_files(const std::vector<int> &fds) {
+	}
+
 	virtual void submit_io_request(struct iocb* ioq[], int num) = 0;
+	/*
+	 * Wait for at least `num' requests to complete and process all
+	 * completed requests. If `num' is 0, it doesn't block.
+	 */
 	virtual int io_wait(struct timespec* to, int num) = 0;
 	virtual int max_io_slot() = 0;
 	virtual void print_stat() {
 	}
 };
 
+/*
+ * Create an aio context of the type specified in the system parameters.
+ * It falls back to libaio if the requested implementation isn't available.
+ */
+aio_ctx *create_aio_ctx(int node_id, int max_aio);
+
+/*
+ * Register a memory region that is used as I/O buffers for a long time
+ * (e.g., the pages in the page cache). An aio context may map the regions
+ * on its own NUMA node in the kernel in advance to avoid pinning pages
+ * for every request.
+ */
+void register_io_buf(char *buf, size_t size, int node_id);
+
 class aio_ctx_impl: public aio_ctx
 {
 	int max_aio;
@@ -99,6 +147,126 @@ public:
 	virtual int max_io_slot();
 };
 
+#ifdef USE_IO_URING
+
+/*
+ * The aio context implemented with io_uring.
+ * It registers the files and the I/O buffers in the kernel, so the kernel
+ * doesn't need to look up files and pin user pages for every request.
+ * If SQ polling is enabled, a kernel thread fetches requests from
+ * the submission queue and we don't need a system call to submit requests.
+ */
+class aio_ctx_uring: public aio_ctx
+{
+	/*
+	 * The request structure used by io_uring.
+	 */
+	struct uring_iocb
+	{
+		io_callback_s *cb;
+		int fd;
+		int io_type;
+		// The number of buffers. It's 0 if the request has a single buffer.
+		int num_bufs;
+		union {
+			void *buf;
+			const struct iovec *iov;
+		};
+		size_t size;
+		long long offset;
+	};
+
+	/*
+	 * The memory-mapped submission queue.
+	 */
+	struct sq_ring {
+		unsigned *head;
+		unsigned *tail;
+		unsigned *ring_mask;
+		unsigned *flags;
+		unsigned *array;
+		struct io_uring_sqe *sqes;
+	};
+
+	/*
+	 * The memory-mapped completion queue.
+	 */
+	struct cq_ring {
+		unsigned *head;
+		unsigned *tail;
+		unsigned *ring_mask;
+		struct io_uring_cqe *cqes;
+	};
+
+	obj_allocator<uring_iocb> req_allocator;
+	// Only the I/O buffers on this node are registered.
+	int node_id;
+	int ring_fd;
+	int max_aio;
+	int busy_aio;
+	unsigned features;
+	bool sq_poll;
+	sq_ring sq;
+	cq_ring cq;
+	void *sq_ptr;
+	size_t sq_map_size;
+	void *cq_ptr;
+	size_t cq_map_size;
+	void *sqes_ptr;
+	size_t sqes_map_size;
+
+	// The slots in the fixed file table.
+	bool fixed_files;
+	std::unordered_map<int, int> file_slots;
+	std::vector<int> free_file_slots;
+
+	// The registered buffers. The key is the end address of a buffer,
+	// the value is the index of the buffer in the kernel.
+	bool fixed_bufs;
+	size_t buf_gen;
+	std::map<char *, std::pair<char *, int> > bufs;
+
+	long num_submit_calls;
+	long num_wait_calls;
+	long num_reqs;
+	long num_fixed_buf_reqs;
+
+	int enter(unsigned to_submit, unsigned min_complete, unsigned flags,
+			struct timespec *to);
+	void update_bufs();
+	int get_buf_idx(const void *buf, size_t size) const;
+	int get_file_slot(int fd) const {
+		auto it = file_slots.find(fd);
+		if (it == file_slots.end())
+			return -1;
+		else
+			return it->second;
+	}
+public:
+	aio_ctx_uring(int node_id, int max_aio, bool sq_poll);
+	~aio_ctx_uring();
+
+	virtual struct iocb* make_io_request(int fd, size_t iosize, long long offset,
+			void* buffer, int io_type, struct io_callback_s *cb);
+	virtual struct iocb *make_iovec_request(int fd, const struct iovec iov[],
+			int count, long long offset, int io_type, struct io_callback_s *cb);
+	virtual void destroy_io_requests(struct iocb **iocbs, int num) {
+		req_allocator.free((uring_iocb **) iocbs, num);
+	}
+
+	virtual void register_files(const std::vector<int> &fds);
+	virtual void unregister_files(const std::vector<int> &fds);
+
+	virtual void submit_io_request(struct iocb* ioq[], int num);
+	virtual int io_wait(struct timespec* to, int num);
+	virtual int max_io_slot() {
+		return max_aio - busy_aio;
+	}
+	virtual void print_stat();
+};
+
+#endif
+
 typedef void (*callback_t) (io_context_t, struct iocb*[],
 		void *[], long *, long *, int);
 
@@ -472,6 +472,9 @@ async_cres_t EM_matrix_store::get_portion_async(
 
 	safs::data_loc_t loc(io.get_file_id(), off);
 	safs::io_request req(buf->get_raw_arr(), loc, num_bytes, READ);
+	// Streaming a matrix shouldn't delay the latency-sensitive requests
+	// to the same disks.
+	req.set_prio_class(safs::IO_PRIO_BULK);
 	static_cast<portion_callback &>(io.get_callback()).add(req, compute);
 	io.access(&req, 1);
 	io.flush_requests();
@@ -561,6 +564,7 @@ void EM_matrix_store::_write_portion_async(
 	safs::data_loc_t loc(io.get_file_id(), off);
 	safs::io_request req(const_cast<char *>(portion->get_raw_arr()),
 			loc, num_bytes, WRITE);
+	req.set_prio_class(safs::IO_PRIO_BULK);
 	detail::matrix_stats.inc_write_bytes(num_bytes, false);
 	portion_compute::ptr compute(new portion_write_complete(portion));
 	static_cast<portion_callback &>(io.get_callback()).add(req, compute);
@@ -463,6 +463,13 @@ void comm_show_info(int argc, char *argv[])
 	printf("RAID block size: %d\n", header.get_block_size() * PAGE_SIZE);
 	printf("RAID mapping option: %d\n", header.get_mapping_option());
 	printf("file size: %ld\n", header.get_size());
+	std::vector<int> weights = header.get_disk_weights();
+	if (!weights.empty()) {
+		printf("disk weights:");
+		for (size_t i = 0; i < weights.size(); i++)
+			printf(" %d", weights[i]);
+		printf("\n");
+	}
 }
 
 void comm_rename(int argc, char *argv[])
@@ -487,6 +494,141 @@ void comm_rename(int argc, char *argv[])
 				new_name.c_str());
 }
 
+/*
+ * Copy the data of an SAFS file to a new file with the RAID mapping in
+ * the current config, and replace the file with the new one.
+ */
+void comm_relayout(int argc, char *argv[])
+{
+	if (argc < 1) {
+		fprintf(stderr, "relayout file_name [RAID_mapping]\n");
+		return;
+	}
+
+	std::string file_name = argv[0];
+	if (argc >= 2)
+		configs->add_options((std::string("RAID_mapping=") + argv[1]).c_str());
+	configs->add_options("writable=1");
+	init_io_system(configs, false);
+	const RAID_config &conf = get_sys_RAID_conf();
+	safs_file old_file(conf, file_name);
+	if (!old_file.exist()) {
+		fprintf(stderr, "%s doesn't exist in SAFS\n", file_name.c_str());
+		return;
+	}
+	std::string tmp_name = file_name + ".relayout";
+	safs_file new_file(conf, tmp_name);
+	if (new_file.exist()) {
+		fprintf(stderr, "%s exists in SAFS\n", tmp_name.c_str());
+		return;
+	}
+
+	file_io_factory::shared_ptr in_factory = create_io_factory(file_name,
+			REMOTE_ACCESS);
+	size_t file_size = in_factory->get_header().get_size();
+	if (file_size == 0)
+		file_size = in_factory->get_file_size();
+	int block_size = in_factory->get_header().get_block_size();
+	if (block_size == 0)
+		block_size = params.get_RAID_block_size();
+	bool ret = new_file.create_file(file_size, block_size,
+			params.get_RAID_mapping_option());
+	if (!ret) {
+		fprintf(stderr, "can't create %s\n", tmp_name.c_str());
+		return;
+	}
+	file_io_factory::shared_ptr out_factory = create_io_factory(tmp_name,
+			REMOTE_ACCESS);
+	io_interface::ptr in = create_io(in_factory, thread::get_curr_thread());
+	io_interface::ptr out = create_io(out_factory, thread::get_curr_thread());
+
+	size_t buf_size = 16 * 1024 * 1024;
+	char *buf = (char *) valloc(buf_size);
+	assert(buf);
+	for (size_t off = 0; off < file_size; off += buf_size) {
+		// We access the SAFS files with direct I/O, so the size has to be
+		// rounded up to the page size.
+		size_t size = min(buf_size, ROUNDUP(file_size - off, PAGE_SIZE));
+		io_request read_req(buf, data_loc_t(in->get_file_id(), off), size,
+				READ);
+		in->access(&read_req, 1);
+		in->wait4complete(1);
+		io_request write_req(buf, data_loc_t(out->get_file_id(), off), size,
+				WRITE);
+		out->access(&write_req, 1);
+		out->wait4complete(1);
+	}
+	free(buf);
+	in->cleanup();
+	out->cleanup();
+	in.reset();
+	out.reset();
+
+	std::vector<char> metadata = old_file.get_user_metadata();
+	if (!metadata.empty())
+		new_file.set_user_metadata(metadata);
+	old_file.delete_file();
+	ret = new_file.rename(file_name);
+	if (!ret)
+		fprintf(stderr, "can't rename %s to %s\n", tmp_name.c_str(),
+				file_name.c_str());
+	else
+		printf("relayout %s of %ld bytes\n", file_name.c_str(), file_size);
+}
+
+/*
+ * Measure the read bandwidth of the disks in the RAID config and print
+ * the RAID config with the weights of the disks. The slowest disk gets
+ * the weight of 4, so the weights can express the difference of 25%.
+ */
+void comm_measure_bw(int argc, char *argv[])
+{
+	size_t size = 1024L * 1024 * 1024;
+	if (argc >= 1)
+		size = str2size(argv[0]);
+	size = ROUNDUP(size, BUF_SIZE);
+
+	init_io_system(configs, false);
+	const RAID_config &conf = get_sys_RAID_conf();
+	char *buf = (char *) valloc(BUF_SIZE);
+	assert(buf);
+	memset(buf, 0, BUF_SIZE);
+	std::vector<double> bws(conf.get_num_disks());
+	for (int i = 0; i < conf.get_num_disks(); i++) {
+		std::string test_file = conf.get_disk(i).get_file_name() + "/bw_test";
+		int fd = open(test_file.c_str(), O_RDWR | O_CREAT | O_DIRECT, 0644);
+		if (fd < 0) {
+			perror("open");
+			exit(-1);
+		}
+		for (off_t off = 0; off < (off_t) size; off += BUF_SIZE) {
+			ssize_t ret = pwrite(fd, buf, BUF_SIZE, off);
+			BOOST_VERIFY(ret == BUF_SIZE);
+		}
+		fsync(fd);
+
+		long start = get_curr_ns();
+		for (off_t off = 0; off < (off_t) size; off += BUF_SIZE) {
+			ssize_t ret = pread(fd, buf, BUF_SIZE, off);
+			BOOST_VERIFY(ret == BUF_SIZE);
+		}
+		bws[i] = ((double) size) / (get_curr_ns() - start) * 1000;
+		close(fd);
+		unlink(test_file.c_str());
+		printf("%s: %.1f MB/s\n", conf.get_disk(i).get_file_name().c_str(),
+				bws[i]);
+	}
+	free(buf);
+
+	double min_bw = *std::min_element(bws.begin(), bws.end());
+	printf("RAID config with the weights:\n");
+	for (int i = 0; i < conf.get_num_disks(); i++) {
+		int weight = std::max(1, (int) (bws[i] / min_bw * 4 + 0.5));
+		printf("%d:%s:%d\n", conf.get_disk(i).get_node_id(),
+				conf.get_disk(i).get_file_name().c_str(), weight);
+	}
+}
+
 typedef void (*command_func_t)(int argc, char *argv[]);
 
 struct command
@@ -516,6 +658,10 @@ struct command commands[] = {
 		"info file_name: show the information of an SAFS file"},
 	{"rename", comm_rename,
 		"rename file_name new_name: rename an SAFS file"},
+	{"relayout", comm_relayout,
+		"relayout file_name [RAID_mapping]: move the data of an SAFS file to a new RAID mapping"},
+	{"measure_bw", comm_measure_bw,
+		"measure_bw [size]: measure the bandwidth of the disks and print the weights of the disks"},
 };
 
 int get_num_commands()